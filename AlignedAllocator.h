@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+// std::vector allocator for SIMD streams, every block starts on an Alignment byte boundary so kernels can use
+// aligned loads. 32 bytes covers AVX.
+template <typename T, size_t Alignment = 32>
+struct AlignedAllocator {
+	typedef T value_type;
+
+	template <typename U>
+	struct rebind {
+		typedef AlignedAllocator<U, Alignment> other;
+	};
+
+	AlignedAllocator() {}
+	template <typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+	T* allocate(size_t count) {
+		void* p = nullptr;
+#if defined(_MSC_VER)
+		p = _aligned_malloc(count * sizeof(T), Alignment);
+#else
+		if (posix_memalign(&p, Alignment, count * sizeof(T)) != 0) {
+			p = nullptr;
+		}
+#endif
+		if (!p) {
+			throw std::bad_alloc();
+		}
+		return (T*)p;
+	}
+
+	void deallocate(T* p, size_t) {
+#if defined(_MSC_VER)
+		_aligned_free(p);
+#else
+		free(p);
+#endif
+	}
+
+	template <typename U>
+	bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+	template <typename U>
+	bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
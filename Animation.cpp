@@ -0,0 +1,370 @@
+#include "Animation.h"
+#include "CpuFeatures.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#if defined(SIMD_X86)
+#include <immintrin.h>
+#endif
+
+static const size_t SIMD_WIDTH = 8;
+
+static float channelValue(const JointPose& pose, int c) {
+	switch (c) {
+	case ROTATION_X: return pose.rotation.x;
+	case ROTATION_Y: return pose.rotation.y;
+	case ROTATION_Z: return pose.rotation.z;
+	case ROTATION_W: return pose.rotation.w;
+	case TRANSLATION_X: return pose.translation.x;
+	case TRANSLATION_Y: return pose.translation.y;
+	case TRANSLATION_Z: return pose.translation.z;
+	case SCALE_X: return pose.scale.x;
+	case SCALE_Y: return pose.scale.y;
+	default: return pose.scale.z;
+	}
+}
+
+// value of each channel in the identity transform, used for padding joints
+static float identityValue(int c) {
+	return c == ROTATION_W || c >= SCALE_X ? 1.0f : 0.0f;
+}
+
+glm::mat4 jointMatrix(const JointPose& pose) {
+	return glm::scale(glm::translate(glm::mat4(1.0f), pose.translation) * glm::mat4_cast(pose.rotation), pose.scale);
+}
+
+void Skeleton::computeInverseBind() {
+	size_t count = jointCount();
+	std::vector<glm::mat4> model(count);
+	std::vector<glm::dualquat> modelDual(count);
+	for (size_t j = 0; j < count; j++) {
+		glm::mat4 local = jointMatrix(bindPose[j]);
+		glm::dualquat localDual(bindPose[j].rotation, bindPose[j].translation);
+		model[j] = parents[j] < 0 ? local : model[parents[j]] * local;
+		modelDual[j] = parents[j] < 0 ? localDual : modelDual[parents[j]] * localDual;
+	}
+	inverseBind.resize(count);
+	inverseBindDual.resize(count);
+	for (size_t j = 0; j < count; j++) {
+		inverseBind[j] = glm::inverse(model[j]);
+		inverseBindDual[j] = glm::inverse(glm::normalize(modelDual[j]));
+	}
+}
+
+void PoseSoA::resize(size_t joints) {
+	if (joints == jointCount && !data.empty()) {
+		return;
+	}
+	jointCount = joints;
+	stride = (joints + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+	data.assign(POSE_CHANNELS * stride, 0.0f);
+	for (int c = 0; c < POSE_CHANNELS; c++) {
+		std::fill(channel(c), channel(c) + stride, identityValue(c));
+	}
+}
+
+JointPose PoseSoA::joint(size_t index) const {
+	JointPose pose;
+	pose.rotation = glm::quat(channel(ROTATION_W)[index], channel(ROTATION_X)[index], channel(ROTATION_Y)[index], channel(ROTATION_Z)[index]);
+	pose.translation = glm::vec3(channel(TRANSLATION_X)[index], channel(TRANSLATION_Y)[index], channel(TRANSLATION_Z)[index]);
+	pose.scale = glm::vec3(channel(SCALE_X)[index], channel(SCALE_Y)[index], channel(SCALE_Z)[index]);
+	return pose;
+}
+
+void PoseSoA::setJoint(size_t index, const JointPose& pose) {
+	for (int c = 0; c < POSE_CHANNELS; c++) {
+		channel(c)[index] = channelValue(pose, c);
+	}
+}
+
+AnimationClip compressClip(const JointPose* frames, size_t frameCount, size_t jointCount, float sampleRate, const char* name) {
+	AnimationClip clip;
+	clip.name = name;
+	clip.jointCount = (uint32_t)jointCount;
+	clip.stride = (uint32_t)((jointCount + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH);
+	clip.frameCount = (uint32_t)frameCount;
+	clip.sampleRate = sampleRate;
+	size_t stride = clip.stride;
+
+	// q and -q are the same rotation, keep each joint's keys in the hemisphere of the previous key
+	std::vector<JointPose> poses(frames, frames + frameCount * jointCount);
+	for (size_t f = 1; f < frameCount; f++) {
+		for (size_t j = 0; j < jointCount; j++) {
+			JointPose& pose = poses[f * jointCount + j];
+			if (glm::dot(pose.rotation, poses[(f - 1) * jointCount + j].rotation) < 0.0f) {
+				pose.rotation = -pose.rotation;
+			}
+		}
+	}
+
+	clip.rangeMin.assign(POSE_CHANNELS * stride, 0.0f);
+	clip.rangeScale.assign(POSE_CHANNELS * stride, 0.0f);
+	clip.samples.assign(frameCount * POSE_CHANNELS * stride, 0);
+	for (int c = 0; c < POSE_CHANNELS; c++) {
+		for (size_t j = 0; j < stride; j++) {
+			float lo = identityValue(c), hi = lo;
+			if (j < jointCount && frameCount > 0) {
+				lo = hi = channelValue(poses[j], c);
+				for (size_t f = 1; f < frameCount; f++) {
+					float v = channelValue(poses[f * jointCount + j], c);
+					lo = std::min(lo, v);
+					hi = std::max(hi, v);
+				}
+			}
+			clip.rangeMin[c * stride + j] = lo;
+			clip.rangeScale[c * stride + j] = (hi - lo) / 65535.0f;
+			if (j >= jointCount || hi <= lo) {
+				continue;
+			}
+			for (size_t f = 0; f < frameCount; f++) {
+				float v = channelValue(poses[f * jointCount + j], c);
+				clip.samples[(f * POSE_CHANNELS + c) * stride + j] = (uint16_t)std::lround((v - lo) / (hi - lo) * 65535.0f);
+			}
+		}
+	}
+	return clip;
+}
+
+// keys to interpolate between and the weight of the second one
+static void clipFrames(const AnimationClip& clip, float time, bool loop, size_t& first, size_t& second, float& alpha) {
+	float duration = clip.duration();
+	if (loop && duration > 0.0f) {
+		time = std::fmod(time, duration);
+		if (time < 0.0f) {
+			time += duration;
+		}
+	}
+	float position = std::min(std::max(time, 0.0f), duration) * clip.sampleRate;
+	first = std::min((size_t)position, (size_t)clip.frameCount - 1);
+	second = std::min(first + 1, (size_t)clip.frameCount - 1);
+	alpha = first == second ? 0.0f : position - (float)first;
+}
+
+// ---------------------------------------------------------------------------------------------
+// scalar reference paths
+
+static void decodeLerpScalar(const uint16_t* a, const uint16_t* b, const float* rangeMin, const float* rangeScale, float alpha, float* out, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		float va = rangeMin[i] + a[i] * rangeScale[i];
+		float vb = rangeMin[i] + b[i] * rangeScale[i];
+		out[i] = va + (vb - va) * alpha;
+	}
+}
+
+static void normalizeRotationsScalar(PoseSoA& pose) {
+	float* x = pose.channel(ROTATION_X);
+	float* y = pose.channel(ROTATION_Y);
+	float* z = pose.channel(ROTATION_Z);
+	float* w = pose.channel(ROTATION_W);
+	for (size_t j = 0; j < pose.stride; j++) {
+		float scale = 1.0f / std::sqrt(x[j] * x[j] + y[j] * y[j] + z[j] * z[j] + w[j] * w[j]);
+		x[j] *= scale;
+		y[j] *= scale;
+		z[j] *= scale;
+		w[j] *= scale;
+	}
+}
+
+void sampleClipScalar(const AnimationClip& clip, float time, bool loop, PoseSoA& out) {
+	out.resize(clip.jointCount);
+	if (clip.frameCount == 0) {
+		return;
+	}
+	size_t first, second;
+	float alpha;
+	clipFrames(clip, time, loop, first, second, alpha);
+	size_t frameSize = POSE_CHANNELS * (size_t)clip.stride;
+	decodeLerpScalar(clip.samples.data() + first * frameSize, clip.samples.data() + second * frameSize, clip.rangeMin.data(), clip.rangeScale.data(), alpha, out.data.data(), frameSize);
+	normalizeRotationsScalar(out);
+}
+
+void blendPosesScalar(const PoseSoA& a, const PoseSoA& b, float weight, PoseSoA& out) {
+	out.resize(a.jointCount);
+	const float* ax = a.channel(ROTATION_X), * ay = a.channel(ROTATION_Y), * az = a.channel(ROTATION_Z), * aw = a.channel(ROTATION_W);
+	const float* bx = b.channel(ROTATION_X), * by = b.channel(ROTATION_Y), * bz = b.channel(ROTATION_Z), * bw = b.channel(ROTATION_W);
+	float* ox = out.channel(ROTATION_X), * oy = out.channel(ROTATION_Y), * oz = out.channel(ROTATION_Z), * ow = out.channel(ROTATION_W);
+	for (size_t j = 0; j < a.stride; j++) {
+		float dot = ax[j] * bx[j] + ay[j] * by[j] + az[j] * bz[j] + aw[j] * bw[j];
+		float wb = dot < 0.0f ? -weight : weight;
+		float wa = 1.0f - weight;
+		ox[j] = ax[j] * wa + bx[j] * wb;
+		oy[j] = ay[j] * wa + by[j] * wb;
+		oz[j] = az[j] * wa + bz[j] * wb;
+		ow[j] = aw[j] * wa + bw[j] * wb;
+	}
+	normalizeRotationsScalar(out);
+	for (size_t i = TRANSLATION_X * a.stride; i < POSE_CHANNELS * a.stride; i++) {
+		out.data[i] = a.data[i] + (b.data[i] - a.data[i]) * weight;
+	}
+}
+
+// ---------------------------------------------------------------------------------------------
+// AVX2 paths, 8 joints per step. Pose and clip arrays are 32 byte aligned and padded to 8 joints.
+
+#if defined(SIMD_X86)
+
+TARGET_AVX2 static void decodeLerpAVX2(const uint16_t* a, const uint16_t* b, const float* rangeMin, const float* rangeScale, float alpha, float* out, size_t count) {
+	__m256 t = _mm256_set1_ps(alpha);
+	for (size_t i = 0; i < count; i += 8) {
+		__m256 qa = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_load_si128((const __m128i*)(a + i))));
+		__m256 qb = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_load_si128((const __m128i*)(b + i))));
+		__m256 lo = _mm256_load_ps(rangeMin + i);
+		__m256 scale = _mm256_load_ps(rangeScale + i);
+		__m256 va = _mm256_add_ps(lo, _mm256_mul_ps(qa, scale));
+		__m256 vb = _mm256_add_ps(lo, _mm256_mul_ps(qb, scale));
+		_mm256_store_ps(out + i, _mm256_add_ps(va, _mm256_mul_ps(_mm256_sub_ps(vb, va), t)));
+	}
+}
+
+TARGET_AVX2 static void normalizeRotationsAVX2(PoseSoA& pose) {
+	float* x = pose.channel(ROTATION_X);
+	float* y = pose.channel(ROTATION_Y);
+	float* z = pose.channel(ROTATION_Z);
+	float* w = pose.channel(ROTATION_W);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	for (size_t j = 0; j < pose.stride; j += 8) {
+		__m256 vx = _mm256_load_ps(x + j), vy = _mm256_load_ps(y + j), vz = _mm256_load_ps(z + j), vw = _mm256_load_ps(w + j);
+		__m256 length = _mm256_mul_ps(vx, vx);
+		length = _mm256_add_ps(length, _mm256_mul_ps(vy, vy));
+		length = _mm256_add_ps(length, _mm256_mul_ps(vz, vz));
+		length = _mm256_add_ps(length, _mm256_mul_ps(vw, vw));
+		// sqrt and divide rather than rsqrt, the 12 bit estimate would be coarser than the quantized keys
+		__m256 scale = _mm256_div_ps(one, _mm256_sqrt_ps(length));
+		_mm256_store_ps(x + j, _mm256_mul_ps(vx, scale));
+		_mm256_store_ps(y + j, _mm256_mul_ps(vy, scale));
+		_mm256_store_ps(z + j, _mm256_mul_ps(vz, scale));
+		_mm256_store_ps(w + j, _mm256_mul_ps(vw, scale));
+	}
+}
+
+TARGET_AVX2 static void sampleClipAVX2(const AnimationClip& clip, float time, bool loop, PoseSoA& out) {
+	out.resize(clip.jointCount);
+	if (clip.frameCount == 0) {
+		return;
+	}
+	size_t first, second;
+	float alpha;
+	clipFrames(clip, time, loop, first, second, alpha);
+	size_t frameSize = POSE_CHANNELS * (size_t)clip.stride;
+	decodeLerpAVX2(clip.samples.data() + first * frameSize, clip.samples.data() + second * frameSize, clip.rangeMin.data(), clip.rangeScale.data(), alpha, out.data.data(), frameSize);
+	normalizeRotationsAVX2(out);
+}
+
+TARGET_AVX2 static void blendPosesAVX2(const PoseSoA& a, const PoseSoA& b, float weight, PoseSoA& out) {
+	out.resize(a.jointCount);
+	const float* ax = a.channel(ROTATION_X), * ay = a.channel(ROTATION_Y), * az = a.channel(ROTATION_Z), * aw = a.channel(ROTATION_W);
+	const float* bx = b.channel(ROTATION_X), * by = b.channel(ROTATION_Y), * bz = b.channel(ROTATION_Z), * bw = b.channel(ROTATION_W);
+	float* ox = out.channel(ROTATION_X), * oy = out.channel(ROTATION_Y), * oz = out.channel(ROTATION_Z), * ow = out.channel(ROTATION_W);
+	const __m256 signBit = _mm256_set1_ps(-0.0f);
+	const __m256 wa = _mm256_set1_ps(1.0f - weight);
+	const __m256 w = _mm256_set1_ps(weight);
+	for (size_t j = 0; j < a.stride; j += 8) {
+		__m256 vax = _mm256_load_ps(ax + j), vay = _mm256_load_ps(ay + j), vaz = _mm256_load_ps(az + j), vaw = _mm256_load_ps(aw + j);
+		__m256 vbx = _mm256_load_ps(bx + j), vby = _mm256_load_ps(by + j), vbz = _mm256_load_ps(bz + j), vbw = _mm256_load_ps(bw + j);
+		__m256 dot = _mm256_mul_ps(vax, vbx);
+		dot = _mm256_add_ps(dot, _mm256_mul_ps(vay, vby));
+		dot = _mm256_add_ps(dot, _mm256_mul_ps(vaz, vbz));
+		dot = _mm256_add_ps(dot, _mm256_mul_ps(vaw, vbw));
+		// flips b's weight where the rotations are in opposite hemispheres
+		__m256 wb = _mm256_xor_ps(w, _mm256_and_ps(dot, signBit));
+		_mm256_store_ps(ox + j, _mm256_add_ps(_mm256_mul_ps(vax, wa), _mm256_mul_ps(vbx, wb)));
+		_mm256_store_ps(oy + j, _mm256_add_ps(_mm256_mul_ps(vay, wa), _mm256_mul_ps(vby, wb)));
+		_mm256_store_ps(oz + j, _mm256_add_ps(_mm256_mul_ps(vaz, wa), _mm256_mul_ps(vbz, wb)));
+		_mm256_store_ps(ow + j, _mm256_add_ps(_mm256_mul_ps(vaw, wa), _mm256_mul_ps(vbw, wb)));
+	}
+	normalizeRotationsAVX2(out);
+	for (size_t i = TRANSLATION_X * a.stride; i < POSE_CHANNELS * a.stride; i += 8) {
+		__m256 va = _mm256_load_ps(a.data.data() + i);
+		__m256 vb = _mm256_load_ps(b.data.data() + i);
+		_mm256_store_ps(out.data.data() + i, _mm256_add_ps(va, _mm256_mul_ps(_mm256_sub_ps(vb, va), w)));
+	}
+}
+
+#endif
+
+// ---------------------------------------------------------------------------------------------
+// dispatch
+
+void sampleClip(const AnimationClip& clip, float time, bool loop, PoseSoA& out) {
+#if defined(SIMD_X86)
+	if (cpuFeatures().avx2) {
+		sampleClipAVX2(clip, time, loop, out);
+		return;
+	}
+#endif
+	sampleClipScalar(clip, time, loop, out);
+}
+
+void blendPoses(const PoseSoA& a, const PoseSoA& b, float weight, PoseSoA& out) {
+#if defined(SIMD_X86)
+	if (cpuFeatures().avx2) {
+		blendPosesAVX2(a, b, weight, out);
+		return;
+	}
+#endif
+	blendPosesScalar(a, b, weight, out);
+}
+
+// ---------------------------------------------------------------------------------------------
+// palettes
+
+// The hierarchy walk is serial, each joint needs its parent. The palette holds model space transforms
+// until every joint is done, then each one is multiplied by its inverse bind transform in place.
+void computeDualQuatPalette(const Skeleton& skeleton, const PoseSoA& pose, glm::dualquat* palette) {
+	const float* rx = pose.channel(ROTATION_X), * ry = pose.channel(ROTATION_Y), * rz = pose.channel(ROTATION_Z), * rw = pose.channel(ROTATION_W);
+	const float* tx = pose.channel(TRANSLATION_X), * ty = pose.channel(TRANSLATION_Y), * tz = pose.channel(TRANSLATION_Z);
+	size_t count = skeleton.jointCount();
+	for (size_t j = 0; j < count; j++) {
+		glm::dualquat local(glm::quat(rw[j], rx[j], ry[j], rz[j]), glm::vec3(tx[j], ty[j], tz[j]));
+		int parent = skeleton.parents[j];
+		palette[j] = parent < 0 ? local : palette[parent] * local;
+	}
+	for (size_t j = 0; j < count; j++) {
+		palette[j] = palette[j] * skeleton.inverseBindDual[j];
+	}
+}
+
+void computeMatrixPalette(const Skeleton& skeleton, const PoseSoA& pose, glm::mat4* palette) {
+	size_t count = skeleton.jointCount();
+	for (size_t j = 0; j < count; j++) {
+		glm::mat4 local = jointMatrix(pose.joint(j));
+		int parent = skeleton.parents[j];
+		palette[j] = parent < 0 ? local : palette[parent] * local;
+	}
+	for (size_t j = 0; j < count; j++) {
+		palette[j] = palette[j] * skeleton.inverseBind[j];
+	}
+}
+
+// characters per parallelFor job, the pool takes a lock per job
+static const size_t CHARACTER_BATCH = 16;
+
+void animateCharacters(Character* characters, size_t count, ThreadPool& pool, bool dualQuaternions) {
+	size_t batches = (count + CHARACTER_BATCH - 1) / CHARACTER_BATCH;
+	pool.parallelFor(batches, [&](size_t batch) {
+		// scratch poses stay allocated on each thread between frames
+		thread_local PoseSoA poses[2];
+		size_t end = std::min(count, (batch + 1) * CHARACTER_BATCH);
+		for (size_t i = batch * CHARACTER_BATCH; i < end; i++) {
+			Character& character = characters[i];
+			sampleClip(*character.clips[0], character.times[0], true, poses[0]);
+			if (character.blend > 0.0f && character.clips[1]) {
+				sampleClip(*character.clips[1], character.times[1], true, poses[1]);
+				blendPoses(poses[0], poses[1], character.blend, poses[0]);
+			}
+			size_t joints = character.skeleton->jointCount();
+			if (dualQuaternions) {
+				character.palette.resize(joints);
+				computeDualQuatPalette(*character.skeleton, poses[0], character.palette.data());
+			}
+			else {
+				character.matrices.resize(joints);
+				computeMatrixPalette(*character.skeleton, poses[0], character.matrices.data());
+			}
+		}
+	});
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#ifndef GLM_ENABLE_EXPERIMENTAL
+#define GLM_ENABLE_EXPERIMENTAL
+#endif
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtx/dual_quaternion.hpp>
+
+#include "AlignedAllocator.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// Skeletal animation runtime. Clips store quantized keyframes, poses are sampled and blended as structure of
+// arrays so the kernels work on 8 joints at a time (AVX2, with scalar fallbacks kept public as the reference),
+// and skinning palettes come out as dual quaternions or matrices. Characters are evaluated in parallel.
+
+// Local transform of a joint relative to its parent: scale, then rotation, then translation.
+struct JointPose {
+	glm::quat rotation;
+	glm::vec3 translation;
+	glm::vec3 scale;
+};
+
+//translation * rotation * scale
+glm::mat4 jointMatrix(const JointPose& pose);
+
+// Joints are ordered so every parent comes before its children, the root's parent is -1.
+struct Skeleton {
+	std::vector<std::string> names;
+	std::vector<int> parents;
+	std::vector<JointPose> bindPose;
+	// model space to joint space in the bind pose, filled by computeInverseBind
+	std::vector<glm::mat4> inverseBind;
+	// the same without scale, dual quaternions are rigid
+	std::vector<glm::dualquat> inverseBindDual;
+
+	size_t jointCount() const { return parents.size(); }
+	void computeInverseBind();
+};
+
+// Channels of a pose or a clip frame, each one a separate array over all joints.
+enum PoseChannel {
+	ROTATION_X, ROTATION_Y, ROTATION_Z, ROTATION_W,
+	TRANSLATION_X, TRANSLATION_Y, TRANSLATION_Z,
+	SCALE_X, SCALE_Y, SCALE_Z,
+	POSE_CHANNELS
+};
+
+// Pose of every joint as one array per channel. Arrays are padded to a multiple of 8 joints with identity
+// transforms, so SIMD kernels never need a tail loop.
+struct PoseSoA {
+	size_t jointCount = 0;
+	size_t stride = 0;
+	std::vector<float, AlignedAllocator<float>> data;
+
+	void resize(size_t joints);
+	float* channel(int c) { return data.data() + c * stride; }
+	const float* channel(int c) const { return data.data() + c * stride; }
+	JointPose joint(size_t index) const;
+	void setJoint(size_t index, const JointPose& pose);
+};
+
+// Keyframes sampled at a fixed rate. Every channel of every joint is stored as 16 bits inside that channel's
+// range over the clip, rotations are flipped into one hemisphere per joint first so neighbouring keys
+// interpolate the short way. Frames are stored whole, a sample reads two contiguous blocks.
+struct AnimationClip {
+	std::string name;
+	uint32_t jointCount = 0;
+	uint32_t stride = 0;
+	uint32_t frameCount = 0;
+	float sampleRate = 30.0f;
+	// value = rangeMin + stored * rangeScale, indexed [channel * stride + joint]
+	std::vector<float, AlignedAllocator<float>> rangeMin;
+	std::vector<float, AlignedAllocator<float>> rangeScale;
+	// [(frame * POSE_CHANNELS + channel) * stride + joint]
+	std::vector<uint16_t, AlignedAllocator<uint16_t>> samples;
+
+	float duration() const { return frameCount > 1 ? (frameCount - 1) / sampleRate : 0.0f; }
+	size_t bytes() const { return samples.size() * sizeof(uint16_t) + (rangeMin.size() + rangeScale.size()) * sizeof(float); }
+};
+
+//quantizes frames[frame * jointCount + joint] taken at sampleRate per second
+AnimationClip compressClip(const JointPose* frames, size_t frameCount, size_t jointCount, float sampleRate, const char* name = "");
+
+//interpolates the clip at time (seconds) into out, which must have the clip's joint count.
+//loop wraps time around the duration, otherwise it is clamped.
+void sampleClip(const AnimationClip& clip, float time, bool loop, PoseSoA& out);
+void sampleClipScalar(const AnimationClip& clip, float time, bool loop, PoseSoA& out);
+
+//out = a * (1 - weight) + b * weight, rotations take the short way and are renormalized. out may alias a or b.
+void blendPoses(const PoseSoA& a, const PoseSoA& b, float weight, PoseSoA& out);
+void blendPosesScalar(const PoseSoA& a, const PoseSoA& b, float weight, PoseSoA& out);
+
+//walks the hierarchy and writes one skinning transform per joint, bind pose vertices to model space.
+//Dual quaternions ignore scale, matrices keep it.
+void computeDualQuatPalette(const Skeleton& skeleton, const PoseSoA& pose, glm::dualquat* palette);
+void computeMatrixPalette(const Skeleton& skeleton, const PoseSoA& pose, glm::mat4* palette);
+
+// One animated instance, two clips cross faded by blend. animateCharacters fills the palette.
+struct Character {
+	const Skeleton* skeleton = nullptr;
+	const AnimationClip* clips[2] = { nullptr, nullptr };
+	float times[2] = { 0.0f, 0.0f };
+	// 0 plays clips[0] only, 1 plays clips[1] only, clips[1] may be null when this is 0
+	float blend = 0.0f;
+	std::vector<glm::dualquat> palette;
+	std::vector<glm::mat4> matrices;
+};
+
+//samples, blends and builds the palette (or matrices) of every character, batches of characters are spread
+//over the pool's threads
+void animateCharacters(Character* characters, size_t count, ThreadPool& pool, bool dualQuaternions = true);
+
+// Vertex of a skinned mesh as shader_skinned.vert reads it: locations 0 to 2 as in Vertex,
+// 3 joint indices (4 bytes, glVertexAttribIPointer), 4 weights summing to 1.
+struct SkinnedVertex {
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 texCoord;
+	uint8_t joints[4];
+	glm::vec4 weights;
+};
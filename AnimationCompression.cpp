@@ -0,0 +1,463 @@
+#include "AnimationCompression.h"
+#include "CpuFeatures.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#if defined(SIMD_X86)
+#include <immintrin.h>
+#endif
+
+enum TrackKind {
+	TRACK_ROTATION,
+	TRACK_TRANSLATION,
+	TRACK_SCALE,
+	TRACK_KINDS
+};
+
+// first pose channel and channel count of each kind
+static const int KIND_CHANNEL[TRACK_KINDS] = { ROTATION_X, TRANSLATION_X, SCALE_X };
+static const int KIND_CHANNELS[TRACK_KINDS] = { 4, 3, 3 };
+
+static const float SQRT_HALF = 0.70710678f;
+static const float SMALLEST_THREE_STEPS = 32767.0f;
+
+// ---------------------------------------------------------------------------------------------
+// key encoding
+
+// Drops the largest component of the unit quaternion and stores the other three in 15 bits each, they lie in
+// [-sqrt(1/2), sqrt(1/2)]. The largest one is made positive (q and -q are the same rotation) and rebuilt
+// from the unit length, its index takes the top bits of the first two words.
+static void packRotation(const glm::quat& q, uint16_t data[3]) {
+	float c[4] = { q.x, q.y, q.z, q.w };
+	int largest = 0;
+	for (int i = 1; i < 4; i++) {
+		if (std::abs(c[i]) > std::abs(c[largest])) {
+			largest = i;
+		}
+	}
+	float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+	uint16_t stored[3];
+	int k = 0;
+	for (int i = 0; i < 4; i++) {
+		if (i == largest) {
+			continue;
+		}
+		float v = (c[i] * sign / SQRT_HALF + 1.0f) * 0.5f;
+		stored[k++] = (uint16_t)std::min(std::max(std::lround(v * SMALLEST_THREE_STEPS), 0L), (long)SMALLEST_THREE_STEPS);
+	}
+	data[0] = (uint16_t)(stored[0] | ((largest >> 1) << 15));
+	data[1] = (uint16_t)(stored[1] | ((largest & 1) << 15));
+	data[2] = stored[2];
+}
+
+static glm::vec4 unpackRotation(const uint16_t data[3]) {
+	const float scale = 2.0f * SQRT_HALF / SMALLEST_THREE_STEPS;
+	float a = (data[0] & 0x7FFF) * scale - SQRT_HALF;
+	float b = (data[1] & 0x7FFF) * scale - SQRT_HALF;
+	float c = data[2] * scale - SQRT_HALF;
+	float largest = std::sqrt(std::max(0.0f, 1.0f - a * a - b * b - c * c));
+	switch (((data[0] >> 15) << 1) | (data[1] >> 15)) {
+	case 0: return glm::vec4(largest, a, b, c);
+	case 1: return glm::vec4(a, largest, b, c);
+	case 2: return glm::vec4(a, b, largest, c);
+	default: return glm::vec4(a, b, c, largest);
+	}
+}
+
+static void packRange(const glm::vec3& v, const glm::vec3& rangeMin, const glm::vec3& rangeScale, uint16_t data[3]) {
+	for (int i = 0; i < 3; i++) {
+		data[i] = rangeScale[i] > 0.0f ? (uint16_t)std::min(std::max(std::lround((v[i] - rangeMin[i]) / rangeScale[i]), 0L), 65535L) : 0;
+	}
+}
+
+static glm::vec4 unpackRange(const uint16_t data[3], const glm::vec3& rangeMin, const glm::vec3& rangeScale) {
+	return glm::vec4(rangeMin + glm::vec3(data[0], data[1], data[2]) * rangeScale, 0.0f);
+}
+
+static glm::vec4 trackValue(const JointPose& pose, int kind) {
+	if (kind == TRACK_ROTATION) {
+		return glm::vec4(pose.rotation.x, pose.rotation.y, pose.rotation.z, pose.rotation.w);
+	}
+	return glm::vec4(kind == TRACK_TRANSLATION ? pose.translation : pose.scale, 0.0f);
+}
+
+// how far b is from a in the units the tolerance of the kind uses: radians for rotations, model units otherwise
+static float trackDistance(const glm::vec4& a, const glm::vec4& b, int kind) {
+	if (kind == TRACK_ROTATION) {
+		glm::quat difference = glm::inverse(glm::quat(a.w, a.x, a.y, a.z)) * glm::quat(b.w, b.x, b.y, b.z);
+		return 2.0f * std::atan2(glm::length(glm::vec3(difference.x, difference.y, difference.z)), std::abs(difference.w));
+	}
+	if (kind == TRACK_TRANSLATION) {
+		return glm::length(glm::vec3(a - b));
+	}
+	glm::vec3 d = glm::abs(glm::vec3(a - b));
+	return std::max(d.x, std::max(d.y, d.z));
+}
+
+// what the cursor computes between two decoded keys, rotations are normalized linear interpolations
+static glm::vec4 interpolateKeys(const glm::vec4& a, glm::vec4 b, float alpha, int kind) {
+	if (kind != TRACK_ROTATION) {
+		return a + (b - a) * alpha;
+	}
+	if (glm::dot(a, b) < 0.0f) {
+		b = -b;
+	}
+	return glm::normalize(a + (b - a) * alpha);
+}
+
+// ---------------------------------------------------------------------------------------------
+// compressor
+
+size_t StreamedClip::bytes() const {
+	return constants.size() * sizeof(glm::vec4) + (rangeMin.size() + rangeScale.size()) * sizeof(glm::vec3) + animated.size() + keys.size() * sizeof(StreamedKey);
+}
+
+bool compressStreamedClip(const Skeleton& skeleton, const JointPose* frames, size_t frameCount, float sampleRate, const AnimationCompressionSettings& settings,
+	StreamedClip& clip, AnimationCompressionReport* report, const char* name) {
+	size_t joints = skeleton.jointCount();
+	size_t tracks = joints * TRACK_KINDS;
+	if (frameCount > StreamedKey::MAX_FRAMES || tracks > StreamedKey::MAX_TRACKS) {
+		// keys store both in 16 bits, they would wrap around and play the wrong frames on the wrong joints
+		std::cout << "Animation " << name << " has " << frameCount << " frames and " << tracks << " tracks, streamed clips hold at most "
+			<< StreamedKey::MAX_FRAMES << " of each" << std::endl;
+		return false;
+	}
+	clip = StreamedClip();
+	clip.name = name;
+	clip.jointCount = (uint32_t)joints;
+	clip.frameCount = (uint32_t)frameCount;
+	clip.sampleRate = sampleRate;
+	clip.constants.assign(tracks, glm::vec4(0.0f));
+	clip.rangeMin.assign(tracks, glm::vec3(0.0f));
+	clip.rangeScale.assign(tracks, glm::vec3(0.0f));
+	clip.animated.assign(tracks, 0);
+
+	// Error budget per joint. A point below joint a moves by about angle * distance when a's rotation is off, so
+	// rotation and scale tolerances shrink with how far a's descendants reach. Every joint on the way from the root
+	// to a leaf adds its error to the leaf's, joints split the tolerance by the depth of the deepest leaf below them.
+	std::vector<glm::vec3> bindPosition(joints);
+	std::vector<glm::mat4> bindModel(joints);
+	std::vector<int> depth(joints), leafDepth(joints);
+	std::vector<float> reach(joints, 0.0f);
+	for (size_t j = 0; j < joints; j++) {
+		int parent = skeleton.parents[j];
+		bindModel[j] = parent < 0 ? jointMatrix(skeleton.bindPose[j]) : bindModel[parent] * jointMatrix(skeleton.bindPose[j]);
+		bindPosition[j] = glm::vec3(bindModel[j][3]);
+		depth[j] = parent < 0 ? 1 : depth[parent] + 1;
+		leafDepth[j] = depth[j];
+		for (int a = parent; a >= 0; a = skeleton.parents[a]) {
+			reach[a] = std::max(reach[a], glm::length(bindPosition[j] - bindPosition[a]));
+		}
+	}
+	for (size_t j = joints; j-- > 0;) {
+		int parent = skeleton.parents[j];
+		if (parent >= 0) {
+			leafDepth[parent] = std::max(leafDepth[parent], leafDepth[j]);
+		}
+	}
+
+	std::vector<glm::vec4> raw(frameCount), decoded(frameCount);
+	std::vector<std::pair<int, StreamedKey>> stream;
+	size_t constantTracks = 0;
+	for (size_t track = 0; track < tracks; track++) {
+		size_t joint = track / TRACK_KINDS;
+		int kind = (int)(track % TRACK_KINDS);
+		float budget = settings.tolerance / leafDepth[joint] / TRACK_KINDS;
+		float tolerance = kind == TRACK_TRANSLATION ? budget : budget / (reach[joint] + settings.shellDistance);
+
+		for (size_t f = 0; f < frameCount; f++) {
+			raw[f] = trackValue(frames[f * joints + joint], kind);
+			if (kind == TRACK_ROTATION && f > 0 && glm::dot(raw[f], raw[f - 1]) < 0.0f) {
+				raw[f] = -raw[f];
+			}
+		}
+		bool constant = true;
+		for (size_t f = 1; f < frameCount && constant; f++) {
+			constant = trackDistance(raw[0], raw[f], kind) <= tolerance;
+		}
+		if (constant || frameCount < 2) {
+			clip.constants[track] = frameCount > 0 ? raw[0] : trackValue(skeleton.bindPose[joint], kind);
+			constantTracks++;
+			continue;
+		}
+		clip.animated[track] = 1;
+
+		// quantize every frame first, the reduction below then sees the values the cursor will decode
+		std::vector<StreamedKey> keys(frameCount);
+		if (kind != TRACK_ROTATION) {
+			glm::vec3 lo = glm::vec3(raw[0]), hi = lo;
+			for (size_t f = 1; f < frameCount; f++) {
+				lo = glm::min(lo, glm::vec3(raw[f]));
+				hi = glm::max(hi, glm::vec3(raw[f]));
+			}
+			clip.rangeMin[track] = lo;
+			clip.rangeScale[track] = (hi - lo) / 65535.0f;
+		}
+		for (size_t f = 0; f < frameCount; f++) {
+			keys[f].track = (uint16_t)track;
+			keys[f].frame = (uint16_t)f;
+			if (kind == TRACK_ROTATION) {
+				packRotation(glm::quat(raw[f].w, raw[f].x, raw[f].y, raw[f].z), keys[f].data);
+				decoded[f] = unpackRotation(keys[f].data);
+			}
+			else {
+				packRange(glm::vec3(raw[f]), clip.rangeMin[track], clip.rangeScale[track], keys[f].data);
+				decoded[f] = unpackRange(keys[f].data, clip.rangeMin[track], clip.rangeScale[track]);
+			}
+		}
+
+		// Greedy reduction: from each kept key, reach as far as interpolating to the candidate reproduces every
+		// frame in between, then keep the candidate. The first and last frames are always kept.
+		int previousKey = -1;
+		size_t start = 0;
+		stream.push_back(std::make_pair(previousKey, keys[0]));
+		previousKey = 0;
+		while (start + 1 < frameCount) {
+			size_t end = start + 1;
+			while (end + 1 < frameCount) {
+				size_t candidate = end + 1;
+				bool fits = true;
+				for (size_t f = start + 1; f < candidate && fits; f++) {
+					float alpha = (float)(f - start) / (float)(candidate - start);
+					fits = trackDistance(raw[f], interpolateKeys(decoded[start], decoded[candidate], alpha, kind), kind) <= tolerance;
+				}
+				if (!fits) {
+					break;
+				}
+				end = candidate;
+			}
+			stream.push_back(std::make_pair(previousKey, keys[end]));
+			previousKey = (int)end;
+			start = end;
+		}
+	}
+
+	// order keys by the frame at which playback first needs them, the frame of the key before them in their track
+	std::stable_sort(stream.begin(), stream.end(), [](const std::pair<int, StreamedKey>& a, const std::pair<int, StreamedKey>& b) {
+		return a.first < b.first;
+	});
+	clip.keys.reserve(stream.size());
+	for (const std::pair<int, StreamedKey>& entry : stream) {
+		clip.keys.push_back(entry.second);
+	}
+
+	if (report) {
+		report->tracks = tracks;
+		report->constantTracks = constantTracks;
+		report->keys = clip.keys.size();
+		report->sourceKeys = (tracks - constantTracks) * frameCount;
+		report->sourceBytes = frameCount * joints * sizeof(JointPose);
+		report->bytes = clip.bytes();
+		StreamedClipCursor cursor(clip);
+		measureClipError(skeleton, frames, frameCount, settings.shellDistance, [&](size_t frame, PoseSoA& pose) { cursor.sampleFrame((float)frame, pose); }, report->jointErrors);
+		report->maxError = 0.0f;
+		report->averageError = 0.0f;
+		for (float error : report->jointErrors) {
+			report->maxError = std::max(report->maxError, error);
+			report->averageError += error / joints;
+		}
+	}
+	return true;
+}
+
+void measureClipError(const Skeleton& skeleton, const JointPose* frames, size_t frameCount, float shellDistance, const std::function<void(size_t, PoseSoA&)>& sample,
+	std::vector<float>& jointErrors) {
+	size_t joints = skeleton.jointCount();
+	jointErrors.assign(joints, 0.0f);
+	std::vector<glm::mat4> original(joints), compressed(joints);
+	PoseSoA pose;
+	pose.resize(joints);
+	const glm::vec4 shell[] = { glm::vec4(shellDistance, 0.0f, 0.0f, 1.0f), glm::vec4(0.0f, shellDistance, 0.0f, 1.0f), glm::vec4(0.0f, 0.0f, shellDistance, 1.0f) };
+	for (size_t f = 0; f < frameCount; f++) {
+		sample(f, pose);
+		for (size_t j = 0; j < joints; j++) {
+			glm::mat4 a = jointMatrix(frames[f * joints + j]);
+			glm::mat4 b = jointMatrix(pose.joint(j));
+			int parent = skeleton.parents[j];
+			original[j] = parent < 0 ? a : original[parent] * a;
+			compressed[j] = parent < 0 ? b : compressed[parent] * b;
+			for (const glm::vec4& point : shell) {
+				jointErrors[j] = std::max(jointErrors[j], glm::length(glm::vec3(original[j] * point - compressed[j] * point)));
+			}
+		}
+	}
+}
+
+// ---------------------------------------------------------------------------------------------
+// cursor
+
+StreamedClipCursor::StreamedClipCursor(const StreamedClip& clip) : decodedKeys(0), clip(&clip), position(0), lastFrame(-1.0f) {
+	previous.resize(clip.jointCount);
+	next.resize(clip.jointCount);
+	previousFrame.assign(TRACK_KINDS * previous.stride, 0.0f);
+	nextFrame.assign(TRACK_KINDS * previous.stride, 1.0f);
+	reset();
+}
+
+void StreamedClipCursor::reset() {
+	position = 0;
+	lastFrame = -1.0f;
+	size_t stride = previous.stride;
+	for (size_t track = 0; track < clip->animated.size(); track++) {
+		size_t joint = track / TRACK_KINDS;
+		int kind = (int)(track % TRACK_KINDS);
+		if (clip->animated[track]) {
+			// no key yet, the first two keys of the track are due at once
+			previousFrame[kind * stride + joint] = -1.0f;
+			nextFrame[kind * stride + joint] = -1.0f;
+			continue;
+		}
+		const glm::vec4& value = clip->constants[track];
+		for (int c = 0; c < KIND_CHANNELS[kind]; c++) {
+			previous.channel(KIND_CHANNEL[kind] + c)[joint] = value[c];
+			next.channel(KIND_CHANNEL[kind] + c)[joint] = value[c];
+		}
+		previousFrame[kind * stride + joint] = 0.0f;
+		nextFrame[kind * stride + joint] = 1.0f;
+	}
+}
+
+void StreamedClipCursor::decode(const StreamedKey& key) {
+	size_t joint = key.track / TRACK_KINDS;
+	int kind = key.track % TRACK_KINDS;
+	int first = KIND_CHANNEL[kind];
+	size_t stride = previous.stride;
+	float* p = previous.data.data() + first * stride + joint;
+	float* n = next.data.data() + first * stride + joint;
+	if (kind == TRACK_ROTATION) {
+		glm::vec4 value = unpackRotation(key.data);
+		p[0] = n[0];
+		p[stride] = n[stride];
+		p[2 * stride] = n[2 * stride];
+		p[3 * stride] = n[3 * stride];
+		// interpolate the short way, the packing made the largest component positive
+		if (p[0] * value.x + p[stride] * value.y + p[2 * stride] * value.z + p[3 * stride] * value.w < 0.0f) {
+			value = -value;
+		}
+		n[0] = value.x;
+		n[stride] = value.y;
+		n[2 * stride] = value.z;
+		n[3 * stride] = value.w;
+	}
+	else {
+		const glm::vec3& rangeMin = clip->rangeMin[key.track];
+		const glm::vec3& rangeScale = clip->rangeScale[key.track];
+		for (int c = 0; c < 3; c++) {
+			p[c * stride] = n[c * stride];
+			n[c * stride] = rangeMin[c] + key.data[c] * rangeScale[c];
+		}
+	}
+	size_t slot = kind * stride + joint;
+	previousFrame[slot] = nextFrame[slot];
+	nextFrame[slot] = key.frame;
+	decodedKeys++;
+}
+
+void StreamedClipCursor::advance(float frame) {
+	if (frame < lastFrame) {
+		reset();
+	}
+	lastFrame = frame;
+	size_t stride = previous.stride;
+	const StreamedKey* keys = clip->keys.data();
+	size_t count = clip->keys.size();
+	// the stream is sorted by when keys are due, so the first key that isn't due yet ends the walk
+	while (position < count) {
+		const StreamedKey& key = keys[position];
+		if (nextFrame[(key.track % TRACK_KINDS) * stride + key.track / TRACK_KINDS] > frame) {
+			break;
+		}
+		decode(key);
+		position++;
+	}
+}
+
+void StreamedClipCursor::sample(float time, PoseSoA& out) {
+	float duration = clip->duration();
+	if (duration > 0.0f) {
+		time = std::fmod(time, duration);
+		if (time < 0.0f) {
+			time += duration;
+		}
+	}
+	sampleFrame(std::min(std::max(time, 0.0f) * clip->sampleRate, (float)clip->frameCount - 1.0f), out);
+}
+
+// weight of the next key for every joint of one kind
+static inline float keyAlpha(float frame, float previousFrame, float nextFrame) {
+	return std::min(std::max((frame - previousFrame) / std::max(nextFrame - previousFrame, 1e-6f), 0.0f), 1.0f);
+}
+
+void StreamedClipCursor::sampleFrameScalar(float frame, PoseSoA& out) {
+	advance(frame);
+	out.resize(clip->jointCount);
+	size_t stride = previous.stride;
+	for (int kind = 0; kind < TRACK_KINDS; kind++) {
+		const float* t0 = previousFrame.data() + kind * stride;
+		const float* t1 = nextFrame.data() + kind * stride;
+		for (size_t j = 0; j < stride; j++) {
+			float alpha = keyAlpha(frame, t0[j], t1[j]);
+			for (int c = KIND_CHANNEL[kind]; c < KIND_CHANNEL[kind] + KIND_CHANNELS[kind]; c++) {
+				float a = previous.channel(c)[j];
+				out.channel(c)[j] = a + (next.channel(c)[j] - a) * alpha;
+			}
+		}
+	}
+	float* x = out.channel(ROTATION_X), * y = out.channel(ROTATION_Y), * z = out.channel(ROTATION_Z), * w = out.channel(ROTATION_W);
+	for (size_t j = 0; j < stride; j++) {
+		float scale = 1.0f / std::sqrt(x[j] * x[j] + y[j] * y[j] + z[j] * z[j] + w[j] * w[j]);
+		x[j] *= scale;
+		y[j] *= scale;
+		z[j] *= scale;
+		w[j] *= scale;
+	}
+}
+
+#if defined(SIMD_X86)
+
+// interpolates the decoded keys of 8 joints per step, rotations are normalized in the same pass
+TARGET_AVX2 static void interpolateKeysAVX2(const PoseSoA& previous, const PoseSoA& next, const float* previousFrame, const float* nextFrame, float frame, PoseSoA& out) {
+	size_t stride = previous.stride;
+	const __m256 f = _mm256_set1_ps(frame);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 epsilon = _mm256_set1_ps(1e-6f);
+	for (int kind = 0; kind < TRACK_KINDS; kind++) {
+		const float* t0 = previousFrame + kind * stride;
+		const float* t1 = nextFrame + kind * stride;
+		int first = KIND_CHANNEL[kind], channels = KIND_CHANNELS[kind];
+		for (size_t j = 0; j < stride; j += 8) {
+			__m256 start = _mm256_load_ps(t0 + j);
+			__m256 span = _mm256_max_ps(_mm256_sub_ps(_mm256_load_ps(t1 + j), start), epsilon);
+			__m256 alpha = _mm256_min_ps(_mm256_max_ps(_mm256_div_ps(_mm256_sub_ps(f, start), span), zero), one);
+			__m256 values[4];
+			__m256 length = zero;
+			for (int c = 0; c < channels; c++) {
+				__m256 a = _mm256_load_ps(previous.channel(first + c) + j);
+				__m256 b = _mm256_load_ps(next.channel(first + c) + j);
+				values[c] = _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), alpha));
+				length = _mm256_add_ps(length, _mm256_mul_ps(values[c], values[c]));
+			}
+			__m256 scale = kind == TRACK_ROTATION ? _mm256_div_ps(one, _mm256_sqrt_ps(length)) : one;
+			for (int c = 0; c < channels; c++) {
+				_mm256_store_ps(out.channel(first + c) + j, _mm256_mul_ps(values[c], scale));
+			}
+		}
+	}
+}
+
+#endif
+
+void StreamedClipCursor::sampleFrame(float frame, PoseSoA& out) {
+#if defined(SIMD_X86)
+	if (cpuFeatures().avx2) {
+		advance(frame);
+		out.resize(clip->jointCount);
+		interpolateKeysAVX2(previous, next, previousFrame.data(), nextFrame.data(), frame, out);
+		return;
+	}
+#endif
+	sampleFrameScalar(frame, out);
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "Animation.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Offline animation compressor and the streaming decompressor for its output.
+//
+// Every joint has a rotation, a translation and a scale track. Tracks that never leave the error budget of
+// their first value are stored as one constant. Animated tracks keep only the keys that linear interpolation
+// can't replace within the budget, rotations packed as the three smallest components (48 bits) and translations
+// and scales as 16 bits per component inside the track's range.
+//
+// The keys of all tracks form one stream sorted by the frame at which playback first needs them, so moving
+// forward decodes the few keys that became due from one sequential read. Each key is decoded once, sampling
+// then interpolates the decoded keys of all joints as structure of arrays, 8 joints per step.
+
+// Largest model space error the compressor may introduce.
+struct AnimationCompressionSettings {
+	// distance in model units between the original and the compressed position of any point shellDistance
+	// away from a joint, the usual stand in for skinned vertices
+	float tolerance = 0.001f;
+	float shellDistance = 0.1f;
+};
+
+// One key of the stream, joint * 3 + kind identifies the track (0 rotation, 1 translation, 2 scale).
+// Both fields are 16 bits, the compressor rejects clips with more frames or skeletons with more tracks.
+struct StreamedKey {
+	static const size_t MAX_TRACKS = 65536;
+	static const size_t MAX_FRAMES = 65536;
+
+	uint16_t track;
+	uint16_t frame;
+	uint16_t data[3];
+};
+
+struct StreamedClip {
+	std::string name;
+	uint32_t jointCount = 0;
+	uint32_t frameCount = 0;
+	float sampleRate = 30.0f;
+	// per track, the value of constant tracks (xyzw rotation, xyz otherwise), unused for animated ones
+	std::vector<glm::vec4> constants;
+	// per track, translation and scale keys decode as rangeMin + stored * rangeScale
+	std::vector<glm::vec3> rangeMin;
+	std::vector<glm::vec3> rangeScale;
+	std::vector<uint8_t> animated;
+	std::vector<StreamedKey> keys;
+
+	float duration() const { return frameCount > 1 ? (frameCount - 1) / sampleRate : 0.0f; }
+	size_t bytes() const;
+};
+
+// What the compressor kept and the error it measured.
+struct AnimationCompressionReport {
+	size_t tracks = 0;
+	size_t constantTracks = 0;
+	size_t keys = 0; // kept keys of animated tracks
+	size_t sourceKeys = 0; // keys of animated tracks before reduction
+	size_t sourceBytes = 0; // frames as float JointPoses
+	size_t bytes = 0;
+	// per joint, largest model space error over every frame, see measureClipError
+	std::vector<float> jointErrors;
+	float maxError = 0.0f;
+	float averageError = 0.0f;
+};
+
+//compresses frames[frame * jointCount + joint] taken at sampleRate per second into clip. The skeleton's hierarchy and bind
+//pose set how much error each track may add, so that errors summed down any chain stay under settings.tolerance.
+//False when the clip has more than StreamedKey::MAX_FRAMES frames or the skeleton more than MAX_TRACKS tracks.
+bool compressStreamedClip(const Skeleton& skeleton, const JointPose* frames, size_t frameCount, float sampleRate, const AnimationCompressionSettings& settings,
+	StreamedClip& clip, AnimationCompressionReport* report = nullptr, const char* name = "");
+
+//largest model space error per joint between frames and sample(frame), over every frame. Points at shellDistance
+//along each joint's axes are compared, so rotations, translations and scales are all measured in model units.
+//sample fills a pose for a frame index.
+void measureClipError(const Skeleton& skeleton, const JointPose* frames, size_t frameCount, float shellDistance, const std::function<void(size_t, PoseSoA&)>& sample,
+	std::vector<float>& jointErrors);
+
+// Plays a StreamedClip. Moving forward decodes only the keys that became due, moving backwards (or looping
+// around) restarts from the first key. One cursor per playing clip, it holds the decoded keys of every track.
+class StreamedClipCursor
+{
+public:
+	explicit StreamedClipCursor(const StreamedClip& clip);
+
+	//samples at time in seconds, wrapped around the duration
+	void sample(float time, PoseSoA& out);
+	//samples at a frame position, fractions interpolate
+	void sampleFrame(float frame, PoseSoA& out);
+	void sampleFrameScalar(float frame, PoseSoA& out);
+	void reset();
+
+	// keys decoded since the cursor was made, including replays after resets
+	size_t decodedKeys;
+
+private:
+	void advance(float frame);
+	void decode(const StreamedKey& key);
+
+	const StreamedClip* clip;
+	size_t position;
+	float lastFrame;
+	// decoded keys either side of the cursor
+	PoseSoA previous, next;
+	// [kind * stride + joint], frames of the previous and the next key of each track
+	std::vector<float, AlignedAllocator<float>> previousFrame, nextFrame;
+};
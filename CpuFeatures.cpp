@@ -0,0 +1,56 @@
+#include "CpuFeatures.h"
+
+#if defined(SIMD_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(SIMD_X86)
+static void cpuid(int leaf, int subleaf, unsigned int regs[4]) {
+#if defined(_MSC_VER)
+	__cpuidex((int*)regs, leaf, subleaf);
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// AVX state must be enabled by the OS, not only supported by the CPU
+static bool osSavesYmm() {
+#if defined(_MSC_VER)
+	return (_xgetbv(0) & 6) == 6;
+#else
+	unsigned int eax, edx;
+	__asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return (eax & 6) == 6;
+#endif
+}
+#endif
+
+static CpuFeatures detect() {
+	CpuFeatures f = {};
+#if defined(SIMD_X86)
+	unsigned int regs[4];
+	cpuid(0, 0, regs);
+	unsigned int maxLeaf = regs[0];
+	cpuid(1, 0, regs);
+	f.sse2 = (regs[3] >> 26) & 1;
+	f.ssse3 = (regs[2] >> 9) & 1;
+	f.sse41 = (regs[2] >> 19) & 1;
+	bool osxsave = (regs[2] >> 27) & 1;
+	bool avx = ((regs[2] >> 28) & 1) && osxsave && osSavesYmm();
+	f.f16c = avx && ((regs[2] >> 29) & 1);
+	if (avx && maxLeaf >= 7) {
+		cpuid(7, 0, regs);
+		f.avx2 = (regs[1] >> 5) & 1;
+	}
+#endif
+	return f;
+}
+
+const CpuFeatures& cpuFeatures() {
+	static const CpuFeatures features = detect();
+	return features;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+// Runtime CPU feature detection for the SIMD kernels. Kernels are compiled with per-function target
+// attributes so the rest of the program keeps the baseline instruction set and picks a path at run time.
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#endif
+
+#if defined(SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_F16C __attribute__((target("avx,f16c")))
+#else
+// MSVC accepts every intrinsic without extra flags
+#define TARGET_SSE2
+#define TARGET_SSSE3
+#define TARGET_SSE41
+#define TARGET_AVX2
+#define TARGET_F16C
+#endif
+
+struct CpuFeatures {
+	bool sse2;
+	bool ssse3;
+	bool sse41;
+	bool avx2;
+	bool f16c;
+};
+
+//detected once on first use
+const CpuFeatures& cpuFeatures();
@@ -0,0 +1,140 @@
+#include "CpuProfiler.h"
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> CpuProfiler::active(false);
+std::atomic<uint32_t> CpuProfiler::generation(0);
+thread_local CpuProfiler::ThreadBuffer* CpuProfiler::threadBuffer = nullptr;
+
+// Buffers are created once per thread and kept until exit, so a capture can still be written after its threads ended.
+static std::mutex registryMutex;
+static std::vector<std::unique_ptr<CpuProfiler::ThreadBuffer>> registry;
+static uint64_t startTicks = 0;
+static double nanosecondsPerTick = 1.0;
+
+CpuProfiler::ThreadBuffer* CpuProfiler::registerThread() {
+	std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+	buffer->count.store(0);
+	for (Event*& chunk : buffer->chunks) {
+		chunk = nullptr;
+	}
+	buffer->dropped.store(0);
+	buffer->generation.store(generation.load());
+	buffer->name = nullptr;
+	std::lock_guard<std::mutex> lock(registryMutex);
+	buffer->id = (uint32_t)registry.size() + 1;
+	threadBuffer = buffer.get();
+	registry.push_back(std::move(buffer));
+	return threadBuffer;
+}
+
+CpuProfiler::Event* CpuProfiler::allocateChunk(ThreadBuffer* buffer, size_t chunk) {
+	// the writer is the only thread touching its chunk table, readers only look below the published count
+	buffer->chunks[chunk] = new Event[CHUNK_EVENTS];
+	return buffer->chunks[chunk];
+}
+
+void CpuProfiler::setThreadName(const char* name) {
+	(threadBuffer ? threadBuffer : registerThread())->name = name;
+}
+
+void CpuProfiler::start() {
+	stop();
+	generation.fetch_add(1);
+#if defined(SIMD_X86)
+	// the TSC rate against the steady clock over 10 ms, invariant TSCs (every x86 CPU of the last decade) keep it
+	auto clockStart = std::chrono::steady_clock::now();
+	uint64_t tscStart = now();
+	while (std::chrono::steady_clock::now() - clockStart < std::chrono::milliseconds(10)) {
+	}
+	auto clockEnd = std::chrono::steady_clock::now();
+	uint64_t tscEnd = now();
+	nanosecondsPerTick = std::chrono::duration<double, std::nano>(clockEnd - clockStart).count() / (double)(tscEnd - tscStart);
+#else
+	nanosecondsPerTick = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::duration(1)).count();
+#endif
+	startTicks = now();
+	active.store(true);
+}
+
+void CpuProfiler::stop() {
+	active.store(false);
+}
+
+size_t CpuProfiler::droppedEvents() {
+	std::lock_guard<std::mutex> lock(registryMutex);
+	size_t dropped = 0;
+	uint32_t capture = generation.load();
+	for (std::unique_ptr<ThreadBuffer>& buffer : registry) {
+		if (buffer->generation.load(std::memory_order_acquire) == capture) {
+			dropped += buffer->dropped.load(std::memory_order_relaxed);
+		}
+	}
+	return dropped;
+}
+
+static void writeJsonString(std::ostream& out, const char* text) {
+	out << '"';
+	for (const char* c = text ? text : ""; *c; c++) {
+		if (*c == '"' || *c == '\\') {
+			out << '\\';
+		}
+		out << *c;
+	}
+	out << '"';
+}
+
+bool CpuProfiler::writeChromeTrace(const char* path) {
+	std::ofstream file(path);
+	file.precision(3);
+	file << std::fixed << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+	bool first = true;
+	std::lock_guard<std::mutex> lock(registryMutex);
+	uint32_t capture = generation.load();
+	for (std::unique_ptr<ThreadBuffer>& buffer : registry) {
+		// threads that recorded nothing since start() still hold an older capture
+		bool current = buffer->generation.load(std::memory_order_acquire) == capture;
+		size_t count = current ? buffer->count.load(std::memory_order_acquire) : 0;
+		if (buffer->name) {
+			file << (first ? "" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->id << ",\"args\":{\"name\":";
+			writeJsonString(file, buffer->name);
+			file << "}}";
+			first = false;
+		}
+		for (size_t i = 0; i < count; i++) {
+			const Event& event = buffer->chunks[i >> CHUNK_BITS][i & (CHUNK_EVENTS - 1)];
+			// Chrome traces count microseconds
+			double us = (double)(int64_t)(event.time - startTicks) * nanosecondsPerTick * 1e-3;
+			file << (first ? "" : ",\n");
+			first = false;
+			switch (event.type) {
+			case ZONE_BEGIN:
+				file << "{\"ph\":\"B\",\"name\":";
+				writeJsonString(file, event.name);
+				file << ",\"pid\":1,\"tid\":" << buffer->id << ",\"ts\":" << us << "}";
+				break;
+			case ZONE_END:
+				file << "{\"ph\":\"E\",\"pid\":1,\"tid\":" << buffer->id << ",\"ts\":" << us << "}";
+				break;
+			case COUNTER:
+				file << "{\"ph\":\"C\",\"name\":";
+				writeJsonString(file, event.name);
+				file << ",\"pid\":1,\"ts\":" << us << ",\"args\":{\"value\":" << event.value << "}}";
+				break;
+			case FRAME:
+				file << "{\"ph\":\"i\",\"s\":\"g\",\"name\":\"frame\",\"pid\":1,\"tid\":" << buffer->id << ",\"ts\":" << us << "}";
+				break;
+			}
+		}
+	}
+	file << "\n]}\n";
+	if (!file) {
+		std::cout << "Failed to write " << path << std::endl;
+		return false;
+	}
+	return true;
+}
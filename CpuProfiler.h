@@ -0,0 +1,139 @@
+#pragma once
+
+#include "CpuFeatures.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Build with CPU_PROFILING=0 to compile the profiler out, the CPU_ macros then expand to nothing.
+#ifndef CPU_PROFILING
+#define CPU_PROFILING 1
+#endif
+
+#if defined(SIMD_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+// Instrumentation of CPU work. Every thread appends events to its own buffer, a fixed table of chunks that only
+// that thread writes, and publishes them with one release store of its count, so recording takes no lock.
+// Timestamps are raw TSC ticks (steady_clock elsewhere) converted to nanoseconds with a rate measured when the
+// capture starts. Captures are written as Chrome trace JSON, which chrome://tracing and Perfetto both open.
+class CpuProfiler
+{
+public:
+	enum EventType : uint32_t { ZONE_BEGIN, ZONE_END, COUNTER, FRAME };
+
+	struct Event {
+		uint64_t time;
+		const char* name;
+		EventType type;
+		float value;
+	};
+
+	//starts recording on every thread, earlier events are discarded. Each thread drops its old events itself
+	//with its next event, so threads inside record() are never reset under their feet.
+	static void start();
+	//stops recording, the events stay until the next start()
+	static void stop();
+	static bool capturing() { return active.load(std::memory_order_relaxed); }
+	//writes everything recorded as Chrome trace JSON. Call after stop(), or while threads are quiet.
+	static bool writeChromeTrace(const char* path);
+	//name shown for the calling thread's track, must outlive the profiler
+	static void setThreadName(const char* name);
+	//events lost because a thread's buffer was full
+	static size_t droppedEvents();
+
+	//names must outlive the profiler, string literals are meant
+	static void beginZone(const char* name) { if (capturing()) record(ZONE_BEGIN, name, 0.0f); }
+	static void endZone() { if (capturing()) record(ZONE_END, nullptr, 0.0f); }
+	static void counter(const char* name, float value) { if (capturing()) record(COUNTER, name, value); }
+	static void frameMark() { if (capturing()) record(FRAME, "frame", 0.0f); }
+
+	static uint64_t now() {
+#if defined(SIMD_X86)
+		return __rdtsc();
+#else
+		return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+	}
+
+	// 16384 events per chunk, up to 256 chunks (4M events, 96 MB) per thread
+	static const size_t CHUNK_BITS = 14;
+	static const size_t CHUNK_EVENTS = (size_t)1 << CHUNK_BITS;
+	static const size_t MAX_CHUNKS = 256;
+
+	struct ThreadBuffer {
+		std::atomic<size_t> count;
+		Event* chunks[MAX_CHUNKS];
+		std::atomic<size_t> dropped;
+		// capture that count and dropped belong to, buffers of older captures are skipped by readers
+		std::atomic<uint32_t> generation;
+		uint32_t id;
+		const char* name;
+	};
+
+private:
+	static void record(EventType type, const char* name, float value) {
+		ThreadBuffer* buffer = threadBuffer ? threadBuffer : registerThread();
+		uint32_t capture = generation.load(std::memory_order_relaxed);
+		if (buffer->generation.load(std::memory_order_relaxed) != capture) {
+			// first event of this thread since start(), only the owning thread resets its buffer
+			buffer->count.store(0, std::memory_order_relaxed);
+			buffer->dropped.store(0, std::memory_order_relaxed);
+			buffer->generation.store(capture, std::memory_order_release);
+		}
+		size_t n = buffer->count.load(std::memory_order_relaxed);
+		size_t chunk = n >> CHUNK_BITS;
+		if (chunk >= MAX_CHUNKS) {
+			buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		Event* events = buffer->chunks[chunk] ? buffer->chunks[chunk] : allocateChunk(buffer, chunk);
+		Event& event = events[n & (CHUNK_EVENTS - 1)];
+		event.time = now();
+		event.name = name;
+		event.type = type;
+		event.value = value;
+		buffer->count.store(n + 1, std::memory_order_release);
+	}
+	static ThreadBuffer* registerThread();
+	static Event* allocateChunk(ThreadBuffer* buffer, size_t chunk);
+
+	static std::atomic<bool> active;
+	// bumped by every start()
+	static std::atomic<uint32_t> generation;
+	static thread_local ThreadBuffer* threadBuffer;
+};
+
+// Times the enclosing scope as one zone.
+class CpuZone
+{
+public:
+	explicit CpuZone(const char* name) { CpuProfiler::beginZone(name); }
+	~CpuZone() { CpuProfiler::endZone(); }
+	CpuZone(const CpuZone&) = delete;
+	CpuZone& operator=(const CpuZone&) = delete;
+};
+
+#define CPU_ZONE_CONCAT2(a, b) a##b
+#define CPU_ZONE_CONCAT(a, b) CPU_ZONE_CONCAT2(a, b)
+#if CPU_PROFILING
+#define CPU_ZONE(name) CpuZone CPU_ZONE_CONCAT(cpuZone, __LINE__)(name)
+// for zones that don't match a scope
+#define CPU_ZONE_BEGIN(name) CpuProfiler::beginZone(name)
+#define CPU_ZONE_END() CpuProfiler::endZone()
+#define CPU_COUNTER(name, value) CpuProfiler::counter(name, (float)(value))
+#define CPU_FRAME() CpuProfiler::frameMark()
+#else
+#define CPU_ZONE(name)
+#define CPU_ZONE_BEGIN(name)
+#define CPU_ZONE_END()
+#define CPU_COUNTER(name, value)
+#define CPU_FRAME()
+#endif
@@ -0,0 +1,198 @@
+#include "FrameReadback.h"
+#include "CpuProfiler.h"
+
+#include <cstdio>
+#include <iostream>
+
+FrameReadback::FrameReadback() : width(0), height(0), captured(0), dropped(0), next(0), frameNumber(0), stopping(false) {
+}
+
+FrameReadback::~FrameReadback() {
+	// the buffers belong to the context, release() deletes them while it is alive
+	if (worker.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		worker.join();
+	}
+}
+
+bool FrameReadback::init(int width, int height, const Consumer& consumer, int slotCount) {
+	release();
+	if (!GLAD_GL_VERSION_4_4) {
+		std::cout << "Frame readback needs glBufferStorage (GL 4.4), nothing is captured." << std::endl;
+		return false;
+	}
+	this->width = width;
+	this->height = height;
+	this->consumer = consumer;
+	captured = 0;
+	dropped = 0;
+	next = 0;
+	frameNumber = 0;
+
+	// client storage asks for cached system memory, the CPU reads every byte of it
+	GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	GLsizeiptr bytes = (GLsizeiptr)width * height * 4;
+	slots.resize(slotCount);
+	for (Slot& slot : slots) {
+		glGenBuffers(1, &slot.buffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		glBufferStorage(GL_PIXEL_PACK_BUFFER, bytes, NULL, flags | GL_CLIENT_STORAGE_BIT);
+		slot.mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, flags);
+		slot.fence = 0;
+		slot.frame = 0;
+		slot.busy = false;
+	}
+	// left bound, every other glReadPixels would write into the buffer
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	for (Slot& slot : slots) {
+		if (!slot.mapped) {
+			std::cout << "Failed to map the frame readback buffers." << std::endl;
+			release();
+			return false;
+		}
+	}
+	stopping = false;
+	worker = std::thread(&FrameReadback::run, this);
+	return true;
+}
+
+void FrameReadback::collect() {
+	// oldest first, fences signal in the order they were put in
+	for (size_t i = 0; i < slots.size(); i++) {
+		int index = (int)((next + i) % slots.size());
+		Slot& slot = slots[index];
+		if (!slot.fence) {
+			continue;
+		}
+		if (glClientWaitSync(slot.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+			break;
+		}
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			slot.busy = true;
+			queue.push_back(index);
+		}
+		wake.notify_one();
+	}
+}
+
+void FrameReadback::capture() {
+	if (slots.empty()) {
+		return;
+	}
+	CPU_ZONE("FrameReadback::capture");
+	collect();
+	uint64_t frame = frameNumber++;
+	Slot& slot = slots[next];
+	bool busy;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		busy = slot.busy;
+	}
+	if (slot.fence || busy) {
+		// the GPU or the consumer is behind, waiting here is the spike this class exists to avoid
+		dropped++;
+		return;
+	}
+	slot.frame = frame;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	next = (next + 1) % (int)slots.size();
+	captured++;
+}
+
+void FrameReadback::finish() {
+	for (Slot& slot : slots) {
+		if (slot.fence) {
+			glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+		}
+	}
+	collect();
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this] {
+		for (const Slot& slot : slots) {
+			if (slot.busy) {
+				return false;
+			}
+		}
+		return true;
+	});
+}
+
+void FrameReadback::release() {
+	finish();
+	if (worker.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		worker.join();
+	}
+	for (Slot& slot : slots) {
+		if (slot.mapped) {
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glDeleteBuffers(1, &slot.buffer);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	slots.clear();
+	queue.clear();
+}
+
+void FrameReadback::run() {
+	CpuProfiler::setThreadName("FrameReadback worker");
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		wake.wait(lock, [this] { return stopping || !queue.empty(); });
+		if (queue.empty()) {
+			return;
+		}
+		Slot& slot = slots[queue.front()];
+		queue.pop_front();
+		Image image = { slot.frame, width, height, slot.mapped };
+		lock.unlock();
+		{
+			CPU_ZONE("consume frame");
+			consumer(image);
+		}
+		lock.lock();
+		slot.busy = false;
+		idle.notify_all();
+	}
+}
+
+FrameReadback::Consumer FrameReadback::ppmWriter(const std::string& prefix) {
+	return [prefix](const Image& image) {
+		char number[32];
+		snprintf(number, sizeof(number), "_%06llu.ppm", (unsigned long long)image.frame);
+		std::string path = prefix + number;
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file) {
+			std::cout << "Failed to write " << path << std::endl;
+			return;
+		}
+		fprintf(file, "P6\n%d %d\n255\n", image.width, image.height);
+		std::vector<unsigned char> rgb((size_t)image.width * 3);
+		for (int y = 0; y < image.height; y++) {
+			const unsigned char* rgba = image.row(y);
+			for (int x = 0; x < image.width; x++) {
+				rgb[x * 3 + 0] = rgba[x * 4 + 0];
+				rgb[x * 3 + 1] = rgba[x * 4 + 1];
+				rgb[x * 3 + 2] = rgba[x * 4 + 2];
+			}
+			fwrite(rgb.data(), 1, rgb.size(), file);
+		}
+		fclose(file);
+	};
+}
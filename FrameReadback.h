@@ -0,0 +1,87 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Reads frames back from the GPU without waiting for it. capture() issues glReadPixels into one of a ring of pixel
+// pack buffers, persistently mapped for reading (glBufferStorage, GL 4.4), and puts a fence behind it. Once a
+// fence says the copy is done, the slot's memory goes straight to a worker thread that hands it to the consumer,
+// to convert and encode there; the render thread never copies or touches the pixels. A slot comes back to the ring
+// when the consumer returns. When every slot is still on the GPU or with the consumer the frame is dropped and
+// counted instead of stalling.
+class FrameReadback
+{
+public:
+	// One frame as glReadPixels wrote it: RGBA8, rows from the bottom of the image up.
+	struct Image {
+		// number of the capture() call that read it, dropped frames leave gaps
+		uint64_t frame;
+		int width;
+		int height;
+		const unsigned char* rgba;
+
+		//row y counted from the top of the image
+		const unsigned char* row(int y) const { return rgba + (size_t)(height - 1 - y) * width * 4; }
+	};
+	//runs on the worker thread, the image is only valid until it returns
+	typedef std::function<void(const Image&)> Consumer;
+
+	FrameReadback();
+	~FrameReadback();
+	FrameReadback(const FrameReadback&) = delete;
+	FrameReadback& operator=(const FrameReadback&) = delete;
+
+	//width x height from the lower left corner of the read framebuffer, slots frames in flight. False without GL 4.4.
+	bool init(int width, int height, const Consumer& consumer, int slots = 4);
+	//reads the bound read framebuffer, call after the frame is drawn and before the swap
+	void capture();
+	//hands every finished readback to the worker, capture() does it too
+	void collect();
+	//waits for the GPU and the consumer to be done with every frame captured so far
+	void finish();
+	//finishes, stops the worker and deletes the buffers, must be called while the context is still alive
+	void release();
+
+	//writes every image as a binary PPM, prefix followed by the frame number: shots/frame_000042.ppm
+	static Consumer ppmWriter(const std::string& prefix);
+
+	int width;
+	int height;
+	// capture() calls that issued a readback
+	size_t captured;
+	// capture() calls that found no free slot
+	size_t dropped;
+
+private:
+	struct Slot {
+		GLuint buffer;
+		unsigned char* mapped;
+		GLsync fence;
+		uint64_t frame;
+		// with the worker, guarded by mutex
+		bool busy;
+	};
+
+	void run();
+
+	std::vector<Slot> slots;
+	int next;
+	uint64_t frameNumber;
+	Consumer consumer;
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable idle;
+	// slots in the order their frames finished
+	std::deque<int> queue;
+	bool stopping;
+};
@@ -0,0 +1,948 @@
+#include "GLCapture.h"
+#include "GLInterposer.h"
+#include "MappedFile.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+
+// File layout, in the byte order of the machine that made it (little endian everywhere this runs):
+//   header: "GLCP", version, framebuffer width and height, function count, then every function's name as a
+//   uint8 length and its characters. Records refer to functions by their index in this list.
+//   call record: uint16 function, uint8 argument count, per argument its kind ('i', 'u', 'f' or 'p') and
+//   8 bytes of bits, a pointer's bits followed by a PointerTag and that tag's payload, then 8 bytes of result.
+//   FRAME_END and MAPPED records use function numbers past any table.
+static const char CAPTURE_MAGIC[4] = { 'G', 'L', 'C', 'P' };
+static const uint32_t CAPTURE_VERSION = 1;
+static const uint16_t RECORD_FRAME_END = 0xFFFF;
+// uint64 pointer the mapping returned, uint64 offset into it, uint32 size and the bytes
+static const uint16_t RECORD_MAPPED = 0xFFFE;
+static const size_t MAX_ARGS = 16;
+// scratch given to outputs of unknown size, more than any glGet* of a single value writes
+static const uint32_t DEFAULT_OUTPUT_BYTES = 64 * 1024;
+
+// How a pointer argument is stored.
+enum PointerTag : uint8_t {
+	// the bits as they are, null or an offset into a bound buffer
+	POINTER_VALUE,
+	// uint32 size and the bytes pointed at
+	POINTER_DATA,
+	// written by the call, uint32 size (0 when unknown) of the scratch memory the replay passes instead
+	POINTER_OUTPUT,
+	// uint32 size and the names a glGen* or glCreate* wrote, compared on replay
+	POINTER_NAMES,
+	// uint32 size and glShaderSource's strings joined into one, terminator included
+	POINTER_SOURCE,
+	// a GLsync glFenceSync returned, translated on replay
+	POINTER_SYNC
+};
+
+// How the capture finds the memory behind a pointer argument.
+enum PointerRule : uint8_t {
+	// written by the call, sizeArg (when there is one) holds a count, times elementBytes
+	RULE_OUTPUT,
+	RULE_OFFSET,
+	// passed as null on replay, callbacks and lengths that the stored form makes unnecessary
+	RULE_NULL,
+	// sizeArg holds a count, times elementBytes
+	RULE_BYTES,
+	// texel data, sizeArg is the width, followed by height and depth up to elementBytes dimensions. Format and
+	// type are the two arguments before the pointer. Unpack (or pack) state applies.
+	RULE_PIXELS,
+	RULE_PACK_PIXELS,
+	// a whole texture level read back, target and level are the first two arguments, format and type the two
+	// before the pointer. The level's size is asked of the context, pack state applies.
+	RULE_TEXTURE_OUTPUT,
+	// sizeArg holds the length, negative or none meaning null terminated
+	RULE_STRING,
+	// sizeArg holds the string count
+	RULE_SOURCE,
+	// sizeArg holds the name count
+	RULE_NAMES,
+	RULE_SYNC,
+	// four values when the enum in sizeArg asks for a color, border color or swizzle, otherwise one
+	RULE_VECTOR
+};
+
+struct PointerRuleEntry {
+	const char* function;
+	int8_t arg;
+	PointerRule rule;
+	int8_t sizeArg;
+	uint16_t elementBytes;
+};
+
+static const PointerRuleEntry POINTER_RULES[] = {
+	// core profile draws and attribute pointers only take offsets into bound buffers
+	{ "glVertexAttribPointer", 5, RULE_OFFSET, -1, 0 },
+	{ "glVertexAttribIPointer", 4, RULE_OFFSET, -1, 0 },
+	{ "glVertexAttribLPointer", 4, RULE_OFFSET, -1, 0 },
+	{ "glDrawElements", 3, RULE_OFFSET, -1, 0 },
+	{ "glDrawElementsBaseVertex", 3, RULE_OFFSET, -1, 0 },
+	{ "glDrawElementsInstanced", 3, RULE_OFFSET, -1, 0 },
+	{ "glDrawElementsInstancedBaseVertex", 3, RULE_OFFSET, -1, 0 },
+	{ "glDrawElementsInstancedBaseInstance", 3, RULE_OFFSET, -1, 0 },
+	{ "glDrawElementsInstancedBaseVertexBaseInstance", 3, RULE_OFFSET, -1, 0 },
+	{ "glDrawRangeElements", 5, RULE_OFFSET, -1, 0 },
+	{ "glDrawRangeElementsBaseVertex", 5, RULE_OFFSET, -1, 0 },
+	{ "glDrawArraysIndirect", 1, RULE_OFFSET, -1, 0 },
+	{ "glDrawElementsIndirect", 2, RULE_OFFSET, -1, 0 },
+	{ "glMultiDrawArraysIndirect", 1, RULE_OFFSET, -1, 0 },
+	{ "glMultiDrawElementsIndirect", 2, RULE_OFFSET, -1, 0 },
+	{ "glMultiDrawArraysIndirectCount", 1, RULE_OFFSET, -1, 0 },
+	{ "glMultiDrawElementsIndirectCount", 2, RULE_OFFSET, -1, 0 },
+	{ "glMultiDrawArrays", 1, RULE_BYTES, 3, 4 },
+	{ "glMultiDrawArrays", 2, RULE_BYTES, 3, 4 },
+	{ "glMultiDrawElements", 1, RULE_BYTES, 4, 4 },
+	{ "glMultiDrawElements", 3, RULE_BYTES, 4, sizeof(void*) },
+	{ "glBufferData", 2, RULE_BYTES, 1, 1 },
+	{ "glBufferSubData", 3, RULE_BYTES, 2, 1 },
+	{ "glBufferStorage", 2, RULE_BYTES, 1, 1 },
+	{ "glNamedBufferData", 2, RULE_BYTES, 1, 1 },
+	{ "glNamedBufferSubData", 3, RULE_BYTES, 2, 1 },
+	{ "glNamedBufferStorage", 2, RULE_BYTES, 1, 1 },
+	{ "glCompressedTexImage2D", 7, RULE_BYTES, 6, 1 },
+	{ "glCompressedTexSubImage2D", 8, RULE_BYTES, 7, 1 },
+	{ "glCompressedTexImage3D", 8, RULE_BYTES, 7, 1 },
+	{ "glCompressedTexSubImage3D", 10, RULE_BYTES, 9, 1 },
+	{ "glCompressedTextureSubImage2D", 8, RULE_BYTES, 7, 1 },
+	{ "glCompressedTextureSubImage3D", 10, RULE_BYTES, 9, 1 },
+	{ "glDrawBuffers", 1, RULE_BYTES, 0, 4 },
+	{ "glNamedFramebufferDrawBuffers", 2, RULE_BYTES, 1, 4 },
+	{ "glInvalidateFramebuffer", 2, RULE_BYTES, 1, 4 },
+	{ "glInvalidateNamedFramebufferData", 2, RULE_BYTES, 1, 4 },
+	{ "glUniformSubroutinesuiv", 2, RULE_BYTES, 1, 4 },
+	{ "glTexImage1D", 7, RULE_PIXELS, 3, 1 },
+	{ "glTexImage2D", 8, RULE_PIXELS, 3, 2 },
+	{ "glTexImage3D", 9, RULE_PIXELS, 3, 3 },
+	{ "glTexSubImage1D", 6, RULE_PIXELS, 3, 1 },
+	{ "glTexSubImage2D", 8, RULE_PIXELS, 4, 2 },
+	{ "glTexSubImage3D", 10, RULE_PIXELS, 5, 3 },
+	{ "glTextureSubImage1D", 6, RULE_PIXELS, 3, 1 },
+	{ "glTextureSubImage2D", 8, RULE_PIXELS, 4, 2 },
+	{ "glTextureSubImage3D", 10, RULE_PIXELS, 5, 3 },
+	{ "glReadPixels", 6, RULE_PACK_PIXELS, 2, 2 },
+	{ "glGetTexImage", 4, RULE_TEXTURE_OUTPUT, -1, 0 },
+	{ "glGetBufferSubData", 3, RULE_OUTPUT, 2, 1 },
+	{ "glGetNamedBufferSubData", 3, RULE_OUTPUT, 2, 1 },
+	{ "glGetUniformLocation", 1, RULE_STRING, -1, 0 },
+	{ "glGetAttribLocation", 1, RULE_STRING, -1, 0 },
+	{ "glBindAttribLocation", 2, RULE_STRING, -1, 0 },
+	{ "glGetUniformBlockIndex", 1, RULE_STRING, -1, 0 },
+	{ "glGetFragDataLocation", 1, RULE_STRING, -1, 0 },
+	{ "glBindFragDataLocation", 2, RULE_STRING, -1, 0 },
+	{ "glGetProgramResourceIndex", 2, RULE_STRING, -1, 0 },
+	{ "glGetProgramResourceLocation", 2, RULE_STRING, -1, 0 },
+	{ "glGetSubroutineIndex", 2, RULE_STRING, -1, 0 },
+	{ "glGetSubroutineUniformLocation", 2, RULE_STRING, -1, 0 },
+	{ "glObjectLabel", 3, RULE_STRING, 2, 0 },
+	{ "glPushDebugGroup", 3, RULE_STRING, 2, 0 },
+	{ "glDebugMessageInsert", 5, RULE_STRING, 4, 0 },
+	{ "glShaderSource", 2, RULE_SOURCE, 1, 0 },
+	{ "glShaderSource", 3, RULE_NULL, -1, 0 },
+	{ "glCreateShaderProgramv", 2, RULE_SOURCE, 1, 0 },
+	{ "glDebugMessageCallback", 0, RULE_NULL, -1, 0 },
+	{ "glDebugMessageCallback", 1, RULE_NULL, -1, 0 },
+	{ "glClientWaitSync", 0, RULE_SYNC, -1, 0 },
+	{ "glWaitSync", 0, RULE_SYNC, -1, 0 },
+	{ "glDeleteSync", 0, RULE_SYNC, -1, 0 },
+	{ "glIsSync", 0, RULE_SYNC, -1, 0 },
+	{ "glGetSynciv", 0, RULE_SYNC, -1, 0 },
+	{ "glClearBufferfv", 2, RULE_VECTOR, 0, 0 },
+	{ "glClearBufferiv", 2, RULE_VECTOR, 0, 0 },
+	{ "glClearBufferuiv", 2, RULE_VECTOR, 0, 0 },
+	{ "glClearNamedFramebufferfv", 3, RULE_VECTOR, 1, 0 },
+	{ "glClearNamedFramebufferiv", 3, RULE_VECTOR, 1, 0 },
+	{ "glClearNamedFramebufferuiv", 3, RULE_VECTOR, 1, 0 },
+	{ "glTexParameterfv", 2, RULE_VECTOR, 1, 0 },
+	{ "glTexParameteriv", 2, RULE_VECTOR, 1, 0 },
+	{ "glTexParameterIiv", 2, RULE_VECTOR, 1, 0 },
+	{ "glTexParameterIuiv", 2, RULE_VECTOR, 1, 0 },
+	{ "glTextureParameterfv", 2, RULE_VECTOR, 1, 0 },
+	{ "glTextureParameteriv", 2, RULE_VECTOR, 1, 0 },
+	{ "glTextureParameterIiv", 2, RULE_VECTOR, 1, 0 },
+	{ "glTextureParameterIuiv", 2, RULE_VECTOR, 1, 0 },
+	{ "glSamplerParameterfv", 2, RULE_VECTOR, 1, 0 },
+	{ "glSamplerParameteriv", 2, RULE_VECTOR, 1, 0 },
+	{ "glSamplerParameterIiv", 2, RULE_VECTOR, 1, 0 },
+	{ "glSamplerParameterIuiv", 2, RULE_VECTOR, 1, 0 }
+};
+
+struct PointerArg {
+	PointerRule rule;
+	int8_t sizeArg;
+	uint16_t elementBytes;
+};
+
+// glUniform3fv, glUniformMatrix4fv, glProgramUniform2iv and the rest of the array forms
+static bool uniformArray(const char* name, size_t& dataArg, PointerArg& rule) {
+	size_t shift = 0;
+	if (strncmp(name, "glProgramUniform", 16) == 0) {
+		name += 16;
+		shift = 1;
+	}
+	else if (strncmp(name, "glUniform", 9) == 0) {
+		name += 9;
+	}
+	else {
+		return false;
+	}
+	size_t length = strlen(name);
+	if (length < 3 || name[length - 1] != 'v') {
+		return false;
+	}
+	uint16_t scalarBytes = name[length - 2] == 'd' ? 8 : 4;
+	rule.rule = RULE_BYTES;
+	rule.sizeArg = (int8_t)(1 + shift);
+	if (strncmp(name, "Matrix", 6) == 0 && name[6] >= '2' && name[6] <= '4') {
+		int columns = name[6] - '0';
+		int rows = name[7] == 'x' ? name[8] - '0' : columns;
+		rule.elementBytes = (uint16_t)(columns * rows * scalarBytes);
+		dataArg = 3 + shift;
+		return true;
+	}
+	if (name[0] >= '1' && name[0] <= '4') {
+		rule.elementBytes = (uint16_t)((name[0] - '0') * scalarBytes);
+		dataArg = 2 + shift;
+		return true;
+	}
+	return false;
+}
+
+static PointerArg pointerRule(const char* name, size_t arg) {
+	PointerArg rule = { RULE_OUTPUT, -1, 0 };
+	for (const PointerRuleEntry& entry : POINTER_RULES) {
+		if ((size_t)entry.arg == arg && strcmp(entry.function, name) == 0) {
+			rule.rule = entry.rule;
+			rule.sizeArg = entry.sizeArg;
+			rule.elementBytes = entry.elementBytes;
+			return rule;
+		}
+	}
+	size_t dataArg;
+	PointerArg uniform;
+	if (uniformArray(name, dataArg, uniform) && dataArg == arg) {
+		return uniform;
+	}
+	// glDeleteBuffers(n, names) and the like
+	if (strncmp(name, "glDelete", 8) == 0 && arg == 1) {
+		rule.rule = RULE_BYTES;
+		rule.sizeArg = 0;
+		rule.elementBytes = 4;
+	}
+	// glGenBuffers(n, names), glCreateTextures(target, n, names)
+	if ((strncmp(name, "glGen", 5) == 0 && strncmp(name, "glGenerate", 10) != 0) || strncmp(name, "glCreate", 8) == 0) {
+		rule.rule = RULE_NAMES;
+		rule.sizeArg = (int8_t)(arg - 1);
+		rule.elementBytes = 4;
+	}
+	return rule;
+}
+
+static size_t pixelBytes(uint64_t format, uint64_t type) {
+	if (type == GL_UNSIGNED_INT_8_8_8_8 || type == GL_UNSIGNED_INT_8_8_8_8_REV || type == GL_UNSIGNED_INT_10_10_10_2 || type == GL_UNSIGNED_INT_2_10_10_10_REV
+		|| type == GL_UNSIGNED_INT_24_8 || type == GL_UNSIGNED_INT_10F_11F_11F_REV || type == GL_UNSIGNED_INT_5_9_9_9_REV) {
+		return 4;
+	}
+	if (type == GL_UNSIGNED_SHORT_5_6_5 || type == GL_UNSIGNED_SHORT_5_6_5_REV || type == GL_UNSIGNED_SHORT_4_4_4_4 || type == GL_UNSIGNED_SHORT_4_4_4_4_REV
+		|| type == GL_UNSIGNED_SHORT_5_5_5_1 || type == GL_UNSIGNED_SHORT_1_5_5_5_REV) {
+		return 2;
+	}
+	if (type == GL_UNSIGNED_BYTE_3_3_2 || type == GL_UNSIGNED_BYTE_2_3_3_REV) {
+		return 1;
+	}
+	if (type == GL_FLOAT_32_UNSIGNED_INT_24_8_REV) {
+		return 8;
+	}
+	size_t components = 1;
+	if (format == GL_RGBA || format == GL_BGRA || format == GL_RGBA_INTEGER || format == GL_BGRA_INTEGER) {
+		components = 4;
+	}
+	else if (format == GL_RGB || format == GL_BGR || format == GL_RGB_INTEGER || format == GL_BGR_INTEGER) {
+		components = 3;
+	}
+	else if (format == GL_RG || format == GL_RG_INTEGER || format == GL_DEPTH_STENCIL) {
+		components = 2;
+	}
+	size_t componentBytes = 4;
+	if (type == GL_UNSIGNED_BYTE || type == GL_BYTE) {
+		componentBytes = 1;
+	}
+	else if (type == GL_UNSIGNED_SHORT || type == GL_SHORT || type == GL_HALF_FLOAT) {
+		componentBytes = 2;
+	}
+	return components * componentBytes;
+}
+
+// bytes a texel transfer of width x height x depth reads, rows padded to the alignment except the last one
+static size_t transferBytes(uint64_t width, uint64_t height, uint64_t depth, const GLInterposer::Arg* args, size_t dataArg, uint64_t alignment, uint64_t rowLength) {
+	if (width == 0 || height == 0 || depth == 0 || (int64_t)width < 0 || (int64_t)height < 0 || (int64_t)depth < 0) {
+		return 0;
+	}
+	size_t bytes = pixelBytes(args[dataArg - 2].bits, args[dataArg - 1].bits);
+	size_t row = (rowLength > 0 ? rowLength : width) * bytes;
+	size_t stride = alignment > 1 ? (row + alignment - 1) / alignment * alignment : row;
+	return stride * (height * depth - 1) + width * bytes;
+}
+
+static size_t imageBytes(const GLInterposer::Arg* args, const PointerArg& rule, size_t dataArg, uint64_t alignment, uint64_t rowLength) {
+	uint64_t width = args[rule.sizeArg].bits;
+	uint64_t height = rule.elementBytes >= 2 ? args[rule.sizeArg + 1].bits : 1;
+	uint64_t depth = rule.elementBytes >= 3 ? args[rule.sizeArg + 2].bits : 1;
+	return transferBytes(width, height, depth, args, dataArg, alignment, rowLength);
+}
+
+// ---------------------------------------------------------------------------------------------
+// capture
+
+struct Mapping {
+	uint64_t buffer;
+	uint64_t pointer;
+	uint64_t length;
+};
+
+// functions whose calls change what the capture has to track
+struct TrackedFunctions {
+	size_t bindBuffer, pixelStore, mapRange, mapNamedRange, map, mapNamed, unmap, unmapNamed, flush, flushNamed;
+};
+
+static std::ofstream captureFile;
+static std::string capturePath;
+static bool recording = false;
+static uint32_t frameLimit = 0, framesWritten = 0;
+static uint64_t callsWritten = 0;
+static std::vector<PointerArg> pointerRules;
+static TrackedFunctions tracked;
+static std::unordered_map<uint64_t, uint64_t> boundBuffers;
+static uint64_t unpackAlignment = 4, unpackRowLength = 0, packAlignment = 4, packRowLength = 0;
+static std::vector<Mapping> mappings;
+static bool warnedWholeMap = false;
+
+template<typename T>
+static void put(const T& value) {
+	captureFile.write((const char*)&value, sizeof(T));
+}
+
+static void putBytes(const void* data, uint32_t size) {
+	put(size);
+	captureFile.write((const char*)data, size);
+}
+
+static Mapping* findMapping(uint64_t buffer) {
+	for (Mapping& mapping : mappings) {
+		if (mapping.buffer == buffer) {
+			return &mapping;
+		}
+	}
+	return nullptr;
+}
+
+static void putMapped(const Mapping& mapping, uint64_t offset, uint64_t size) {
+	if (offset + size > mapping.length) {
+		return;
+	}
+	put(RECORD_MAPPED);
+	put(mapping.pointer);
+	put(offset);
+	putBytes((const char*)(uintptr_t)mapping.pointer + offset, (uint32_t)size);
+}
+
+static void beforeCall(size_t function, const GLInterposer::Arg* args, size_t count, uint64_t);
+static void afterCall(size_t function, const GLInterposer::Arg* args, size_t count, uint64_t result);
+
+// bytes glGetTexImage writes for the level its arguments name, the queries are left out of the capture
+static size_t levelBytes(const GLInterposer::Arg* args, size_t dataArg, uint64_t alignment, uint64_t rowLength) {
+	GLint width = 0, height = 0, depth = 0;
+	GLInterposer::setListeners(nullptr, nullptr);
+	glGetTexLevelParameteriv((GLenum)args[0].bits, (GLint)args[1].bits, GL_TEXTURE_WIDTH, &width);
+	glGetTexLevelParameteriv((GLenum)args[0].bits, (GLint)args[1].bits, GL_TEXTURE_HEIGHT, &height);
+	glGetTexLevelParameteriv((GLenum)args[0].bits, (GLint)args[1].bits, GL_TEXTURE_DEPTH, &depth);
+	GLInterposer::setListeners(beforeCall, afterCall);
+	return transferBytes((uint64_t)(int64_t)width, (uint64_t)(int64_t)height, (uint64_t)(int64_t)depth, args, dataArg, alignment, rowLength);
+}
+
+static void putPointer(size_t function, const GLInterposer::Arg* args, size_t count, size_t index) {
+	const PointerArg& rule = pointerRules[function * MAX_ARGS + index];
+	uint64_t bits = rule.rule == RULE_NULL ? 0 : args[index].bits;
+	const char* data = (const char*)(uintptr_t)bits;
+	put(bits);
+	bool unpackBuffer = boundBuffers[GL_PIXEL_UNPACK_BUFFER] != 0;
+	bool packBuffer = boundBuffers[GL_PIXEL_PACK_BUFFER] != 0;
+	if (bits == 0 || rule.rule == RULE_OFFSET || (rule.rule == RULE_PIXELS && unpackBuffer) || ((rule.rule == RULE_PACK_PIXELS || rule.rule == RULE_TEXTURE_OUTPUT) && packBuffer)) {
+		put(POINTER_VALUE);
+		return;
+	}
+	if (rule.rule == RULE_BYTES) {
+		put(POINTER_DATA);
+		putBytes(data, (uint32_t)(args[rule.sizeArg].bits * rule.elementBytes));
+	}
+	else if (rule.rule == RULE_PIXELS) {
+		put(POINTER_DATA);
+		putBytes(data, (uint32_t)imageBytes(args, rule, index, unpackAlignment, unpackRowLength));
+	}
+	else if (rule.rule == RULE_PACK_PIXELS) {
+		put(POINTER_OUTPUT);
+		put((uint32_t)imageBytes(args, rule, index, packAlignment, packRowLength));
+	}
+	else if (rule.rule == RULE_TEXTURE_OUTPUT) {
+		put(POINTER_OUTPUT);
+		put((uint32_t)levelBytes(args, index, packAlignment, packRowLength));
+	}
+	else if (rule.rule == RULE_STRING) {
+		int64_t length = rule.sizeArg >= 0 ? (int64_t)args[rule.sizeArg].bits : -1;
+		std::string text = length >= 0 ? std::string(data, (size_t)length) : std::string(data);
+		put(POINTER_DATA);
+		putBytes(text.c_str(), (uint32_t)text.size() + 1);
+	}
+	else if (rule.rule == RULE_SOURCE) {
+		const char* const* strings = (const char* const*)data;
+		const GLint* lengths = index + 1 < count && args[index + 1].kind == 'p' ? (const GLint*)(uintptr_t)args[index + 1].bits : nullptr;
+		std::string text;
+		for (uint64_t i = 0; i < args[rule.sizeArg].bits; i++) {
+			text += lengths && lengths[i] >= 0 ? std::string(strings[i], lengths[i]) : std::string(strings[i]);
+		}
+		put(POINTER_SOURCE);
+		putBytes(text.c_str(), (uint32_t)text.size() + 1);
+	}
+	else if (rule.rule == RULE_NAMES) {
+		put(POINTER_NAMES);
+		putBytes(data, (uint32_t)(args[rule.sizeArg].bits * rule.elementBytes));
+	}
+	else if (rule.rule == RULE_SYNC) {
+		put(POINTER_SYNC);
+	}
+	else if (rule.rule == RULE_VECTOR) {
+		uint64_t selector = args[rule.sizeArg].bits;
+		bool four = selector == GL_COLOR || selector == GL_TEXTURE_BORDER_COLOR || selector == GL_TEXTURE_SWIZZLE_RGBA;
+		put(POINTER_DATA);
+		putBytes(data, four ? 16 : 4);
+	}
+	else {
+		put(POINTER_OUTPUT);
+		put((uint32_t)(rule.sizeArg >= 0 ? args[rule.sizeArg].bits * rule.elementBytes : 0));
+	}
+}
+
+static void beforeCall(size_t function, const GLInterposer::Arg* args, size_t count, uint64_t) {
+	// memory written through a mapping has to be in the file before the call that publishes it
+	if (function == tracked.unmap || function == tracked.unmapNamed) {
+		uint64_t buffer = function == tracked.unmap ? boundBuffers[args[0].bits] : args[0].bits;
+		Mapping* mapping = findMapping(buffer);
+		if (mapping) {
+			putMapped(*mapping, 0, mapping->length);
+			*mapping = mappings.back();
+			mappings.pop_back();
+		}
+	}
+	else if ((function == tracked.flush || function == tracked.flushNamed) && count == 3) {
+		uint64_t buffer = function == tracked.flush ? boundBuffers[args[0].bits] : args[0].bits;
+		Mapping* mapping = findMapping(buffer);
+		if (mapping) {
+			putMapped(*mapping, args[1].bits, args[2].bits);
+		}
+	}
+}
+
+static void afterCall(size_t function, const GLInterposer::Arg* args, size_t count, uint64_t result) {
+	put((uint16_t)function);
+	put((uint8_t)count);
+	for (size_t i = 0; i < count; i++) {
+		put(args[i].kind);
+		if (args[i].kind == 'p') {
+			putPointer(function, args, count, i);
+		}
+		else {
+			put(args[i].bits);
+		}
+	}
+	put(result);
+	callsWritten++;
+
+	if (function == tracked.bindBuffer) {
+		boundBuffers[args[0].bits] = args[1].bits;
+	}
+	else if (function == tracked.pixelStore) {
+		if (args[0].bits == GL_UNPACK_ALIGNMENT) {
+			unpackAlignment = args[1].bits;
+		}
+		else if (args[0].bits == GL_UNPACK_ROW_LENGTH) {
+			unpackRowLength = args[1].bits;
+		}
+		else if (args[0].bits == GL_PACK_ALIGNMENT) {
+			packAlignment = args[1].bits;
+		}
+		else if (args[0].bits == GL_PACK_ROW_LENGTH) {
+			packRowLength = args[1].bits;
+		}
+	}
+	else if ((function == tracked.mapRange || function == tracked.mapNamedRange) && result != 0) {
+		Mapping mapping = { function == tracked.mapRange ? boundBuffers[args[0].bits] : args[0].bits, result, args[2].bits };
+		mappings.push_back(mapping);
+	}
+	else if ((function == tracked.map || function == tracked.mapNamed) && !warnedWholeMap) {
+		std::cout << "GL capture: writes through glMapBuffer aren't captured, only through glMapBufferRange." << std::endl;
+		warnedWholeMap = true;
+	}
+}
+
+bool GLCapture::start(const char* path, int width, int height, uint32_t frames) {
+	if (!GLInterposer::installed()) {
+		std::cout << "GL capture needs GLInterposer::install() first." << std::endl;
+		return false;
+	}
+	stop();
+	captureFile.open(path, std::ios::binary | std::ios::trunc);
+	if (!captureFile) {
+		std::cout << "Failed to open " << path << std::endl;
+		return false;
+	}
+	size_t functionCount = GLInterposer::functionCount();
+	captureFile.write(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+	put(CAPTURE_VERSION);
+	put((int32_t)width);
+	put((int32_t)height);
+	put((uint32_t)functionCount);
+	PointerArg output = { RULE_OUTPUT, -1, 0 };
+	pointerRules.assign(functionCount * MAX_ARGS, output);
+	for (size_t i = 0; i < functionCount; i++) {
+		const char* name = GLInterposer::name(i);
+		put((uint8_t)strlen(name));
+		captureFile.write(name, strlen(name));
+		for (size_t arg = 0; arg < MAX_ARGS; arg++) {
+			pointerRules[i * MAX_ARGS + arg] = pointerRule(name, arg);
+		}
+	}
+	tracked.bindBuffer = GLInterposer::find("glBindBuffer");
+	tracked.pixelStore = GLInterposer::find("glPixelStorei");
+	tracked.mapRange = GLInterposer::find("glMapBufferRange");
+	tracked.mapNamedRange = GLInterposer::find("glMapNamedBufferRange");
+	tracked.map = GLInterposer::find("glMapBuffer");
+	tracked.mapNamed = GLInterposer::find("glMapNamedBuffer");
+	tracked.unmap = GLInterposer::find("glUnmapBuffer");
+	tracked.unmapNamed = GLInterposer::find("glUnmapNamedBuffer");
+	tracked.flush = GLInterposer::find("glFlushMappedBufferRange");
+	tracked.flushNamed = GLInterposer::find("glFlushMappedNamedBufferRange");
+	boundBuffers.clear();
+	mappings.clear();
+	unpackAlignment = 4;
+	unpackRowLength = 0;
+	packAlignment = 4;
+	packRowLength = 0;
+	capturePath = path;
+	frameLimit = frames;
+	framesWritten = 0;
+	callsWritten = 0;
+	recording = true;
+	GLInterposer::setListeners(beforeCall, afterCall);
+	return true;
+}
+
+void GLCapture::endFrame() {
+	if (!recording) {
+		return;
+	}
+	put(RECORD_FRAME_END);
+	if (++framesWritten >= frameLimit) {
+		stop();
+	}
+}
+
+void GLCapture::stop() {
+	if (!recording) {
+		return;
+	}
+	GLInterposer::setListeners(nullptr, nullptr);
+	recording = false;
+	// persistent mappings are never unmapped, their contents as they are now
+	for (const Mapping& mapping : mappings) {
+		putMapped(mapping, 0, mapping.length);
+	}
+	mappings.clear();
+	double megabytes = (double)captureFile.tellp() / (1024.0 * 1024.0);
+	captureFile.close();
+	if (!captureFile) {
+		std::cout << "Failed to write " << capturePath << std::endl;
+		return;
+	}
+	std::cout << "GL capture: " << callsWritten << " calls over " << framesWritten << " frames, " << megabytes << " MB written to " << capturePath << std::endl;
+}
+
+bool GLCapture::capturing() {
+	return recording;
+}
+
+// ---------------------------------------------------------------------------------------------
+// replay
+
+// Bounds checked reads from the capture.
+struct CaptureReader {
+	const char* at;
+	const char* end;
+	bool failed;
+
+	template<typename T>
+	T get() {
+		T value = T();
+		if ((size_t)(end - at) < sizeof(T)) {
+			failed = true;
+			return value;
+		}
+		memcpy(&value, at, sizeof(T));
+		at += sizeof(T);
+		return value;
+	}
+	const char* bytes(size_t size) {
+		if ((size_t)(end - at) < size) {
+			failed = true;
+			return nullptr;
+		}
+		const char* data = at;
+		at += size;
+		return data;
+	}
+};
+
+static bool readHeader(CaptureReader& reader, int& width, int& height, uint32_t& functionCount) {
+	const char* magic = reader.bytes(sizeof(CAPTURE_MAGIC));
+	if (!magic || memcmp(magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0 || reader.get<uint32_t>() != CAPTURE_VERSION) {
+		return false;
+	}
+	width = reader.get<int32_t>();
+	height = reader.get<int32_t>();
+	functionCount = reader.get<uint32_t>();
+	return !reader.failed;
+}
+
+bool GLCapture::readSize(const char* path, int& width, int& height) {
+	MappedFile file;
+	uint32_t functionCount;
+	if (!file.open(path)) {
+		std::cout << "Failed to open " << path << std::endl;
+		return false;
+	}
+	CaptureReader reader = { file.data(), file.data() + file.size(), false };
+	if (!readHeader(reader, width, height, functionCount)) {
+		std::cout << path << " is not a GL capture" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+struct ReplayArg {
+	uint64_t bits;
+	const char* data;
+	uint32_t size;
+	char kind;
+	PointerTag tag;
+};
+
+struct ReplayRecord {
+	uint16_t type;
+	// index into the capture's function list
+	uint16_t function;
+	uint8_t count;
+	uint32_t firstArg;
+	// what the call returned when captured, the mapped pointer of MAPPED records
+	uint64_t result;
+};
+
+// calls the player has to look at besides playing them
+enum ReplaySpecial : uint8_t { SPECIAL_NONE, SPECIAL_FINISH, SPECIAL_USE_PROGRAM, SPECIAL_UNIFORM_LOCATION, SPECIAL_FENCE, SPECIAL_DELETE_SYNC, SPECIAL_MAP, SPECIAL_CREATE };
+
+struct ReplayFunction {
+	size_t local;
+	ReplaySpecial special;
+	// argument holding a uniform location, -1 for none
+	int8_t locationArg;
+};
+
+static ReplayFunction replayFunction(const char* name) {
+	ReplayFunction function = { GLInterposer::find(name), SPECIAL_NONE, -1 };
+	if (strcmp(name, "glFinish") == 0) {
+		function.special = SPECIAL_FINISH;
+	}
+	else if (strcmp(name, "glUseProgram") == 0) {
+		function.special = SPECIAL_USE_PROGRAM;
+	}
+	else if (strcmp(name, "glGetUniformLocation") == 0) {
+		function.special = SPECIAL_UNIFORM_LOCATION;
+	}
+	else if (strcmp(name, "glFenceSync") == 0) {
+		function.special = SPECIAL_FENCE;
+	}
+	else if (strcmp(name, "glDeleteSync") == 0) {
+		function.special = SPECIAL_DELETE_SYNC;
+	}
+	else if (strcmp(name, "glMapBufferRange") == 0 || strcmp(name, "glMapNamedBufferRange") == 0) {
+		function.special = SPECIAL_MAP;
+	}
+	else if (strcmp(name, "glCreateProgram") == 0 || strcmp(name, "glCreateShader") == 0 || strcmp(name, "glCreateShaderProgramv") == 0) {
+		function.special = SPECIAL_CREATE;
+	}
+	if (strncmp(name, "glUniform", 9) == 0 && ((name[9] >= '1' && name[9] <= '4') || strncmp(name + 9, "Matrix", 6) == 0)) {
+		function.locationArg = 0;
+	}
+	else if (strncmp(name, "glProgramUniform", 16) == 0) {
+		function.locationArg = 1;
+	}
+	return function;
+}
+
+// what a glMapBufferRange returned on replay and how many bytes it maps
+struct ReplayMapping {
+	uint64_t pointer;
+	uint64_t length;
+};
+
+// Plays records against the current context and translates what differs from the capture.
+struct ReplayPlayer {
+	std::vector<ReplayFunction> functions;
+	std::vector<ReplayArg> args;
+	std::vector<char> scratch;
+	std::unordered_map<uint64_t, uint64_t> syncs;
+	std::unordered_map<uint64_t, ReplayMapping> pointers;
+	// (program << 32 | captured location) to the location in this context
+	std::unordered_map<uint64_t, uint64_t> locations;
+	uint64_t program = 0;
+	size_t nameMismatches = 0;
+	size_t missingMappings = 0;
+	size_t outOfRangeWrites = 0;
+	size_t missingSyncs = 0;
+
+	//false for calls left out, glFinish while looping
+	bool play(const ReplayRecord& record, bool looping) {
+		if (record.type == RECORD_FRAME_END) {
+			return false;
+		}
+		if (record.type == RECORD_MAPPED) {
+			const ReplayArg& write = args[record.firstArg];
+			auto found = pointers.find(record.result);
+			if (found == pointers.end()) {
+				missingMappings++;
+				return false;
+			}
+			if (write.bits > found->second.length || write.size > found->second.length - write.bits) {
+				outOfRangeWrites++;
+				return false;
+			}
+			memcpy((char*)(uintptr_t)found->second.pointer + write.bits, write.data, write.size);
+			return false;
+		}
+		const ReplayFunction& function = functions[record.function];
+		if (looping && function.special == SPECIAL_FINISH) {
+			return false;
+		}
+		uint64_t values[MAX_ARGS];
+		const char* sources[MAX_ARGS];
+		size_t scratchUsed = 0;
+		for (size_t i = 0; i < record.count; i++) {
+			const ReplayArg& arg = args[record.firstArg + i];
+			values[i] = arg.bits;
+			if (arg.kind != 'p' || arg.tag == POINTER_VALUE) {
+				continue;
+			}
+			if (arg.tag == POINTER_DATA) {
+				values[i] = (uint64_t)(uintptr_t)arg.data;
+			}
+			else if (arg.tag == POINTER_OUTPUT || arg.tag == POINTER_NAMES) {
+				values[i] = (uint64_t)(uintptr_t)(scratch.data() + scratchUsed);
+				scratchUsed += ((arg.size ? arg.size : DEFAULT_OUTPUT_BYTES) + 15) & ~(size_t)15;
+			}
+			else if (arg.tag == POINTER_SOURCE) {
+				// one string with its terminator, the count before it becomes 1
+				sources[i] = arg.data;
+				values[i] = (uint64_t)(uintptr_t)&sources[i];
+				values[i - 1] = 1;
+			}
+			else if (arg.tag == POINTER_SYNC) {
+				// a fence from a frame before the looped one is gone after the first iteration, waiting on 0 is an error
+				auto found = syncs.find(arg.bits);
+				if (found == syncs.end()) {
+					missingSyncs++;
+					return false;
+				}
+				values[i] = found->second;
+			}
+		}
+		if (function.locationArg >= 0 && !locations.empty()) {
+			uint64_t owner = function.locationArg == 1 ? values[0] : program;
+			auto found = locations.find(owner << 32 | (uint32_t)values[function.locationArg]);
+			if (found != locations.end()) {
+				values[function.locationArg] = found->second;
+			}
+		}
+
+		uint64_t result = GLInterposer::invoke(function.local, values);
+
+		for (size_t i = 0; i < record.count; i++) {
+			const ReplayArg& arg = args[record.firstArg + i];
+			if (arg.kind == 'p' && arg.tag == POINTER_NAMES && memcmp((const void*)(uintptr_t)values[i], arg.data, arg.size) != 0) {
+				nameMismatches++;
+			}
+		}
+		if (function.special == SPECIAL_USE_PROGRAM) {
+			program = values[0];
+		}
+		else if (function.special == SPECIAL_UNIFORM_LOCATION && result != record.result) {
+			locations[values[0] << 32 | (uint32_t)record.result] = (uint32_t)result;
+		}
+		else if (function.special == SPECIAL_FENCE) {
+			// the same record plays every iteration, the sync it made last time is dropped unless deleted already
+			auto found = syncs.find(record.result);
+			if (found != syncs.end()) {
+				glDeleteSync((GLsync)(uintptr_t)found->second);
+				found->second = result;
+			}
+			else {
+				syncs[record.result] = result;
+			}
+		}
+		else if (function.special == SPECIAL_DELETE_SYNC) {
+			syncs.erase(args[record.firstArg].bits);
+		}
+		else if (function.special == SPECIAL_MAP) {
+			// glMapBufferRange(target or buffer, offset, length, access), a failed map takes no writes
+			if (result != 0) {
+				ReplayMapping mapping = { result, values[2] };
+				pointers[record.result] = mapping;
+			}
+			else {
+				pointers.erase(record.result);
+			}
+		}
+		else if (function.special == SPECIAL_CREATE && result != record.result) {
+			nameMismatches++;
+		}
+		return true;
+	}
+};
+
+bool GLCapture::replay(const char* path, int iterations, ReplayStats& stats) {
+	MappedFile file;
+	if (!file.open(path)) {
+		std::cout << "Failed to open " << path << std::endl;
+		return false;
+	}
+	CaptureReader reader = { file.data(), file.data() + file.size(), false };
+	int width, height;
+	uint32_t functionCount;
+	if (!readHeader(reader, width, height, functionCount)) {
+		std::cout << path << " is not a GL capture" << std::endl;
+		return false;
+	}
+	ReplayPlayer player;
+	for (uint32_t i = 0; i < functionCount && !reader.failed; i++) {
+		uint8_t length = reader.get<uint8_t>();
+		const char* name = reader.bytes(length);
+		if (!name) {
+			break;
+		}
+		player.functions.push_back(replayFunction(std::string(name, length).c_str()));
+	}
+
+	// everything is parsed up front so the timed loop only plays
+	std::vector<ReplayRecord> records;
+	std::vector<size_t> frameEnds;
+	size_t scratchBytes = 0;
+	while (!reader.failed && reader.at < reader.end) {
+		ReplayRecord record = { reader.get<uint16_t>(), 0, 0, (uint32_t)player.args.size(), 0 };
+		if (record.type == RECORD_FRAME_END) {
+			frameEnds.push_back(records.size());
+		}
+		else if (record.type == RECORD_MAPPED) {
+			record.result = reader.get<uint64_t>();
+			ReplayArg write = { reader.get<uint64_t>(), nullptr, reader.get<uint32_t>(), 'p', POINTER_DATA };
+			write.data = reader.bytes(write.size);
+			player.args.push_back(write);
+		}
+		else {
+			record.function = record.type;
+			record.count = reader.get<uint8_t>();
+			if (record.function >= player.functions.size() || player.functions[record.function].local == GLInterposer::functionCount() || record.count > MAX_ARGS) {
+				std::cout << path << " calls a function this build of glad doesn't load" << std::endl;
+				return false;
+			}
+			size_t callScratch = 0;
+			for (size_t i = 0; i < record.count; i++) {
+				ReplayArg arg = { 0, nullptr, 0, reader.get<char>(), POINTER_VALUE };
+				arg.bits = reader.get<uint64_t>();
+				if (arg.kind == 'p') {
+					arg.tag = (PointerTag)reader.get<uint8_t>();
+					if (arg.tag == POINTER_DATA || arg.tag == POINTER_NAMES || arg.tag == POINTER_SOURCE) {
+						arg.size = reader.get<uint32_t>();
+						arg.data = reader.bytes(arg.size);
+					}
+					else if (arg.tag == POINTER_OUTPUT) {
+						arg.size = reader.get<uint32_t>();
+					}
+					if (arg.tag == POINTER_OUTPUT || arg.tag == POINTER_NAMES) {
+						callScratch += ((arg.size ? arg.size : DEFAULT_OUTPUT_BYTES) + 15) & ~(size_t)15;
+					}
+				}
+				player.args.push_back(arg);
+			}
+			record.result = reader.get<uint64_t>();
+			scratchBytes = std::max(scratchBytes, callScratch);
+		}
+		records.push_back(record);
+	}
+	if (reader.failed) {
+		std::cout << path << " is cut short" << std::endl;
+		return false;
+	}
+	if (frameEnds.empty()) {
+		std::cout << path << " holds no complete frame" << std::endl;
+		return false;
+	}
+	player.scratch.resize(scratchBytes);
+
+	// setup is everything before the last frame, the records after the last frame end are mapped memory
+	size_t frameEnd = frameEnds.back();
+	size_t frameBegin = frameEnds.size() >= 2 ? frameEnds[frameEnds.size() - 2] + 1 : 0;
+	auto setupStart = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < frameBegin; i++) {
+		stats.setupCalls += player.play(records[i], false) ? 1 : 0;
+	}
+	for (size_t i = frameEnd + 1; i < records.size(); i++) {
+		if (records[i].type == RECORD_MAPPED) {
+			player.play(records[i], false);
+		}
+	}
+	glFinish();
+	stats.setupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - setupStart).count();
+
+	for (int iteration = 0; iteration < iterations; iteration++) {
+		auto start = std::chrono::steady_clock::now();
+		size_t calls = 0;
+		for (size_t i = frameBegin; i < frameEnd; i++) {
+			calls += player.play(records[i], true) ? 1 : 0;
+		}
+		auto submitted = std::chrono::steady_clock::now();
+		glFinish();
+		auto finished = std::chrono::steady_clock::now();
+		stats.frameCalls = calls;
+		stats.submitMs.push_back(std::chrono::duration<double, std::milli>(submitted - start).count());
+		stats.frameMs.push_back(std::chrono::duration<double, std::milli>(finished - start).count());
+	}
+	stats.nameMismatches = player.nameMismatches;
+	stats.remappedLocations = player.locations.size();
+	if (player.missingMappings > 0) {
+		std::cout << "GL replay: " << player.missingMappings << " writes to mapped memory had no mapping to go to" << std::endl;
+	}
+	if (player.outOfRangeWrites > 0) {
+		std::cout << "GL replay: " << player.outOfRangeWrites << " writes to mapped memory went past the mapped range and were left out" << std::endl;
+	}
+	if (player.missingSyncs > 0) {
+		std::cout << "GL replay: " << player.missingSyncs << " calls on syncs made before the replayed frame were left out" << std::endl;
+	}
+	for (const auto& sync : player.syncs) {
+		glDeleteSync((GLsync)(uintptr_t)sync.second);
+	}
+	return true;
+}
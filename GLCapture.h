@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Capture of the GL command stream into a binary file, and its replay. The capture listens to GLInterposer and
+// writes every call with its arguments, what it returned, and the memory behind its pointer arguments: buffer and
+// texture uploads, uniform arrays, shader sources, names that were generated or deleted. Memory written through a
+// mapped buffer is not a call, it is saved when the range is flushed or unmapped and for every live mapping when
+// the capture stops. Start capturing right after the context is made, so the capture holds every object it uses.
+//
+// A replay plays everything before the last captured frame once as setup, then plays the last frame over and over
+// and times how long submitting it takes. Object names are expected to come out as they were captured, which a
+// fresh context playing the same calls does; differences are counted. Uniform locations, syncs and mapped pointers
+// are translated to the replaying context's.
+class GLCapture
+{
+public:
+	struct ReplayStats {
+		size_t setupCalls = 0;
+		double setupMs = 0.0;
+		size_t frameCalls = 0;
+		// CPU time to submit each replayed frame, and that plus a glFinish
+		std::vector<double> submitMs;
+		std::vector<double> frameMs;
+		// names the driver handed out differently from the capture
+		size_t nameMismatches = 0;
+		// uniform locations that differ from the capture and were translated
+		size_t remappedLocations = 0;
+	};
+
+	//writes every GL call to path from now on, GLInterposer must be installed. Stops by itself after frames frames.
+	static bool start(const char* path, int width, int height, uint32_t frames = 60);
+	//ends the current frame, call where the frame's last GL call is done
+	static void endFrame();
+	//saves live mappings and closes the file, the calls since the last endFrame() are not a frame
+	static void stop();
+	static bool capturing();
+
+	//framebuffer size the capture was made with, to make a context that matches
+	static bool readSize(const char* path, int& width, int& height);
+	//plays path against the current context, the last frame iterations times. glFinish calls of the captured
+	//frame are left out, the replay finishes every frame itself.
+	static bool replay(const char* path, int iterations, ReplayStats& stats);
+};
@@ -0,0 +1,14 @@
+#include "GLExtensions.h"
+#include <cstring>
+
+bool hasGLExtension(const char* name) {
+	int count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (int i = 0; i < count; i++) {
+		const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (ext && strcmp(ext, name) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// glad was generated without extensions, so anything beyond core 4.6 is queried and loaded by hand.
+
+//returns true if the current context advertises the given extension (e.g. "GL_ARB_bindless_texture")
+bool hasGLExtension(const char* name);
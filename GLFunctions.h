@@ -0,0 +1,702 @@
+// Every GL function glad loads, one GL_FUNCTION(name) per glad_name pointer in glad/glad.h (OpenGL 4.6 core).
+// Included by GLInterposer.cpp with GL_FUNCTION defined, regenerate it when glad is regenerated.
+
+GL_FUNCTION(glCullFace)
+GL_FUNCTION(glFrontFace)
+GL_FUNCTION(glHint)
+GL_FUNCTION(glLineWidth)
+GL_FUNCTION(glPointSize)
+GL_FUNCTION(glPolygonMode)
+GL_FUNCTION(glScissor)
+GL_FUNCTION(glTexParameterf)
+GL_FUNCTION(glTexParameterfv)
+GL_FUNCTION(glTexParameteri)
+GL_FUNCTION(glTexParameteriv)
+GL_FUNCTION(glTexImage1D)
+GL_FUNCTION(glTexImage2D)
+GL_FUNCTION(glDrawBuffer)
+GL_FUNCTION(glClear)
+GL_FUNCTION(glClearColor)
+GL_FUNCTION(glClearStencil)
+GL_FUNCTION(glClearDepth)
+GL_FUNCTION(glStencilMask)
+GL_FUNCTION(glColorMask)
+GL_FUNCTION(glDepthMask)
+GL_FUNCTION(glDisable)
+GL_FUNCTION(glEnable)
+GL_FUNCTION(glFinish)
+GL_FUNCTION(glFlush)
+GL_FUNCTION(glBlendFunc)
+GL_FUNCTION(glLogicOp)
+GL_FUNCTION(glStencilFunc)
+GL_FUNCTION(glStencilOp)
+GL_FUNCTION(glDepthFunc)
+GL_FUNCTION(glPixelStoref)
+GL_FUNCTION(glPixelStorei)
+GL_FUNCTION(glReadBuffer)
+GL_FUNCTION(glReadPixels)
+GL_FUNCTION(glGetBooleanv)
+GL_FUNCTION(glGetDoublev)
+GL_FUNCTION(glGetError)
+GL_FUNCTION(glGetFloatv)
+GL_FUNCTION(glGetIntegerv)
+GL_FUNCTION(glGetString)
+GL_FUNCTION(glGetTexImage)
+GL_FUNCTION(glGetTexParameterfv)
+GL_FUNCTION(glGetTexParameteriv)
+GL_FUNCTION(glGetTexLevelParameterfv)
+GL_FUNCTION(glGetTexLevelParameteriv)
+GL_FUNCTION(glIsEnabled)
+GL_FUNCTION(glDepthRange)
+GL_FUNCTION(glViewport)
+GL_FUNCTION(glDrawArrays)
+GL_FUNCTION(glDrawElements)
+GL_FUNCTION(glPolygonOffset)
+GL_FUNCTION(glCopyTexImage1D)
+GL_FUNCTION(glCopyTexImage2D)
+GL_FUNCTION(glCopyTexSubImage1D)
+GL_FUNCTION(glCopyTexSubImage2D)
+GL_FUNCTION(glTexSubImage1D)
+GL_FUNCTION(glTexSubImage2D)
+GL_FUNCTION(glBindTexture)
+GL_FUNCTION(glDeleteTextures)
+GL_FUNCTION(glGenTextures)
+GL_FUNCTION(glIsTexture)
+GL_FUNCTION(glDrawRangeElements)
+GL_FUNCTION(glTexImage3D)
+GL_FUNCTION(glTexSubImage3D)
+GL_FUNCTION(glCopyTexSubImage3D)
+GL_FUNCTION(glActiveTexture)
+GL_FUNCTION(glSampleCoverage)
+GL_FUNCTION(glCompressedTexImage3D)
+GL_FUNCTION(glCompressedTexImage2D)
+GL_FUNCTION(glCompressedTexImage1D)
+GL_FUNCTION(glCompressedTexSubImage3D)
+GL_FUNCTION(glCompressedTexSubImage2D)
+GL_FUNCTION(glCompressedTexSubImage1D)
+GL_FUNCTION(glGetCompressedTexImage)
+GL_FUNCTION(glBlendFuncSeparate)
+GL_FUNCTION(glMultiDrawArrays)
+GL_FUNCTION(glMultiDrawElements)
+GL_FUNCTION(glPointParameterf)
+GL_FUNCTION(glPointParameterfv)
+GL_FUNCTION(glPointParameteri)
+GL_FUNCTION(glPointParameteriv)
+GL_FUNCTION(glBlendColor)
+GL_FUNCTION(glBlendEquation)
+GL_FUNCTION(glGenQueries)
+GL_FUNCTION(glDeleteQueries)
+GL_FUNCTION(glIsQuery)
+GL_FUNCTION(glBeginQuery)
+GL_FUNCTION(glEndQuery)
+GL_FUNCTION(glGetQueryiv)
+GL_FUNCTION(glGetQueryObjectiv)
+GL_FUNCTION(glGetQueryObjectuiv)
+GL_FUNCTION(glBindBuffer)
+GL_FUNCTION(glDeleteBuffers)
+GL_FUNCTION(glGenBuffers)
+GL_FUNCTION(glIsBuffer)
+GL_FUNCTION(glBufferData)
+GL_FUNCTION(glBufferSubData)
+GL_FUNCTION(glGetBufferSubData)
+GL_FUNCTION(glMapBuffer)
+GL_FUNCTION(glUnmapBuffer)
+GL_FUNCTION(glGetBufferParameteriv)
+GL_FUNCTION(glGetBufferPointerv)
+GL_FUNCTION(glBlendEquationSeparate)
+GL_FUNCTION(glDrawBuffers)
+GL_FUNCTION(glStencilOpSeparate)
+GL_FUNCTION(glStencilFuncSeparate)
+GL_FUNCTION(glStencilMaskSeparate)
+GL_FUNCTION(glAttachShader)
+GL_FUNCTION(glBindAttribLocation)
+GL_FUNCTION(glCompileShader)
+GL_FUNCTION(glCreateProgram)
+GL_FUNCTION(glCreateShader)
+GL_FUNCTION(glDeleteProgram)
+GL_FUNCTION(glDeleteShader)
+GL_FUNCTION(glDetachShader)
+GL_FUNCTION(glDisableVertexAttribArray)
+GL_FUNCTION(glEnableVertexAttribArray)
+GL_FUNCTION(glGetActiveAttrib)
+GL_FUNCTION(glGetActiveUniform)
+GL_FUNCTION(glGetAttachedShaders)
+GL_FUNCTION(glGetAttribLocation)
+GL_FUNCTION(glGetProgramiv)
+GL_FUNCTION(glGetProgramInfoLog)
+GL_FUNCTION(glGetShaderiv)
+GL_FUNCTION(glGetShaderInfoLog)
+GL_FUNCTION(glGetShaderSource)
+GL_FUNCTION(glGetUniformLocation)
+GL_FUNCTION(glGetUniformfv)
+GL_FUNCTION(glGetUniformiv)
+GL_FUNCTION(glGetVertexAttribdv)
+GL_FUNCTION(glGetVertexAttribfv)
+GL_FUNCTION(glGetVertexAttribiv)
+GL_FUNCTION(glGetVertexAttribPointerv)
+GL_FUNCTION(glIsProgram)
+GL_FUNCTION(glIsShader)
+GL_FUNCTION(glLinkProgram)
+GL_FUNCTION(glShaderSource)
+GL_FUNCTION(glUseProgram)
+GL_FUNCTION(glUniform1f)
+GL_FUNCTION(glUniform2f)
+GL_FUNCTION(glUniform3f)
+GL_FUNCTION(glUniform4f)
+GL_FUNCTION(glUniform1i)
+GL_FUNCTION(glUniform2i)
+GL_FUNCTION(glUniform3i)
+GL_FUNCTION(glUniform4i)
+GL_FUNCTION(glUniform1fv)
+GL_FUNCTION(glUniform2fv)
+GL_FUNCTION(glUniform3fv)
+GL_FUNCTION(glUniform4fv)
+GL_FUNCTION(glUniform1iv)
+GL_FUNCTION(glUniform2iv)
+GL_FUNCTION(glUniform3iv)
+GL_FUNCTION(glUniform4iv)
+GL_FUNCTION(glUniformMatrix2fv)
+GL_FUNCTION(glUniformMatrix3fv)
+GL_FUNCTION(glUniformMatrix4fv)
+GL_FUNCTION(glValidateProgram)
+GL_FUNCTION(glVertexAttrib1d)
+GL_FUNCTION(glVertexAttrib1dv)
+GL_FUNCTION(glVertexAttrib1f)
+GL_FUNCTION(glVertexAttrib1fv)
+GL_FUNCTION(glVertexAttrib1s)
+GL_FUNCTION(glVertexAttrib1sv)
+GL_FUNCTION(glVertexAttrib2d)
+GL_FUNCTION(glVertexAttrib2dv)
+GL_FUNCTION(glVertexAttrib2f)
+GL_FUNCTION(glVertexAttrib2fv)
+GL_FUNCTION(glVertexAttrib2s)
+GL_FUNCTION(glVertexAttrib2sv)
+GL_FUNCTION(glVertexAttrib3d)
+GL_FUNCTION(glVertexAttrib3dv)
+GL_FUNCTION(glVertexAttrib3f)
+GL_FUNCTION(glVertexAttrib3fv)
+GL_FUNCTION(glVertexAttrib3s)
+GL_FUNCTION(glVertexAttrib3sv)
+GL_FUNCTION(glVertexAttrib4Nbv)
+GL_FUNCTION(glVertexAttrib4Niv)
+GL_FUNCTION(glVertexAttrib4Nsv)
+GL_FUNCTION(glVertexAttrib4Nub)
+GL_FUNCTION(glVertexAttrib4Nubv)
+GL_FUNCTION(glVertexAttrib4Nuiv)
+GL_FUNCTION(glVertexAttrib4Nusv)
+GL_FUNCTION(glVertexAttrib4bv)
+GL_FUNCTION(glVertexAttrib4d)
+GL_FUNCTION(glVertexAttrib4dv)
+GL_FUNCTION(glVertexAttrib4f)
+GL_FUNCTION(glVertexAttrib4fv)
+GL_FUNCTION(glVertexAttrib4iv)
+GL_FUNCTION(glVertexAttrib4s)
+GL_FUNCTION(glVertexAttrib4sv)
+GL_FUNCTION(glVertexAttrib4ubv)
+GL_FUNCTION(glVertexAttrib4uiv)
+GL_FUNCTION(glVertexAttrib4usv)
+GL_FUNCTION(glVertexAttribPointer)
+GL_FUNCTION(glUniformMatrix2x3fv)
+GL_FUNCTION(glUniformMatrix3x2fv)
+GL_FUNCTION(glUniformMatrix2x4fv)
+GL_FUNCTION(glUniformMatrix4x2fv)
+GL_FUNCTION(glUniformMatrix3x4fv)
+GL_FUNCTION(glUniformMatrix4x3fv)
+GL_FUNCTION(glColorMaski)
+GL_FUNCTION(glGetBooleani_v)
+GL_FUNCTION(glGetIntegeri_v)
+GL_FUNCTION(glEnablei)
+GL_FUNCTION(glDisablei)
+GL_FUNCTION(glIsEnabledi)
+GL_FUNCTION(glBeginTransformFeedback)
+GL_FUNCTION(glEndTransformFeedback)
+GL_FUNCTION(glBindBufferRange)
+GL_FUNCTION(glBindBufferBase)
+GL_FUNCTION(glTransformFeedbackVaryings)
+GL_FUNCTION(glGetTransformFeedbackVarying)
+GL_FUNCTION(glClampColor)
+GL_FUNCTION(glBeginConditionalRender)
+GL_FUNCTION(glEndConditionalRender)
+GL_FUNCTION(glVertexAttribIPointer)
+GL_FUNCTION(glGetVertexAttribIiv)
+GL_FUNCTION(glGetVertexAttribIuiv)
+GL_FUNCTION(glVertexAttribI1i)
+GL_FUNCTION(glVertexAttribI2i)
+GL_FUNCTION(glVertexAttribI3i)
+GL_FUNCTION(glVertexAttribI4i)
+GL_FUNCTION(glVertexAttribI1ui)
+GL_FUNCTION(glVertexAttribI2ui)
+GL_FUNCTION(glVertexAttribI3ui)
+GL_FUNCTION(glVertexAttribI4ui)
+GL_FUNCTION(glVertexAttribI1iv)
+GL_FUNCTION(glVertexAttribI2iv)
+GL_FUNCTION(glVertexAttribI3iv)
+GL_FUNCTION(glVertexAttribI4iv)
+GL_FUNCTION(glVertexAttribI1uiv)
+GL_FUNCTION(glVertexAttribI2uiv)
+GL_FUNCTION(glVertexAttribI3uiv)
+GL_FUNCTION(glVertexAttribI4uiv)
+GL_FUNCTION(glVertexAttribI4bv)
+GL_FUNCTION(glVertexAttribI4sv)
+GL_FUNCTION(glVertexAttribI4ubv)
+GL_FUNCTION(glVertexAttribI4usv)
+GL_FUNCTION(glGetUniformuiv)
+GL_FUNCTION(glBindFragDataLocation)
+GL_FUNCTION(glGetFragDataLocation)
+GL_FUNCTION(glUniform1ui)
+GL_FUNCTION(glUniform2ui)
+GL_FUNCTION(glUniform3ui)
+GL_FUNCTION(glUniform4ui)
+GL_FUNCTION(glUniform1uiv)
+GL_FUNCTION(glUniform2uiv)
+GL_FUNCTION(glUniform3uiv)
+GL_FUNCTION(glUniform4uiv)
+GL_FUNCTION(glTexParameterIiv)
+GL_FUNCTION(glTexParameterIuiv)
+GL_FUNCTION(glGetTexParameterIiv)
+GL_FUNCTION(glGetTexParameterIuiv)
+GL_FUNCTION(glClearBufferiv)
+GL_FUNCTION(glClearBufferuiv)
+GL_FUNCTION(glClearBufferfv)
+GL_FUNCTION(glClearBufferfi)
+GL_FUNCTION(glGetStringi)
+GL_FUNCTION(glIsRenderbuffer)
+GL_FUNCTION(glBindRenderbuffer)
+GL_FUNCTION(glDeleteRenderbuffers)
+GL_FUNCTION(glGenRenderbuffers)
+GL_FUNCTION(glRenderbufferStorage)
+GL_FUNCTION(glGetRenderbufferParameteriv)
+GL_FUNCTION(glIsFramebuffer)
+GL_FUNCTION(glBindFramebuffer)
+GL_FUNCTION(glDeleteFramebuffers)
+GL_FUNCTION(glGenFramebuffers)
+GL_FUNCTION(glCheckFramebufferStatus)
+GL_FUNCTION(glFramebufferTexture1D)
+GL_FUNCTION(glFramebufferTexture2D)
+GL_FUNCTION(glFramebufferTexture3D)
+GL_FUNCTION(glFramebufferRenderbuffer)
+GL_FUNCTION(glGetFramebufferAttachmentParameteriv)
+GL_FUNCTION(glGenerateMipmap)
+GL_FUNCTION(glBlitFramebuffer)
+GL_FUNCTION(glRenderbufferStorageMultisample)
+GL_FUNCTION(glFramebufferTextureLayer)
+GL_FUNCTION(glMapBufferRange)
+GL_FUNCTION(glFlushMappedBufferRange)
+GL_FUNCTION(glBindVertexArray)
+GL_FUNCTION(glDeleteVertexArrays)
+GL_FUNCTION(glGenVertexArrays)
+GL_FUNCTION(glIsVertexArray)
+GL_FUNCTION(glDrawArraysInstanced)
+GL_FUNCTION(glDrawElementsInstanced)
+GL_FUNCTION(glTexBuffer)
+GL_FUNCTION(glPrimitiveRestartIndex)
+GL_FUNCTION(glCopyBufferSubData)
+GL_FUNCTION(glGetUniformIndices)
+GL_FUNCTION(glGetActiveUniformsiv)
+GL_FUNCTION(glGetActiveUniformName)
+GL_FUNCTION(glGetUniformBlockIndex)
+GL_FUNCTION(glGetActiveUniformBlockiv)
+GL_FUNCTION(glGetActiveUniformBlockName)
+GL_FUNCTION(glUniformBlockBinding)
+GL_FUNCTION(glDrawElementsBaseVertex)
+GL_FUNCTION(glDrawRangeElementsBaseVertex)
+GL_FUNCTION(glDrawElementsInstancedBaseVertex)
+GL_FUNCTION(glMultiDrawElementsBaseVertex)
+GL_FUNCTION(glProvokingVertex)
+GL_FUNCTION(glFenceSync)
+GL_FUNCTION(glIsSync)
+GL_FUNCTION(glDeleteSync)
+GL_FUNCTION(glClientWaitSync)
+GL_FUNCTION(glWaitSync)
+GL_FUNCTION(glGetInteger64v)
+GL_FUNCTION(glGetSynciv)
+GL_FUNCTION(glGetInteger64i_v)
+GL_FUNCTION(glGetBufferParameteri64v)
+GL_FUNCTION(glFramebufferTexture)
+GL_FUNCTION(glTexImage2DMultisample)
+GL_FUNCTION(glTexImage3DMultisample)
+GL_FUNCTION(glGetMultisamplefv)
+GL_FUNCTION(glSampleMaski)
+GL_FUNCTION(glBindFragDataLocationIndexed)
+GL_FUNCTION(glGetFragDataIndex)
+GL_FUNCTION(glGenSamplers)
+GL_FUNCTION(glDeleteSamplers)
+GL_FUNCTION(glIsSampler)
+GL_FUNCTION(glBindSampler)
+GL_FUNCTION(glSamplerParameteri)
+GL_FUNCTION(glSamplerParameteriv)
+GL_FUNCTION(glSamplerParameterf)
+GL_FUNCTION(glSamplerParameterfv)
+GL_FUNCTION(glSamplerParameterIiv)
+GL_FUNCTION(glSamplerParameterIuiv)
+GL_FUNCTION(glGetSamplerParameteriv)
+GL_FUNCTION(glGetSamplerParameterIiv)
+GL_FUNCTION(glGetSamplerParameterfv)
+GL_FUNCTION(glGetSamplerParameterIuiv)
+GL_FUNCTION(glQueryCounter)
+GL_FUNCTION(glGetQueryObjecti64v)
+GL_FUNCTION(glGetQueryObjectui64v)
+GL_FUNCTION(glVertexAttribDivisor)
+GL_FUNCTION(glVertexAttribP1ui)
+GL_FUNCTION(glVertexAttribP1uiv)
+GL_FUNCTION(glVertexAttribP2ui)
+GL_FUNCTION(glVertexAttribP2uiv)
+GL_FUNCTION(glVertexAttribP3ui)
+GL_FUNCTION(glVertexAttribP3uiv)
+GL_FUNCTION(glVertexAttribP4ui)
+GL_FUNCTION(glVertexAttribP4uiv)
+GL_FUNCTION(glVertexP2ui)
+GL_FUNCTION(glVertexP2uiv)
+GL_FUNCTION(glVertexP3ui)
+GL_FUNCTION(glVertexP3uiv)
+GL_FUNCTION(glVertexP4ui)
+GL_FUNCTION(glVertexP4uiv)
+GL_FUNCTION(glTexCoordP1ui)
+GL_FUNCTION(glTexCoordP1uiv)
+GL_FUNCTION(glTexCoordP2ui)
+GL_FUNCTION(glTexCoordP2uiv)
+GL_FUNCTION(glTexCoordP3ui)
+GL_FUNCTION(glTexCoordP3uiv)
+GL_FUNCTION(glTexCoordP4ui)
+GL_FUNCTION(glTexCoordP4uiv)
+GL_FUNCTION(glMultiTexCoordP1ui)
+GL_FUNCTION(glMultiTexCoordP1uiv)
+GL_FUNCTION(glMultiTexCoordP2ui)
+GL_FUNCTION(glMultiTexCoordP2uiv)
+GL_FUNCTION(glMultiTexCoordP3ui)
+GL_FUNCTION(glMultiTexCoordP3uiv)
+GL_FUNCTION(glMultiTexCoordP4ui)
+GL_FUNCTION(glMultiTexCoordP4uiv)
+GL_FUNCTION(glNormalP3ui)
+GL_FUNCTION(glNormalP3uiv)
+GL_FUNCTION(glColorP3ui)
+GL_FUNCTION(glColorP3uiv)
+GL_FUNCTION(glColorP4ui)
+GL_FUNCTION(glColorP4uiv)
+GL_FUNCTION(glSecondaryColorP3ui)
+GL_FUNCTION(glSecondaryColorP3uiv)
+GL_FUNCTION(glMinSampleShading)
+GL_FUNCTION(glBlendEquationi)
+GL_FUNCTION(glBlendEquationSeparatei)
+GL_FUNCTION(glBlendFunci)
+GL_FUNCTION(glBlendFuncSeparatei)
+GL_FUNCTION(glDrawArraysIndirect)
+GL_FUNCTION(glDrawElementsIndirect)
+GL_FUNCTION(glUniform1d)
+GL_FUNCTION(glUniform2d)
+GL_FUNCTION(glUniform3d)
+GL_FUNCTION(glUniform4d)
+GL_FUNCTION(glUniform1dv)
+GL_FUNCTION(glUniform2dv)
+GL_FUNCTION(glUniform3dv)
+GL_FUNCTION(glUniform4dv)
+GL_FUNCTION(glUniformMatrix2dv)
+GL_FUNCTION(glUniformMatrix3dv)
+GL_FUNCTION(glUniformMatrix4dv)
+GL_FUNCTION(glUniformMatrix2x3dv)
+GL_FUNCTION(glUniformMatrix2x4dv)
+GL_FUNCTION(glUniformMatrix3x2dv)
+GL_FUNCTION(glUniformMatrix3x4dv)
+GL_FUNCTION(glUniformMatrix4x2dv)
+GL_FUNCTION(glUniformMatrix4x3dv)
+GL_FUNCTION(glGetUniformdv)
+GL_FUNCTION(glGetSubroutineUniformLocation)
+GL_FUNCTION(glGetSubroutineIndex)
+GL_FUNCTION(glGetActiveSubroutineUniformiv)
+GL_FUNCTION(glGetActiveSubroutineUniformName)
+GL_FUNCTION(glGetActiveSubroutineName)
+GL_FUNCTION(glUniformSubroutinesuiv)
+GL_FUNCTION(glGetUniformSubroutineuiv)
+GL_FUNCTION(glGetProgramStageiv)
+GL_FUNCTION(glPatchParameteri)
+GL_FUNCTION(glPatchParameterfv)
+GL_FUNCTION(glBindTransformFeedback)
+GL_FUNCTION(glDeleteTransformFeedbacks)
+GL_FUNCTION(glGenTransformFeedbacks)
+GL_FUNCTION(glIsTransformFeedback)
+GL_FUNCTION(glPauseTransformFeedback)
+GL_FUNCTION(glResumeTransformFeedback)
+GL_FUNCTION(glDrawTransformFeedback)
+GL_FUNCTION(glDrawTransformFeedbackStream)
+GL_FUNCTION(glBeginQueryIndexed)
+GL_FUNCTION(glEndQueryIndexed)
+GL_FUNCTION(glGetQueryIndexediv)
+GL_FUNCTION(glReleaseShaderCompiler)
+GL_FUNCTION(glShaderBinary)
+GL_FUNCTION(glGetShaderPrecisionFormat)
+GL_FUNCTION(glDepthRangef)
+GL_FUNCTION(glClearDepthf)
+GL_FUNCTION(glGetProgramBinary)
+GL_FUNCTION(glProgramBinary)
+GL_FUNCTION(glProgramParameteri)
+GL_FUNCTION(glUseProgramStages)
+GL_FUNCTION(glActiveShaderProgram)
+GL_FUNCTION(glCreateShaderProgramv)
+GL_FUNCTION(glBindProgramPipeline)
+GL_FUNCTION(glDeleteProgramPipelines)
+GL_FUNCTION(glGenProgramPipelines)
+GL_FUNCTION(glIsProgramPipeline)
+GL_FUNCTION(glGetProgramPipelineiv)
+GL_FUNCTION(glProgramUniform1i)
+GL_FUNCTION(glProgramUniform1iv)
+GL_FUNCTION(glProgramUniform1f)
+GL_FUNCTION(glProgramUniform1fv)
+GL_FUNCTION(glProgramUniform1d)
+GL_FUNCTION(glProgramUniform1dv)
+GL_FUNCTION(glProgramUniform1ui)
+GL_FUNCTION(glProgramUniform1uiv)
+GL_FUNCTION(glProgramUniform2i)
+GL_FUNCTION(glProgramUniform2iv)
+GL_FUNCTION(glProgramUniform2f)
+GL_FUNCTION(glProgramUniform2fv)
+GL_FUNCTION(glProgramUniform2d)
+GL_FUNCTION(glProgramUniform2dv)
+GL_FUNCTION(glProgramUniform2ui)
+GL_FUNCTION(glProgramUniform2uiv)
+GL_FUNCTION(glProgramUniform3i)
+GL_FUNCTION(glProgramUniform3iv)
+GL_FUNCTION(glProgramUniform3f)
+GL_FUNCTION(glProgramUniform3fv)
+GL_FUNCTION(glProgramUniform3d)
+GL_FUNCTION(glProgramUniform3dv)
+GL_FUNCTION(glProgramUniform3ui)
+GL_FUNCTION(glProgramUniform3uiv)
+GL_FUNCTION(glProgramUniform4i)
+GL_FUNCTION(glProgramUniform4iv)
+GL_FUNCTION(glProgramUniform4f)
+GL_FUNCTION(glProgramUniform4fv)
+GL_FUNCTION(glProgramUniform4d)
+GL_FUNCTION(glProgramUniform4dv)
+GL_FUNCTION(glProgramUniform4ui)
+GL_FUNCTION(glProgramUniform4uiv)
+GL_FUNCTION(glProgramUniformMatrix2fv)
+GL_FUNCTION(glProgramUniformMatrix3fv)
+GL_FUNCTION(glProgramUniformMatrix4fv)
+GL_FUNCTION(glProgramUniformMatrix2dv)
+GL_FUNCTION(glProgramUniformMatrix3dv)
+GL_FUNCTION(glProgramUniformMatrix4dv)
+GL_FUNCTION(glProgramUniformMatrix2x3fv)
+GL_FUNCTION(glProgramUniformMatrix3x2fv)
+GL_FUNCTION(glProgramUniformMatrix2x4fv)
+GL_FUNCTION(glProgramUniformMatrix4x2fv)
+GL_FUNCTION(glProgramUniformMatrix3x4fv)
+GL_FUNCTION(glProgramUniformMatrix4x3fv)
+GL_FUNCTION(glProgramUniformMatrix2x3dv)
+GL_FUNCTION(glProgramUniformMatrix3x2dv)
+GL_FUNCTION(glProgramUniformMatrix2x4dv)
+GL_FUNCTION(glProgramUniformMatrix4x2dv)
+GL_FUNCTION(glProgramUniformMatrix3x4dv)
+GL_FUNCTION(glProgramUniformMatrix4x3dv)
+GL_FUNCTION(glValidateProgramPipeline)
+GL_FUNCTION(glGetProgramPipelineInfoLog)
+GL_FUNCTION(glVertexAttribL1d)
+GL_FUNCTION(glVertexAttribL2d)
+GL_FUNCTION(glVertexAttribL3d)
+GL_FUNCTION(glVertexAttribL4d)
+GL_FUNCTION(glVertexAttribL1dv)
+GL_FUNCTION(glVertexAttribL2dv)
+GL_FUNCTION(glVertexAttribL3dv)
+GL_FUNCTION(glVertexAttribL4dv)
+GL_FUNCTION(glVertexAttribLPointer)
+GL_FUNCTION(glGetVertexAttribLdv)
+GL_FUNCTION(glViewportArrayv)
+GL_FUNCTION(glViewportIndexedf)
+GL_FUNCTION(glViewportIndexedfv)
+GL_FUNCTION(glScissorArrayv)
+GL_FUNCTION(glScissorIndexed)
+GL_FUNCTION(glScissorIndexedv)
+GL_FUNCTION(glDepthRangeArrayv)
+GL_FUNCTION(glDepthRangeIndexed)
+GL_FUNCTION(glGetFloati_v)
+GL_FUNCTION(glGetDoublei_v)
+GL_FUNCTION(glDrawArraysInstancedBaseInstance)
+GL_FUNCTION(glDrawElementsInstancedBaseInstance)
+GL_FUNCTION(glDrawElementsInstancedBaseVertexBaseInstance)
+GL_FUNCTION(glGetInternalformativ)
+GL_FUNCTION(glGetActiveAtomicCounterBufferiv)
+GL_FUNCTION(glBindImageTexture)
+GL_FUNCTION(glMemoryBarrier)
+GL_FUNCTION(glTexStorage1D)
+GL_FUNCTION(glTexStorage2D)
+GL_FUNCTION(glTexStorage3D)
+GL_FUNCTION(glDrawTransformFeedbackInstanced)
+GL_FUNCTION(glDrawTransformFeedbackStreamInstanced)
+GL_FUNCTION(glClearBufferData)
+GL_FUNCTION(glClearBufferSubData)
+GL_FUNCTION(glDispatchCompute)
+GL_FUNCTION(glDispatchComputeIndirect)
+GL_FUNCTION(glCopyImageSubData)
+GL_FUNCTION(glFramebufferParameteri)
+GL_FUNCTION(glGetFramebufferParameteriv)
+GL_FUNCTION(glGetInternalformati64v)
+GL_FUNCTION(glInvalidateTexSubImage)
+GL_FUNCTION(glInvalidateTexImage)
+GL_FUNCTION(glInvalidateBufferSubData)
+GL_FUNCTION(glInvalidateBufferData)
+GL_FUNCTION(glInvalidateFramebuffer)
+GL_FUNCTION(glInvalidateSubFramebuffer)
+GL_FUNCTION(glMultiDrawArraysIndirect)
+GL_FUNCTION(glMultiDrawElementsIndirect)
+GL_FUNCTION(glGetProgramInterfaceiv)
+GL_FUNCTION(glGetProgramResourceIndex)
+GL_FUNCTION(glGetProgramResourceName)
+GL_FUNCTION(glGetProgramResourceiv)
+GL_FUNCTION(glGetProgramResourceLocation)
+GL_FUNCTION(glGetProgramResourceLocationIndex)
+GL_FUNCTION(glShaderStorageBlockBinding)
+GL_FUNCTION(glTexBufferRange)
+GL_FUNCTION(glTexStorage2DMultisample)
+GL_FUNCTION(glTexStorage3DMultisample)
+GL_FUNCTION(glTextureView)
+GL_FUNCTION(glBindVertexBuffer)
+GL_FUNCTION(glVertexAttribFormat)
+GL_FUNCTION(glVertexAttribIFormat)
+GL_FUNCTION(glVertexAttribLFormat)
+GL_FUNCTION(glVertexAttribBinding)
+GL_FUNCTION(glVertexBindingDivisor)
+GL_FUNCTION(glDebugMessageControl)
+GL_FUNCTION(glDebugMessageInsert)
+GL_FUNCTION(glDebugMessageCallback)
+GL_FUNCTION(glGetDebugMessageLog)
+GL_FUNCTION(glPushDebugGroup)
+GL_FUNCTION(glPopDebugGroup)
+GL_FUNCTION(glObjectLabel)
+GL_FUNCTION(glGetObjectLabel)
+GL_FUNCTION(glObjectPtrLabel)
+GL_FUNCTION(glGetObjectPtrLabel)
+GL_FUNCTION(glGetPointerv)
+GL_FUNCTION(glBufferStorage)
+GL_FUNCTION(glClearTexImage)
+GL_FUNCTION(glClearTexSubImage)
+GL_FUNCTION(glBindBuffersBase)
+GL_FUNCTION(glBindBuffersRange)
+GL_FUNCTION(glBindTextures)
+GL_FUNCTION(glBindSamplers)
+GL_FUNCTION(glBindImageTextures)
+GL_FUNCTION(glBindVertexBuffers)
+GL_FUNCTION(glClipControl)
+GL_FUNCTION(glCreateTransformFeedbacks)
+GL_FUNCTION(glTransformFeedbackBufferBase)
+GL_FUNCTION(glTransformFeedbackBufferRange)
+GL_FUNCTION(glGetTransformFeedbackiv)
+GL_FUNCTION(glGetTransformFeedbacki_v)
+GL_FUNCTION(glGetTransformFeedbacki64_v)
+GL_FUNCTION(glCreateBuffers)
+GL_FUNCTION(glNamedBufferStorage)
+GL_FUNCTION(glNamedBufferData)
+GL_FUNCTION(glNamedBufferSubData)
+GL_FUNCTION(glCopyNamedBufferSubData)
+GL_FUNCTION(glClearNamedBufferData)
+GL_FUNCTION(glClearNamedBufferSubData)
+GL_FUNCTION(glMapNamedBuffer)
+GL_FUNCTION(glMapNamedBufferRange)
+GL_FUNCTION(glUnmapNamedBuffer)
+GL_FUNCTION(glFlushMappedNamedBufferRange)
+GL_FUNCTION(glGetNamedBufferParameteriv)
+GL_FUNCTION(glGetNamedBufferParameteri64v)
+GL_FUNCTION(glGetNamedBufferPointerv)
+GL_FUNCTION(glGetNamedBufferSubData)
+GL_FUNCTION(glCreateFramebuffers)
+GL_FUNCTION(glNamedFramebufferRenderbuffer)
+GL_FUNCTION(glNamedFramebufferParameteri)
+GL_FUNCTION(glNamedFramebufferTexture)
+GL_FUNCTION(glNamedFramebufferTextureLayer)
+GL_FUNCTION(glNamedFramebufferDrawBuffer)
+GL_FUNCTION(glNamedFramebufferDrawBuffers)
+GL_FUNCTION(glNamedFramebufferReadBuffer)
+GL_FUNCTION(glInvalidateNamedFramebufferData)
+GL_FUNCTION(glInvalidateNamedFramebufferSubData)
+GL_FUNCTION(glClearNamedFramebufferiv)
+GL_FUNCTION(glClearNamedFramebufferuiv)
+GL_FUNCTION(glClearNamedFramebufferfv)
+GL_FUNCTION(glClearNamedFramebufferfi)
+GL_FUNCTION(glBlitNamedFramebuffer)
+GL_FUNCTION(glCheckNamedFramebufferStatus)
+GL_FUNCTION(glGetNamedFramebufferParameteriv)
+GL_FUNCTION(glGetNamedFramebufferAttachmentParameteriv)
+GL_FUNCTION(glCreateRenderbuffers)
+GL_FUNCTION(glNamedRenderbufferStorage)
+GL_FUNCTION(glNamedRenderbufferStorageMultisample)
+GL_FUNCTION(glGetNamedRenderbufferParameteriv)
+GL_FUNCTION(glCreateTextures)
+GL_FUNCTION(glTextureBuffer)
+GL_FUNCTION(glTextureBufferRange)
+GL_FUNCTION(glTextureStorage1D)
+GL_FUNCTION(glTextureStorage2D)
+GL_FUNCTION(glTextureStorage3D)
+GL_FUNCTION(glTextureStorage2DMultisample)
+GL_FUNCTION(glTextureStorage3DMultisample)
+GL_FUNCTION(glTextureSubImage1D)
+GL_FUNCTION(glTextureSubImage2D)
+GL_FUNCTION(glTextureSubImage3D)
+GL_FUNCTION(glCompressedTextureSubImage1D)
+GL_FUNCTION(glCompressedTextureSubImage2D)
+GL_FUNCTION(glCompressedTextureSubImage3D)
+GL_FUNCTION(glCopyTextureSubImage1D)
+GL_FUNCTION(glCopyTextureSubImage2D)
+GL_FUNCTION(glCopyTextureSubImage3D)
+GL_FUNCTION(glTextureParameterf)
+GL_FUNCTION(glTextureParameterfv)
+GL_FUNCTION(glTextureParameteri)
+GL_FUNCTION(glTextureParameterIiv)
+GL_FUNCTION(glTextureParameterIuiv)
+GL_FUNCTION(glTextureParameteriv)
+GL_FUNCTION(glGenerateTextureMipmap)
+GL_FUNCTION(glBindTextureUnit)
+GL_FUNCTION(glGetTextureImage)
+GL_FUNCTION(glGetCompressedTextureImage)
+GL_FUNCTION(glGetTextureLevelParameterfv)
+GL_FUNCTION(glGetTextureLevelParameteriv)
+GL_FUNCTION(glGetTextureParameterfv)
+GL_FUNCTION(glGetTextureParameterIiv)
+GL_FUNCTION(glGetTextureParameterIuiv)
+GL_FUNCTION(glGetTextureParameteriv)
+GL_FUNCTION(glCreateVertexArrays)
+GL_FUNCTION(glDisableVertexArrayAttrib)
+GL_FUNCTION(glEnableVertexArrayAttrib)
+GL_FUNCTION(glVertexArrayElementBuffer)
+GL_FUNCTION(glVertexArrayVertexBuffer)
+GL_FUNCTION(glVertexArrayVertexBuffers)
+GL_FUNCTION(glVertexArrayAttribBinding)
+GL_FUNCTION(glVertexArrayAttribFormat)
+GL_FUNCTION(glVertexArrayAttribIFormat)
+GL_FUNCTION(glVertexArrayAttribLFormat)
+GL_FUNCTION(glVertexArrayBindingDivisor)
+GL_FUNCTION(glGetVertexArrayiv)
+GL_FUNCTION(glGetVertexArrayIndexediv)
+GL_FUNCTION(glGetVertexArrayIndexed64iv)
+GL_FUNCTION(glCreateSamplers)
+GL_FUNCTION(glCreateProgramPipelines)
+GL_FUNCTION(glCreateQueries)
+GL_FUNCTION(glGetQueryBufferObjecti64v)
+GL_FUNCTION(glGetQueryBufferObjectiv)
+GL_FUNCTION(glGetQueryBufferObjectui64v)
+GL_FUNCTION(glGetQueryBufferObjectuiv)
+GL_FUNCTION(glMemoryBarrierByRegion)
+GL_FUNCTION(glGetTextureSubImage)
+GL_FUNCTION(glGetCompressedTextureSubImage)
+GL_FUNCTION(glGetGraphicsResetStatus)
+GL_FUNCTION(glGetnCompressedTexImage)
+GL_FUNCTION(glGetnTexImage)
+GL_FUNCTION(glGetnUniformdv)
+GL_FUNCTION(glGetnUniformfv)
+GL_FUNCTION(glGetnUniformiv)
+GL_FUNCTION(glGetnUniformuiv)
+GL_FUNCTION(glReadnPixels)
+GL_FUNCTION(glGetnMapdv)
+GL_FUNCTION(glGetnMapfv)
+GL_FUNCTION(glGetnMapiv)
+GL_FUNCTION(glGetnPixelMapfv)
+GL_FUNCTION(glGetnPixelMapuiv)
+GL_FUNCTION(glGetnPixelMapusv)
+GL_FUNCTION(glGetnPolygonStipple)
+GL_FUNCTION(glGetnColorTable)
+GL_FUNCTION(glGetnConvolutionFilter)
+GL_FUNCTION(glGetnSeparableFilter)
+GL_FUNCTION(glGetnHistogram)
+GL_FUNCTION(glGetnMinmax)
+GL_FUNCTION(glTextureBarrier)
+GL_FUNCTION(glSpecializeShader)
+GL_FUNCTION(glMultiDrawArraysIndirectCount)
+GL_FUNCTION(glMultiDrawElementsIndirectCount)
+GL_FUNCTION(glPolygonOffsetClamp)
@@ -0,0 +1,657 @@
+#include "GLInterposer.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+typedef std::chrono::steady_clock Clock;
+
+// Which state a setter writes: the family, the leading arguments that select it (a target, a unit, a location)
+// and the state that is implied rather than passed (the active texture unit, the program in use, the VAO that
+// holds the element array binding).
+enum StateScope : uint8_t { SCOPE_NONE, SCOPE_UNIT, SCOPE_PROGRAM, SCOPE_ELEMENTS };
+enum StateTrack : uint8_t { TRACK_NONE, TRACK_PROGRAM, TRACK_VAO, TRACK_UNIT };
+// State a setter writes that another family remembers under its own key: glBindTextureUnit replaces what
+// glBindTexture bound on that unit, glBindBufferBase also sets the glBindBuffer binding of its target. The other
+// family's values are forgotten on such a write, otherwise A, the other form, A would be flagged as redundant.
+enum StateAlias : uint8_t { ALIAS_NONE, ALIAS_TEXTURE, ALIAS_TEXTURE_UNIT, ALIAS_BUFFER, ALIAS_FRAMEBUFFER, ALIAS_ENABLE, ALIAS_ENABLEI };
+
+struct SetterRule {
+	const char* name;
+	// setters of one family write the same state, glEnable and glDisable for one
+	const char* family;
+	int keyArgs;
+	StateScope scope;
+	StateTrack track;
+	StateAlias alias;
+};
+
+static const SetterRule SETTERS[] = {
+	{ "glUseProgram", "glUseProgram", 0, SCOPE_NONE, TRACK_PROGRAM, ALIAS_NONE },
+	{ "glBindVertexArray", "glBindVertexArray", 0, SCOPE_NONE, TRACK_VAO, ALIAS_NONE },
+	{ "glActiveTexture", "glActiveTexture", 0, SCOPE_NONE, TRACK_UNIT, ALIAS_NONE },
+	{ "glBindBuffer", "glBindBuffer", 1, SCOPE_ELEMENTS, TRACK_NONE, ALIAS_NONE },
+	{ "glBindBufferBase", "glBindBufferBase", 2, SCOPE_NONE, TRACK_NONE, ALIAS_BUFFER },
+	{ "glBindBufferRange", "glBindBufferBase", 2, SCOPE_NONE, TRACK_NONE, ALIAS_BUFFER },
+	{ "glBindTexture", "glBindTexture", 1, SCOPE_UNIT, TRACK_NONE, ALIAS_TEXTURE_UNIT },
+	{ "glBindTextureUnit", "glBindTextureUnit", 1, SCOPE_NONE, TRACK_NONE, ALIAS_TEXTURE },
+	{ "glBindSampler", "glBindSampler", 1, SCOPE_NONE, TRACK_NONE, ALIAS_NONE },
+	{ "glBindImageTexture", "glBindImageTexture", 1, SCOPE_NONE, TRACK_NONE, ALIAS_NONE },
+	{ "glBindFramebuffer", "glBindFramebuffer", 1, SCOPE_NONE, TRACK_NONE, ALIAS_FRAMEBUFFER },
+	{ "glBindRenderbuffer", "glBindRenderbuffer", 1, SCOPE_NONE, TRACK_NONE, ALIAS_NONE },
+	{ "glEnable", "glEnable", 1, SCOPE_NONE, TRACK_NONE, ALIAS_ENABLEI },
+	{ "glDisable", "glEnable", 1, SCOPE_NONE, TRACK_NONE, ALIAS_ENABLEI },
+	{ "glEnablei", "glEnablei", 2, SCOPE_NONE, TRACK_NONE, ALIAS_ENABLE },
+	{ "glDisablei", "glEnablei", 2, SCOPE_NONE, TRACK_NONE, ALIAS_ENABLE },
+	{ "glBlendFunc", "glBlendFunc", 0, SCOPE_NONE, TRACK_NONE, ALIAS_NONE },
+	{ "glBlendFuncSeparate", "glBlendFunc", 0, SCOPE_NONE, TRACK_NONE, ALIAS_NONE },
+	{ "glBlendEquation", "glBlendEquation", 0, SCOPE_NONE, TRACK_NONE, ALIAS_NONE },
+	{ "glDepthFunc", "glDepthFunc", 0, SCOPE_NONE, TRACK_NONE, ALIAS_NONE },
+	{ "glDepthMask", "glDepthMask", 0, SCOPE_NONE, TRACK_NONE, ALIAS_NONE },
+	{ "glColorMask", "glColorMask", 0, SCOPE_NONE, TRACK_NONE, ALIAS_NONE },
+	{ "glCullFace", "glCullFace", 0, SCOPE_NONE, TRACK_NONE, ALIAS_NONE },
+	{ "glFrontFace", "glFrontFace", 0, SCOPE_NONE, TRACK_NONE, ALIAS_NONE },
+	{ "glPolygonMode", "glPolygonMode", 1, SCOPE_NONE, TRACK_NONE, ALIAS_NONE },
+	{ "glViewport", "glViewport", 0, SCOPE_NONE, TRACK_NONE, ALIAS_NONE },
+	{ "glScissor", "glScissor", 0, SCOPE_NONE, TRACK_NONE, ALIAS_NONE },
+	{ "glClearColor", "glClearColor", 0, SCOPE_NONE, TRACK_NONE, ALIAS_NONE },
+	{ "glClearDepth", "glClearDepth", 0, SCOPE_NONE, TRACK_NONE, ALIAS_NONE },
+	{ "glPixelStorei", "glPixelStorei", 1, SCOPE_NONE, TRACK_NONE, ALIAS_NONE },
+	{ "glLineWidth", "glLineWidth", 0, SCOPE_NONE, TRACK_NONE, ALIAS_NONE },
+	{ "glPointSize", "glPointSize", 0, SCOPE_NONE, TRACK_NONE, ALIAS_NONE },
+	{ "glPatchParameteri", "glPatchParameteri", 1, SCOPE_NONE, TRACK_NONE, ALIAS_NONE }
+};
+static const int SETTER_COUNT = sizeof(SETTERS) / sizeof(SETTERS[0]);
+// families of the scalar uniform setters, after the rules above
+static const int UNIFORM_FAMILY = SETTER_COUNT;
+static const int PROGRAM_UNIFORM_FAMILY = SETTER_COUNT + 1;
+
+static int setterIndex(const char* name) {
+	for (int i = 0; i < SETTER_COUNT; i++) {
+		if (strcmp(SETTERS[i].name, name) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// families whose values other setters forget, see StateAlias
+static const int TEXTURE_FAMILY = setterIndex("glBindTexture");
+static const int TEXTURE_UNIT_FAMILY = setterIndex("glBindTextureUnit");
+static const int BUFFER_FAMILY = setterIndex("glBindBuffer");
+static const int FRAMEBUFFER_FAMILY = setterIndex("glBindFramebuffer");
+static const int ENABLE_FAMILY = setterIndex("glEnable");
+static const int ENABLEI_FAMILY = setterIndex("glEnablei");
+// every target glBindTextureUnit may replace, it binds to whichever target the texture was made for
+static const GLenum TEXTURE_TARGETS[] = {
+	GL_TEXTURE_1D, GL_TEXTURE_2D, GL_TEXTURE_3D, GL_TEXTURE_1D_ARRAY, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_RECTANGLE, GL_TEXTURE_CUBE_MAP,
+	GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_BUFFER, GL_TEXTURE_2D_MULTISAMPLE, GL_TEXTURE_2D_MULTISAMPLE_ARRAY
+};
+// glEnable(cap) sets every index of an indexed capability, more draw buffers or viewports than this are not tracked
+static const uint64_t MAX_INDEXED_CAPS = 16;
+
+// calls that make the CPU wait for the GPU or read state back, besides every glGet*
+static const char* SYNC_FUNCTIONS[] = {
+	"glReadPixels", "glReadnPixels", "glFinish", "glClientWaitSync",
+	"glMapBuffer", "glMapBufferRange", "glMapNamedBuffer", "glMapNamedBufferRange"
+};
+
+struct FunctionInfo {
+	const char* name;
+	bool sync;
+	// glDelete* frees names the driver may hand out again, the remembered state is dropped
+	bool invalidates;
+	int family;
+	int keyArgs;
+	StateScope scope;
+	StateTrack track;
+	StateAlias alias;
+};
+
+struct TracedCall {
+	uint32_t frame;
+	uint16_t function;
+	uint8_t argCount;
+	uint8_t flags;
+	uint32_t firstArg;
+	double startMs;
+	double ms;
+};
+
+static bool hooksInstalled = false;
+static GLInterposer::CallListener beforeListener = nullptr, afterListener = nullptr;
+static std::vector<FunctionInfo> functions;
+static std::vector<GLInterposer::FunctionStats> currentStats, lastStats;
+static GLInterposer::FrameTotals currentTotals, lastTotals;
+static uint32_t frameNumber = 0;
+
+static std::unordered_map<uint64_t, uint64_t> stateValues;
+static uint64_t currentProgram = 0, currentVao = 0, activeUnit = GL_TEXTURE0;
+
+static bool tracing = false;
+static size_t traceLimit = 0;
+static size_t traceDropped = 0;
+static Clock::time_point traceStart;
+static std::vector<TracedCall> traceCalls;
+static std::vector<GLInterposer::Arg> traceArgs;
+
+static uint64_t mix(uint64_t hash, uint64_t value) {
+	return hash ^ (value + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2));
+}
+
+static FunctionInfo classify(const char* name) {
+	FunctionInfo info = { name, strncmp(name, "glGet", 5) == 0, strncmp(name, "glDelete", 8) == 0, -1, 0, SCOPE_NONE, TRACK_NONE, ALIAS_NONE };
+	for (const char* sync : SYNC_FUNCTIONS) {
+		if (strcmp(name, sync) == 0) {
+			info.sync = true;
+		}
+	}
+	for (const SetterRule& rule : SETTERS) {
+		if (strcmp(name, rule.name) != 0) {
+			continue;
+		}
+		for (int i = 0; i < SETTER_COUNT; i++) {
+			if (strcmp(rule.family, SETTERS[i].name) == 0) {
+				info.family = i;
+			}
+		}
+		info.keyArgs = rule.keyArgs;
+		info.scope = rule.scope;
+		info.track = rule.track;
+		info.alias = rule.alias;
+	}
+	// glUniform4f and the like, the vector forms pass pointers so their values can't be compared
+	size_t length = strlen(name);
+	if (strncmp(name, "glUniform", 9) == 0 && name[9] >= '1' && name[9] <= '4' && name[length - 1] != 'v') {
+		info.family = UNIFORM_FAMILY;
+		info.keyArgs = 1;
+		info.scope = SCOPE_PROGRAM;
+	}
+	else if (strncmp(name, "glProgramUniform", 16) == 0 && name[16] >= '1' && name[16] <= '4' && name[length - 1] != 'v') {
+		info.family = PROGRAM_UNIFORM_FAMILY;
+		info.keyArgs = 2;
+	}
+	return info;
+}
+
+// key of the state a family's setter with these leading arguments writes, the same mix beginCall builds
+static uint64_t stateKey(int family, uint64_t first, uint64_t second) {
+	return mix(mix(mix(0, (uint64_t)family), first), second);
+}
+
+static uint64_t stateKey(int family, uint64_t first) {
+	return mix(mix(0, (uint64_t)family), first);
+}
+
+static void forgetAliases(const FunctionInfo& info, const GLInterposer::Arg* args) {
+	switch (info.alias) {
+	case ALIAS_TEXTURE:
+		// glBindTextureUnit takes a unit number, glBindTexture is keyed on its target and GL_TEXTUREi
+		for (GLenum target : TEXTURE_TARGETS) {
+			stateValues.erase(stateKey(TEXTURE_FAMILY, target, GL_TEXTURE0 + args[0].bits));
+		}
+		break;
+	case ALIAS_TEXTURE_UNIT:
+		stateValues.erase(stateKey(TEXTURE_UNIT_FAMILY, activeUnit - GL_TEXTURE0));
+		break;
+	case ALIAS_BUFFER:
+		stateValues.erase(stateKey(BUFFER_FAMILY, args[0].bits));
+		break;
+	case ALIAS_FRAMEBUFFER:
+		// GL_FRAMEBUFFER binds both the draw and the read framebuffer
+		if (args[0].bits == GL_FRAMEBUFFER) {
+			stateValues.erase(stateKey(FRAMEBUFFER_FAMILY, GL_DRAW_FRAMEBUFFER));
+			stateValues.erase(stateKey(FRAMEBUFFER_FAMILY, GL_READ_FRAMEBUFFER));
+		}
+		else {
+			stateValues.erase(stateKey(FRAMEBUFFER_FAMILY, GL_FRAMEBUFFER));
+		}
+		break;
+	case ALIAS_ENABLE:
+		stateValues.erase(stateKey(ENABLE_FAMILY, args[0].bits));
+		break;
+	case ALIAS_ENABLEI:
+		for (uint64_t index = 0; index < MAX_INDEXED_CAPS; index++) {
+			stateValues.erase(stateKey(ENABLEI_FAMILY, args[0].bits, index));
+		}
+		break;
+	case ALIAS_NONE:
+		break;
+	}
+}
+
+static uint8_t beginCall(uint16_t function, const GLInterposer::Arg* args, size_t count) {
+	if (beforeListener) {
+		beforeListener(function, args, count, 0);
+	}
+	const FunctionInfo& info = functions[function];
+	uint8_t flags = info.sync ? GLInterposer::SYNC : 0;
+	if (info.invalidates) {
+		stateValues.clear();
+	}
+	if (info.family < 0) {
+		return flags;
+	}
+	uint64_t key = mix(0, (uint64_t)info.family);
+	for (int i = 0; i < info.keyArgs; i++) {
+		key = mix(key, args[i].bits);
+	}
+	if (info.scope == SCOPE_UNIT) {
+		key = mix(key, activeUnit);
+	}
+	else if (info.scope == SCOPE_PROGRAM) {
+		key = mix(key, currentProgram);
+	}
+	else if (info.scope == SCOPE_ELEMENTS && args[0].bits == GL_ELEMENT_ARRAY_BUFFER) {
+		// the element array binding belongs to the bound VAO
+		key = mix(key, currentVao);
+	}
+	uint64_t value = mix(0, function);
+	for (size_t i = 0; i < count; i++) {
+		value = mix(value, args[i].bits);
+	}
+	uint64_t& known = stateValues[key];
+	if (known == value) {
+		flags |= GLInterposer::REDUNDANT;
+	}
+	known = value;
+	forgetAliases(info, args);
+	if (info.track == TRACK_PROGRAM) {
+		currentProgram = args[0].bits;
+	}
+	else if (info.track == TRACK_VAO) {
+		currentVao = args[0].bits;
+	}
+	else if (info.track == TRACK_UNIT) {
+		activeUnit = args[0].bits;
+	}
+	return flags;
+}
+
+static void endCall(uint16_t function, const GLInterposer::Arg* args, size_t count, uint64_t result, uint8_t flags, Clock::time_point start, Clock::time_point end) {
+	if (afterListener) {
+		afterListener(function, args, count, result);
+	}
+	double ms = std::chrono::duration<double, std::milli>(end - start).count();
+	GLInterposer::FunctionStats& stats = currentStats[function];
+	stats.calls++;
+	stats.ms += ms;
+	currentTotals.calls++;
+	currentTotals.ms += ms;
+	if (flags & GLInterposer::REDUNDANT) {
+		stats.redundant++;
+		currentTotals.redundant++;
+	}
+	if (flags & GLInterposer::SYNC) {
+		currentTotals.sync++;
+	}
+	if (!tracing) {
+		return;
+	}
+	if (traceCalls.size() >= traceLimit) {
+		traceDropped++;
+		return;
+	}
+	TracedCall call = { frameNumber, function, (uint8_t)count, flags, (uint32_t)traceArgs.size(),
+		std::chrono::duration<double, std::milli>(start - traceStart).count(), ms };
+	traceCalls.push_back(call);
+	traceArgs.insert(traceArgs.end(), args, args + count);
+}
+
+// Times the call it lives around, the wrappers put one on their stack.
+struct CallScope {
+	uint16_t function;
+	const GLInterposer::Arg* args;
+	size_t count;
+	uint64_t result;
+	uint8_t flags;
+	Clock::time_point start;
+
+	CallScope(uint16_t function, const GLInterposer::Arg* args, size_t count)
+		: function(function), args(args), count(count), result(0), flags(beginCall(function, args, count)), start(Clock::now()) {
+	}
+	~CallScope() {
+		endCall(function, args, count, result, flags, start, Clock::now());
+	}
+};
+
+template<typename T>
+static typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, GLInterposer::Arg>::type toArg(T value) {
+	GLInterposer::Arg arg = { (uint64_t)(int64_t)value, std::is_signed<T>::value ? 'i' : 'u' };
+	return arg;
+}
+
+template<typename T>
+static typename std::enable_if<std::is_floating_point<T>::value, GLInterposer::Arg>::type toArg(T value) {
+	double wide = value;
+	GLInterposer::Arg arg = { 0, 'f' };
+	memcpy(&arg.bits, &wide, sizeof(wide));
+	return arg;
+}
+
+template<typename T>
+static typename std::enable_if<std::is_pointer<T>::value, GLInterposer::Arg>::type toArg(T value) {
+	GLInterposer::Arg arg = { (uint64_t)(uintptr_t)value, 'p' };
+	return arg;
+}
+
+template<typename T>
+static typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, T>::type fromArg(uint64_t bits) {
+	return (T)bits;
+}
+
+template<typename T>
+static typename std::enable_if<std::is_floating_point<T>::value, T>::type fromArg(uint64_t bits) {
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return (T)value;
+}
+
+template<typename T>
+static typename std::enable_if<std::is_pointer<T>::value, T>::type fromArg(uint64_t bits) {
+	return (T)(uintptr_t)bits;
+}
+
+// Calls a function and keeps the bits of what it returned, void functions return 0.
+template<typename R>
+struct Returned {
+	template<typename F, typename... A>
+	static R call(CallScope& scope, F function, A... args) {
+		R result = function(args...);
+		scope.result = toArg(result).bits;
+		return result;
+	}
+	template<typename F, typename... A>
+	static uint64_t bits(F function, A... args) {
+		return toArg(function(args...)).bits;
+	}
+};
+
+template<>
+struct Returned<void> {
+	template<typename F, typename... A>
+	static void call(CallScope&, F function, A... args) {
+		function(args...);
+	}
+	template<typename F, typename... A>
+	static uint64_t bits(F function, A... args) {
+		function(args...);
+		return 0;
+	}
+};
+
+#if GL_INTERPOSER
+
+// One wrapper per glad pointer, generated from the pointer's type: same signature, records the call around
+// the driver's function.
+template<typename P, P* Slot>
+struct Wrapper;
+
+template<typename R, typename... A, R (APIENTRYP* Slot)(A...)>
+struct Wrapper<R (APIENTRYP)(A...), Slot> {
+	typedef R (APIENTRYP Function)(A...);
+	static Function original;
+	static uint16_t function;
+
+	static R APIENTRY call(A... args) {
+		GLInterposer::Arg values[sizeof...(A) + 1] = { toArg(args)... };
+		CallScope scope(function, values, sizeof...(A));
+		return Returned<R>::call(scope, original, args...);
+	}
+	//calls whatever glad's pointer holds, the wrapper when installed
+	static uint64_t invoke(const uint64_t* args) {
+		return invokeWith(args, std::index_sequence_for<A...>());
+	}
+	template<size_t... I>
+	static uint64_t invokeWith(const uint64_t* args, std::index_sequence<I...>) {
+		(void)args;
+		return Returned<R>::bits(*Slot, fromArg<A>(args[I])...);
+	}
+	//false when glad didn't load the function
+	static bool install(uint16_t index) {
+		function = index;
+		original = *Slot;
+		if (!original) {
+			return false;
+		}
+		*Slot = &call;
+		return true;
+	}
+	static void uninstall() {
+		if (original) {
+			*Slot = original;
+		}
+	}
+};
+
+template<typename R, typename... A, R (APIENTRYP* Slot)(A...)>
+typename Wrapper<R (APIENTRYP)(A...), Slot>::Function Wrapper<R (APIENTRYP)(A...), Slot>::original = nullptr;
+template<typename R, typename... A, R (APIENTRYP* Slot)(A...)>
+uint16_t Wrapper<R (APIENTRYP)(A...), Slot>::function = 0;
+
+struct Hook {
+	const char* name;
+	bool (*install)(uint16_t);
+	void (*uninstall)();
+	uint64_t (*invoke)(const uint64_t*);
+};
+
+#define GL_FUNCTION(name) { #name, &Wrapper<decltype(glad_##name), &glad_##name>::install, &Wrapper<decltype(glad_##name), &glad_##name>::uninstall, \
+	&Wrapper<decltype(glad_##name), &glad_##name>::invoke },
+static const Hook HOOKS[] = {
+#include "GLFunctions.h"
+};
+#undef GL_FUNCTION
+
+#endif
+
+static void buildTable() {
+#if GL_INTERPOSER
+	if (functions.empty()) {
+		for (const Hook& hook : HOOKS) {
+			functions.push_back(classify(hook.name));
+		}
+	}
+#endif
+}
+
+size_t GLInterposer::install() {
+	size_t wrapped = 0;
+#if GL_INTERPOSER
+	if (hooksInstalled) {
+		uninstall();
+	}
+	buildTable();
+	for (size_t i = 0; i < functions.size(); i++) {
+		if (HOOKS[i].install((uint16_t)i)) {
+			wrapped++;
+		}
+	}
+	GLInterposer::FunctionStats zero = { 0, 0, 0.0 };
+	currentStats.assign(functions.size(), zero);
+	lastStats.assign(functions.size(), zero);
+	memset(&currentTotals, 0, sizeof(currentTotals));
+	memset(&lastTotals, 0, sizeof(lastTotals));
+	// whatever was set before is unknown, the first set of anything is never redundant
+	stateValues.clear();
+	currentProgram = 0;
+	currentVao = 0;
+	activeUnit = GL_TEXTURE0;
+	hooksInstalled = true;
+#endif
+	return wrapped;
+}
+
+void GLInterposer::uninstall() {
+#if GL_INTERPOSER
+	if (!hooksInstalled) {
+		return;
+	}
+	for (const Hook& hook : HOOKS) {
+		hook.uninstall();
+	}
+	hooksInstalled = false;
+#endif
+}
+
+bool GLInterposer::installed() {
+	return hooksInstalled;
+}
+
+void GLInterposer::startTrace(size_t maxCalls) {
+	traceCalls.clear();
+	traceArgs.clear();
+	traceCalls.reserve(std::min(maxCalls, (size_t)1 << 16));
+	traceLimit = maxCalls;
+	traceDropped = 0;
+	traceStart = Clock::now();
+	tracing = true;
+}
+
+void GLInterposer::stopTrace() {
+	tracing = false;
+}
+
+static void writeArg(std::ostream& out, const GLInterposer::Arg& arg) {
+	if (arg.kind == 'i') {
+		out << (int64_t)arg.bits;
+	}
+	else if (arg.kind == 'u') {
+		// enums are unsigned too and read better in hex, object names and small values stay decimal
+		if (arg.bits >= 0x100) {
+			out << "0x" << std::hex << arg.bits << std::dec;
+		}
+		else {
+			out << arg.bits;
+		}
+	}
+	else if (arg.kind == 'f') {
+		double value;
+		memcpy(&value, &arg.bits, sizeof(value));
+		out << value;
+	}
+	else if (arg.bits == 0) {
+		out << "null";
+	}
+	else {
+		out << "0x" << std::hex << arg.bits << std::dec;
+	}
+}
+
+bool GLInterposer::writeTrace(const char* path) {
+	std::ofstream file(path);
+	file << "# frame start_ms call_us call\n";
+	for (const TracedCall& call : traceCalls) {
+		file << call.frame << " " << call.startMs << " " << call.ms * 1000.0 << " " << functions[call.function].name << "(";
+		for (size_t i = 0; i < call.argCount; i++) {
+			if (i > 0) {
+				file << ", ";
+			}
+			writeArg(file, traceArgs[call.firstArg + i]);
+		}
+		file << ")";
+		if (call.flags & REDUNDANT) {
+			file << " redundant";
+		}
+		if (call.flags & SYNC) {
+			file << " sync";
+		}
+		file << "\n";
+	}
+	if (traceDropped > 0) {
+		file << "# " << traceDropped << " calls after the first " << traceLimit << " were not kept\n";
+	}
+	if (!file) {
+		std::cout << "Failed to write " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void GLInterposer::endFrame() {
+	if (!hooksInstalled) {
+		return;
+	}
+	lastStats.swap(currentStats);
+	lastTotals = currentTotals;
+	GLInterposer::FunctionStats zero = { 0, 0, 0.0 };
+	std::fill(currentStats.begin(), currentStats.end(), zero);
+	memset(&currentTotals, 0, sizeof(currentTotals));
+	frameNumber++;
+}
+
+const GLInterposer::FrameTotals& GLInterposer::lastFrame() {
+	return lastTotals;
+}
+
+const std::vector<GLInterposer::FunctionStats>& GLInterposer::frameStats() {
+	return lastStats;
+}
+
+size_t GLInterposer::functionCount() {
+	buildTable();
+	return functions.size();
+}
+
+const char* GLInterposer::name(size_t function) {
+	return functions[function].name;
+}
+
+bool GLInterposer::isSync(size_t function) {
+	return functions[function].sync;
+}
+
+size_t GLInterposer::find(const char* name) {
+	buildTable();
+	for (size_t i = 0; i < functions.size(); i++) {
+		if (strcmp(functions[i].name, name) == 0) {
+			return i;
+		}
+	}
+	return functions.size();
+}
+
+void GLInterposer::setListeners(CallListener before, CallListener after) {
+	beforeListener = before;
+	afterListener = after;
+}
+
+uint64_t GLInterposer::invoke(size_t function, const uint64_t* args) {
+#if GL_INTERPOSER
+	return HOOKS[function].invoke(args);
+#else
+	(void)function;
+	(void)args;
+	return 0;
+#endif
+}
+
+void GLInterposer::report(std::ostream& out, size_t top) {
+	out << "GL calls: " << lastTotals.calls << " per frame, " << lastTotals.redundant << " redundant, " << lastTotals.sync << " sync points, "
+		<< lastTotals.ms << " ms in the driver" << std::endl;
+	std::vector<size_t> order;
+	for (size_t i = 0; i < lastStats.size(); i++) {
+		if (lastStats[i].calls > 0) {
+			order.push_back(i);
+		}
+	}
+	std::sort(order.begin(), order.end(), [](size_t a, size_t b) { return lastStats[a].calls > lastStats[b].calls; });
+	for (size_t i = 0; i < order.size() && i < top; i++) {
+		const FunctionStats& stats = lastStats[order[i]];
+		out << "  " << functions[order[i]].name << ": " << stats.calls << " calls, " << stats.ms << " ms";
+		if (stats.redundant > 0) {
+			out << ", " << stats.redundant << " redundant";
+		}
+		if (functions[order[i]].sync) {
+			out << ", sync";
+		}
+		out << std::endl;
+	}
+}
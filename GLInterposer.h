@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Build with GL_INTERPOSER=0 to compile the wrappers out, install() then wraps nothing.
+#ifndef GL_INTERPOSER
+#define GL_INTERPOSER 1
+#endif
+
+// Interposition of the GL entry points glad loads. glad keeps one global pointer per function (glUseProgram is a
+// macro for glad_glUseProgram), install() swaps every loaded pointer for a generated wrapper that records the
+// call and then calls the driver. Nothing is swapped until install(), so GL calls cost what they always did
+// unless the layer is asked for.
+// Calls are counted and timed per function per frame. State setters that set the value already set (same
+// program, same binding on the same target and unit, same scalar uniform value) are flagged as redundant, and
+// calls that wait for the GPU or read state back (glGet*, glReadPixels, glFinish, glClientWaitSync,
+// glMapBuffer*) are flagged as sync points. A trace keeps every call with its arguments.
+// GL is only called from the thread that owns the context, so none of this takes locks.
+class GLInterposer
+{
+public:
+	// one argument of a traced call, kind is 'i' signed, 'u' unsigned, 'f' floating (bits of a double) or 'p' pointer
+	struct Arg {
+		uint64_t bits;
+		char kind;
+	};
+
+	struct FunctionStats {
+		uint64_t calls;
+		uint64_t redundant;
+		double ms;
+	};
+
+	struct FrameTotals {
+		uint64_t calls;
+		uint64_t redundant;
+		uint64_t sync;
+		double ms;
+	};
+
+	enum CallFlags : uint8_t { REDUNDANT = 1, SYNC = 2 };
+
+	// sees every wrapped call, result holds the returned value's bits (0 before the call and for void functions)
+	typedef void (*CallListener)(size_t function, const Arg* args, size_t count, uint64_t result);
+
+	//wraps every function glad loaded, call after gladLoadGL*. Returns how many were wrapped.
+	static size_t install();
+	//puts the driver's pointers back
+	static void uninstall();
+	static bool installed();
+
+	//keeps every call with its arguments from now on, up to maxCalls, earlier calls are discarded
+	static void startTrace(size_t maxCalls = (size_t)1 << 20);
+	static void stopTrace();
+	//writes the trace as text, one call per line
+	static bool writeTrace(const char* path);
+
+	//closes the frame, its counts are then what lastFrame() and frameStats() return
+	static void endFrame();
+	static const FrameTotals& lastFrame();
+	//indexed by function, see name()
+	static const std::vector<FunctionStats>& frameStats();
+	static size_t functionCount();
+	static const char* name(size_t function);
+	static bool isSync(size_t function);
+	//index of the function called name, functionCount() when glad has no such function
+	static size_t find(const char* name);
+
+	//listeners called before and after every wrapped call, null for none
+	static void setListeners(CallListener before, CallListener after);
+	//calls the function through glad's pointer with arguments given as Arg bits, returns the result's bits.
+	//Works whether or not the wrappers are installed.
+	static uint64_t invoke(size_t function, const uint64_t* args);
+	//prints the last frame's totals and its functions with the most calls
+	static void report(std::ostream& out, size_t top = 10);
+};
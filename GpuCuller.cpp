@@ -0,0 +1,266 @@
+#include "GpuCuller.h"
+#include "GLExtensions.h"
+#include "RenderStats.h"
+#include "Shader.h"
+#include "StateTracker.h"
+
+#include <algorithm>
+#include <iostream>
+
+static_assert(sizeof(GpuInstance) == 96, "GpuInstance must match the std430 Instance struct");
+static_assert(sizeof(DrawElementsIndirectCommand) == 20, "commands are written by cull.comp");
+
+// glMultiDrawElementsIndirectCount from 4.6 core or ARB_indirect_parameters, which glad does not load below 4.6
+static PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC multiDrawElementsIndirectCount = NULL;
+
+// binding points of the blocks in cull.comp and shader_instanced.vert
+static const unsigned int INSTANCE_BINDING = 1;
+static const unsigned int COMMAND_BINDING = 2;
+static const unsigned int COUNT_BINDING = 3;
+static const unsigned int CULL_GROUP_SIZE = 64;
+static const unsigned int HIZ_GROUP_SIZE = 8;
+
+static bool linked(unsigned int program) {
+	int success = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	return success != 0;
+}
+
+GpuCuller::GpuCuller() : frustumCulling(true), occlusionCulling(false), indirectCount(false), uploadedBytes(0), instanceCount(0), dirtyBegin(0), dirtyEnd(0),
+	cullProgram(0), hiZProgram(0), instanceBuffer(0), commandBuffer(0), countBuffer(0), indexBuffer(0), hiZTexture(0), hiZWidth(0), hiZHeight(0), hiZLevels(0), locations(),
+	countReadback(0), countFence(0) {
+}
+
+bool GpuCuller::init(GLADloadproc loader, size_t maxInstances) {
+	release();
+	cullProgram = Shader("cull.comp").ID;
+	hiZProgram = Shader("hiz.comp").ID;
+	if (!linked(cullProgram) || !linked(hiZProgram)) {
+		std::cout << "GPU culling shaders failed to build, culling on the CPU." << std::endl;
+		release();
+		return false;
+	}
+	multiDrawElementsIndirectCount = GLAD_GL_VERSION_4_6 ? glad_glMultiDrawElementsIndirectCount : NULL;
+	if (!multiDrawElementsIndirectCount && hasGLExtension("GL_ARB_indirect_parameters")) {
+		multiDrawElementsIndirectCount = (PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC)loader("glMultiDrawElementsIndirectCountARB");
+	}
+	indirectCount = multiDrawElementsIndirectCount != NULL;
+	if (!indirectCount) {
+		std::cout << "ARB_indirect_parameters not supported, drawing every command slot." << std::endl;
+	}
+	locations.instanceCount = glGetUniformLocation(cullProgram, "instanceCount");
+	locations.view = glGetUniformLocation(cullProgram, "view");
+	locations.projection = glGetUniformLocation(cullProgram, "projection");
+	locations.planes = glGetUniformLocation(cullProgram, "planes");
+	locations.frustumCulling = glGetUniformLocation(cullProgram, "frustumCulling");
+	locations.occlusionCulling = glGetUniformLocation(cullProgram, "occlusionCulling");
+	locations.hiZLevels = glGetUniformLocation(cullProgram, "hiZLevels");
+	locations.hiZ = glGetUniformLocation(cullProgram, "hiZ");
+
+	instances.assign(maxInstances, GpuInstance());
+	instanceCount = 0;
+	dirtyBegin = dirtyEnd = 0;
+	glGenBuffers(1, &instanceBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, maxInstances * sizeof(GpuInstance), NULL, GL_DYNAMIC_DRAW);
+	glGenBuffers(1, &commandBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, maxInstances * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_COPY);
+	glGenBuffers(1, &countBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(uint32_t), NULL, GL_DYNAMIC_COPY);
+	glGenBuffers(1, &countReadback);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, countReadback);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(uint32_t), NULL, GL_STREAM_READ);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	// instance i reads index i through an attribute with divisor 1, so each command's baseInstance selects its instance
+	std::vector<uint32_t> indices(maxInstances);
+	for (size_t i = 0; i < maxInstances; i++) {
+		indices[i] = (uint32_t)i;
+	}
+	glGenBuffers(1, &indexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, indexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return true;
+}
+
+void GpuCuller::setInstance(size_t index, const GpuInstance& instance) {
+	instances[index] = instance;
+	if (dirtyBegin == dirtyEnd) {
+		dirtyBegin = index;
+		dirtyEnd = index + 1;
+	}
+	else {
+		dirtyBegin = std::min(dirtyBegin, index);
+		dirtyEnd = std::max(dirtyEnd, index + 1);
+	}
+	instanceCount = std::max(instanceCount, index + 1);
+}
+
+void GpuCuller::setInstanceCount(size_t count) {
+	instanceCount = std::min(count, instances.size());
+}
+
+void GpuCuller::updateHiZ(const float* depth, int width, int height, StateTracker& state) {
+	if (width != hiZWidth || height != hiZHeight) {
+		// a deleted name can come back from glGenTextures, the tracker must not think it is still bound
+		state.bindTexture(0, 0);
+		glDeleteTextures(1, &hiZTexture);
+		hiZWidth = width;
+		hiZHeight = height;
+		hiZLevels = 1;
+		while ((std::max(width, height) >> hiZLevels) > 0) {
+			hiZLevels++;
+		}
+		glGenTextures(1, &hiZTexture);
+		state.bindTexture(0, hiZTexture);
+		glTexStorage2D(GL_TEXTURE_2D, hiZLevels, GL_R32F, width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+	state.bindTexture(0, hiZTexture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RED, GL_FLOAT, depth);
+	RENDER_STAT(TEXTURE_BYTES, (size_t)width * height * sizeof(float));
+
+	state.useProgram(hiZProgram);
+	for (int level = 1; level < hiZLevels; level++) {
+		int w = std::max(1, width >> level), h = std::max(1, height >> level);
+		glBindImageTexture(0, hiZTexture, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		glBindImageTexture(1, hiZTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute((w + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, (h + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, 1);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	}
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void GpuCuller::cull(const glm::mat4& view, const glm::mat4& projection, StateTracker& state) {
+	uploadedBytes = 0;
+	if (dirtyEnd > dirtyBegin) {
+		uploadedBytes = (dirtyEnd - dirtyBegin) * sizeof(GpuInstance);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, dirtyBegin * sizeof(GpuInstance), uploadedBytes, &instances[dirtyBegin]);
+		RENDER_STAT(BUFFER_BYTES, uploadedBytes);
+		dirtyBegin = dirtyEnd = 0;
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+	if (!indirectCount) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, instanceBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNT_BINDING, countBuffer);
+
+	glm::vec4 planes[6];
+	frustumPlanes(projection * view, planes);
+	state.useProgram(cullProgram);
+	glUniform1i(locations.instanceCount, (int)instanceCount);
+	glUniformMatrix4fv(locations.view, 1, GL_FALSE, &view[0][0]);
+	glUniformMatrix4fv(locations.projection, 1, GL_FALSE, &projection[0][0]);
+	glUniform4fv(locations.planes, 6, &planes[0][0]);
+	glUniform1i(locations.frustumCulling, frustumCulling);
+	bool occlusion = occlusionCulling && hiZTexture != 0;
+	glUniform1i(locations.occlusionCulling, occlusion);
+	glUniform1i(locations.hiZLevels, hiZLevels);
+	glUniform1i(locations.hiZ, 0);
+	RENDER_STAT(UNIFORM_UPLOADS, 8);
+	state.bindTexture(0, occlusion ? hiZTexture : 0);
+	glDispatchCompute((GLuint)((instanceCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE), 1, 1);
+	// the commands and the count are read by the draw next, the count also by readDrawCount
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+void GpuCuller::draw(GLenum indexType) const {
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	if (indirectCount) {
+		glBindBuffer(GL_PARAMETER_BUFFER, countBuffer);
+		multiDrawElementsIndirectCount(GL_TRIANGLES, indexType, 0, 0, (GLsizei)instanceCount, 0);
+		glBindBuffer(GL_PARAMETER_BUFFER, 0);
+	}
+	else {
+		glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, 0, (GLsizei)instanceCount, 0);
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	RENDER_STAT(DRAW_CALLS, 1);
+	// instances and triangles are decided on the GPU, the CPU never sees them
+}
+
+void GpuCuller::setupInstanceAttribute(GLuint location) const {
+	glBindBuffer(GL_ARRAY_BUFFER, indexBuffer);
+	glVertexAttribIPointer(location, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void*)0);
+	glVertexAttribDivisor(location, 1);
+	glEnableVertexAttribArray(location);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+uint32_t GpuCuller::readDrawCount() const {
+	uint32_t count = 0;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(count), &count);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	return count;
+}
+
+void GpuCuller::readCommands(std::vector<DrawElementsIndirectCommand>& out) const {
+	out.resize(std::min((size_t)readDrawCount(), instanceCount));
+	if (out.empty()) {
+		return;
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, out.size() * sizeof(DrawElementsIndirectCommand), out.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void GpuCuller::requestDrawCount() {
+	if (countFence || !countBuffer) {
+		return;
+	}
+	// a GPU side copy, the barrier at the end of cull() already covers it
+	glBindBuffer(GL_COPY_READ_BUFFER, countBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, countReadback);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(uint32_t));
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	countFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+bool GpuCuller::pollDrawCount(uint32_t& count) {
+	if (!countFence) {
+		return false;
+	}
+	GLenum status = glClientWaitSync(countFence, 0, 0);
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+		return false;
+	}
+	glDeleteSync(countFence);
+	countFence = 0;
+	// the copy is done, reading it back does not wait
+	glBindBuffer(GL_COPY_READ_BUFFER, countReadback);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(count), &count);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	return true;
+}
+
+void GpuCuller::release() {
+	glDeleteProgram(cullProgram);
+	glDeleteProgram(hiZProgram);
+	unsigned int buffers[] = { instanceBuffer, commandBuffer, countBuffer, indexBuffer, countReadback };
+	glDeleteBuffers(5, buffers);
+	glDeleteTextures(1, &hiZTexture);
+	if (countFence) {
+		glDeleteSync(countFence);
+	}
+	cullProgram = hiZProgram = 0;
+	instanceBuffer = commandBuffer = countBuffer = indexBuffer = countReadback = 0;
+	countFence = 0;
+	hiZTexture = 0;
+	hiZWidth = hiZHeight = hiZLevels = 0;
+	instances.clear();
+	instanceCount = 0;
+	dirtyBegin = dirtyEnd = 0;
+}
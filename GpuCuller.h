@@ -0,0 +1,84 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Meshlets.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One instance in the instance SSBO, std430 layout as declared in cull.comp and shader_instanced.vert.
+struct GpuInstance {
+	glm::mat4 model;
+	glm::vec4 sphere; // model space bounding sphere, center and radius
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	int32_t baseVertex;
+	uint32_t pad;
+};
+
+// Culls instances on the GPU. A compute pass tests every instance's bounding sphere against the frustum and a
+// Hi-Z pyramid, and appends the survivors as DrawElementsIndirectCommands with an atomic counter. The commands
+// are drawn with glMultiDrawElementsIndirectCount, so the visible count never comes back to the CPU.
+//
+// Instances stay in GPU memory between frames, the CPU only uploads the range it changed. Each command's
+// baseInstance is the instance index, shader_instanced.vert reads the model matrix with it.
+// Without ARB_indirect_parameters the command buffer is cleared every frame and drawn in full, culled slots
+// are zero and draw nothing.
+class GpuCuller
+{
+public:
+	GpuCuller();
+
+	//compiles the compute shaders and creates buffers for up to maxInstances, false when the context can't run them.
+	//Pass the same loader that was given to glad.
+	bool init(GLADloadproc loader, size_t maxInstances);
+	//changes one instance, uploaded by the next cull()
+	void setInstance(size_t index, const GpuInstance& instance);
+	void setInstanceCount(size_t count);
+	const GpuInstance& instance(size_t index) const { return instances[index]; }
+	//uploads a [0, 1] depth image, bottom row first, and builds the Hi-Z pyramid from it.
+	//Binds its program and texture unit 0 through the tracker.
+	void updateHiZ(const float* depth, int width, int height, class StateTracker& state);
+	//uploads changed instances and runs the culling pass, binds through the tracker like updateHiZ
+	void cull(const glm::mat4& view, const glm::mat4& projection, class StateTracker& state);
+	//draws the commands of the last cull() with the bound VAO and element buffer
+	void draw(GLenum indexType) const;
+	//adds the per instance index attribute to the bound VAO
+	void setupInstanceAttribute(GLuint location) const;
+
+	//read back the results of the last cull(), these wait for the GPU and are meant for tests
+	uint32_t readDrawCount() const;
+	void readCommands(std::vector<DrawElementsIndirectCommand>& out) const;
+	//copies the count of the last cull() behind a fence, does nothing while an earlier request is pending
+	void requestDrawCount();
+	//true once the requested count has arrived, never waits for the GPU. For statistics in the render loop.
+	bool pollDrawCount(uint32_t& count);
+
+	//deletes programs, buffers and the pyramid, must be called while the context is still alive
+	void release();
+
+	bool frustumCulling;
+	bool occlusionCulling;
+	// ARB_indirect_parameters (core in 4.6) was found
+	bool indirectCount;
+	// bytes of instance data uploaded by the last cull()
+	size_t uploadedBytes;
+
+private:
+	std::vector<GpuInstance> instances;
+	size_t instanceCount;
+	size_t dirtyBegin, dirtyEnd;
+	unsigned int cullProgram, hiZProgram;
+	unsigned int instanceBuffer, commandBuffer, countBuffer, indexBuffer;
+	unsigned int hiZTexture;
+	int hiZWidth, hiZHeight, hiZLevels;
+	// cull.comp uniforms, looked up once by init()
+	struct {
+		int instanceCount, view, projection, planes, frustumCulling, occlusionCulling, hiZLevels, hiZ;
+	} locations;
+	unsigned int countReadback;
+	GLsync countFence;
+};
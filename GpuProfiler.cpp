@@ -0,0 +1,195 @@
+#include "GpuProfiler.h"
+
+#if GPU_PROFILING
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+GpuProfiler::GpuProfiler() : enabled(false), keepHistory(false), skippedFrames(0), current(0), recording(false), ready(false), frameNumber(0) {
+	for (Frame& frame : ring) {
+		frame.number = 0;
+		frame.pending = false;
+		frame.used = 0;
+	}
+	latest.frame = 0;
+}
+
+bool GpuProfiler::init() {
+	if (!GLAD_GL_VERSION_3_3) {
+		std::cout << "Timer queries need OpenGL 3.3, GPU profiling is off." << std::endl;
+		return false;
+	}
+	ready = true;
+	enabled = true;
+	return true;
+}
+
+size_t GpuProfiler::query(Frame& frame) {
+	if (frame.used == frame.queries.size()) {
+		// grows to the most queries a frame ever needed, then stays
+		size_t grown = frame.queries.size() + 16;
+		frame.queries.resize(grown);
+		glGenQueries(16, &frame.queries[grown - 16]);
+	}
+	return frame.used++;
+}
+
+void GpuProfiler::collect(Frame& frame) {
+	std::vector<GLuint64> times(frame.used);
+	for (size_t i = 0; i < frame.used; i++) {
+		glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &times[i]);
+		// available already, the last query of the frame was and they complete in order
+	}
+	latest.frame = frame.number;
+	latest.zones.clear();
+	GLuint64 origin = frame.zones.empty() ? 0 : times[frame.zones[0].begin];
+	for (const Zone& zone : frame.zones) {
+		GpuZoneResult result;
+		result.name = zone.name;
+		result.depth = zone.depth;
+		result.startMs = (double)(times[zone.begin] - origin) * 1e-6;
+		result.ms = (double)(times[zone.end] - times[zone.begin]) * 1e-6;
+		latest.zones.push_back(result);
+
+		Average* average = nullptr;
+		for (Average& a : averages) {
+			if (a.name == zone.name || strcmp(a.name, zone.name) == 0) {
+				average = &a;
+				break;
+			}
+		}
+		if (!average) {
+			averages.push_back(Average());
+			average = &averages.back();
+			average->name = zone.name;
+			average->count = 0;
+			average->next = 0;
+		}
+		average->samples[average->next] = result.ms;
+		average->next = (average->next + 1) % AVERAGE_FRAMES;
+		average->count = average->count < AVERAGE_FRAMES ? average->count + 1 : AVERAGE_FRAMES;
+	}
+	if (keepHistory) {
+		frames.push_back(latest);
+	}
+	frame.pending = false;
+}
+
+void GpuProfiler::beginFrame() {
+	recording = false;
+	if (!ready) {
+		return;
+	}
+	// oldest first, so history stays in frame order
+	for (int i = 1; i <= FRAMES; i++) {
+		Frame& frame = ring[(current + i) % FRAMES];
+		if (!frame.pending) {
+			continue;
+		}
+		GLint available = 0;
+		glGetQueryObjectiv(frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			break;
+		}
+		collect(frame);
+	}
+	frameNumber++;
+	if (!enabled) {
+		return;
+	}
+	Frame& frame = ring[(current + 1) % FRAMES];
+	if (frame.pending) {
+		skippedFrames++;
+		return;
+	}
+	current = (current + 1) % FRAMES;
+	frame.number = frameNumber;
+	frame.used = 0;
+	frame.zones.clear();
+	open.clear();
+	recording = true;
+}
+
+void GpuProfiler::endFrame() {
+	if (!recording) {
+		return;
+	}
+	recording = false;
+	Frame& frame = ring[current];
+	if (!open.empty()) {
+		std::cout << "GPU zone " << frame.zones[open.back()].name << " was not closed, frame dropped." << std::endl;
+		return;
+	}
+	frame.pending = frame.used > 0;
+}
+
+void GpuProfiler::beginZone(const char* name) {
+	if (!recording) {
+		return;
+	}
+	Frame& frame = ring[current];
+	Zone zone;
+	zone.name = name;
+	zone.depth = (int)open.size();
+	zone.begin = query(frame);
+	zone.end = zone.begin;
+	glQueryCounter(frame.queries[zone.begin], GL_TIMESTAMP);
+	open.push_back(frame.zones.size());
+	frame.zones.push_back(zone);
+}
+
+void GpuProfiler::endZone() {
+	if (!recording || open.empty()) {
+		return;
+	}
+	Frame& frame = ring[current];
+	Zone& zone = frame.zones[open.back()];
+	open.pop_back();
+	zone.end = query(frame);
+	glQueryCounter(frame.queries[zone.end], GL_TIMESTAMP);
+}
+
+void GpuProfiler::release() {
+	for (Frame& frame : ring) {
+		if (!frame.queries.empty()) {
+			glDeleteQueries((GLsizei)frame.queries.size(), frame.queries.data());
+		}
+		frame.queries.clear();
+		frame.used = 0;
+		frame.pending = false;
+	}
+	ready = false;
+	enabled = false;
+	recording = false;
+}
+
+double GpuProfiler::average(const char* name) const {
+	for (const Average& a : averages) {
+		if (a.name == name || strcmp(a.name, name) == 0) {
+			double total = 0.0;
+			for (int i = 0; i < a.count; i++) {
+				total += a.samples[i];
+			}
+			return a.count > 0 ? total / a.count : 0.0;
+		}
+	}
+	return 0.0;
+}
+
+bool GpuProfiler::writeCsv(const char* path) const {
+	std::ofstream file(path);
+	file << "frame,zone,depth,start_ms,ms\n";
+	for (const GpuFrameResult& frame : frames) {
+		for (const GpuZoneResult& zone : frame.zones) {
+			file << frame.frame << "," << zone.name << "," << zone.depth << "," << zone.startMs << "," << zone.ms << "\n";
+		}
+	}
+	if (!file) {
+		std::cout << "Failed to write " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+#endif
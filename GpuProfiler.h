@@ -0,0 +1,154 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Build with GPU_PROFILING=0 to compile the profiler out, GpuProfiler then has empty inline members and
+// GPU_ZONE expands to nothing.
+#ifndef GPU_PROFILING
+#define GPU_PROFILING 1
+#endif
+
+// Time of one zone in a finished frame, zones are listed in the order they began.
+struct GpuZoneResult {
+	const char* name;
+	int depth;
+	// from the start of the frame's first zone, milliseconds
+	double startMs;
+	double ms;
+};
+
+struct GpuFrameResult {
+	uint64_t frame;
+	std::vector<GpuZoneResult> zones;
+};
+
+#if GPU_PROFILING
+
+// Measures GPU time of nested zones with GL_TIMESTAMP queries, one at each end of a zone (GL_TIME_ELAPSED
+// queries can't nest). Queries go into a ring several frames deep, a frame's results are read once
+// GL_QUERY_RESULT_AVAILABLE says the GPU got through it, so nothing waits for the GPU. When every slot of the
+// ring is still pending a frame is skipped instead of stalling.
+class GpuProfiler
+{
+public:
+	static const int FRAMES = 4;
+
+	GpuProfiler();
+
+	//false when the context has no timer queries (core since 3.3), the profiler then stays disabled
+	bool init();
+	//collects every finished frame, then starts recording a new one
+	void beginFrame();
+	void endFrame();
+	//name must outlive the profiler, string literals are meant
+	void beginZone(const char* name);
+	void endZone();
+	//deletes the queries, must be called while the context is still alive
+	void release();
+
+	//rolling average over the last AVERAGE_FRAMES results of the zone, 0 when it never finished
+	double average(const char* name) const;
+	//the most recent finished frame
+	const GpuFrameResult& lastFrame() const { return latest; }
+	//every finished frame since keepHistory was set, for export
+	const std::vector<GpuFrameResult>& history() const { return frames; }
+	//writes the history as CSV: frame, zone, depth, start and duration in milliseconds
+	bool writeCsv(const char* path) const;
+
+	// recording on or off at run time, off costs one branch per call
+	bool enabled;
+	// keeps every finished frame in history()
+	bool keepHistory;
+	// frames not recorded because the ring was full
+	size_t skippedFrames;
+
+private:
+	static const int AVERAGE_FRAMES = 64;
+
+	struct Zone {
+		const char* name;
+		int depth;
+		size_t begin;
+		size_t end;
+	};
+	struct Frame {
+		uint64_t number;
+		bool pending;
+		std::vector<GLuint> queries;
+		size_t used;
+		std::vector<Zone> zones;
+	};
+	struct Average {
+		const char* name;
+		double samples[AVERAGE_FRAMES];
+		int count;
+		int next;
+	};
+
+	size_t query(Frame& frame);
+	void collect(Frame& frame);
+
+	Frame ring[FRAMES];
+	int current;
+	bool recording;
+	bool ready;
+	uint64_t frameNumber;
+	std::vector<size_t> open;
+	GpuFrameResult latest;
+	std::vector<GpuFrameResult> frames;
+	std::vector<Average> averages;
+};
+
+#else
+
+class GpuProfiler
+{
+public:
+	static const int FRAMES = 4;
+
+	bool init() { return false; }
+	void beginFrame() {}
+	void endFrame() {}
+	void beginZone(const char*) {}
+	void endZone() {}
+	void release() {}
+	double average(const char*) const { return 0.0; }
+	const GpuFrameResult& lastFrame() const { return latest; }
+	const std::vector<GpuFrameResult>& history() const { return frames; }
+	bool writeCsv(const char*) const { return false; }
+
+	bool enabled = false;
+	bool keepHistory = false;
+	size_t skippedFrames = 0;
+
+private:
+	GpuFrameResult latest;
+	std::vector<GpuFrameResult> frames;
+};
+
+#endif
+
+// Times the enclosing scope as one zone.
+class GpuZone
+{
+public:
+	GpuZone(GpuProfiler& profiler, const char* name) : profiler(profiler) { profiler.beginZone(name); }
+	~GpuZone() { profiler.endZone(); }
+	GpuZone(const GpuZone&) = delete;
+	GpuZone& operator=(const GpuZone&) = delete;
+
+private:
+	GpuProfiler& profiler;
+};
+
+#define GPU_ZONE_CONCAT2(a, b) a##b
+#define GPU_ZONE_CONCAT(a, b) GPU_ZONE_CONCAT2(a, b)
+#if GPU_PROFILING
+#define GPU_ZONE(profiler, name) GpuZone GPU_ZONE_CONCAT(gpuZone, __LINE__)(profiler, name)
+#else
+#define GPU_ZONE(profiler, name)
+#endif
@@ -0,0 +1,152 @@
+#include "HeadlessContext.h"
+
+#include <iostream>
+
+#if !defined(_WIN32)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+#ifndef EGL_NO_CONFIG_KHR
+#define EGL_NO_CONFIG_KHR ((EGLConfig)0)
+#endif
+
+HeadlessContext::HeadlessContext() : width(0), height(0), framebuffer(0), renderbuffers(), display(nullptr), context(nullptr), surface(nullptr) {
+}
+
+HeadlessContext::~HeadlessContext() {
+	release();
+}
+
+#if defined(_WIN32)
+
+bool HeadlessContext::init(int, int) {
+	std::cout << "Headless rendering needs EGL, it is not available on Windows." << std::endl;
+	return false;
+}
+
+void HeadlessContext::release() {
+}
+
+void* HeadlessContext::getProcAddress(const char*) {
+	return nullptr;
+}
+
+#else
+
+void* HeadlessContext::getProcAddress(const char* name) {
+	return (void*)eglGetProcAddress(name);
+}
+
+bool HeadlessContext::init(int w, int h) {
+	release();
+	width = w;
+	height = h;
+	// surfaceless first, it needs neither a display server nor a config
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+	EGLint major, minor;
+	if (getPlatformDisplay) {
+		eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		if (eglDisplay != EGL_NO_DISPLAY && !eglInitialize(eglDisplay, &major, &minor)) {
+			eglDisplay = EGL_NO_DISPLAY;
+		}
+	}
+	if (eglDisplay == EGL_NO_DISPLAY) {
+		eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor)) {
+			std::cout << "Failed to initialise EGL." << std::endl;
+			return false;
+		}
+	}
+	display = eglDisplay;
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		std::cout << "EGL has no desktop OpenGL." << std::endl;
+		release();
+		return false;
+	}
+
+	const EGLint configAttributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_NONE };
+	EGLConfig config = EGL_NO_CONFIG_KHR;
+	EGLint configCount = 0;
+	eglChooseConfig(eglDisplay, configAttributes, &config, 1, &configCount);
+	if (configCount == 0) {
+		config = EGL_NO_CONFIG_KHR;
+		// fine with EGL_KHR_no_config_context, the surfaceless platform has it
+	}
+	const EGLint contextAttributes[] = { EGL_CONTEXT_MAJOR_VERSION, 4, EGL_CONTEXT_MINOR_VERSION, 4,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE };
+	context = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, contextAttributes);
+	if (context == EGL_NO_CONTEXT) {
+		context = nullptr;
+		std::cout << "Failed to create an OpenGL 4.4 core context with EGL." << std::endl;
+		release();
+		return false;
+	}
+	// drawing goes to the framebuffer object, a surface is only made when the context can't be current without one
+	if (!eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, (EGLContext)context)) {
+		const EGLint pbufferAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		EGLSurface pbuffer = configCount > 0 ? eglCreatePbufferSurface(eglDisplay, config, pbufferAttributes) : EGL_NO_SURFACE;
+		if (pbuffer == EGL_NO_SURFACE || !eglMakeCurrent(eglDisplay, pbuffer, pbuffer, (EGLContext)context)) {
+			if (pbuffer != EGL_NO_SURFACE) {
+				eglDestroySurface(eglDisplay, pbuffer);
+			}
+			std::cout << "Failed to make the EGL context current." << std::endl;
+			release();
+			return false;
+		}
+		surface = pbuffer;
+	}
+	if (!gladLoadGLLoader((GLADloadproc)getProcAddress)) {
+		std::cout << "Failed to initialise GLAD !" << std::endl;
+		release();
+		return false;
+	}
+
+	glGenFramebuffers(1, &framebuffer);
+	glGenRenderbuffers(2, renderbuffers);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cout << "Headless framebuffer is incomplete." << std::endl;
+		release();
+		return false;
+	}
+	// stays bound, the renderer never binds the default framebuffer so it draws here unchanged
+	glViewport(0, 0, width, height);
+	return true;
+}
+
+void HeadlessContext::release() {
+	if (context) {
+		if (framebuffer) {
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glDeleteFramebuffers(1, &framebuffer);
+			glDeleteRenderbuffers(2, renderbuffers);
+			framebuffer = 0;
+		}
+		eglMakeCurrent((EGLDisplay)display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext((EGLDisplay)display, (EGLContext)context);
+		context = nullptr;
+	}
+	if (surface) {
+		eglDestroySurface((EGLDisplay)display, (EGLSurface)surface);
+		surface = nullptr;
+	}
+	if (display) {
+		eglTerminate((EGLDisplay)display);
+		display = nullptr;
+	}
+}
+
+#endif
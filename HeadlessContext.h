@@ -0,0 +1,35 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// OpenGL context without a window for build machines and render servers. On Linux it is created through EGL,
+// surfaceless (EGL_MESA_platform_surfaceless, which Mesa's llvmpipe provides without a display or GPU) or with a
+// pbuffer on the default display, and everything is drawn into a framebuffer object of the requested size.
+// Not available on Windows, init fails there.
+class HeadlessContext
+{
+public:
+	HeadlessContext();
+	~HeadlessContext();
+	HeadlessContext(const HeadlessContext&) = delete;
+	HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+	//creates a 4.4 core context, makes it current, loads glad and binds a width x height framebuffer with color
+	//and depth/stencil, returns false if any of it fails
+	bool init(int width, int height);
+	//deletes the framebuffer and destroys the context
+	void release();
+
+	//loader for glad and everything else taking a GLADloadproc
+	static void* getProcAddress(const char* name);
+
+	int width;
+	int height;
+	unsigned int framebuffer;
+
+private:
+	unsigned int renderbuffers[2];
+	void* display;
+	void* context;
+	void* surface;
+};
@@ -0,0 +1,251 @@
+#include "Json.h"
+
+#include <cstdlib>
+#include <cstring>
+
+static const JsonValue nullValue;
+
+const JsonValue& JsonValue::operator[](const char* key) const {
+	if (type == Object) {
+		for (const auto& member : object) {
+			if (member.first == key) {
+				return member.second;
+			}
+		}
+	}
+	return nullValue;
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const {
+	if (type == Array && index < array.size()) {
+		return array[index];
+	}
+	return nullValue;
+}
+
+namespace {
+
+struct Parser {
+	const char* p;
+	const char* end;
+	std::string error;
+
+	void skipSpace() {
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+			p++;
+		}
+	}
+
+	bool fail(const char* message) {
+		if (error.empty()) {
+			error = message;
+		}
+		return false;
+	}
+
+	bool literal(const char* word) {
+		size_t n = strlen(word);
+		if ((size_t)(end - p) < n || memcmp(p, word, n) != 0) {
+			return fail("unexpected token");
+		}
+		p += n;
+		return true;
+	}
+
+	static void appendUtf8(std::string& out, unsigned int c) {
+		if (c < 0x80) {
+			out += (char)c;
+		}
+		else if (c < 0x800) {
+			out += (char)(0xC0 | (c >> 6));
+			out += (char)(0x80 | (c & 0x3F));
+		}
+		else if (c < 0x10000) {
+			out += (char)(0xE0 | (c >> 12));
+			out += (char)(0x80 | ((c >> 6) & 0x3F));
+			out += (char)(0x80 | (c & 0x3F));
+		}
+		else {
+			out += (char)(0xF0 | (c >> 18));
+			out += (char)(0x80 | ((c >> 12) & 0x3F));
+			out += (char)(0x80 | ((c >> 6) & 0x3F));
+			out += (char)(0x80 | (c & 0x3F));
+		}
+	}
+
+	bool hex4(unsigned int& c) {
+		if (end - p < 4) {
+			return fail("bad unicode escape");
+		}
+		c = 0;
+		for (int i = 0; i < 4; i++) {
+			char h = *p++;
+			c <<= 4;
+			if (h >= '0' && h <= '9') c |= h - '0';
+			else if (h >= 'a' && h <= 'f') c |= h - 'a' + 10;
+			else if (h >= 'A' && h <= 'F') c |= h - 'A' + 10;
+			else return fail("bad unicode escape");
+		}
+		return true;
+	}
+
+	bool parseString(std::string& out) {
+		p++; // opening quote
+		while (p < end && *p != '"') {
+			char c = *p++;
+			if (c != '\\') {
+				out += c;
+				continue;
+			}
+			if (p >= end) {
+				break;
+			}
+			char e = *p++;
+			switch (e) {
+			case 'n': out += '\n'; break;
+			case 't': out += '\t'; break;
+			case 'r': out += '\r'; break;
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'u': {
+				unsigned int code;
+				if (!hex4(code)) {
+					return false;
+				}
+				// surrogate pair
+				if (code >= 0xD800 && code < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+					p += 2;
+					unsigned int low;
+					if (!hex4(low)) {
+						return false;
+					}
+					code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+				}
+				appendUtf8(out, code);
+				break;
+			}
+			default: out += e; break;
+			}
+		}
+		if (p >= end) {
+			return fail("unterminated string");
+		}
+		p++; // closing quote
+		return true;
+	}
+
+	bool parseValue(JsonValue& v, int depth) {
+		if (depth > 256) {
+			return fail("nesting too deep");
+		}
+		skipSpace();
+		if (p >= end) {
+			return fail("unexpected end of input");
+		}
+		switch (*p) {
+		case '{': {
+			v.type = JsonValue::Object;
+			p++;
+			skipSpace();
+			if (p < end && *p == '}') {
+				p++;
+				return true;
+			}
+			while (true) {
+				skipSpace();
+				if (p >= end || *p != '"') {
+					return fail("expected member name");
+				}
+				v.object.emplace_back();
+				if (!parseString(v.object.back().first)) {
+					return false;
+				}
+				skipSpace();
+				if (p >= end || *p != ':') {
+					return fail("expected ':'");
+				}
+				p++;
+				if (!parseValue(v.object.back().second, depth + 1)) {
+					return false;
+				}
+				skipSpace();
+				if (p < end && *p == ',') {
+					p++;
+					continue;
+				}
+				if (p < end && *p == '}') {
+					p++;
+					return true;
+				}
+				return fail("expected ',' or '}'");
+			}
+		}
+		case '[': {
+			v.type = JsonValue::Array;
+			p++;
+			skipSpace();
+			if (p < end && *p == ']') {
+				p++;
+				return true;
+			}
+			while (true) {
+				v.array.emplace_back();
+				if (!parseValue(v.array.back(), depth + 1)) {
+					return false;
+				}
+				skipSpace();
+				if (p < end && *p == ',') {
+					p++;
+					continue;
+				}
+				if (p < end && *p == ']') {
+					p++;
+					return true;
+				}
+				return fail("expected ',' or ']'");
+			}
+		}
+		case '"':
+			v.type = JsonValue::String;
+			return parseString(v.string);
+		case 't':
+			v.type = JsonValue::Bool;
+			v.boolean = true;
+			return literal("true");
+		case 'f':
+			v.type = JsonValue::Bool;
+			return literal("false");
+		case 'n':
+			return literal("null");
+		default: {
+			// strtod needs a terminated string, numbers are short so copy them out
+			char buffer[64];
+			size_t n = 0;
+			while (p + n < end && n < sizeof(buffer) - 1 && strchr("+-0123456789.eE", p[n])) {
+				buffer[n] = p[n];
+				n++;
+			}
+			if (n == 0) {
+				return fail("unexpected character");
+			}
+			buffer[n] = 0;
+			v.type = JsonValue::Number;
+			v.number = strtod(buffer, nullptr);
+			p += n;
+			return true;
+		}
+		}
+	}
+};
+
+}
+
+bool JsonValue::parse(const char* text, size_t length, JsonValue& out, std::string& error) {
+	Parser parser{ text, text + length, std::string() };
+	out = JsonValue();
+	if (!parser.parseValue(out, 0)) {
+		error = parser.error;
+		return false;
+	}
+	return true;
+}
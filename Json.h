@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Minimal JSON document, enough to read glTF scene descriptions.
+struct JsonValue {
+	enum Type { Null, Bool, Number, String, Array, Object };
+
+	Type type = Null;
+	bool boolean = false;
+	double number = 0.0;
+	std::string string;
+	std::vector<JsonValue> array;
+	std::vector<std::pair<std::string, JsonValue>> object;
+
+	//member lookup, returns a shared null value when missing or not an object
+	const JsonValue& operator[](const char* key) const;
+	//element lookup, returns a shared null value when out of range or not an array
+	const JsonValue& operator[](size_t index) const;
+	size_t size() const { return type == Array ? array.size() : type == Object ? object.size() : 0; }
+
+	bool isNull() const { return type == Null; }
+	double asNumber(double fallback = 0.0) const { return type == Number ? number : fallback; }
+	int asInt(int fallback = 0) const { return type == Number ? (int)number : fallback; }
+	const std::string& asString() const { return string; }
+
+	//parses a complete document, returns false and leaves an error message on malformed input
+	static bool parse(const char* text, size_t length, JsonValue& out, std::string& error);
+};
@@ -0,0 +1,51 @@
+#include "LodSelector.h"
+
+#include <algorithm>
+
+LodSelector::LodSelector(float pixelThreshold, float hysteresis) : pixelThreshold(pixelThreshold), hysteresis(hysteresis), switches(0) {
+}
+
+float LodSelector::projectedError(float error, float distance, float focalPixels) {
+	if (distance <= 0.0f) {
+		return error > 0.0f ? 1e6f : 0.0f;
+	}
+	return error * focalPixels / distance;
+}
+
+int LodSelector::select(size_t object, const MeshLod* lods, size_t lodCount, float distance, float scale, float focalPixels) {
+	if (object >= current.size()) {
+		current.resize(object + 1, -1);
+	}
+	int& level = current[object];
+	if (lodCount == 0) {
+		return 0;
+	}
+	// errors grow with the level, so the coarsest acceptable level is the last one under the limit
+	auto coarsest = [&](float limit) {
+		int found = 0;
+		for (size_t i = 1; i < lodCount; i++) {
+			if (projectedError(lods[i].error * scale, distance, focalPixels) <= limit) {
+				found = (int)i;
+			}
+		}
+		return found;
+	};
+	int wanted = coarsest(pixelThreshold);
+	if (level < 0 || level >= (int)lodCount) {
+		level = wanted; // first time this object is seen
+		return level;
+	}
+	int next = level;
+	if (wanted < level) {
+		next = wanted;
+	}
+	else if (wanted > level) {
+		// only go coarser with some margin below the threshold
+		next = std::max(level, coarsest(pixelThreshold * (1.0f - hysteresis)));
+	}
+	if (next != level) {
+		switches++;
+		level = next;
+	}
+	return level;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Mesh.h"
+
+#include <cstddef>
+#include <vector>
+
+// Picks a level of detail per object from the screen-space size of each level's error. Like MipResidency it
+// has no GL dependency, so selection can be driven by a simulated camera.
+//
+// A level is good enough while its error projects to at most pixelThreshold pixels. Objects switch to a finer
+// level as soon as that is exceeded but only go coarser once the coarser level is below (1 - hysteresis) times
+// the threshold, so objects sitting at a switching distance do not pop back and forth every frame.
+class LodSelector
+{
+public:
+	LodSelector(float pixelThreshold = 1.0f, float hysteresis = 0.25f);
+
+	//returns the level to draw for object, scale is the largest axis scale of its model matrix.
+	//Objects are numbered by the caller and remember their last level.
+	int select(size_t object, const MeshLod* lods, size_t lodCount, float distance, float scale, float focalPixels);
+	//forgets every object's level, e.g. after a camera cut
+	void reset() { current.clear(); switches = 0; }
+
+	//size in pixels of a model space error seen from distance, focalPixels = viewportHeight / (2 * tan(fovY / 2))
+	static float projectedError(float error, float distance, float focalPixels);
+
+	float pixelThreshold;
+	float hysteresis;
+	// level changes since the last reset, a measure of popping
+	size_t switches;
+
+private:
+	std::vector<int> current;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+
+// Read only memory mapping of a whole file. Pages are loaded by the OS on first touch,
+// so parsers can work on the file contents without copying them into a buffer first.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const char* path);
+	void close();
+
+	const char* data() const { return (const char*)view; }
+	size_t size() const { return length; }
+
+private:
+	void* view;
+	size_t length;
+#if defined(_WIN32)
+	void* file;
+	void* mapping;
+#endif
+};
@@ -0,0 +1,68 @@
+#include "Mesh.h"
+
+#include <algorithm>
+
+void Mesh::computeBounds() {
+	if (vertices.empty()) {
+		boundsMin = boundsMax = glm::vec3(0.0f);
+		return;
+	}
+	boundsMin = boundsMax = vertices[0].position;
+	for (const Vertex& v : vertices) {
+		boundsMin = glm::min(boundsMin, v.position);
+		boundsMax = glm::max(boundsMax, v.position);
+	}
+}
+
+void Mesh::computeNormals() {
+	computeNormals(0, indices.size());
+}
+
+void Mesh::computeNormals(size_t firstIndex, size_t indexCount) {
+	size_t last = firstIndex + indexCount - indexCount % 3;
+	for (size_t i = firstIndex; i < last; i++) {
+		vertices[indices[i]].normal = glm::vec3(0.0f);
+	}
+	for (size_t i = firstIndex; i < last; i += 3) {
+		Vertex& a = vertices[indices[i]];
+		Vertex& b = vertices[indices[i + 1]];
+		Vertex& c = vertices[indices[i + 2]];
+		// the cross product length is twice the triangle area, which weights the average
+		glm::vec3 n = glm::cross(b.position - a.position, c.position - a.position);
+		a.normal += n;
+		b.normal += n;
+		c.normal += n;
+	}
+	for (size_t i = firstIndex; i < last; i++) {
+		Vertex& v = vertices[indices[i]];
+		float length = glm::length(v.normal);
+		v.normal = length > 0.0f ? v.normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+	}
+}
+
+void Mesh::computeNormals(const std::vector<uint8_t>& missing) {
+	for (size_t i = 0; i < vertices.size(); i++) {
+		if (missing[i]) {
+			vertices[i].normal = glm::vec3(0.0f);
+		}
+	}
+	size_t last = indices.size() - indices.size() % 3;
+	for (size_t i = 0; i < last; i += 3) {
+		uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+		if (!missing[a] && !missing[b] && !missing[c]) {
+			continue;
+		}
+		glm::vec3 n = glm::cross(vertices[b].position - vertices[a].position, vertices[c].position - vertices[a].position);
+		for (uint32_t v : { a, b, c }) {
+			if (missing[v]) {
+				vertices[v].normal += n;
+			}
+		}
+	}
+	for (size_t i = 0; i < vertices.size(); i++) {
+		if (missing[i]) {
+			float length = glm::length(vertices[i].normal);
+			vertices[i].normal = length > 0.0f ? vertices[i].normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+		}
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Interleaved vertex as the shaders read it: location 0 position, 1 normal, 2 texture coordinate.
+struct Vertex {
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 texCoord;
+};
+
+// Part of the index buffer drawn with one material.
+struct Submesh {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	std::string material;
+};
+
+// Cluster of at most 64 vertices and 124 triangles, a contiguous range of the index buffer.
+// The bounds are in model space and are used to cull whole clusters, see Meshlets.h.
+struct Meshlet {
+	uint32_t firstIndex;
+	uint32_t triangleCount;
+	uint32_t vertexCount;
+	float radius;
+	glm::vec3 center;
+	// every triangle faces away from cameras where dot(normalize(coneApex - camera), coneAxis) >= coneCutoff,
+	// cutoff is above 1 when the normals spread too far for the test to reject anything
+	float coneCutoff;
+	glm::vec3 coneApex;
+	glm::vec3 coneAxis;
+};
+
+// One level of detail: a range of the index buffer drawn instead of the full mesh. Every level uses the same
+// vertices, coarser levels are appended after the submeshes with their submeshes concatenated in order.
+struct MeshLod {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	// meshlets of this level, see buildMeshlets
+	uint32_t firstMeshlet;
+	uint32_t meshletCount;
+	// largest distance in model units between this level and the full mesh
+	float error;
+};
+
+// Triangle list ready to be copied into a vertex and an element buffer as is.
+struct Mesh {
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<Submesh> submeshes;
+	// empty until buildMeshlets runs, index reordering invalidates them
+	std::vector<Meshlet> meshlets;
+	// empty or level 0 first, filled by buildLods
+	std::vector<MeshLod> lods;
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+
+	void computeBounds();
+	//area weighted smooth normals, for formats or files that do not provide them
+	void computeNormals();
+	//same for the vertices used by a range of the index buffer, ranges that share no vertices can run in parallel
+	void computeNormals(size_t firstIndex, size_t indexCount);
+	//only the vertices flagged in missing (one flag per vertex), the others keep the normals they have
+	void computeNormals(const std::vector<uint8_t>& missing);
+	size_t triangleCount() const { return indices.size() / 3; }
+};
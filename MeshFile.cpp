@@ -0,0 +1,259 @@
+#include "MeshFile.h"
+#include "VertexCompression.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static_assert(sizeof(Meshlet) == 56, "Meshlet is stored as is");
+static_assert(sizeof(MeshLod) == 20, "MeshLod is stored as is");
+static_assert(sizeof(MeshFileHeader) == 176, "MeshFileHeader must not contain padding");
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+MeshFile::MeshFile() : head(nullptr) {
+}
+
+bool MeshFile::fileStamp(const char* path, uint64_t& size, int64_t& time) {
+	struct stat info;
+	if (stat(path, &info) != 0) {
+		return false;
+	}
+	size = (uint64_t)info.st_size;
+	time = (int64_t)info.st_mtime;
+	return true;
+}
+
+bool MeshFile::write(const char* path, const Mesh& mesh, const VertexCompression& compression, const char* sourcePath, CompressionReport* report) {
+	EncodedMesh encoded;
+	encodeMesh(mesh, compression, encoded, report);
+
+	MeshFileHeader header = {};
+	header.magic = MAGIC;
+	header.version = VERSION;
+	if (sourcePath) {
+		fileStamp(sourcePath, header.sourceSize, header.sourceTime);
+	}
+	header.vertexCount = (uint32_t)mesh.vertices.size();
+	header.indexCount = (uint32_t)mesh.indices.size();
+	header.vertexStride = encoded.stride;
+	header.indexType = encoded.indexType;
+	for (int i = 0; i < 3; i++) {
+		header.boundsMin[i] = mesh.boundsMin[i];
+		header.boundsMax[i] = mesh.boundsMax[i];
+		header.positionOffset[i] = encoded.positionOffset[i];
+		header.positionScale[i] = encoded.positionScale[i];
+	}
+	header.normalEncoding = encoded.normalEncoding;
+	header.attributeCount = (uint32_t)encoded.attributes.size();
+
+	std::vector<MeshFileSubmesh> submeshes;
+	std::string names;
+	for (const Submesh& s : mesh.submeshes) {
+		submeshes.push_back({ s.firstIndex, s.indexCount, (uint32_t)names.size(), (uint32_t)s.material.size() });
+		names += s.material;
+	}
+	header.submeshCount = (uint32_t)submeshes.size();
+
+	header.attributesOffset = sizeof(MeshFileHeader);
+	header.submeshesOffset = header.attributesOffset + encoded.attributes.size() * sizeof(MeshFileAttribute);
+	header.namesOffset = header.submeshesOffset + submeshes.size() * sizeof(MeshFileSubmesh);
+	header.namesSize = names.size();
+	header.meshletCount = (uint32_t)mesh.meshlets.size();
+	header.meshletsOffset = alignUp(header.namesOffset + header.namesSize, 4);
+	header.lodCount = (uint32_t)mesh.lods.size();
+	header.lodsOffset = header.meshletsOffset + mesh.meshlets.size() * sizeof(Meshlet);
+	header.vertexOffset = alignUp(header.lodsOffset + mesh.lods.size() * sizeof(MeshLod), STREAM_ALIGNMENT);
+	header.indexOffset = alignUp(header.vertexOffset + encoded.vertices.size(), STREAM_ALIGNMENT);
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out) {
+		std::cout << "Failed to create mesh file " << path << std::endl;
+		return false;
+	}
+	static const char zeros[STREAM_ALIGNMENT] = {};
+	auto padTo = [&](uint64_t offset) {
+		uint64_t at = (uint64_t)out.tellp();
+		if (offset > at) {
+			out.write(zeros, (std::streamsize)(offset - at));
+		}
+	};
+	out.write((const char*)&header, sizeof(header));
+	out.write((const char*)encoded.attributes.data(), encoded.attributes.size() * sizeof(MeshFileAttribute));
+	if (!submeshes.empty()) {
+		out.write((const char*)submeshes.data(), submeshes.size() * sizeof(MeshFileSubmesh));
+	}
+	out.write(names.data(), names.size());
+	padTo(header.meshletsOffset);
+	if (!mesh.meshlets.empty()) {
+		out.write((const char*)mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet));
+	}
+	if (!mesh.lods.empty()) {
+		out.write((const char*)mesh.lods.data(), mesh.lods.size() * sizeof(MeshLod));
+	}
+	padTo(header.vertexOffset);
+	out.write((const char*)encoded.vertices.data(), encoded.vertices.size());
+	padTo(header.indexOffset);
+	out.write((const char*)encoded.indices.data(), encoded.indices.size());
+	if (!out) {
+		std::cout << "Failed to write mesh file " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool MeshFile::open(const char* path) {
+	close();
+	if (!file.open(path)) {
+		return false;
+	}
+	uint64_t size = file.size();
+	const MeshFileHeader* h = (const MeshFileHeader*)file.data();
+	auto inside = [&](uint64_t offset, uint64_t bytes) {
+		return offset <= size && bytes <= size - offset;
+	};
+	bool valid = size >= sizeof(MeshFileHeader) && h->magic == MAGIC && h->version == VERSION;
+	valid = valid && (h->indexType == GL_UNSIGNED_SHORT || h->indexType == GL_UNSIGNED_INT);
+	valid = valid && h->attributesOffset % 4 == 0 && h->submeshesOffset % 4 == 0 && h->meshletsOffset % 4 == 0 && h->lodsOffset % 4 == 0 && h->vertexOffset % 4 == 0 && h->indexOffset % 4 == 0;
+	valid = valid && inside(h->attributesOffset, (uint64_t)h->attributeCount * sizeof(MeshFileAttribute));
+	valid = valid && inside(h->submeshesOffset, (uint64_t)h->submeshCount * sizeof(MeshFileSubmesh));
+	valid = valid && inside(h->namesOffset, h->namesSize);
+	valid = valid && inside(h->meshletsOffset, (uint64_t)h->meshletCount * sizeof(Meshlet));
+	valid = valid && inside(h->lodsOffset, (uint64_t)h->lodCount * sizeof(MeshLod));
+	valid = valid && inside(h->vertexOffset, (uint64_t)h->vertexCount * h->vertexStride);
+	valid = valid && inside(h->indexOffset, (uint64_t)h->indexCount * (h->indexType == GL_UNSIGNED_SHORT ? 2 : 4));
+	if (!valid) {
+		std::cout << "Invalid or outdated mesh file " << path << std::endl;
+		file.close();
+		return false;
+	}
+	head = h;
+	const MeshFileAttribute* a = attributes();
+	for (uint32_t i = 0; i < h->attributeCount; i++) {
+		if (a[i].offset >= h->vertexStride || a[i].components == 0 || a[i].components > 4) {
+			std::cout << "Invalid vertex attribute in mesh file " << path << std::endl;
+			close();
+			return false;
+		}
+	}
+	const MeshFileSubmesh* s = (const MeshFileSubmesh*)(file.data() + h->submeshesOffset);
+	for (uint32_t i = 0; i < h->submeshCount; i++) {
+		if ((uint64_t)s[i].firstIndex + s[i].indexCount > h->indexCount || (uint64_t)s[i].nameOffset + s[i].nameLength > h->namesSize) {
+			std::cout << "Invalid submesh in mesh file " << path << std::endl;
+			close();
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < h->meshletCount; i++) {
+		if ((uint64_t)meshlets()[i].firstIndex + (uint64_t)meshlets()[i].triangleCount * 3 > h->indexCount) {
+			std::cout << "Invalid meshlet in mesh file " << path << std::endl;
+			close();
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < h->lodCount; i++) {
+		const MeshLod& lod = lods()[i];
+		if ((uint64_t)lod.firstIndex + lod.indexCount > h->indexCount || (uint64_t)lod.firstMeshlet + lod.meshletCount > h->meshletCount) {
+			std::cout << "Invalid level of detail in mesh file " << path << std::endl;
+			close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void MeshFile::close() {
+	file.close();
+	head = nullptr;
+}
+
+bool MeshFile::isCurrent(const char* sourcePath) const {
+	uint64_t size;
+	int64_t time;
+	if (!head || !fileStamp(sourcePath, size, time)) {
+		// without the source the cooked file is all there is
+		return head != nullptr;
+	}
+	return head->sourceSize == size && head->sourceTime == time;
+}
+
+const MeshFileAttribute* MeshFile::attributes() const {
+	return (const MeshFileAttribute*)(file.data() + head->attributesOffset);
+}
+
+Submesh MeshFile::submesh(uint32_t index) const {
+	const MeshFileSubmesh& s = ((const MeshFileSubmesh*)(file.data() + head->submeshesOffset))[index];
+	Submesh out;
+	out.firstIndex = s.firstIndex;
+	out.indexCount = s.indexCount;
+	out.material.assign(file.data() + head->namesOffset + s.nameOffset, s.nameLength);
+	return out;
+}
+
+glm::mat4 MeshFile::positionDecode() const {
+	glm::mat4 decode = glm::translate(glm::mat4(1.0f), glm::vec3(head->positionOffset[0], head->positionOffset[1], head->positionOffset[2]));
+	return glm::scale(decode, glm::vec3(head->positionScale[0], head->positionScale[1], head->positionScale[2]));
+}
+
+void MeshFile::decodePositions(std::vector<glm::vec3>& out) const {
+	out.assign(head->vertexCount, glm::vec3(0.0f));
+	const MeshFileAttribute* a = attributes();
+	const MeshFileAttribute* position = nullptr;
+	for (uint32_t i = 0; i < head->attributeCount; i++) {
+		if (a[i].location == 0) {
+			position = &a[i];
+		}
+	}
+	if (!position) {
+		return;
+	}
+	glm::mat4 decode = positionDecode();
+	const char* data = (const char*)vertexData() + position->offset;
+	for (uint32_t v = 0; v < head->vertexCount; v++) {
+		const char* p = data + (size_t)v * head->vertexStride;
+		glm::vec3 stored(0.0f);
+		for (uint32_t c = 0; c < position->components && c < 3; c++) {
+			if (position->type == GL_FLOAT) {
+				memcpy(&stored[c], p + c * 4, 4);
+			}
+			else if (position->type == GL_HALF_FLOAT || position->type == GL_UNSIGNED_SHORT) {
+				uint16_t value;
+				memcpy(&value, p + c * 2, 2);
+				stored[c] = position->type == GL_HALF_FLOAT ? glm::unpackHalf1x16(value) : (position->normalized ? value / 65535.0f : (float)value);
+			}
+		}
+		out[v] = glm::vec3(decode * glm::vec4(stored, 1.0f));
+	}
+}
+
+void MeshFile::decodeIndices(std::vector<uint32_t>& out) const {
+	out.resize(head->indexCount);
+	if (head->indexType == GL_UNSIGNED_SHORT) {
+		const uint16_t* in = (const uint16_t*)indexData();
+		for (uint32_t i = 0; i < head->indexCount; i++) {
+			out[i] = in[i];
+		}
+	}
+	else if (head->indexCount > 0) {
+		memcpy(out.data(), indexData(), (size_t)head->indexCount * 4);
+	}
+}
+
+void MeshFile::setupAttributes() const {
+	const MeshFileAttribute* a = attributes();
+	for (uint32_t i = 0; i < head->attributeCount; i++) {
+		glVertexAttribPointer(a[i].location, a[i].components, a[i].type, a[i].normalized ? GL_TRUE : GL_FALSE, head->vertexStride, (void*)(size_t)a[i].offset);
+		glEnableVertexAttribArray(a[i].location);
+	}
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "MappedFile.h"
+#include "Mesh.h"
+
+#include <cstdint>
+#include <vector>
+
+// Cooked mesh file layout, little endian. The vertex and index streams start on page boundaries and are
+// stored exactly as the GPU reads them, so a loader maps the file and hands the pointers to glBufferData.
+//
+//   MeshFileHeader
+//   MeshFileAttribute[attributeCount]
+//   MeshFileSubmesh[submeshCount]
+//   material names, not null terminated
+//   Meshlet[meshletCount]
+//   MeshLod[lodCount]
+//   vertex stream (vertexCount * vertexStride bytes)
+//   index stream (indexCount * 2 or 4 bytes)
+struct MeshFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	// size and modification time of the file this was cooked from, zero when unknown
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t vertexStride;
+	uint32_t indexType; // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	uint32_t attributeCount;
+	uint32_t submeshCount;
+	float boundsMin[3];
+	float boundsMax[3];
+	// quantized positions decode as offset + stored * scale, see VertexCompression
+	float positionOffset[3];
+	float positionScale[3];
+	uint32_t normalEncoding; // 0 float xyz, 1 octahedral
+	uint32_t meshletCount;
+	uint32_t lodCount; // 0 when the mesh was cooked without levels of detail
+	uint32_t reserved;
+	uint64_t attributesOffset;
+	uint64_t submeshesOffset;
+	uint64_t namesOffset;
+	uint64_t namesSize;
+	uint64_t meshletsOffset;
+	uint64_t lodsOffset;
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+};
+
+// One glVertexAttribPointer call.
+struct MeshFileAttribute {
+	uint32_t location;
+	uint32_t components;
+	uint32_t type; // GL_FLOAT, GL_HALF_FLOAT, GL_SHORT, ...
+	uint32_t normalized;
+	uint32_t offset;
+};
+
+struct MeshFileSubmesh {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t nameOffset; // into the names block
+	uint32_t nameLength;
+};
+
+class MeshFile
+{
+public:
+	static const uint32_t MAGIC = 0x48534D52; // "RMSH"
+	static const uint32_t VERSION = 4;
+	static const size_t STREAM_ALIGNMENT = 4096;
+
+	MeshFile();
+
+	//writes the mesh in the cooked layout with the given vertex formats, report receives the compression statistics.
+	//sourcePath is recorded so isCurrent() can detect stale files.
+	static bool write(const char* path, const Mesh& mesh, const struct VertexCompression& compression, const char* sourcePath = nullptr, struct CompressionReport* report = nullptr);
+
+	//maps the file and validates the header and every range in it, nothing is copied
+	bool open(const char* path);
+	void close();
+	//true when the file was cooked from sourcePath as it currently is on disk
+	bool isCurrent(const char* sourcePath) const;
+
+	const MeshFileHeader& header() const { return *head; }
+	const MeshFileAttribute* attributes() const;
+	//submesh range with its material name
+	Submesh submesh(uint32_t index) const;
+	//meshlets in model space, empty when the mesh was cooked without them
+	const Meshlet* meshlets() const { return (const Meshlet*)(file.data() + head->meshletsOffset); }
+	uint32_t meshletCount() const { return head->meshletCount; }
+	//levels of detail, level 0 is the full mesh, empty when the mesh was cooked without them
+	const MeshLod* lods() const { return (const MeshLod*)(file.data() + head->lodsOffset); }
+	uint32_t lodCount() const { return head->lodCount; }
+
+	const void* vertexData() const { return file.data() + head->vertexOffset; }
+	size_t vertexBytes() const { return (size_t)head->vertexCount * head->vertexStride; }
+	const void* indexData() const { return file.data() + head->indexOffset; }
+	size_t indexBytes() const { return (size_t)head->indexCount * (head->indexType == GL_UNSIGNED_SHORT ? 2 : 4); }
+
+	//maps stored positions back to model space, apply before the model matrix (meshDecode in shader.vert)
+	glm::mat4 positionDecode() const;
+	bool octahedralNormals() const { return head->normalEncoding == 1; }
+
+	//model space positions and 32 bit indices, for CPU side work such as occluder rasterization
+	void decodePositions(std::vector<glm::vec3>& out) const;
+	void decodeIndices(std::vector<uint32_t>& out) const;
+
+	//sets up and enables every attribute of the vertex stream for the bound VAO and GL_ARRAY_BUFFER
+	void setupAttributes() const;
+
+	//size and modification time of a file, false when it does not exist
+	static bool fileStamp(const char* path, uint64_t& size, int64_t& time);
+
+private:
+	MappedFile file;
+	const MeshFileHeader* head;
+};
@@ -0,0 +1,754 @@
+#include "MeshImporter.h"
+#include "Json.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+
+MeshImporter::MeshImporter(ThreadPool& pool) : bytesRead(0), seconds(0.0), chunkSize(4 * 1024 * 1024), optimize(false), pool(pool) {
+}
+
+MeshImporter::MeshImporter() : MeshImporter(ThreadPool::global()) {
+}
+
+static bool endsWith(const std::string& s, const char* suffix) {
+	size_t n = strlen(suffix);
+	if (s.size() < n) {
+		return false;
+	}
+	for (size_t i = 0; i < n; i++) {
+		if (tolower((unsigned char)s[s.size() - n + i]) != suffix[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool MeshImporter::load(const char* path, Mesh& mesh) {
+	std::string name(path);
+	bool loaded = false;
+	if (endsWith(name, ".obj")) {
+		loaded = loadOBJ(path, mesh);
+	}
+	else if (endsWith(name, ".gltf") || endsWith(name, ".glb")) {
+		loaded = loadGLTF(path, mesh);
+	}
+	else {
+		std::cout << "Unknown mesh format " << path << std::endl;
+	}
+	if (loaded && optimize) {
+		optimizeMesh(mesh);
+	}
+	return loaded;
+}
+
+// =============================================================================================== //
+// OBJ
+
+namespace {
+
+const int32_t NO_INDEX = INT32_MIN;
+
+// One face corner. OBJ indices are global and 1 based, negative ones count back from the last element
+// read so far. Those are stored relative to the chunk until the chunk's base offsets are known.
+struct Corner {
+	int32_t v, t, n;
+	uint8_t relative; // bit 0 position, bit 1 texture coordinate, bit 2 normal
+};
+
+struct ObjChunk {
+	const char* begin;
+	const char* end;
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> texCoords;
+	std::vector<glm::vec3> normals;
+	std::vector<Corner> corners; // three per triangle
+	std::vector<std::pair<std::string, size_t>> materials; // usemtl name and first triangle in this chunk
+	std::vector<Vertex> vertices;
+	std::vector<glm::ivec3> keys; // resolved corner of each vertex, for merging with the other chunks
+	std::vector<uint32_t> indices;
+	size_t badIndices = 0;
+};
+
+inline bool isBlank(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* skipBlank(const char* p, const char* end) {
+	while (p < end && isBlank(*p)) {
+		p++;
+	}
+	return p;
+}
+
+inline const char* nextLine(const char* p, const char* end) {
+	if (p >= end) {
+		return end;
+	}
+	const char* newline = (const char*)memchr(p, '\n', end - p);
+	return newline ? newline + 1 : end;
+}
+
+double powerOf10(int n) {
+	static const double table[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	return n <= 22 ? table[n] : std::pow(10.0, n);
+}
+
+// Locale independent and much faster than strtof. Exact enough for float output.
+const char* parseFloat(const char* p, const char* end, float& out) {
+	p = skipBlank(p, end);
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+	uint64_t mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; p++) {
+		if (digits < 19) {
+			mantissa = mantissa * 10 + (*p - '0');
+			digits += mantissa != 0;
+		}
+		else {
+			exponent++;
+		}
+	}
+	if (p < end && *p == '.') {
+		for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				digits += mantissa != 0;
+				exponent--;
+			}
+		}
+	}
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		p++;
+		bool negativeExponent = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negativeExponent = *p == '-';
+			p++;
+		}
+		int e = 0;
+		for (; p < end && *p >= '0' && *p <= '9'; p++) {
+			e = e < 10000 ? e * 10 + (*p - '0') : e;
+		}
+		exponent += negativeExponent ? -e : e;
+	}
+	double value = (double)mantissa;
+	value = exponent < 0 ? value / powerOf10(-exponent) : value * powerOf10(exponent);
+	out = (float)(negative ? -value : value);
+	return p;
+}
+
+const char* parseInt(const char* p, const char* end, int& out) {
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+	int value = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; p++) {
+		value = value * 10 + (*p - '0');
+	}
+	out = negative ? -value : value;
+	return p;
+}
+
+inline void encodeIndex(int index, size_t count, int32_t& out, uint8_t& relative, uint8_t bit) {
+	if (index > 0) {
+		out = index - 1;
+	}
+	else if (index < 0) {
+		out = (int32_t)count + index;
+		relative |= bit;
+	}
+	else {
+		out = NO_INDEX;
+	}
+}
+
+void parseChunk(ObjChunk& chunk) {
+	const char* p = chunk.begin;
+	const char* end = chunk.end;
+	std::vector<Corner> polygon;
+	while (p < end) {
+		p = skipBlank(p, end);
+		const char* line = p;
+		p = nextLine(p, end);
+		if (line >= end || line[0] == '#' || line[0] == '\n') {
+			continue;
+		}
+		size_t length = p - line;
+		if (line[0] == 'v' && length > 1) {
+			float x = 0, y = 0, z = 0;
+			if (isBlank(line[1])) {
+				const char* q = parseFloat(line + 1, p, x);
+				q = parseFloat(q, p, y);
+				parseFloat(q, p, z);
+				chunk.positions.push_back(glm::vec3(x, y, z));
+			}
+			else if (line[1] == 't') {
+				const char* q = parseFloat(line + 2, p, x);
+				parseFloat(q, p, y);
+				chunk.texCoords.push_back(glm::vec2(x, y));
+			}
+			else if (line[1] == 'n') {
+				const char* q = parseFloat(line + 2, p, x);
+				q = parseFloat(q, p, y);
+				parseFloat(q, p, z);
+				chunk.normals.push_back(glm::vec3(x, y, z));
+			}
+		}
+		else if (line[0] == 'f' && length > 1 && isBlank(line[1])) {
+			polygon.clear();
+			const char* q = line + 1;
+			while (true) {
+				q = skipBlank(q, p);
+				if (q >= p || *q == '\n' || *q == '#') {
+					break;
+				}
+				Corner c = { NO_INDEX, NO_INDEX, NO_INDEX, 0 };
+				int index = 0;
+				const char* start = q;
+				q = parseInt(q, p, index);
+				encodeIndex(index, chunk.positions.size(), c.v, c.relative, 1);
+				if (q < p && *q == '/') {
+					q++;
+					if (q < p && *q != '/') {
+						q = parseInt(q, p, index);
+						encodeIndex(index, chunk.texCoords.size(), c.t, c.relative, 2);
+					}
+					if (q < p && *q == '/') {
+						q = parseInt(q + 1, p, index);
+						encodeIndex(index, chunk.normals.size(), c.n, c.relative, 4);
+					}
+				}
+				if (q == start) {
+					break; // garbage, stop reading this face
+				}
+				polygon.push_back(c);
+			}
+			// polygons are fanned around their first corner
+			for (size_t i = 2; i < polygon.size(); i++) {
+				chunk.corners.push_back(polygon[0]);
+				chunk.corners.push_back(polygon[i - 1]);
+				chunk.corners.push_back(polygon[i]);
+			}
+		}
+		else if (length > 7 && strncmp(line, "usemtl", 6) == 0 && isBlank(line[6])) {
+			const char* name = skipBlank(line + 6, p);
+			const char* nameEnd = p;
+			while (nameEnd > name && (nameEnd[-1] == '\n' || isBlank(nameEnd[-1]))) {
+				nameEnd--;
+			}
+			chunk.materials.push_back(std::make_pair(std::string(name, nameEnd), chunk.corners.size() / 3));
+		}
+	}
+}
+
+// Open addressing table from resolved corner to vertex index, sized for the worst case of no sharing.
+struct CornerTable {
+	std::vector<uint32_t> slots; // vertex index + 1, 0 is empty
+	std::vector<glm::ivec3> keys;
+	size_t mask;
+
+	explicit CornerTable(size_t corners) {
+		size_t capacity = 16;
+		while (capacity < corners * 2) {
+			capacity <<= 1;
+		}
+		slots.assign(capacity, 0);
+		keys.reserve(corners);
+		mask = capacity - 1;
+	}
+
+	// returns the vertex index and whether the corner was new
+	uint32_t insert(const glm::ivec3& key, bool& added) {
+		uint64_t h = ((uint64_t)(uint32_t)key.x * 0x9E3779B97F4A7C15ull) ^ ((uint64_t)(uint32_t)key.y * 0xC2B2AE3D27D4EB4Full) ^ ((uint64_t)(uint32_t)key.z * 0x165667B19E3779F9ull);
+		size_t slot = (size_t)(h ^ (h >> 29)) & mask;
+		while (slots[slot] != 0) {
+			if (keys[slots[slot] - 1] == key) {
+				added = false;
+				return slots[slot] - 1;
+			}
+			slot = (slot + 1) & mask;
+		}
+		keys.push_back(key);
+		slots[slot] = (uint32_t)keys.size();
+		added = true;
+		return (uint32_t)keys.size() - 1;
+	}
+};
+
+}
+
+bool MeshImporter::loadOBJ(const char* path, Mesh& mesh) {
+	auto start = std::chrono::steady_clock::now();
+	MappedFile file;
+	if (!file.open(path)) {
+		std::cout << "Failed to open mesh " << path << std::endl;
+		return false;
+	}
+	const char* data = file.data();
+	const char* end = data + file.size();
+
+	// 1. split at line boundaries
+	std::vector<ObjChunk> chunks;
+	for (const char* p = data; p < end;) {
+		const char* chunkEnd = (size_t)(end - p) > chunkSize ? nextLine(p + chunkSize, end) : end;
+		chunks.emplace_back();
+		chunks.back().begin = p;
+		chunks.back().end = chunkEnd;
+		p = chunkEnd;
+	}
+
+	// 2. parse every chunk independently
+	pool.parallelFor(chunks.size(), [&](size_t i) { parseChunk(chunks[i]); });
+
+	// 3. offsets of each chunk's elements in the file wide arrays, then gather them
+	std::vector<glm::ivec3> base(chunks.size());
+	glm::ivec3 total(0);
+	for (size_t i = 0; i < chunks.size(); i++) {
+		base[i] = total;
+		total += glm::ivec3((int)chunks[i].positions.size(), (int)chunks[i].texCoords.size(), (int)chunks[i].normals.size());
+	}
+	std::vector<glm::vec3> positions(total.x);
+	std::vector<glm::vec2> texCoords(total.y);
+	std::vector<glm::vec3> normals(total.z);
+	pool.parallelFor(chunks.size(), [&](size_t i) {
+		ObjChunk& c = chunks[i];
+		std::copy(c.positions.begin(), c.positions.end(), positions.begin() + base[i].x);
+		std::copy(c.texCoords.begin(), c.texCoords.end(), texCoords.begin() + base[i].y);
+		std::copy(c.normals.begin(), c.normals.end(), normals.begin() + base[i].z);
+		c.positions = std::vector<glm::vec3>();
+		c.texCoords = std::vector<glm::vec2>();
+		c.normals = std::vector<glm::vec3>();
+	});
+
+	// 4. resolve corners and build deduplicated vertices per chunk
+	pool.parallelFor(chunks.size(), [&](size_t i) {
+		ObjChunk& c = chunks[i];
+		CornerTable table(c.corners.size());
+		c.vertices.reserve(c.corners.size() / 2);
+		c.indices.reserve(c.corners.size());
+		for (const Corner& corner : c.corners) {
+			glm::ivec3 key(corner.v, corner.t, corner.n);
+			if (key.x != NO_INDEX && (corner.relative & 1)) key.x += base[i].x;
+			if (key.y != NO_INDEX && (corner.relative & 2)) key.y += base[i].y;
+			if (key.z != NO_INDEX && (corner.relative & 4)) key.z += base[i].z;
+			bool added;
+			uint32_t index = table.insert(key, added);
+			if (added) {
+				Vertex v;
+				v.position = glm::vec3(0.0f);
+				v.normal = glm::vec3(0.0f);
+				v.texCoord = glm::vec2(0.0f);
+				if (key.x >= 0 && key.x < total.x) v.position = positions[key.x];
+				else c.badIndices++;
+				if (key.y >= 0 && key.y < total.y) v.texCoord = texCoords[key.y];
+				if (key.z >= 0 && key.z < total.z) v.normal = normals[key.z];
+				c.vertices.push_back(v);
+			}
+			c.indices.push_back(index);
+		}
+		c.keys = std::move(table.keys);
+		c.corners = std::vector<Corner>();
+	});
+
+	// 5. merge the vertices chunks have in common, a corner used on both sides of a chunk boundary was added by each.
+	// New vertices are numbered in chunk order, so the ones a chunk adds form a range starting at firstNew.
+	std::vector<size_t> vertexBase(chunks.size()), indexBase(chunks.size()), firstNew(chunks.size() + 1);
+	size_t chunkVertices = 0, indexCount = 0, badIndices = 0;
+	for (size_t i = 0; i < chunks.size(); i++) {
+		vertexBase[i] = chunkVertices;
+		indexBase[i] = indexCount;
+		chunkVertices += chunks[i].vertices.size();
+		indexCount += chunks[i].indices.size();
+		badIndices += chunks[i].badIndices;
+	}
+	std::vector<uint32_t> remap(chunkVertices);
+	std::vector<uint8_t> missingNormal;
+	size_t missingNormals = 0;
+	{
+		CornerTable table(chunkVertices);
+		for (size_t i = 0; i < chunks.size(); i++) {
+			firstNew[i] = table.keys.size();
+			const std::vector<glm::ivec3>& keys = chunks[i].keys;
+			for (size_t k = 0; k < keys.size(); k++) {
+				bool added;
+				remap[vertexBase[i] + k] = table.insert(keys[k], added);
+			}
+		}
+		firstNew[chunks.size()] = table.keys.size();
+		missingNormal.resize(table.keys.size());
+		for (size_t k = 0; k < table.keys.size(); k++) {
+			missingNormal[k] = table.keys[k].z < 0 || table.keys[k].z >= total.z;
+			missingNormals += missingNormal[k];
+		}
+	}
+
+	// 6. copy into the final arrays, each chunk writes the vertices it added first and remaps its indices
+	mesh = Mesh();
+	mesh.vertices.resize(firstNew[chunks.size()]);
+	mesh.indices.resize(indexCount);
+	pool.parallelFor(chunks.size(), [&](size_t i) {
+		ObjChunk& c = chunks[i];
+		const uint32_t* chunkRemap = remap.data() + vertexBase[i];
+		for (size_t k = 0; k < c.vertices.size(); k++) {
+			if (chunkRemap[k] >= firstNew[i]) {
+				mesh.vertices[chunkRemap[k]] = c.vertices[k];
+			}
+		}
+		uint32_t* out = mesh.indices.data() + indexBase[i];
+		for (size_t k = 0; k < c.indices.size(); k++) {
+			out[k] = chunkRemap[c.indices[k]];
+		}
+		c.vertices = std::vector<Vertex>();
+		c.keys = std::vector<glm::ivec3>();
+		c.indices = std::vector<uint32_t>();
+	});
+	if (missingNormals) {
+		// only corners without a normal are computed, vertices with file normals keep theirs
+		mesh.computeNormals(missingNormal);
+	}
+
+	// 7. one submesh per run of triangles using the same material
+	std::string current;
+	size_t runStart = 0;
+	for (size_t i = 0; i < chunks.size(); i++) {
+		for (const auto& material : chunks[i].materials) {
+			size_t first = indexBase[i] + material.second * 3;
+			if (material.first == current) {
+				continue;
+			}
+			if (first > runStart) {
+				mesh.submeshes.push_back({ (uint32_t)runStart, (uint32_t)(first - runStart), current });
+			}
+			current = material.first;
+			runStart = first;
+		}
+	}
+	if (indexCount > runStart || mesh.submeshes.empty()) {
+		mesh.submeshes.push_back({ (uint32_t)runStart, (uint32_t)(indexCount - runStart), current });
+	}
+
+	if (badIndices) {
+		std::cout << "Mesh " << path << " has " << badIndices << " out of range vertex references" << std::endl;
+	}
+	if (missingNormals) {
+		std::cout << "Mesh " << path << " is missing normals on " << missingNormals << " vertices, computed smooth normals for those" << std::endl;
+	}
+	mesh.computeBounds();
+	bytesRead = file.size();
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+// =============================================================================================== //
+// glTF 2.0
+
+namespace {
+
+const uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+const uint32_t GLB_JSON = 0x4E4F534A;
+const uint32_t GLB_BIN = 0x004E4942;
+
+struct BufferRange {
+	const unsigned char* data;
+	size_t size;
+};
+
+struct Accessor {
+	const unsigned char* data; // null for accessors without a buffer view, which read as zero
+	size_t count;
+	size_t stride;
+	int componentType;
+	int components;
+	bool normalized;
+};
+
+struct Primitive {
+	Accessor position, normal, texCoord, index;
+	bool hasNormal, hasTexCoord, hasIndex;
+	size_t firstVertex;
+	size_t firstIndex;
+	size_t indexCount;
+	// indices past the primitive's vertices, pointed at its first vertex instead
+	size_t badIndices;
+	std::string material;
+};
+
+int base64Value(char c) {
+	if (c >= 'A' && c <= 'Z') return c - 'A';
+	if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+	if (c >= '0' && c <= '9') return c - '0' + 52;
+	if (c == '+' || c == '-') return 62;
+	if (c == '/' || c == '_') return 63;
+	return -1;
+}
+
+std::vector<unsigned char> decodeBase64(const char* p, size_t length) {
+	std::vector<unsigned char> out;
+	out.reserve(length / 4 * 3);
+	unsigned int bits = 0;
+	int count = 0;
+	for (size_t i = 0; i < length; i++) {
+		int v = base64Value(p[i]);
+		if (v < 0) {
+			continue;
+		}
+		bits = (bits << 6) | v;
+		count += 6;
+		if (count >= 8) {
+			count -= 8;
+			out.push_back((unsigned char)(bits >> count));
+		}
+	}
+	return out;
+}
+
+size_t componentSize(int type) {
+	switch (type) {
+	case 5120: case 5121: return 1; // BYTE, UNSIGNED_BYTE
+	case 5122: case 5123: return 2; // SHORT, UNSIGNED_SHORT
+	case 5125: case 5126: return 4; // UNSIGNED_INT, FLOAT
+	default: return 0;
+	}
+}
+
+int componentCount(const std::string& type) {
+	if (type == "SCALAR") return 1;
+	if (type == "VEC2") return 2;
+	if (type == "VEC3") return 3;
+	if (type == "VEC4") return 4;
+	return 0;
+}
+
+bool readAccessor(const JsonValue& doc, int index, const std::vector<BufferRange>& buffers, Accessor& out) {
+	const JsonValue& accessor = doc["accessors"][(size_t)index];
+	if (accessor.isNull() || !accessor["sparse"].isNull()) {
+		return false;
+	}
+	out.componentType = accessor["componentType"].asInt();
+	out.components = componentCount(accessor["type"].asString());
+	out.count = (size_t)accessor["count"].asNumber();
+	out.normalized = accessor["normalized"].boolean;
+	size_t elementSize = componentSize(out.componentType) * out.components;
+	if (elementSize == 0) {
+		return false;
+	}
+	out.data = nullptr;
+	out.stride = elementSize;
+	if (accessor["bufferView"].isNull()) {
+		return true;
+	}
+	const JsonValue& view = doc["bufferViews"][(size_t)accessor["bufferView"].asInt()];
+	size_t buffer = (size_t)view["buffer"].asInt();
+	if (view.isNull() || buffer >= buffers.size()) {
+		return false;
+	}
+	size_t stride = (size_t)view["byteStride"].asNumber(0);
+	out.stride = stride ? stride : elementSize;
+	size_t offset = (size_t)view["byteOffset"].asNumber() + (size_t)accessor["byteOffset"].asNumber();
+	size_t needed = out.count ? offset + out.stride * (out.count - 1) + elementSize : offset;
+	if (needed > buffers[buffer].size || needed > (size_t)view["byteOffset"].asNumber() + (size_t)view["byteLength"].asNumber()) {
+		return false;
+	}
+	out.data = buffers[buffer].data + offset;
+	return true;
+}
+
+float readFloat(const Accessor& a, size_t element, int component) {
+	if (!a.data || component >= a.components) {
+		return 0.0f;
+	}
+	const unsigned char* p = a.data + element * a.stride + component * componentSize(a.componentType);
+	switch (a.componentType) {
+	case 5126: { float f; memcpy(&f, p, 4); return f; }
+	case 5121: return a.normalized ? *p / 255.0f : (float)*p;
+	case 5120: { float v = (float)*(const int8_t*)p; return a.normalized ? std::max(v / 127.0f, -1.0f) : v; }
+	case 5123: { uint16_t v; memcpy(&v, p, 2); return a.normalized ? v / 65535.0f : (float)v; }
+	case 5122: { int16_t v; memcpy(&v, p, 2); return a.normalized ? std::max(v / 32767.0f, -1.0f) : (float)v; }
+	case 5125: { uint32_t v; memcpy(&v, p, 4); return (float)v; }
+	default: return 0.0f;
+	}
+}
+
+uint32_t readIndex(const Accessor& a, size_t element) {
+	if (!a.data) {
+		return 0;
+	}
+	const unsigned char* p = a.data + element * a.stride;
+	switch (a.componentType) {
+	case 5121: return *p;
+	case 5123: { uint16_t v; memcpy(&v, p, 2); return v; }
+	case 5125: { uint32_t v; memcpy(&v, p, 4); return v; }
+	default: return 0;
+	}
+}
+
+}
+
+bool MeshImporter::loadGLTF(const char* path, Mesh& mesh) {
+	auto start = std::chrono::steady_clock::now();
+	MappedFile file;
+	if (!file.open(path)) {
+		std::cout << "Failed to open mesh " << path << std::endl;
+		return false;
+	}
+	size_t totalBytes = file.size();
+
+	// .glb keeps the JSON and the first buffer in one file, .gltf is the JSON alone
+	const char* json = file.data();
+	size_t jsonLength = file.size();
+	BufferRange glbBuffer = { nullptr, 0 };
+	uint32_t header[3];
+	if (file.size() >= 20 && (memcpy(header, file.data(), 12), header[0] == GLB_MAGIC)) {
+		size_t offset = 12;
+		jsonLength = 0;
+		while (offset + 8 <= file.size()) {
+			uint32_t chunk[2];
+			memcpy(chunk, file.data() + offset, 8);
+			const char* chunkData = file.data() + offset + 8;
+			if (offset + 8 + chunk[0] > file.size()) {
+				break;
+			}
+			if (chunk[1] == GLB_JSON) {
+				json = chunkData;
+				jsonLength = chunk[0];
+			}
+			else if (chunk[1] == GLB_BIN && !glbBuffer.data) {
+				glbBuffer = { (const unsigned char*)chunkData, chunk[0] };
+			}
+			offset += 8 + ((chunk[0] + 3) & ~3u);
+		}
+	}
+
+	JsonValue doc;
+	std::string error;
+	if (!JsonValue::parse(json, jsonLength, doc, error)) {
+		std::cout << "Failed to parse glTF " << path << ": " << error << std::endl;
+		return false;
+	}
+
+	// resolve buffers: the GLB chunk, embedded base64 data or files next to the .gltf
+	std::string directory(path);
+	size_t slash = directory.find_last_of("/\\");
+	directory = slash == std::string::npos ? std::string() : directory.substr(0, slash + 1);
+	std::vector<BufferRange> buffers;
+	std::vector<std::unique_ptr<MappedFile>> bufferFiles;
+	std::vector<std::vector<unsigned char>> decoded;
+	decoded.reserve(doc["buffers"].size());
+	for (size_t i = 0; i < doc["buffers"].size(); i++) {
+		const JsonValue& buffer = doc["buffers"][i];
+		const std::string& uri = buffer["uri"].asString();
+		if (uri.empty()) {
+			buffers.push_back(glbBuffer);
+		}
+		else if (uri.compare(0, 5, "data:") == 0) {
+			size_t comma = uri.find(',');
+			decoded.push_back(decodeBase64(uri.data() + comma + 1, comma == std::string::npos ? 0 : uri.size() - comma - 1));
+			buffers.push_back({ decoded.back().data(), decoded.back().size() });
+		}
+		else {
+			bufferFiles.emplace_back(new MappedFile());
+			if (!bufferFiles.back()->open((directory + uri).c_str())) {
+				std::cout << "Failed to open glTF buffer " << directory + uri << std::endl;
+				return false;
+			}
+			buffers.push_back({ (const unsigned char*)bufferFiles.back()->data(), bufferFiles.back()->size() });
+			totalBytes += bufferFiles.back()->size();
+		}
+	}
+
+	// collect triangle primitives and give each its place in the output arrays
+	std::vector<Primitive> primitives;
+	size_t vertexCount = 0, indexCount = 0;
+	const JsonValue& meshes = doc["meshes"];
+	for (size_t m = 0; m < meshes.size(); m++) {
+		const JsonValue& list = meshes[m]["primitives"];
+		for (size_t p = 0; p < list.size(); p++) {
+			const JsonValue& primitive = list[p];
+			const JsonValue& attributes = primitive["attributes"];
+			if (primitive["mode"].asInt(4) != 4 || attributes["POSITION"].isNull()) {
+				continue; // only triangle lists are supported
+			}
+			Primitive prim;
+			if (!readAccessor(doc, attributes["POSITION"].asInt(), buffers, prim.position)) {
+				std::cout << "Skipping glTF primitive with unreadable positions in " << path << std::endl;
+				continue;
+			}
+			prim.hasNormal = !attributes["NORMAL"].isNull() && readAccessor(doc, attributes["NORMAL"].asInt(), buffers, prim.normal);
+			prim.hasTexCoord = !attributes["TEXCOORD_0"].isNull() && readAccessor(doc, attributes["TEXCOORD_0"].asInt(), buffers, prim.texCoord);
+			prim.hasIndex = !primitive["indices"].isNull() && readAccessor(doc, primitive["indices"].asInt(), buffers, prim.index);
+			prim.indexCount = prim.hasIndex ? prim.index.count : prim.position.count;
+			prim.indexCount -= prim.indexCount % 3;
+			prim.firstVertex = vertexCount;
+			prim.firstIndex = indexCount;
+			prim.badIndices = 0;
+			const JsonValue& material = doc["materials"][(size_t)primitive["material"].asInt(-1)];
+			prim.material = material["name"].asString();
+			if (prim.material.empty() && !primitive["material"].isNull()) {
+				prim.material = std::to_string(primitive["material"].asInt());
+			}
+			vertexCount += prim.position.count;
+			indexCount += prim.indexCount;
+			primitives.push_back(prim);
+		}
+	}
+
+	mesh = Mesh();
+	mesh.vertices.resize(vertexCount);
+	mesh.indices.resize(indexCount);
+	pool.parallelFor(primitives.size(), [&](size_t i) {
+		Primitive& prim = primitives[i];
+		size_t count = prim.position.count;
+		for (size_t v = 0; v < count; v++) {
+			Vertex& out = mesh.vertices[prim.firstVertex + v];
+			out.position = glm::vec3(readFloat(prim.position, v, 0), readFloat(prim.position, v, 1), readFloat(prim.position, v, 2));
+			out.normal = prim.hasNormal ? glm::vec3(readFloat(prim.normal, v, 0), readFloat(prim.normal, v, 1), readFloat(prim.normal, v, 2)) : glm::vec3(0.0f);
+			// glTF puts the texture origin at the top left, opengl at the bottom left
+			out.texCoord = prim.hasTexCoord ? glm::vec2(readFloat(prim.texCoord, v, 0), 1.0f - readFloat(prim.texCoord, v, 1)) : glm::vec2(0.0f);
+		}
+		for (size_t k = 0; k < prim.indexCount; k++) {
+			uint32_t index = prim.hasIndex ? readIndex(prim.index, k) : (uint32_t)k;
+			if (index >= count) {
+				index = 0;
+				prim.badIndices++;
+			}
+			mesh.indices[prim.firstIndex + k] = (uint32_t)prim.firstVertex + index;
+		}
+		if (!prim.hasNormal) {
+			mesh.computeNormals(prim.firstIndex, prim.indexCount);
+		}
+	});
+
+	size_t badIndices = 0;
+	for (const Primitive& prim : primitives) {
+		badIndices += prim.badIndices;
+		if (!mesh.submeshes.empty() && mesh.submeshes.back().material == prim.material) {
+			mesh.submeshes.back().indexCount += (uint32_t)prim.indexCount;
+		}
+		else {
+			mesh.submeshes.push_back({ (uint32_t)prim.firstIndex, (uint32_t)prim.indexCount, prim.material });
+		}
+	}
+	if (badIndices) {
+		std::cout << "Mesh " << path << " has " << badIndices << " out of range vertex references" << std::endl;
+	}
+	mesh.computeBounds();
+	bytesRead = totalBytes;
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
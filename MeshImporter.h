@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Mesh.h"
+
+class ThreadPool;
+
+// Imports Wavefront OBJ and glTF 2.0 (.gltf and .glb) files into a Mesh.
+// Files are memory mapped and never copied. OBJ text is split into chunks at line boundaries that are
+// parsed in parallel; glTF primitives are decoded in parallel straight into the final vertex and index arrays.
+class MeshImporter
+{
+public:
+	explicit MeshImporter(ThreadPool& pool);
+	MeshImporter();
+
+	//picks the format from the file extension, runs the optimizer when optimize is set
+	bool load(const char* path, Mesh& mesh);
+	bool loadOBJ(const char* path, Mesh& mesh);
+	bool loadGLTF(const char* path, Mesh& mesh);
+
+	// statistics of the last successful load
+	size_t bytesRead;
+	double seconds;
+	// target size of one OBJ parse chunk
+	size_t chunkSize;
+	// runs optimizeMesh after load(), off by default because it takes longer than parsing
+	bool optimize;
+
+private:
+	ThreadPool& pool;
+};
@@ -0,0 +1,306 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// FIFO cache simulated with time stamps: a vertex is cached while fewer than cacheSize misses happened since it was loaded.
+struct CacheSimulator {
+	std::vector<uint32_t> stamp;
+	uint32_t time;
+	unsigned int size;
+
+	CacheSimulator(size_t vertexCount, unsigned int cacheSize) : stamp(vertexCount, 0), time(cacheSize + 1), size(cacheSize) {
+	}
+	bool cached(uint32_t v) const {
+		return time - stamp[v] <= size;
+	}
+	//returns 1 on a miss
+	unsigned int access(uint32_t v) {
+		if (cached(v)) {
+			return 0;
+		}
+		stamp[v] = time++;
+		return 1;
+	}
+	void flush() {
+		time += size + 1;
+	}
+};
+
+}
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize) {
+	VertexCacheStats stats = { 0.0f, 0.0f };
+	if (indexCount < 3) {
+		return stats;
+	}
+	CacheSimulator cache(vertexCount, cacheSize);
+	std::vector<char> used(vertexCount, 0);
+	size_t misses = 0, referenced = 0;
+	for (size_t i = 0; i < indexCount; i++) {
+		uint32_t v = indices[i];
+		if (v >= vertexCount) {
+			continue;
+		}
+		misses += cache.access(v);
+		referenced += used[v] == 0;
+		used[v] = 1;
+	}
+	stats.acmr = (float)misses / (float)(indexCount / 3);
+	stats.atvr = referenced ? (float)misses / (float)referenced : 0.0f;
+	return stats;
+}
+
+size_t remapDuplicateVertices(Mesh& mesh) {
+	size_t count = mesh.vertices.size();
+	size_t capacity = 16;
+	while (capacity < count * 2) {
+		capacity <<= 1;
+	}
+	std::vector<uint32_t> slots(capacity, 0); // unique vertex index + 1, 0 is empty
+	std::vector<uint32_t> remap(count);
+	std::vector<Vertex> unique;
+	unique.reserve(count);
+	for (size_t i = 0; i < count; i++) {
+		const Vertex& v = mesh.vertices[i];
+		uint32_t words[sizeof(Vertex) / 4];
+		memcpy(words, &v, sizeof(Vertex));
+		uint32_t h = 2166136261u;
+		for (uint32_t w : words) {
+			h = (h ^ w) * 16777619u;
+		}
+		size_t slot = (h ^ (h >> 15)) & (capacity - 1);
+		while (slots[slot] != 0 && memcmp(&unique[slots[slot] - 1], &v, sizeof(Vertex)) != 0) {
+			slot = (slot + 1) & (capacity - 1);
+		}
+		if (slots[slot] == 0) {
+			unique.push_back(v);
+			slots[slot] = (uint32_t)unique.size();
+		}
+		remap[i] = slots[slot] - 1;
+	}
+	for (uint32_t& index : mesh.indices) {
+		index = remap[index];
+	}
+	size_t removed = count - unique.size();
+	mesh.vertices.swap(unique);
+	return removed;
+}
+
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize, std::vector<uint32_t>* clusterStarts) {
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+	// triangles around every vertex, in compressed rows
+	std::vector<uint32_t> live(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++) {
+		live[indices[i]]++;
+	}
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++) {
+		offsets[v + 1] = offsets[v] + live[v];
+	}
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++) {
+		adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+	}
+
+	CacheSimulator cache(vertexCount, cacheSize);
+	std::vector<char> emitted(triangleCount, 0);
+	std::vector<uint32_t> deadEnd;
+	deadEnd.reserve(triangleCount * 3);
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> out;
+	out.reserve(triangleCount * 3);
+	size_t cursor = 0;
+	int64_t current = indices[0];
+
+	while (current >= 0) {
+		// emit every remaining triangle around the fan vertex
+		candidates.clear();
+		for (uint32_t k = offsets[current]; k < offsets[current + 1]; k++) {
+			uint32_t t = adjacency[k];
+			if (emitted[t]) {
+				continue;
+			}
+			const uint32_t* tri = indices + t * 3;
+			if (clusterStarts && !cache.cached(tri[0]) && !cache.cached(tri[1]) && !cache.cached(tri[2])) {
+				clusterStarts->push_back((uint32_t)(out.size() / 3));
+			}
+			for (int c = 0; c < 3; c++) {
+				uint32_t v = tri[c];
+				out.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				cache.access(v);
+			}
+			emitted[t] = 1;
+		}
+
+		// next fan: the oldest candidate that stays in the cache while its own triangles are emitted
+		int64_t next = -1;
+		int64_t best = -1;
+		for (uint32_t v : candidates) {
+			if (live[v] == 0) {
+				continue;
+			}
+			int64_t priority = 0;
+			int64_t age = cache.time - cache.stamp[v];
+			if (age + 2 * (int64_t)live[v] <= (int64_t)cacheSize) {
+				priority = age;
+			}
+			if (priority > best) {
+				best = priority;
+				next = v;
+			}
+		}
+		if (next < 0) {
+			// dead end, back up to a recently used vertex with triangles left, then scan for any
+			while (!deadEnd.empty() && next < 0) {
+				uint32_t v = deadEnd.back();
+				deadEnd.pop_back();
+				if (live[v] > 0) {
+					next = v;
+				}
+			}
+			for (; next < 0 && cursor < vertexCount; cursor++) {
+				if (live[cursor] > 0) {
+					next = (int64_t)cursor;
+				}
+			}
+		}
+		current = next;
+	}
+	std::copy(out.begin(), out.end(), indices);
+}
+
+size_t optimizeOverdraw(uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, unsigned int cacheSize, float threshold) {
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) {
+		return 0;
+	}
+	std::vector<uint32_t> hard;
+	optimizeVertexCache(indices, indexCount, vertexCount, cacheSize, &hard);
+	hard.push_back((uint32_t)triangleCount);
+
+	// Inside every hard cluster, cut wherever the run since the last cut is as cache friendly as the
+	// whole cluster allows. Each cut flushes the simulated cache because the pieces may end up far apart.
+	std::vector<uint32_t> starts;
+	CacheSimulator cache(vertexCount, cacheSize);
+	for (size_t h = 0; h + 1 < hard.size(); h++) {
+		uint32_t begin = hard[h], end = hard[h + 1];
+		cache.flush();
+		size_t misses = 0;
+		for (uint32_t t = begin; t < end; t++) {
+			for (int c = 0; c < 3; c++) {
+				misses += cache.access(indices[t * 3 + c]);
+			}
+		}
+		float limit = threshold * (float)misses / (float)(end - begin);
+
+		starts.push_back(begin);
+		cache.flush();
+		uint32_t runStart = begin;
+		size_t runMisses = 0;
+		for (uint32_t t = begin; t < end; t++) {
+			for (int c = 0; c < 3; c++) {
+				runMisses += cache.access(indices[t * 3 + c]);
+			}
+			if (t + 1 < end && (float)runMisses <= limit * (float)(t + 1 - runStart)) {
+				starts.push_back(t + 1);
+				runStart = t + 1;
+				runMisses = 0;
+				cache.flush();
+			}
+		}
+	}
+	starts.push_back((uint32_t)triangleCount);
+	size_t clusterCount = starts.size() - 1;
+
+	// sort clusters by how far they face away from the center of the range
+	glm::vec3 meshCenter(0.0f);
+	float meshArea = 0.0f;
+	std::vector<glm::vec3> centers(clusterCount, glm::vec3(0.0f));
+	std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+	std::vector<float> areas(clusterCount, 0.0f);
+	for (size_t c = 0; c < clusterCount; c++) {
+		for (uint32_t t = starts[c]; t < starts[c + 1]; t++) {
+			const glm::vec3& a = vertices[indices[t * 3]].position;
+			const glm::vec3& b = vertices[indices[t * 3 + 1]].position;
+			const glm::vec3& d = vertices[indices[t * 3 + 2]].position;
+			glm::vec3 n = glm::cross(b - a, d - a);
+			float area = glm::length(n);
+			glm::vec3 center = (a + b + d) / 3.0f;
+			centers[c] += center * area;
+			normals[c] += n;
+			areas[c] += area;
+			meshCenter += center * area;
+			meshArea += area;
+		}
+	}
+	if (meshArea > 0.0f) {
+		meshCenter /= meshArea;
+	}
+	std::vector<float> keys(clusterCount, 0.0f);
+	for (size_t c = 0; c < clusterCount; c++) {
+		float length = glm::length(normals[c]);
+		if (areas[c] > 0.0f && length > 0.0f) {
+			keys[c] = glm::dot(centers[c] / areas[c] - meshCenter, normals[c] / length);
+		}
+	}
+	std::vector<uint32_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++) {
+		order[c] = (uint32_t)c;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] > keys[b]; });
+
+	std::vector<uint32_t> sorted;
+	sorted.reserve(triangleCount * 3);
+	for (uint32_t c : order) {
+		sorted.insert(sorted.end(), indices + starts[c] * 3, indices + starts[c + 1] * 3);
+	}
+	std::copy(sorted.begin(), sorted.end(), indices);
+	return clusterCount;
+}
+
+void optimizeVertexFetch(Mesh& mesh) {
+	const uint32_t UNUSED = 0xFFFFFFFF;
+	std::vector<uint32_t> remap(mesh.vertices.size(), UNUSED);
+	std::vector<Vertex> ordered;
+	ordered.reserve(mesh.vertices.size());
+	for (uint32_t& index : mesh.indices) {
+		if (remap[index] == UNUSED) {
+			remap[index] = (uint32_t)ordered.size();
+			ordered.push_back(mesh.vertices[index]);
+		}
+		index = remap[index];
+	}
+	mesh.vertices.swap(ordered);
+}
+
+MeshOptimizeReport optimizeMesh(Mesh& mesh, bool verbose) {
+	MeshOptimizeReport report;
+	report.before = analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+	report.duplicatesRemoved = remapDuplicateVertices(mesh);
+	report.clusters = 0;
+	if (mesh.submeshes.empty()) {
+		report.clusters += optimizeOverdraw(mesh.indices.data(), mesh.indices.size(), mesh.vertices.data(), mesh.vertices.size());
+	}
+	for (const Submesh& s : mesh.submeshes) {
+		report.clusters += optimizeOverdraw(mesh.indices.data() + s.firstIndex, s.indexCount, mesh.vertices.data(), mesh.vertices.size());
+	}
+	optimizeVertexFetch(mesh);
+	mesh.meshlets.clear();
+	report.after = analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+	if (verbose) {
+		std::cout << "Optimized mesh: ACMR " << report.before.acmr << " -> " << report.after.acmr << ", ATVR " << report.before.atvr << " -> " << report.after.atvr
+			<< ", " << report.duplicatesRemoved << " duplicate vertices merged, " << report.clusters << " overdraw clusters" << std::endl;
+	}
+	return report;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Mesh.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Offline passes that reorder a mesh for the GPU without changing what is drawn.
+// Index passes work on each submesh range separately so submeshes stay contiguous.
+
+// Post-transform cache efficiency of an index buffer, simulated with a FIFO cache.
+// ACMR is transformed vertices per triangle (0.5 is ideal for large grids, 3 is worst),
+// ATVR is transformed vertices per referenced vertex (1 is ideal).
+struct VertexCacheStats {
+	float acmr;
+	float atvr;
+};
+
+struct MeshOptimizeReport {
+	VertexCacheStats before;
+	VertexCacheStats after;
+	size_t duplicatesRemoved;
+	size_t clusters;
+};
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = 16);
+
+//merges vertices that are bit for bit identical and remaps the indices, returns how many were removed
+size_t remapDuplicateVertices(Mesh& mesh);
+//Tipsify (Sander, Nehab, Barczak 2007) triangle order for a cache of cacheSize entries.
+//clusterStarts, when given, receives the first triangle of every run that began without any cached vertex.
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = 16, std::vector<uint32_t>* clusterStarts = nullptr);
+//splits a cache optimized range into clusters and sorts them so outward facing ones are drawn first,
+//which lets early depth testing reject more of the rest. Clusters are only cut where the cache
+//miss rate stays within threshold times that of the unsplit order. Returns the number of clusters.
+size_t optimizeOverdraw(uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, unsigned int cacheSize = 16, float threshold = 1.05f);
+//renumbers vertices in the order the index buffer first uses them and drops unreferenced ones
+void optimizeVertexFetch(Mesh& mesh);
+
+//all of the above in order, prints the cache statistics before and after when verbose
+MeshOptimizeReport optimizeMesh(Mesh& mesh, bool verbose = true);
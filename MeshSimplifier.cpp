@@ -0,0 +1,480 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Symmetric 4x4 matrix summing squared distances to planes, scaled by the area they came from.
+struct Quadric {
+	double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+	double weight;
+};
+
+Quadric planeQuadric(const glm::vec3& n, float d, float weight) {
+	Quadric q;
+	q.a2 = weight * n.x * n.x; q.ab = weight * n.x * n.y; q.ac = weight * n.x * n.z; q.ad = weight * n.x * d;
+	q.b2 = weight * n.y * n.y; q.bc = weight * n.y * n.z; q.bd = weight * n.y * d;
+	q.c2 = weight * n.z * n.z; q.cd = weight * n.z * d;
+	q.d2 = weight * d * d;
+	q.weight = weight;
+	return q;
+}
+
+void accumulate(Quadric& q, const Quadric& r) {
+	q.a2 += r.a2; q.ab += r.ab; q.ac += r.ac; q.ad += r.ad;
+	q.b2 += r.b2; q.bc += r.bc; q.bd += r.bd;
+	q.c2 += r.c2; q.cd += r.cd;
+	q.d2 += r.d2;
+	q.weight += r.weight;
+}
+
+//mean squared distance of p to the planes in q
+double evaluate(const Quadric& q, const glm::vec3& p) {
+	double x = p.x, y = p.y, z = p.z;
+	double rx = q.a2 * x + q.ab * y + q.ac * z + q.ad;
+	double ry = q.ab * x + q.b2 * y + q.bc * z + q.bd;
+	double rz = q.ac * x + q.bc * y + q.c2 * z + q.cd;
+	double e = rx * x + ry * y + rz * z + q.ad * x + q.bd * y + q.cd * z + q.d2;
+	return std::max(e, 0.0) / std::max(q.weight, 1e-30);
+}
+
+uint64_t edgeKey(uint32_t a, uint32_t b) {
+	return ((uint64_t)a << 32) | b;
+}
+
+// what a vertex may collapse onto
+enum VertexKind : unsigned char {
+	MANIFOLD, // any neighbour
+	BORDER,   // only along an open border edge
+	LOCKED    // stays where it is: seams, non-manifold spots, locked by the caller
+};
+
+struct Collapse {
+	uint32_t from;
+	uint32_t to;
+	float cost;
+};
+
+//squared distance from p to the closest point of triangle abc (Ericson, Real-Time Collision Detection 5.1.5)
+float distanceToTriangle2(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+	glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+	float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+	glm::vec3 closest;
+	if (d1 <= 0.0f && d2 <= 0.0f) {
+		closest = a;
+	}
+	else {
+		glm::vec3 bp = p - b;
+		float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+		glm::vec3 cp = p - c;
+		float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+		float vc = d1 * d4 - d3 * d2, vb = d5 * d2 - d1 * d6, va = d3 * d6 - d5 * d4;
+		if (d3 >= 0.0f && d4 <= d3) {
+			closest = b;
+		}
+		else if (d6 >= 0.0f && d5 <= d6) {
+			closest = c;
+		}
+		else if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+			closest = a + ab * (d1 / (d1 - d3));
+		}
+		else if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+			closest = a + ac * (d2 / (d2 - d6));
+		}
+		else if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+			closest = b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+		}
+		else {
+			float denominator = 1.0f / (va + vb + vc);
+			closest = a + ab * (vb * denominator) + ac * (vc * denominator);
+		}
+	}
+	glm::vec3 d = p - closest;
+	return glm::dot(d, d);
+}
+
+}
+
+// Simplifies once and copies the triangle list out whenever it gets down to the next target, so a whole
+// chain of levels costs about as much as its coarsest level. targets must be decreasing.
+static void simplifyLevels(const Mesh& mesh, const uint32_t* indices, size_t indexCount, const std::vector<size_t>& targets, float maxError, const std::vector<char>* locked,
+	std::vector<std::vector<uint32_t>>& levels, std::vector<float>& errors) {
+	levels.clear();
+	errors.clear();
+	std::vector<uint32_t> result(indices, indices + indexCount - indexCount % 3);
+	size_t vertexCount = mesh.vertices.size();
+	if (vertexCount == 0) {
+		levels.assign(targets.size(), result);
+		errors.assign(targets.size(), 0.0f);
+		return;
+	}
+
+	// Vertices with the same position are welded, so quadrics and topology ignore attribute splits.
+	// A position shared by several vertices is a texture or normal seam and is locked.
+	size_t capacity = 16;
+	while (capacity < vertexCount * 2) {
+		capacity <<= 1;
+	}
+	std::vector<uint32_t> slots(capacity, 0); // welded vertex + 1, 0 is empty
+	std::vector<uint32_t> weld(vertexCount);
+	std::vector<uint32_t> wedges(vertexCount, 0);
+	for (size_t v = 0; v < vertexCount; v++) {
+		const glm::vec3& p = mesh.vertices[v].position;
+		uint32_t words[3];
+		memcpy(words, &p, sizeof(words));
+		uint32_t h = 2166136261u;
+		for (uint32_t w : words) {
+			h = (h ^ w) * 16777619u;
+		}
+		size_t slot = (h ^ (h >> 15)) & (capacity - 1);
+		while (slots[slot] != 0 && memcmp(&mesh.vertices[slots[slot] - 1].position, &p, sizeof(glm::vec3)) != 0) {
+			slot = (slot + 1) & (capacity - 1);
+		}
+		if (slots[slot] == 0) {
+			slots[slot] = (uint32_t)v + 1;
+		}
+		weld[v] = slots[slot] - 1;
+		wedges[weld[v]]++;
+	}
+	auto position = [&](uint32_t v) -> const glm::vec3& { return mesh.vertices[v].position; };
+
+	// directed edges of the welded triangles, an edge without its reverse is on an open border
+	std::vector<uint64_t> edges;
+	auto collectEdges = [&]() {
+		edges.clear();
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (int c = 0; c < 3; c++) {
+				edges.push_back(edgeKey(weld[result[i + c]], weld[result[i + (c + 1) % 3]]));
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+	};
+	auto edgeCount = [&](uint32_t a, uint32_t b) {
+		auto range = std::equal_range(edges.begin(), edges.end(), edgeKey(a, b));
+		return (size_t)(range.second - range.first);
+	};
+	auto isBorder = [&](uint32_t a, uint32_t b) {
+		return edgeCount(a, b) == 1 && edgeCount(b, a) == 0;
+	};
+
+	// plane quadrics of the original triangles, plus planes perpendicular to border edges so borders keep their shape
+	std::vector<Quadric> quadrics(vertexCount, Quadric());
+	collectEdges();
+	for (size_t i = 0; i < result.size(); i += 3) {
+		uint32_t w[3] = { weld[result[i]], weld[result[i + 1]], weld[result[i + 2]] };
+		glm::vec3 n = glm::cross(position(w[1]) - position(w[0]), position(w[2]) - position(w[0]));
+		float area = glm::length(n);
+		if (area <= 0.0f) {
+			continue;
+		}
+		n /= area;
+		Quadric q = planeQuadric(n, -glm::dot(n, position(w[0])), area * 0.5f);
+		for (int c = 0; c < 3; c++) {
+			accumulate(quadrics[w[c]], q);
+		}
+		for (int c = 0; c < 3; c++) {
+			uint32_t a = w[c], b = w[(c + 1) % 3];
+			if (!isBorder(a, b)) {
+				continue;
+			}
+			glm::vec3 edge = position(b) - position(a);
+			glm::vec3 m = glm::cross(edge, n);
+			float length = glm::length(m);
+			if (length > 0.0f) {
+				m /= length;
+				Quadric border = planeQuadric(m, -glm::dot(m, position(a)), 10.0f * glm::dot(edge, edge));
+				accumulate(quadrics[a], border);
+				accumulate(quadrics[b], border);
+			}
+		}
+	}
+
+	double maxCost = (double)maxError * maxError;
+	double worst = 0.0;
+	std::vector<VertexKind> kind(vertexCount);
+	std::vector<uint32_t> borderEdges(vertexCount);
+	std::vector<uint32_t> offsets(vertexCount + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<Collapse> best(vertexCount);
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<uint32_t> moved(vertexCount); // where every vertex ended up, over all passes
+	std::vector<char> touched(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) {
+		moved[v] = (uint32_t)v;
+	}
+
+	// triangles around every welded vertex, in compressed rows
+	auto buildAdjacency = [&]() {
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (uint32_t v : result) {
+			offsets[weld[v] + 1]++;
+		}
+		for (size_t v = 0; v < vertexCount; v++) {
+			offsets[v + 1] += offsets[v];
+		}
+		adjacency.resize(result.size());
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < result.size(); i++) {
+			adjacency[fill[weld[result[i]]]++] = (uint32_t)(i / 3);
+		}
+	};
+
+	// The quadric cost is an area weighted average, so the error of a level is the larger of its square root and
+	// the distance from every original vertex to the triangles around the vertex it was collapsed into.
+	auto snapshot = [&]() {
+		buildAdjacency();
+		double deviation = worst;
+		std::vector<char> measured(vertexCount, 0);
+		for (size_t i = 0; i < indexCount - indexCount % 3; i++) {
+			uint32_t v = indices[i];
+			if (moved[v] == v || measured[v]) {
+				continue;
+			}
+			measured[v] = 1;
+			uint32_t target = v;
+			while (moved[target] != target) {
+				target = moved[target];
+			}
+			// the vertex may have drifted past the first ring after several collapses, so look at two
+			uint32_t wt = weld[target];
+			float closest = -1.0f;
+			for (uint32_t k = offsets[wt]; k < offsets[wt + 1]; k++) {
+				const uint32_t* ring = result.data() + adjacency[k] * 3;
+				for (int c = 0; c < 3; c++) {
+					uint32_t wr = weld[ring[c]];
+					for (uint32_t j = offsets[wr]; j < offsets[wr + 1]; j++) {
+						const uint32_t* tri = result.data() + adjacency[j] * 3;
+						float d = distanceToTriangle2(position(v), position(tri[0]), position(tri[1]), position(tri[2]));
+						closest = closest < 0.0f ? d : std::min(closest, d);
+					}
+				}
+			}
+			deviation = std::max(deviation, (double)closest);
+		}
+		levels.push_back(result);
+		errors.push_back((float)std::sqrt(deviation));
+	};
+
+	// Every pass sorts the cheapest collapse of each vertex and applies those whose neighbourhoods do not overlap,
+	// then rebuilds the topology. A pass only goes a bit past the cost of the collapses it needs, so cheap ones come first.
+	bool stuck = false;
+	for (bool first = true; levels.size() < targets.size(); first = false) {
+		size_t target = targets[levels.size()];
+		if (result.size() <= target || stuck) {
+			snapshot();
+			continue;
+		}
+		if (!first) {
+			collectEdges();
+		}
+		size_t triangleCount = result.size() / 3;
+
+		std::fill(borderEdges.begin(), borderEdges.end(), 0);
+		std::fill(kind.begin(), kind.end(), MANIFOLD);
+		for (size_t e = 0; e < edges.size(); e++) {
+			uint32_t a = (uint32_t)(edges[e] >> 32), b = (uint32_t)edges[e];
+			bool repeated = (e > 0 && edges[e - 1] == edges[e]) || (e + 1 < edges.size() && edges[e + 1] == edges[e]);
+			if (repeated) {
+				kind[a] = kind[b] = LOCKED; // non-manifold edge
+			}
+			else if (edgeCount(b, a) == 0) {
+				borderEdges[a]++;
+				borderEdges[b]++;
+			}
+		}
+		for (size_t v = 0; v < vertexCount; v++) {
+			if (weld[v] != v) {
+				continue;
+			}
+			if (wedges[v] > 1 || borderEdges[v] > 2) {
+				kind[v] = LOCKED;
+			}
+			else if (borderEdges[v] > 0 && kind[v] != LOCKED) {
+				kind[v] = BORDER;
+			}
+		}
+		if (locked) {
+			for (size_t v = 0; v < vertexCount; v++) {
+				if ((*locked)[v]) {
+					kind[weld[v]] = LOCKED;
+				}
+			}
+		}
+		buildAdjacency();
+
+		// a vertex moves at most once per pass, so only its cheapest collapse is a candidate
+		const uint32_t NONE = 0xFFFFFFFF;
+		std::fill(best.begin(), best.end(), Collapse{ NONE, NONE, 0.0f });
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (int c = 0; c < 3; c++) {
+				uint32_t a = result[i + c], b = result[i + (c + 1) % 3];
+				uint32_t wa = weld[a], wb = weld[b];
+				for (int direction = 0; direction < 2; direction++) {
+					uint32_t from = direction ? b : a, to = direction ? a : b;
+					uint32_t wf = direction ? wb : wa, wt = direction ? wa : wb;
+					if (kind[wf] == LOCKED || (kind[wf] == BORDER && !isBorder(wa, wb))) {
+						continue;
+					}
+					Quadric q = quadrics[wf];
+					accumulate(q, quadrics[wt]);
+					float cost = (float)evaluate(q, position(wt));
+					if (best[wf].from == NONE || cost < best[wf].cost) {
+						best[wf] = { from, to, cost };
+					}
+				}
+			}
+		}
+		collapses.clear();
+		for (const Collapse& c : best) {
+			if (c.from != NONE) {
+				collapses.push_back(c);
+			}
+		}
+		if (collapses.empty()) {
+			stuck = true;
+			continue;
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+		// each collapse removes about two triangles
+		size_t needed = std::min(collapses.size(), (triangleCount - target / 3) / 2 + 1);
+		double passLimit = std::min(maxCost, std::max((double)collapses[needed - 1].cost * 1.5, 1e-12));
+
+		for (size_t v = 0; v < vertexCount; v++) {
+			remap[v] = (uint32_t)v;
+		}
+		std::fill(touched.begin(), touched.end(), 0);
+		size_t live = triangleCount;
+		size_t applied = 0;
+		for (const Collapse& c : collapses) {
+			if (live * 3 <= target || c.cost > passLimit) {
+				break;
+			}
+			uint32_t wf = weld[c.from], wt = weld[c.to];
+			if (touched[wf] || touched[wt]) {
+				continue;
+			}
+			// reject collapses that flip a remaining triangle around the moving vertex
+			bool flips = false;
+			size_t removed = 0;
+			for (uint32_t k = offsets[wf]; k < offsets[wf + 1] && !flips; k++) {
+				const uint32_t* tri = result.data() + adjacency[k] * 3;
+				glm::vec3 p[3], q[3];
+				bool shared = false;
+				for (int i = 0; i < 3; i++) {
+					uint32_t w = weld[tri[i]];
+					shared = shared || w == wt;
+					p[i] = position(w);
+					q[i] = w == wf ? position(wt) : p[i];
+				}
+				if (shared) {
+					removed++;
+					continue;
+				}
+				glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+				glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+				flips = glm::dot(before, after) <= 0.0f;
+			}
+			if (flips) {
+				continue;
+			}
+			for (uint32_t k = offsets[wf]; k < offsets[wf + 1]; k++) {
+				const uint32_t* tri = result.data() + adjacency[k] * 3;
+				for (int i = 0; i < 3; i++) {
+					touched[weld[tri[i]]] = 1;
+				}
+			}
+			remap[c.from] = c.to;
+			moved[c.from] = c.to;
+			accumulate(quadrics[wt], quadrics[wf]);
+			worst = std::max(worst, (double)c.cost);
+			live -= removed;
+			applied++;
+		}
+		if (applied == 0) {
+			stuck = true;
+			continue;
+		}
+
+		// a welded vertex that moved now refers to the vertex it collapsed onto
+		size_t out = 0;
+		for (size_t i = 0; i < result.size(); i += 3) {
+			uint32_t a = remap[result[i]], b = remap[result[i + 1]], d = remap[result[i + 2]];
+			if (weld[a] == weld[b] || weld[b] == weld[d] || weld[a] == weld[d]) {
+				continue;
+			}
+			result[out++] = a;
+			result[out++] = b;
+			result[out++] = d;
+		}
+		result.resize(out);
+	}
+}
+
+std::vector<uint32_t> simplifyMesh(const Mesh& mesh, const uint32_t* indices, size_t indexCount, size_t targetIndexCount, float maxError, float& error, const std::vector<char>* locked) {
+	std::vector<std::vector<uint32_t>> levels;
+	std::vector<float> errors;
+	simplifyLevels(mesh, indices, indexCount, std::vector<size_t>(1, targetIndexCount), maxError, locked, levels, errors);
+	error = errors[0];
+	return levels[0];
+}
+
+void buildLods(Mesh& mesh, int maxLevels, float ratio) {
+	mesh.lods.clear();
+	MeshLod full = { 0, (uint32_t)mesh.indices.size(), 0, 0, 0.0f }; // level 0 is the index buffer as it is now
+	mesh.lods.push_back(full);
+
+	std::vector<Submesh> ranges = mesh.submeshes;
+	if (ranges.empty()) {
+		ranges.push_back({ 0, (uint32_t)mesh.indices.size(), std::string() });
+	}
+	// vertices used by more than one submesh keep material boundaries closed
+	const uint32_t NONE = 0xFFFFFFFF, SHARED = 0xFFFFFFFE;
+	std::vector<uint32_t> owner(mesh.vertices.size(), NONE);
+	for (size_t r = 0; r < ranges.size(); r++) {
+		for (uint32_t i = ranges[r].firstIndex; i < ranges[r].firstIndex + ranges[r].indexCount; i++) {
+			uint32_t& o = owner[mesh.indices[i]];
+			o = o == NONE || o == r ? (uint32_t)r : SHARED;
+		}
+	}
+	std::vector<char> locked(mesh.vertices.size(), 0);
+	for (size_t v = 0; v < owner.size(); v++) {
+		locked[v] = owner[v] == SHARED;
+	}
+
+	// every range is simplified once from the full mesh, so quadrics and errors are measured against the original surface
+	float maxError = glm::length(mesh.boundsMax - mesh.boundsMin) * 0.1f;
+	std::vector<std::vector<uint32_t>> levelIndices(maxLevels);
+	std::vector<float> levelErrors(maxLevels, 0.0f);
+	for (const Submesh& r : ranges) {
+		std::vector<size_t> targets;
+		float scale = 1.0f;
+		for (int level = 0; level < maxLevels; level++) {
+			scale *= ratio;
+			targets.push_back((size_t)(r.indexCount * scale));
+		}
+		std::vector<std::vector<uint32_t>> levels;
+		std::vector<float> errors;
+		simplifyLevels(mesh, mesh.indices.data() + r.firstIndex, r.indexCount, targets, maxError, &locked, levels, errors);
+		for (int level = 0; level < maxLevels; level++) {
+			levelIndices[level].insert(levelIndices[level].end(), levels[level].begin(), levels[level].end());
+			levelErrors[level] = std::max(levelErrors[level], errors[level]);
+		}
+	}
+	size_t previous = mesh.indices.size();
+	for (int level = 0; level < maxLevels; level++) {
+		std::vector<uint32_t>& indices = levelIndices[level];
+		if (indices.empty() || (float)indices.size() > (float)previous * 0.9f) {
+			break;
+		}
+		optimizeVertexCache(indices.data(), indices.size(), mesh.vertices.size());
+		MeshLod lod = { (uint32_t)mesh.indices.size(), (uint32_t)indices.size(), 0, 0, levelErrors[level] };
+		mesh.indices.insert(mesh.indices.end(), indices.begin(), indices.end());
+		mesh.lods.push_back(lod);
+		previous = indices.size();
+	}
+	mesh.meshlets.clear();
+}
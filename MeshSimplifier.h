@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Mesh.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Quadric error metric simplification (Garland and Heckbert 1997) by collapsing vertices onto their neighbours.
+// No vertices are created, so simplified index lists keep using the mesh's vertex buffer.
+// Vertices on texture or normal seams stay in place, open borders only collapse along themselves.
+
+//simplifies a triangle list until at most targetIndexCount indices are left or the next collapse would move
+//the surface more than maxError (model units). Returns the new index list, error receives the largest deviation.
+//Vertices flagged in locked (one entry per mesh vertex) never move, e.g. those shared with other submeshes.
+std::vector<uint32_t> simplifyMesh(const Mesh& mesh, const uint32_t* indices, size_t indexCount, size_t targetIndexCount, float maxError, float& error, const std::vector<char>* locked = nullptr);
+
+//appends up to maxLevels coarser copies of the index buffer, each with about ratio times the triangles of the
+//previous one, and fills mesh.lods with level 0 as the full mesh. Stops early when a level barely shrinks.
+void buildLods(Mesh& mesh, int maxLevels = 4, float ratio = 0.5f);
@@ -0,0 +1,310 @@
+#include "Meshlets.h"
+
+#include <algorithm>
+#include <cmath>
+
+void buildMeshlets(Mesh& mesh, size_t maxVertices, size_t maxTriangles) {
+	mesh.meshlets.clear();
+	std::vector<uint32_t> stamp(mesh.vertices.size(), 0); // id of the last meshlet that used the vertex
+	uint32_t id = 0;
+
+	auto buildRange = [&](size_t firstIndex, size_t indexCount) {
+		size_t end = firstIndex + indexCount - indexCount % 3;
+		Meshlet current = {};
+		current.firstIndex = (uint32_t)firstIndex;
+		id++;
+		for (size_t i = firstIndex; i < end; i += 3) {
+			const uint32_t* tri = mesh.indices.data() + i;
+			auto newVertices = [&]() {
+				uint32_t count = 0;
+				for (int c = 0; c < 3; c++) {
+					bool repeated = (c > 0 && tri[c] == tri[0]) || (c > 1 && tri[c] == tri[1]);
+					count += stamp[tri[c]] != id && !repeated;
+				}
+				return count;
+			};
+			uint32_t added = newVertices();
+			if (current.triangleCount > 0 && (current.vertexCount + added > maxVertices || current.triangleCount + 1 > maxTriangles)) {
+				computeMeshletBounds(mesh, current);
+				mesh.meshlets.push_back(current);
+				current = Meshlet();
+				current.firstIndex = (uint32_t)i;
+				id++;
+				added = newVertices();
+			}
+			for (int c = 0; c < 3; c++) {
+				stamp[tri[c]] = id;
+			}
+			current.vertexCount += added;
+			current.triangleCount++;
+		}
+		if (current.triangleCount > 0) {
+			computeMeshletBounds(mesh, current);
+			mesh.meshlets.push_back(current);
+		}
+	};
+
+	if (mesh.submeshes.empty()) {
+		buildRange(0, mesh.lods.empty() ? mesh.indices.size() : mesh.lods[0].indexCount);
+	}
+	for (const Submesh& s : mesh.submeshes) {
+		buildRange(s.firstIndex, s.indexCount);
+	}
+	for (size_t level = 0; level < mesh.lods.size(); level++) {
+		MeshLod& lod = mesh.lods[level];
+		size_t first = level == 0 ? 0 : mesh.meshlets.size();
+		if (level > 0) {
+			buildRange(lod.firstIndex, lod.indexCount);
+		}
+		lod.firstMeshlet = (uint32_t)first;
+		lod.meshletCount = (uint32_t)(mesh.meshlets.size() - first);
+	}
+}
+
+void computeMeshletBounds(const Mesh& mesh, Meshlet& meshlet) {
+	const uint32_t* indices = mesh.indices.data() + meshlet.firstIndex;
+	size_t indexCount = (size_t)meshlet.triangleCount * 3;
+
+	// sphere around the bounding box
+	glm::vec3 lo = mesh.vertices[indices[0]].position, hi = lo;
+	for (size_t i = 1; i < indexCount; i++) {
+		lo = glm::min(lo, mesh.vertices[indices[i]].position);
+		hi = glm::max(hi, mesh.vertices[indices[i]].position);
+	}
+	meshlet.center = (lo + hi) * 0.5f;
+	float radius2 = 0.0f;
+	for (size_t i = 0; i < indexCount; i++) {
+		glm::vec3 d = mesh.vertices[indices[i]].position - meshlet.center;
+		radius2 = std::max(radius2, glm::dot(d, d));
+	}
+	meshlet.radius = std::sqrt(radius2);
+
+	// normal cone: average direction and the widest angle to it
+	std::vector<glm::vec3> normals;
+	normals.reserve(meshlet.triangleCount);
+	glm::vec3 axis(0.0f);
+	for (size_t i = 0; i < indexCount; i += 3) {
+		glm::vec3 a = mesh.vertices[indices[i]].position;
+		glm::vec3 n = glm::cross(mesh.vertices[indices[i + 1]].position - a, mesh.vertices[indices[i + 2]].position - a);
+		float length = glm::length(n);
+		normals.push_back(length > 0.0f ? n / length : glm::vec3(0.0f));
+		axis += normals.back();
+	}
+	meshlet.coneApex = meshlet.center;
+	meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+	meshlet.coneCutoff = 2.0f;
+	float axisLength = glm::length(axis);
+	if (axisLength <= 0.0f) {
+		return;
+	}
+	axis /= axisLength;
+	meshlet.coneAxis = axis;
+	float minDot = 1.0f;
+	for (const glm::vec3& n : normals) {
+		if (n != glm::vec3(0.0f)) {
+			minDot = std::min(minDot, glm::dot(n, axis));
+		}
+	}
+	if (minDot <= 0.1f) {
+		// wider than about 84 degrees, the cone would almost never reject and the apex would be far away
+		return;
+	}
+	// Move the apex back along the axis until it is behind every triangle plane, then a camera looking at
+	// the apex from within the mirrored cone sees only back faces.
+	float maxT = 0.0f;
+	for (size_t i = 0; i < indexCount; i += 3) {
+		const glm::vec3& n = normals[i / 3];
+		if (n == glm::vec3(0.0f)) {
+			continue;
+		}
+		float t = glm::dot(meshlet.center - mesh.vertices[indices[i]].position, n) / glm::dot(axis, n);
+		maxT = std::max(maxT, t);
+	}
+	meshlet.coneApex = meshlet.center - axis * maxT;
+	meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+void frustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]) {
+	// from the rows of the view projection matrix, pointing inwards
+	const glm::mat4& m = viewProjection;
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++) {
+		rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+	}
+	for (int i = 0; i < 3; i++) {
+		planes[i * 2] = rows[3] + rows[i];
+		planes[i * 2 + 1] = rows[3] - rows[i];
+	}
+	for (int i = 0; i < 6; i++) {
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+	}
+}
+
+// =============================================================================================== //
+
+OcclusionBuffer::OcclusionBuffer(int width, int height) : width(width), height(height), depth((size_t)width * height, 1.0f) {
+}
+
+void OcclusionBuffer::clear() {
+	std::fill(depth.begin(), depth.end(), 1.0f);
+}
+
+void OcclusionBuffer::rasterize(const glm::vec3* positions, const uint32_t* indices, size_t indexCount, const glm::mat4& modelViewProjection) {
+	// Depth of the nearest triangle at every pixel corner. A pixel takes the farthest of its four corners and only
+	// when all of them are covered, so for closed occluders it is never marked nearer than what covers it.
+	const float EMPTY = 2.0f;
+	int cornerWidth = width + 1;
+	corners.assign((size_t)cornerWidth * (height + 1), EMPTY);
+	auto edge = [](const glm::vec3& a, const glm::vec3& b, float x, float y) {
+		return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x);
+	};
+	for (size_t i = 0; i + 2 < indexCount; i += 3) {
+		glm::vec3 screen[3];
+		bool clipped = false;
+		for (int c = 0; c < 3; c++) {
+			glm::vec4 clip = modelViewProjection * glm::vec4(positions[indices[i + c]], 1.0f);
+			if (clip.w <= 0.0f || clip.z < -clip.w) {
+				clipped = true;
+				break;
+			}
+			glm::vec3 ndc = glm::vec3(clip) / clip.w;
+			screen[c] = glm::vec3((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, std::min(ndc.z * 0.5f + 0.5f, 1.0f));
+		}
+		if (clipped) {
+			continue;
+		}
+		float area = edge(screen[0], screen[1], screen[2].x, screen[2].y);
+		if (area == 0.0f) {
+			continue;
+		}
+		float sign = area > 0.0f ? 1.0f : -1.0f;
+		int x0 = std::max(0, (int)std::ceil(std::min(screen[0].x, std::min(screen[1].x, screen[2].x))));
+		int x1 = std::min(width, (int)std::floor(std::max(screen[0].x, std::max(screen[1].x, screen[2].x))));
+		int y0 = std::max(0, (int)std::ceil(std::min(screen[0].y, std::min(screen[1].y, screen[2].y))));
+		int y1 = std::min(height, (int)std::floor(std::max(screen[0].y, std::max(screen[1].y, screen[2].y))));
+		for (int y = y0; y <= y1; y++) {
+			for (int x = x0; x <= x1; x++) {
+				float w0 = edge(screen[1], screen[2], (float)x, (float)y) * sign;
+				float w1 = edge(screen[2], screen[0], (float)x, (float)y) * sign;
+				float w2 = edge(screen[0], screen[1], (float)x, (float)y) * sign;
+				if (w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f) {
+					float z = (w0 * screen[0].z + w1 * screen[1].z + w2 * screen[2].z) / (area * sign);
+					float& corner = corners[(size_t)y * cornerWidth + x];
+					corner = std::min(corner, z);
+				}
+			}
+		}
+	}
+	for (int y = 0; y < height; y++) {
+		const float* row = corners.data() + (size_t)y * cornerWidth;
+		for (int x = 0; x < width; x++) {
+			float farthest = std::max(std::max(row[x], row[x + 1]), std::max(row[x + cornerWidth], row[x + cornerWidth + 1]));
+			float& d = depth[(size_t)y * width + x];
+			if (farthest < d) {
+				d = farthest;
+			}
+		}
+	}
+}
+
+bool OcclusionBuffer::sphereVisible(const glm::vec3& viewCenter, float radius, const glm::mat4& projection) const {
+	// nearest point of the sphere, the camera looks down -z
+	glm::vec4 nearClip = projection * glm::vec4(0.0f, 0.0f, viewCenter.z + radius, 1.0f);
+	if (nearClip.w <= 0.0f || nearClip.z < -nearClip.w) {
+		return true;
+	}
+	float nearestDepth = nearClip.z / nearClip.w * 0.5f + 0.5f;
+
+	glm::vec2 lo(1e30f), hi(-1e30f);
+	for (int corner = 0; corner < 8; corner++) {
+		glm::vec3 offset((corner & 1) ? radius : -radius, (corner & 2) ? radius : -radius, (corner & 4) ? radius : -radius);
+		glm::vec4 clip = projection * glm::vec4(viewCenter + offset, 1.0f);
+		if (clip.w <= 0.0f) {
+			return true;
+		}
+		glm::vec2 ndc = glm::vec2(clip) / clip.w;
+		lo = glm::min(lo, ndc);
+		hi = glm::max(hi, ndc);
+	}
+	int x0 = std::max(0, (int)std::floor((lo.x * 0.5f + 0.5f) * width));
+	int x1 = std::min(width - 1, (int)std::ceil((hi.x * 0.5f + 0.5f) * width) - 1);
+	int y0 = std::max(0, (int)std::floor((lo.y * 0.5f + 0.5f) * height));
+	int y1 = std::min(height - 1, (int)std::ceil((hi.y * 0.5f + 0.5f) * height) - 1);
+	if (x0 > x1 || y0 > y1) {
+		return true; // off screen, left to the frustum test
+	}
+	for (int y = y0; y <= y1; y++) {
+		for (int x = x0; x <= x1; x++) {
+			if (nearestDepth <= depth[(size_t)y * width + x]) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// =============================================================================================== //
+
+MeshletCuller::MeshletCuller() : frustumCulling(true), backfaceCulling(true), occlusionCulling(false), stats(), view(1.0f), projection(1.0f), camera(0.0f) {
+}
+
+void MeshletCuller::beginFrame(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPosition) {
+	this->view = view;
+	this->projection = projection;
+	camera = cameraPosition;
+	stats = MeshletCullStats();
+
+	frustumPlanes(projection * view, planes);
+}
+
+size_t MeshletCuller::cull(const Meshlet* meshlets, size_t count, const glm::mat4& model, uint32_t baseInstance, std::vector<DrawElementsIndirectCommand>& commands) {
+	float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	glm::mat3 rotation(model);
+	size_t appended = 0;
+	for (size_t i = 0; i < count; i++) {
+		const Meshlet& m = meshlets[i];
+		stats.meshlets++;
+		stats.triangles += m.triangleCount;
+		glm::vec3 center = glm::vec3(model * glm::vec4(m.center, 1.0f));
+		float radius = m.radius * scale;
+
+		bool visible = true;
+		if (frustumCulling) {
+			for (const glm::vec4& plane : planes) {
+				if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+					visible = false;
+					stats.frustumRejected++;
+					break;
+				}
+			}
+		}
+		if (visible && backfaceCulling && m.coneCutoff <= 1.0f) {
+			glm::vec3 apex = glm::vec3(model * glm::vec4(m.coneApex, 1.0f));
+			glm::vec3 axis = glm::normalize(rotation * m.coneAxis);
+			glm::vec3 toApex = apex - camera;
+			float distance = glm::length(toApex);
+			if (distance > 0.0f && glm::dot(toApex / distance, axis) >= m.coneCutoff) {
+				visible = false;
+				stats.backfaceRejected++;
+			}
+		}
+		if (visible && occlusionCulling && !occlusion.sphereVisible(glm::vec3(view * glm::vec4(center, 1.0f)), radius, projection)) {
+			visible = false;
+			stats.occlusionRejected++;
+		}
+		if (!visible) {
+			stats.trianglesRejected += m.triangleCount;
+			continue;
+		}
+
+		if (appended > 0 && commands.back().firstIndex + commands.back().count == m.firstIndex) {
+			commands.back().count += m.triangleCount * 3;
+		}
+		else {
+			commands.push_back({ m.triangleCount * 3, 1, m.firstIndex, 0, baseInstance });
+			appended++;
+		}
+	}
+	stats.commands += appended;
+	return appended;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Splits every submesh and every coarser level of detail into meshlets of consecutive triangles. The index buffer
+// is not reordered, run it after the optimizer and buildLods so consecutive triangles share vertices.
+// Fills mesh.meshlets and the meshlet ranges of mesh.lods.
+void buildMeshlets(Mesh& mesh, size_t maxVertices = 64, size_t maxTriangles = 124);
+//bounding sphere and normal cone of the triangles in meshlet's index range
+void computeMeshletBounds(const Mesh& mesh, Meshlet& meshlet);
+//left, right, bottom, top, near, far planes with normalized inward normals, a point p is inside when dot(xyz, p) + w >= 0
+void frustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]);
+
+// Layout of one glMultiDrawElementsIndirect command.
+struct DrawElementsIndirectCommand {
+	uint32_t count;
+	uint32_t instanceCount;
+	uint32_t firstIndex;
+	int32_t baseVertex;
+	uint32_t baseInstance;
+};
+
+// Small software depth buffer for occlusion culling. Occluders are rasterized at low resolution and
+// only ever make pixels nearer, tests compare against the farthest depth under a sphere's screen rectangle,
+// so an occluder can hide what is behind it but never itself.
+class OcclusionBuffer
+{
+public:
+	OcclusionBuffer(int width = 160, int height = 120);
+
+	void clear();
+	//rasterizes one closed occluder mesh transformed by modelViewProjection, triangles crossing the near plane are skipped
+	void rasterize(const glm::vec3* positions, const uint32_t* indices, size_t indexCount, const glm::mat4& modelViewProjection);
+	//false when a view space sphere is completely behind the occluders
+	bool sphereVisible(const glm::vec3& viewCenter, float radius, const glm::mat4& projection) const;
+
+	int width, height;
+	std::vector<float> depth; // [0, 1] window depth, 1 is empty
+
+private:
+	std::vector<float> corners;
+};
+
+// Rejected meshlets and triangles, reset every frame.
+struct MeshletCullStats {
+	size_t meshlets;
+	size_t triangles;
+	size_t frustumRejected;
+	size_t backfaceRejected;
+	size_t occlusionRejected;
+	size_t trianglesRejected;
+	size_t commands;
+};
+
+// Tests meshlets against the view frustum, their normal cone and an optional occlusion buffer and
+// writes the survivors as indirect draw commands. Neighbouring visible meshlets are merged into one command.
+class MeshletCuller
+{
+public:
+	MeshletCuller();
+
+	//sets the camera for the frame and resets the statistics
+	void beginFrame(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPosition);
+	//appends commands for the visible meshlets of one object, returns how many were appended.
+	//Bounds are scaled by the largest axis scale of model.
+	size_t cull(const Meshlet* meshlets, size_t count, const glm::mat4& model, uint32_t baseInstance, std::vector<DrawElementsIndirectCommand>& commands);
+
+	bool frustumCulling;
+	bool backfaceCulling;
+	bool occlusionCulling;
+	// filled by the caller after beginFrame, tested only when occlusionCulling is set
+	OcclusionBuffer occlusion;
+	MeshletCullStats stats;
+
+private:
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 camera;
+	glm::vec4 planes[6];
+};
@@ -0,0 +1,134 @@
+#include "MipResidency.h"
+
+#include <algorithm>
+#include <cmath>
+
+MipResidency::MipResidency(size_t budgetBytes, int minResidentSize, size_t maxUploadBytesPerFrame)
+	: budgetBytes(budgetBytes), maxUploadBytes(maxUploadBytesPerFrame), totalBytes(0), minResidentSize(minResidentSize), frame(0) {
+}
+
+int MipResidency::add(int width, int height, int bytesPerTexel) {
+	Texture t;
+	t.width = width;
+	t.height = height;
+	t.bytesPerTexel = bytesPerTexel;
+	t.levels = 1;
+	while ((std::max(width, height) >> t.levels) > 0) {
+		t.levels++;
+	}
+	t.floorBase = 0;
+	while (t.floorBase < t.levels - 1 && (std::max(width, height) >> t.floorBase) > minResidentSize) {
+		t.floorBase++;
+	}
+	t.residentBase = t.floorBase;
+	t.requestedBase = t.floorBase;
+	t.lastUsed = frame;
+	textures.push_back(t);
+	totalBytes += bytesFrom((int)textures.size() - 1, t.floorBase);
+	return (int)textures.size() - 1;
+}
+
+size_t MipResidency::bytesFrom(int texture, int base) const {
+	const Texture& t = textures[texture];
+	size_t bytes = 0;
+	for (int level = base; level < t.levels; level++) {
+		bytes += (size_t)std::max(1, t.width >> level) * std::max(1, t.height >> level) * t.bytesPerTexel;
+	}
+	return bytes;
+}
+
+void MipResidency::request(int texture, float level) {
+	Texture& t = textures[texture];
+	// round down, a request for level 1.3 needs level 1 to be sharp
+	int base = (int)std::floor(level);
+	base = std::min(std::max(base, 0), t.floorBase);
+	t.requestedBase = std::min(t.requestedBase, base);
+	t.lastUsed = frame;
+}
+
+const std::vector<MipResidency::Change>& MipResidency::update() {
+	changes.clear();
+	std::vector<int> oldBase(textures.size());
+	for (size_t i = 0; i < textures.size(); i++) {
+		oldBase[i] = textures[i].residentBase;
+	}
+
+	// Drops one level of the least recently used texture that has something to give back.
+	// Levels finer than what was requested this frame count as unused. Returns false when nothing is left.
+	auto evictOne = [&](int keep) {
+		int victim = -1;
+		for (int i = 0; i < (int)textures.size(); i++) {
+			const Texture& t = textures[i];
+			if (i == keep || t.residentBase >= t.floorBase) {
+				continue;
+			}
+			if (t.lastUsed == frame && t.residentBase >= t.requestedBase) {
+				continue;
+			}
+			if (victim < 0 || t.lastUsed < textures[victim].lastUsed) {
+				victim = i;
+			}
+		}
+		if (victim < 0) {
+			return false;
+		}
+		Texture& t = textures[victim];
+		totalBytes -= bytesFrom(victim, t.residentBase) - bytesFrom(victim, t.residentBase + 1);
+		t.residentBase++;
+		return true;
+	};
+
+	while (totalBytes > budgetBytes && evictOne(-1)) {
+	}
+
+	// Textures furthest from what they asked for go first, each gains at most one level per frame.
+	std::vector<int> wanting;
+	for (int i = 0; i < (int)textures.size(); i++) {
+		if (textures[i].requestedBase < textures[i].residentBase) {
+			wanting.push_back(i);
+		}
+	}
+	std::sort(wanting.begin(), wanting.end(), [&](int a, int b) {
+		return textures[a].residentBase - textures[a].requestedBase > textures[b].residentBase - textures[b].requestedBase;
+	});
+
+	size_t uploaded = 0;
+	for (int i : wanting) {
+		Texture& t = textures[i];
+		size_t cost = bytesFrom(i, t.residentBase - 1) - bytesFrom(i, t.residentBase);
+		if (uploaded + cost > maxUploadBytes && uploaded > 0) {
+			break;
+		}
+		while (totalBytes + cost > budgetBytes && evictOne(i)) {
+		}
+		if (totalBytes + cost > budgetBytes) {
+			continue;
+		}
+		t.residentBase--;
+		totalBytes += cost;
+		uploaded += cost;
+	}
+
+	for (int i = 0; i < (int)textures.size(); i++) {
+		if (textures[i].residentBase != oldBase[i]) {
+			changes.push_back({ i, oldBase[i], textures[i].residentBase });
+		}
+		textures[i].requestedBase = textures[i].floorBase;
+	}
+	frame++;
+	return changes;
+}
+
+float MipResidency::levelForDensity(int textureSize, float projectedPixels) {
+	if (projectedPixels <= 0.0f) {
+		return 1000.0f;
+	}
+	return std::log2((float)textureSize / projectedPixels);
+}
+
+float MipResidency::projectedSize(float radius, float distance, float focalPixels) {
+	if (distance <= radius) {
+		return 1e6f; // camera inside the bounds, needs full detail
+	}
+	return 2.0f * radius * focalPixels / distance;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Decides which mip levels of streamed textures should be resident. It has no GL dependency so the
+// decisions can be driven on the CPU, e.g. with a simulated camera path, and the results applied later.
+//
+// Every texture always keeps its low mips (at most minResidentSize texels on the largest side) resident.
+// Higher levels are requested each frame from the screen-space texel density of the objects using the
+// texture and are dropped again, least recently used first, when the total goes over the budget.
+class MipResidency
+{
+public:
+	// a texture whose resident base level changed this frame
+	struct Change {
+		int texture;
+		int oldBase;
+		int newBase;
+	};
+
+	MipResidency(size_t budgetBytes, int minResidentSize = 64, size_t maxUploadBytesPerFrame = 16 * 1024 * 1024);
+
+	//registers a texture and returns its index. It starts with only the low mips resident.
+	int add(int width, int height, int bytesPerTexel);
+	//asks for detail down to the given (fractional) mip level, the finest request of the frame wins
+	void request(int texture, float level);
+	//ends the frame and returns the base level changes to apply. Requests are cleared afterwards.
+	const std::vector<Change>& update();
+
+	int residentBase(int texture) const { return textures[texture].residentBase; }
+	int levels(int texture) const { return textures[texture].levels; }
+	size_t residentBytes() const { return totalBytes; }
+	size_t budget() const { return budgetBytes; }
+
+	//bytes used by levels base..levels-1 of a texture
+	size_t bytesFrom(int texture, int base) const;
+	//mip level at which one texel covers one pixel for a texture of the given size drawn
+	//across projectedPixels on screen (fractional, can be negative when magnified)
+	static float levelForDensity(int textureSize, float projectedPixels);
+	//on screen diameter in pixels of a sphere, focalPixels = viewportHeight / (2 * tan(fovY / 2))
+	static float projectedSize(float radius, float distance, float focalPixels);
+
+private:
+	struct Texture {
+		int width;
+		int height;
+		int bytesPerTexel;
+		int levels;
+		int floorBase; // first level that is always resident
+		int residentBase;
+		int requestedBase;
+		uint64_t lastUsed;
+	};
+
+	std::vector<Texture> textures;
+	std::vector<Change> changes;
+	size_t budgetBytes;
+	size_t maxUploadBytes;
+	size_t totalBytes;
+	int minResidentSize;
+	uint64_t frame;
+};
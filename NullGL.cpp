@@ -0,0 +1,384 @@
+#include "NullGL.h"
+
+#if NULL_GL
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Stub of any signature: does nothing, returns zero.
+template<typename P>
+struct NullStub;
+
+template<typename R, typename... A>
+struct NullStub<R (APIENTRYP)(A...)> {
+	static R APIENTRY call(A...) {
+		return R();
+	}
+};
+
+struct NullBuffer {
+	GLsizeiptr size = 0;
+	// only allocated once the buffer is mapped or read back
+	std::vector<char> storage;
+
+	char* data() {
+		if (storage.size() < (size_t)size) {
+			storage.resize((size_t)size);
+		}
+		return storage.data();
+	}
+};
+
+// every kind of object has its own names counting from 1, like a driver's, so replays get the captured names
+enum NullObject { NULL_BUFFER, NULL_TEXTURE, NULL_VERTEX_ARRAY, NULL_FRAMEBUFFER, NULL_RENDERBUFFER, NULL_SAMPLER, NULL_QUERY,
+	NULL_PIPELINE, NULL_TRANSFORM_FEEDBACK, NULL_SHADER_PROGRAM, NULL_OBJECT_KINDS };
+
+static GLuint nextNames[NULL_OBJECT_KINDS] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
+static uintptr_t nextSync = 1;
+static std::unordered_map<GLuint, NullBuffer> buffers;
+static std::unordered_map<GLenum, GLuint> boundBuffers;
+
+static NullBuffer* boundBuffer(GLenum target) {
+	auto bound = boundBuffers.find(target);
+	if (bound == boundBuffers.end() || bound->second == 0) {
+		return nullptr;
+	}
+	return &buffers[bound->second];
+}
+
+// ---------------------------------------------------------------------------------------------
+// names
+
+template<NullObject Kind>
+static void APIENTRY nullGenNames(GLsizei n, GLuint* names) {
+	for (GLsizei i = 0; i < n; i++) {
+		names[i] = nextNames[Kind]++;
+	}
+}
+
+template<NullObject Kind>
+static void APIENTRY nullCreateNames(GLenum, GLsizei n, GLuint* names) {
+	nullGenNames<Kind>(n, names);
+}
+
+// shaders and programs share their names
+static GLuint APIENTRY nullCreateProgram() {
+	return nextNames[NULL_SHADER_PROGRAM]++;
+}
+
+static GLuint APIENTRY nullCreateShader(GLenum) {
+	return nextNames[NULL_SHADER_PROGRAM]++;
+}
+
+// ---------------------------------------------------------------------------------------------
+// buffers
+
+static void APIENTRY nullBindBuffer(GLenum target, GLuint buffer) {
+	boundBuffers[target] = buffer;
+}
+
+static void APIENTRY nullBindBufferBase(GLenum target, GLuint, GLuint buffer) {
+	boundBuffers[target] = buffer;
+}
+
+static void APIENTRY nullBindBufferRange(GLenum target, GLuint, GLuint buffer, GLintptr, GLsizeiptr) {
+	boundBuffers[target] = buffer;
+}
+
+static void APIENTRY nullBufferData(GLenum target, GLsizeiptr size, const void*, GLenum) {
+	NullBuffer* buffer = boundBuffer(target);
+	if (buffer) {
+		buffer->size = size;
+		buffer->storage.clear();
+	}
+}
+
+static void APIENTRY nullBufferStorage(GLenum target, GLsizeiptr size, const void*, GLbitfield) {
+	nullBufferData(target, size, nullptr, 0);
+}
+
+static void APIENTRY nullNamedBufferData(GLuint buffer, GLsizeiptr size, const void*, GLenum) {
+	buffers[buffer].size = size;
+	buffers[buffer].storage.clear();
+}
+
+static void APIENTRY nullNamedBufferStorage(GLuint buffer, GLsizeiptr size, const void*, GLbitfield) {
+	nullNamedBufferData(buffer, size, nullptr, 0);
+}
+
+static void* APIENTRY nullMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr, GLbitfield) {
+	NullBuffer* buffer = boundBuffer(target);
+	return buffer ? buffer->data() + offset : nullptr;
+}
+
+static void* APIENTRY nullMapBuffer(GLenum target, GLenum) {
+	return nullMapBufferRange(target, 0, 0, 0);
+}
+
+static void* APIENTRY nullMapNamedBufferRange(GLuint buffer, GLintptr offset, GLsizeiptr, GLbitfield) {
+	return buffers[buffer].data() + offset;
+}
+
+static void* APIENTRY nullMapNamedBuffer(GLuint buffer, GLenum) {
+	return buffers[buffer].data();
+}
+
+static GLboolean APIENTRY nullUnmapBuffer(GLenum) {
+	return GL_TRUE;
+}
+
+static GLboolean APIENTRY nullUnmapNamedBuffer(GLuint) {
+	return GL_TRUE;
+}
+
+// what was written through a mapping reads back, anything the GPU would have written is zero
+static void APIENTRY nullGetBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, void* data) {
+	NullBuffer* buffer = boundBuffer(target);
+	if (buffer && offset + size <= buffer->size) {
+		memcpy(data, buffer->data() + offset, (size_t)size);
+	}
+	else {
+		memset(data, 0, (size_t)size);
+	}
+}
+
+static void APIENTRY nullDeleteBuffers(GLsizei n, const GLuint* names) {
+	for (GLsizei i = 0; i < n; i++) {
+		buffers.erase(names[i]);
+	}
+}
+
+// ---------------------------------------------------------------------------------------------
+// state queries
+
+static const GLubyte* APIENTRY nullGetString(GLenum name) {
+	if (name == GL_VERSION) {
+		return (const GLubyte*)"4.6.0 NullGL";
+	}
+	if (name == GL_RENDERER) {
+		return (const GLubyte*)"NullGL";
+	}
+	if (name == GL_VENDOR) {
+		return (const GLubyte*)"RockingEngine";
+	}
+	if (name == GL_SHADING_LANGUAGE_VERSION) {
+		return (const GLubyte*)"4.60";
+	}
+	return (const GLubyte*)"";
+}
+
+static const GLubyte* APIENTRY nullGetStringi(GLenum, GLuint) {
+	return (const GLubyte*)"";
+}
+
+static GLint64 integerState(GLenum name) {
+	switch (name) {
+	case GL_MAJOR_VERSION: return 4;
+	case GL_MINOR_VERSION: return 6;
+	case GL_CONTEXT_PROFILE_MASK: return GL_CONTEXT_CORE_PROFILE_BIT;
+	case GL_MAX_TEXTURE_SIZE: return 16384;
+	case GL_MAX_3D_TEXTURE_SIZE: return 2048;
+	case GL_MAX_ARRAY_TEXTURE_LAYERS: return 2048;
+	case GL_MAX_TEXTURE_IMAGE_UNITS: return 32;
+	case GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS: return 192;
+	case GL_MAX_VERTEX_ATTRIBS: return 16;
+	case GL_MAX_UNIFORM_BUFFER_BINDINGS: return 84;
+	case GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS: return 96;
+	case GL_MAX_IMAGE_UNITS: return 8;
+	case GL_MAX_DRAW_BUFFERS: return 8;
+	case GL_MAX_COLOR_ATTACHMENTS: return 8;
+	case GL_MAX_SAMPLES: return 8;
+	case GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS: return 1024;
+	case GL_MAX_UNIFORM_BLOCK_SIZE: return 65536;
+	case GL_MAX_SHADER_STORAGE_BLOCK_SIZE: return 1 << 27;
+	case GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT: return 256;
+	case GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT: return 16;
+	default: return 0;
+	}
+}
+
+static void APIENTRY nullGetIntegerv(GLenum name, GLint* data) {
+	*data = (GLint)integerState(name);
+}
+
+static void APIENTRY nullGetInteger64v(GLenum name, GLint64* data) {
+	*data = integerState(name);
+}
+
+static void APIENTRY nullGetFloatv(GLenum name, GLfloat* data) {
+	*data = name == GL_MAX_TEXTURE_MAX_ANISOTROPY ? 16.0f : (GLfloat)integerState(name);
+}
+
+static void APIENTRY nullGetBooleanv(GLenum name, GLboolean* data) {
+	*data = integerState(name) != 0 ? GL_TRUE : GL_FALSE;
+}
+
+// the layout a real driver copies into RGBA8 without converting
+static void APIENTRY nullGetInternalformativ(GLenum, GLenum, GLenum name, GLsizei count, GLint* params) {
+	if (count > 0) {
+		params[0] = name == GL_TEXTURE_IMAGE_FORMAT ? GL_RGBA : name == GL_TEXTURE_IMAGE_TYPE ? GL_UNSIGNED_BYTE : 0;
+	}
+}
+
+// ---------------------------------------------------------------------------------------------
+// shaders and programs, everything compiles and links
+
+static void APIENTRY nullGetObjectiv(GLuint, GLenum name, GLint* params) {
+	*params = name == GL_COMPILE_STATUS || name == GL_LINK_STATUS || name == GL_VALIDATE_STATUS ? GL_TRUE : 0;
+}
+
+static void APIENTRY nullGetInfoLog(GLuint, GLsizei size, GLsizei* length, GLchar* log) {
+	if (length) {
+		*length = 0;
+	}
+	if (size > 0) {
+		log[0] = '\0';
+	}
+}
+
+// the same name always gets the same location, one per name is plenty for the engine's shaders
+static GLint APIENTRY nullGetLocation(GLuint, const GLchar* name) {
+	uint32_t hash = 2166136261u;
+	for (; *name; name++) {
+		hash = (hash ^ (uint8_t)*name) * 16777619u;
+	}
+	return (GLint)(hash & 0x7FFF);
+}
+
+// ---------------------------------------------------------------------------------------------
+// syncs, queries and framebuffers
+
+static GLsync APIENTRY nullFenceSync(GLenum, GLbitfield) {
+	return (GLsync)nextSync++;
+}
+
+static GLenum APIENTRY nullClientWaitSync(GLsync, GLbitfield, GLuint64) {
+	return GL_ALREADY_SIGNALED;
+}
+
+static void APIENTRY nullGetSynciv(GLsync, GLenum name, GLsizei count, GLsizei* length, GLint* values) {
+	if (length) {
+		*length = count > 0 ? 1 : 0;
+	}
+	if (count > 0) {
+		values[0] = name == GL_SYNC_STATUS ? GL_SIGNALED : 0;
+	}
+}
+
+// results are always available and zero, nothing took any GPU time
+static void APIENTRY nullGetQueryObjectiv(GLuint, GLenum name, GLint* params) {
+	*params = name == GL_QUERY_RESULT_AVAILABLE ? 1 : 0;
+}
+
+static void APIENTRY nullGetQueryObjectuiv(GLuint, GLenum name, GLuint* params) {
+	*params = name == GL_QUERY_RESULT_AVAILABLE ? 1 : 0;
+}
+
+static void APIENTRY nullGetQueryObjecti64v(GLuint, GLenum name, GLint64* params) {
+	*params = name == GL_QUERY_RESULT_AVAILABLE ? 1 : 0;
+}
+
+static void APIENTRY nullGetQueryObjectui64v(GLuint, GLenum name, GLuint64* params) {
+	*params = name == GL_QUERY_RESULT_AVAILABLE ? 1 : 0;
+}
+
+static GLenum APIENTRY nullCheckFramebufferStatus(GLenum) {
+	return GL_FRAMEBUFFER_COMPLETE;
+}
+
+static GLenum APIENTRY nullCheckNamedFramebufferStatus(GLuint, GLenum) {
+	return GL_FRAMEBUFFER_COMPLETE;
+}
+
+// ---------------------------------------------------------------------------------------------
+
+// Each stub is stored as the exact type of the glad pointer it stands in for, so a mismatch doesn't compile.
+#define NULL_STUB(name, stub) { decltype(glad_##name) typed = stub; table[#name] = (void*)typed; }
+
+static std::unordered_map<std::string, void*> buildTable() {
+	std::unordered_map<std::string, void*> table;
+#define GL_FUNCTION(name) table[#name] = (void*)&NullStub<decltype(glad_##name)>::call;
+#include "GLFunctions.h"
+#undef GL_FUNCTION
+
+	NULL_STUB(glGenBuffers, nullGenNames<NULL_BUFFER>);
+	NULL_STUB(glGenTextures, nullGenNames<NULL_TEXTURE>);
+	NULL_STUB(glGenVertexArrays, nullGenNames<NULL_VERTEX_ARRAY>);
+	NULL_STUB(glGenFramebuffers, nullGenNames<NULL_FRAMEBUFFER>);
+	NULL_STUB(glGenRenderbuffers, nullGenNames<NULL_RENDERBUFFER>);
+	NULL_STUB(glGenSamplers, nullGenNames<NULL_SAMPLER>);
+	NULL_STUB(glGenQueries, nullGenNames<NULL_QUERY>);
+	NULL_STUB(glGenProgramPipelines, nullGenNames<NULL_PIPELINE>);
+	NULL_STUB(glGenTransformFeedbacks, nullGenNames<NULL_TRANSFORM_FEEDBACK>);
+	NULL_STUB(glCreateBuffers, nullGenNames<NULL_BUFFER>);
+	NULL_STUB(glCreateVertexArrays, nullGenNames<NULL_VERTEX_ARRAY>);
+	NULL_STUB(glCreateFramebuffers, nullGenNames<NULL_FRAMEBUFFER>);
+	NULL_STUB(glCreateRenderbuffers, nullGenNames<NULL_RENDERBUFFER>);
+	NULL_STUB(glCreateSamplers, nullGenNames<NULL_SAMPLER>);
+	NULL_STUB(glCreateProgramPipelines, nullGenNames<NULL_PIPELINE>);
+	NULL_STUB(glCreateTransformFeedbacks, nullGenNames<NULL_TRANSFORM_FEEDBACK>);
+	NULL_STUB(glCreateTextures, nullCreateNames<NULL_TEXTURE>);
+	NULL_STUB(glCreateQueries, nullCreateNames<NULL_QUERY>);
+	NULL_STUB(glCreateProgram, nullCreateProgram);
+	NULL_STUB(glCreateShader, nullCreateShader);
+
+	NULL_STUB(glBindBuffer, nullBindBuffer);
+	NULL_STUB(glBindBufferBase, nullBindBufferBase);
+	NULL_STUB(glBindBufferRange, nullBindBufferRange);
+	NULL_STUB(glBufferData, nullBufferData);
+	NULL_STUB(glBufferStorage, nullBufferStorage);
+	NULL_STUB(glNamedBufferData, nullNamedBufferData);
+	NULL_STUB(glNamedBufferStorage, nullNamedBufferStorage);
+	NULL_STUB(glMapBuffer, nullMapBuffer);
+	NULL_STUB(glMapBufferRange, nullMapBufferRange);
+	NULL_STUB(glMapNamedBuffer, nullMapNamedBuffer);
+	NULL_STUB(glMapNamedBufferRange, nullMapNamedBufferRange);
+	NULL_STUB(glUnmapBuffer, nullUnmapBuffer);
+	NULL_STUB(glUnmapNamedBuffer, nullUnmapNamedBuffer);
+	NULL_STUB(glGetBufferSubData, nullGetBufferSubData);
+	NULL_STUB(glDeleteBuffers, nullDeleteBuffers);
+
+	NULL_STUB(glGetString, nullGetString);
+	NULL_STUB(glGetStringi, nullGetStringi);
+	NULL_STUB(glGetIntegerv, nullGetIntegerv);
+	NULL_STUB(glGetInteger64v, nullGetInteger64v);
+	NULL_STUB(glGetFloatv, nullGetFloatv);
+	NULL_STUB(glGetBooleanv, nullGetBooleanv);
+	NULL_STUB(glGetInternalformativ, nullGetInternalformativ);
+
+	NULL_STUB(glGetShaderiv, nullGetObjectiv);
+	NULL_STUB(glGetProgramiv, nullGetObjectiv);
+	NULL_STUB(glGetShaderInfoLog, nullGetInfoLog);
+	NULL_STUB(glGetProgramInfoLog, nullGetInfoLog);
+	NULL_STUB(glGetUniformLocation, nullGetLocation);
+	NULL_STUB(glGetAttribLocation, nullGetLocation);
+
+	NULL_STUB(glFenceSync, nullFenceSync);
+	NULL_STUB(glClientWaitSync, nullClientWaitSync);
+	NULL_STUB(glGetSynciv, nullGetSynciv);
+	NULL_STUB(glGetQueryObjectiv, nullGetQueryObjectiv);
+	NULL_STUB(glGetQueryObjectuiv, nullGetQueryObjectuiv);
+	NULL_STUB(glGetQueryObjecti64v, nullGetQueryObjecti64v);
+	NULL_STUB(glGetQueryObjectui64v, nullGetQueryObjectui64v);
+	NULL_STUB(glCheckFramebufferStatus, nullCheckFramebufferStatus);
+	NULL_STUB(glCheckNamedFramebufferStatus, nullCheckNamedFramebufferStatus);
+	return table;
+}
+
+void* NullGL::getProcAddress(const char* name) {
+	static const std::unordered_map<std::string, void*> table = buildTable();
+	auto found = table.find(name);
+	return found != table.end() ? found->second : nullptr;
+}
+
+#else
+
+void* NullGL::getProcAddress(const char*) {
+	return nullptr;
+}
+
+#endif
@@ -0,0 +1,19 @@
+#pragma once
+
+// Build with NULL_GL=0 to leave the null backend out, getProcAddress then finds nothing.
+#ifndef NULL_GL
+#define NULL_GL 1
+#endif
+
+// GL without a driver. getProcAddress hands glad a stub for every function it loads, so gladLoadGLLoader works
+// with no context at all and the whole engine runs on top of it. Stubs return at once after the bookkeeping the
+// engine depends on: names from glGen* and glCreate*, buffer bindings and sizes so mapped writes and readbacks
+// land in memory, successful compiles, links and framebuffers, signalled syncs and available queries. Getters
+// report a GL 4.6 core context without extensions. Nothing is drawn, frame times are the engine's own CPU work.
+// Single threaded like the GL it stands in for.
+class NullGL
+{
+public:
+	//GLADloadproc, null for names glad doesn't know
+	static void* getProcAddress(const char* name);
+};
@@ -0,0 +1,127 @@
+#include "ParticleRenderer.h"
+#include "RenderStats.h"
+#include "Shader.h"
+#include "StateTracker.h"
+
+#include <algorithm>
+#include <iostream>
+
+static_assert(sizeof(ParticleInstance) == 16, "particle.vert reads 16 byte instances");
+
+ParticleRenderer::ParticleRenderer() : size(0.02f), stalls(0), program(0), viewLocation(-1), projectionLocation(-1), sizeLocation(-1), vao(0), buffer(0), mapped(nullptr), regionSize(0), region(0) {
+	for (GLsync& fence : fences) {
+		fence = 0;
+	}
+}
+
+bool ParticleRenderer::init(size_t maxParticles) {
+	release();
+	if (!GLAD_GL_VERSION_4_4) {
+		std::cout << "Particles need glBufferStorage (GL 4.4), they are not drawn." << std::endl;
+		return false;
+	}
+	program = Shader("particle.vert", "particle.frag").ID;
+	viewLocation = glGetUniformLocation(program, "view");
+	projectionLocation = glGetUniformLocation(program, "projection");
+	sizeLocation = glGetUniformLocation(program, "size");
+	regionSize = maxParticles;
+
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(1, &buffer);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	GLsizeiptr bytes = (GLsizeiptr)(REGIONS * regionSize * sizeof(ParticleInstance));
+	glBufferStorage(GL_ARRAY_BUFFER, bytes, NULL, flags);
+	mapped = (ParticleInstance*)glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, flags);
+	// stays mapped for the life of the buffer, coherent so writes need no flush before the draw
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), (void*)offsetof(ParticleInstance, x));
+	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ParticleInstance), (void*)offsetof(ParticleInstance, color));
+	glVertexAttribDivisor(0, 1);
+	glVertexAttribDivisor(1, 1);
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	if (!mapped) {
+		std::cout << "Failed to map the particle buffer." << std::endl;
+		release();
+		return false;
+	}
+	return true;
+}
+
+size_t ParticleRenderer::draw(const ParticleSystem& particles, const glm::mat4& view, const glm::mat4& projection, StateTracker& state, ThreadPool& pool) {
+	if (!mapped) {
+		return 0;
+	}
+	size_t count = std::min(particles.size(), regionSize);
+	region = (region + 1) % REGIONS;
+	if (fences[region]) {
+		// the GPU may still be reading what was written here three frames ago
+		GLenum result = glClientWaitSync(fences[region], 0, 0);
+		if (result == GL_TIMEOUT_EXPIRED) {
+			stalls++;
+			RENDER_STAT(FENCE_WAITS, 1);
+			glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+		}
+		glDeleteSync(fences[region]);
+		fences[region] = 0;
+	}
+	ParticleInstance* out = mapped + region * regionSize;
+	if (count == particles.size()) {
+		particles.writeInstances(out, pool);
+	}
+	else {
+		// more particles than room, the first regionSize are drawn
+		for (size_t i = 0; i < count; i++) {
+			out[i] = { particles.positionX[i], particles.positionY[i], particles.positionZ[i], particles.color[i] };
+		}
+	}
+
+	state.useProgram(program);
+	glUniformMatrix4fv(viewLocation, 1, GL_FALSE, &view[0][0]);
+	glUniformMatrix4fv(projectionLocation, 1, GL_FALSE, &projection[0][0]);
+	glUniform1f(sizeLocation, size);
+	RENDER_STAT(UNIFORM_UPLOADS, 3);
+	state.bindVertexArray(vao);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+	glDepthMask(GL_FALSE);
+	// base instance selects the region, the attributes keep pointing at the start of the buffer
+	glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)count, (GLuint)(region * regionSize));
+	RENDER_STAT(DRAW_CALLS, 1);
+	RENDER_STAT(INSTANCES, count);
+	RENDER_STAT(TRIANGLES, count * 2);
+	RENDER_STAT(BUFFER_BYTES, count * sizeof(ParticleInstance));
+	// written straight into mapped memory, but the same bytes cross to the GPU
+	glDepthMask(GL_TRUE);
+	glDisable(GL_BLEND);
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	return count;
+}
+
+void ParticleRenderer::release() {
+	for (GLsync& fence : fences) {
+		if (fence) {
+			glDeleteSync(fence);
+			fence = 0;
+		}
+	}
+	if (buffer) {
+		if (mapped) {
+			glBindBuffer(GL_ARRAY_BUFFER, buffer);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+		glDeleteBuffers(1, &buffer);
+	}
+	if (vao) {
+		glDeleteVertexArrays(1, &vao);
+	}
+	if (program) {
+		glDeleteProgram(program);
+	}
+	program = vao = buffer = 0;
+	mapped = nullptr;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "ParticleSystem.h"
+
+#include <cstddef>
+
+class StateTracker;
+class ThreadPool;
+
+// Draws a ParticleSystem as camera facing quads, one instance per particle. Instances are written straight into
+// a persistently mapped buffer (glBufferStorage, GL 4.4) split into three regions: the CPU fills one while the GPU
+// may still read the other two, a fence per region says when it can be reused. Nothing is copied by the driver.
+class ParticleRenderer
+{
+public:
+	ParticleRenderer();
+
+	//builds particle.vert/particle.frag and maps room for maxParticles per region, false without GL 4.4
+	bool init(size_t maxParticles);
+	//writes the live particles (up to maxParticles) into the next region and draws them additively, depth tested
+	//but not written. Returns how many were drawn.
+	size_t draw(const ParticleSystem& particles, const glm::mat4& view, const glm::mat4& projection, StateTracker& state, ThreadPool& pool);
+	//deletes the program, buffer and fences, must be called while the context is still alive
+	void release();
+
+	// half the quad's side in world units
+	float size;
+	// draws that had to wait for the GPU to finish with a region
+	size_t stalls;
+
+private:
+	static const int REGIONS = 3;
+
+	unsigned int program;
+	// uniform locations, looked up once by init()
+	int viewLocation, projectionLocation, sizeLocation;
+	unsigned int vao;
+	unsigned int buffer;
+	ParticleInstance* mapped;
+	size_t regionSize;
+	int region;
+	GLsync fences[REGIONS];
+};
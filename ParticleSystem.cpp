@@ -0,0 +1,235 @@
+#include "ParticleSystem.h"
+#include "CpuFeatures.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(SIMD_X86)
+#include <immintrin.h>
+#endif
+
+// particles per parallelFor job, each float stream of a block is 64 KB
+static const size_t PARTICLE_BLOCK = 16384;
+
+ParticleSystem::ParticleSystem(size_t capacity) : gravity(0.0f, -9.81f, 0.0f), drag(0.1f), count(0), maxCount(capacity), random(0x9E3779B9u) {
+	// padded to 8 so the kernels can always run whole vectors, the padding holds dead particles
+	size_t padded = (capacity + 7) / 8 * 8;
+	positionX.assign(padded, 0.0f);
+	positionY.assign(padded, 0.0f);
+	positionZ.assign(padded, 0.0f);
+	velocityX.assign(padded, 0.0f);
+	velocityY.assign(padded, 0.0f);
+	velocityZ.assign(padded, 0.0f);
+	life.assign(padded, 0.0f);
+	inverseLifetime.assign(padded, 0.0f);
+	color.assign(padded, 0);
+}
+
+size_t ParticleSystem::emit(const ParticleEmitter& emitter, size_t requested) {
+	size_t added = std::min(requested, maxCount - count);
+	for (size_t i = count; i < count + added; i++) {
+		// xorshift32, four random numbers in [-1, 1] per particle
+		float r[4];
+		for (float& value : r) {
+			random ^= random << 13;
+			random ^= random >> 17;
+			random ^= random << 5;
+			value = (random >> 8) * (2.0f / 16777216.0f) - 1.0f;
+		}
+		positionX[i] = emitter.position.x;
+		positionY[i] = emitter.position.y;
+		positionZ[i] = emitter.position.z;
+		velocityX[i] = emitter.velocity.x + r[0] * emitter.spread;
+		velocityY[i] = emitter.velocity.y + r[1] * emitter.spread;
+		velocityZ[i] = emitter.velocity.z + r[2] * emitter.spread;
+		float lifetime = emitter.lifetimeMin + (r[3] * 0.5f + 0.5f) * (emitter.lifetimeMax - emitter.lifetimeMin);
+		life[i] = lifetime;
+		inverseLifetime[i] = 1.0f / lifetime;
+		color[i] = emitter.color;
+	}
+	count += added;
+	return added;
+}
+
+// ---------------------------------------------------------------------------------------------
+// scalar reference paths
+
+static void updateBlockScalar(ParticleSystem& p, size_t begin, size_t end, float dt, float damping) {
+	for (size_t i = begin; i < end; i++) {
+		p.velocityX[i] = (p.velocityX[i] + p.gravity.x * dt) * damping;
+		p.velocityY[i] = (p.velocityY[i] + p.gravity.y * dt) * damping;
+		p.velocityZ[i] = (p.velocityZ[i] + p.gravity.z * dt) * damping;
+		p.positionX[i] += p.velocityX[i] * dt;
+		p.positionY[i] += p.velocityY[i] * dt;
+		p.positionZ[i] += p.velocityZ[i] * dt;
+		p.life[i] -= dt;
+		float alpha = std::min(std::max(p.life[i] * p.inverseLifetime[i], 0.0f), 1.0f);
+		p.color[i] = (p.color[i] & 0x00FFFFFF) | ((uint32_t)(int)(alpha * 255.0f + 0.5f) << 24);
+	}
+}
+
+static size_t firstDeadScalar(const float* life, size_t begin, size_t end) {
+	while (begin < end && life[begin] > 0.0f) {
+		begin++;
+	}
+	return begin;
+}
+
+void ParticleSystem::writeInstancesScalar(ParticleInstance* out) const {
+	for (size_t i = 0; i < count; i++) {
+		out[i].x = positionX[i];
+		out[i].y = positionY[i];
+		out[i].z = positionZ[i];
+		out[i].color = color[i];
+	}
+}
+
+// ---------------------------------------------------------------------------------------------
+// AVX2 paths, 8 particles per step
+
+#if defined(SIMD_X86)
+
+TARGET_AVX2 static void updateBlockAVX2(ParticleSystem& p, size_t begin, size_t end, float dt, float damping) {
+	const __m256 step = _mm256_set1_ps(dt);
+	const __m256 keep = _mm256_set1_ps(damping);
+	const __m256 gx = _mm256_set1_ps(p.gravity.x * dt), gy = _mm256_set1_ps(p.gravity.y * dt), gz = _mm256_set1_ps(p.gravity.z * dt);
+	const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), scale = _mm256_set1_ps(255.0f);
+	const __m256i rgb = _mm256_set1_epi32(0x00FFFFFF);
+	for (size_t i = begin; i < end; i += 8) {
+		__m256 vx = _mm256_mul_ps(_mm256_add_ps(_mm256_load_ps(&p.velocityX[i]), gx), keep);
+		__m256 vy = _mm256_mul_ps(_mm256_add_ps(_mm256_load_ps(&p.velocityY[i]), gy), keep);
+		__m256 vz = _mm256_mul_ps(_mm256_add_ps(_mm256_load_ps(&p.velocityZ[i]), gz), keep);
+		_mm256_store_ps(&p.velocityX[i], vx);
+		_mm256_store_ps(&p.velocityY[i], vy);
+		_mm256_store_ps(&p.velocityZ[i], vz);
+		_mm256_store_ps(&p.positionX[i], _mm256_add_ps(_mm256_load_ps(&p.positionX[i]), _mm256_mul_ps(vx, step)));
+		_mm256_store_ps(&p.positionY[i], _mm256_add_ps(_mm256_load_ps(&p.positionY[i]), _mm256_mul_ps(vy, step)));
+		_mm256_store_ps(&p.positionZ[i], _mm256_add_ps(_mm256_load_ps(&p.positionZ[i]), _mm256_mul_ps(vz, step)));
+		__m256 life = _mm256_sub_ps(_mm256_load_ps(&p.life[i]), step);
+		_mm256_store_ps(&p.life[i], life);
+		__m256 alpha = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(life, _mm256_load_ps(&p.inverseLifetime[i])), zero), one);
+		// cvtps rounds to nearest even where the scalar path rounds half up, they can differ by one step at exact halves
+		__m256i a = _mm256_slli_epi32(_mm256_cvtps_epi32(_mm256_mul_ps(alpha, scale)), 24);
+		__m256i c = _mm256_load_si256((const __m256i*)&p.color[i]);
+		_mm256_store_si256((__m256i*)&p.color[i], _mm256_or_si256(_mm256_and_si256(c, rgb), a));
+	}
+}
+
+TARGET_AVX2 static size_t firstDeadAVX2(const float* life, size_t begin, size_t end) {
+	const __m256 zero = _mm256_setzero_ps();
+	// live particles are skipped 8 at a time
+	while (begin + 8 <= end && _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(life + begin), zero, _CMP_LE_OQ)) == 0) {
+		begin += 8;
+	}
+	return firstDeadScalar(life, begin, end);
+}
+
+// 4x8 transpose: eight particles' x, y, z and color become eight 16 byte instances
+TARGET_AVX2 static void writeInstancesAVX2(const ParticleSystem& p, ParticleInstance* out, size_t begin, size_t end) {
+	size_t i = begin;
+	for (; i + 8 <= end; i += 8) {
+		__m256 x = _mm256_load_ps(&p.positionX[i]);
+		__m256 y = _mm256_load_ps(&p.positionY[i]);
+		__m256 z = _mm256_load_ps(&p.positionZ[i]);
+		__m256 c = _mm256_castsi256_ps(_mm256_load_si256((const __m256i*)&p.color[i]));
+		__m256 xy0 = _mm256_unpacklo_ps(x, y), xy1 = _mm256_unpackhi_ps(x, y);
+		__m256 zc0 = _mm256_unpacklo_ps(z, c), zc1 = _mm256_unpackhi_ps(z, c);
+		__m256 p04 = _mm256_shuffle_ps(xy0, zc0, 0x44), p15 = _mm256_shuffle_ps(xy0, zc0, 0xEE);
+		__m256 p26 = _mm256_shuffle_ps(xy1, zc1, 0x44), p37 = _mm256_shuffle_ps(xy1, zc1, 0xEE);
+		float* d = (float*)(out + i);
+		_mm256_storeu_ps(d, _mm256_permute2f128_ps(p04, p15, 0x20));
+		_mm256_storeu_ps(d + 8, _mm256_permute2f128_ps(p26, p37, 0x20));
+		_mm256_storeu_ps(d + 16, _mm256_permute2f128_ps(p04, p15, 0x31));
+		_mm256_storeu_ps(d + 24, _mm256_permute2f128_ps(p26, p37, 0x31));
+	}
+	for (; i < end; i++) {
+		out[i].x = p.positionX[i];
+		out[i].y = p.positionY[i];
+		out[i].z = p.positionZ[i];
+		out[i].color = p.color[i];
+	}
+}
+
+#endif
+
+// ---------------------------------------------------------------------------------------------
+
+void ParticleSystem::compact() {
+#if defined(SIMD_X86)
+	bool avx2 = cpuFeatures().avx2;
+#endif
+	size_t i = 0;
+	while (true) {
+#if defined(SIMD_X86)
+		i = avx2 ? firstDeadAVX2(life.data(), i, count) : firstDeadScalar(life.data(), i, count);
+#else
+		i = firstDeadScalar(life.data(), i, count);
+#endif
+		if (i >= count) {
+			break;
+		}
+		// fill the hole with the last live particle, dead ones at the end are just dropped
+		size_t last = count - 1;
+		while (last > i && life[last] <= 0.0f) {
+			last--;
+		}
+		if (last > i) {
+			positionX[i] = positionX[last];
+			positionY[i] = positionY[last];
+			positionZ[i] = positionZ[last];
+			velocityX[i] = velocityX[last];
+			velocityY[i] = velocityY[last];
+			velocityZ[i] = velocityZ[last];
+			life[i] = life[last];
+			inverseLifetime[i] = inverseLifetime[last];
+			color[i] = color[last];
+		}
+		count = last;
+		i++;
+	}
+}
+
+void ParticleSystem::update(float dt, ThreadPool& pool) {
+	float damping = std::max(0.0f, 1.0f - drag * dt);
+	size_t blocks = (count + PARTICLE_BLOCK - 1) / PARTICLE_BLOCK;
+	pool.parallelFor(blocks, [&](size_t block) {
+		size_t begin = block * PARTICLE_BLOCK;
+		// the last block runs up to the padding, whole vectors only
+		size_t end = std::min(begin + PARTICLE_BLOCK, (count + 7) / 8 * 8);
+#if defined(SIMD_X86)
+		if (cpuFeatures().avx2) {
+			updateBlockAVX2(*this, begin, end, dt, damping);
+			return;
+		}
+#endif
+		updateBlockScalar(*this, begin, end, dt, damping);
+	});
+	compact();
+}
+
+void ParticleSystem::updateScalar(float dt) {
+	updateBlockScalar(*this, 0, count, dt, std::max(0.0f, 1.0f - drag * dt));
+	// the same removal as update(), so both leave the same particles in the same slots
+	compact();
+}
+
+void ParticleSystem::writeInstances(ParticleInstance* out, ThreadPool& pool) const {
+	size_t blocks = (count + PARTICLE_BLOCK - 1) / PARTICLE_BLOCK;
+	pool.parallelFor(blocks, [&](size_t block) {
+		size_t begin = block * PARTICLE_BLOCK;
+		size_t end = std::min(begin + PARTICLE_BLOCK, count);
+#if defined(SIMD_X86)
+		if (cpuFeatures().avx2) {
+			writeInstancesAVX2(*this, out, begin, end);
+			return;
+		}
+#endif
+		for (size_t i = begin; i < end; i++) {
+			out[i].x = positionX[i];
+			out[i].y = positionY[i];
+			out[i].z = positionZ[i];
+			out[i].color = color[i];
+		}
+	});
+}
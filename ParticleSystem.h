@@ -0,0 +1,68 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "AlignedAllocator.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Where and how new particles start.
+struct ParticleEmitter {
+	glm::vec3 position = glm::vec3(0.0f);
+	glm::vec3 velocity = glm::vec3(0.0f, 1.0f, 0.0f);
+	// random velocity added in every direction
+	float spread = 0.5f;
+	float lifetimeMin = 1.0f;
+	float lifetimeMax = 2.0f;
+	// RGBA8, red in the low byte. Alpha is replaced by the remaining life.
+	uint32_t color = 0xFFFFFFFF;
+};
+
+// Interleaved per instance data the particle shader reads, 16 bytes.
+struct ParticleInstance {
+	float x, y, z;
+	uint32_t color;
+};
+
+// Particles stored as one aligned array per component. The update runs AVX2 kernels (scalar fallbacks kept public
+// as the reference) over blocks of particles on the thread pool. Dead particles are removed by moving the last
+// live particle into their slot, so the live range stays packed and nothing is allocated after construction.
+class ParticleSystem
+{
+public:
+	explicit ParticleSystem(size_t capacity);
+
+	//adds up to count particles, returns how many fit
+	size_t emit(const ParticleEmitter& emitter, size_t count);
+	//integrates velocities and positions, fades alpha with the remaining life and removes dead particles
+	void update(float dt, ThreadPool& pool);
+	void updateScalar(float dt);
+	//interleaves position and color of the live particles into out, which must hold size() instances
+	void writeInstances(ParticleInstance* out, ThreadPool& pool) const;
+	void writeInstancesScalar(ParticleInstance* out) const;
+	void clear() { count = 0; }
+
+	size_t size() const { return count; }
+	size_t capacity() const { return maxCount; }
+
+	glm::vec3 gravity;
+	// fraction of velocity lost per second
+	float drag;
+
+	std::vector<float, AlignedAllocator<float>> positionX, positionY, positionZ;
+	std::vector<float, AlignedAllocator<float>> velocityX, velocityY, velocityZ;
+	// seconds left, and one over the lifetime the particle started with
+	std::vector<float, AlignedAllocator<float>> life, inverseLifetime;
+	std::vector<uint32_t, AlignedAllocator<uint32_t>> color;
+
+private:
+	void compact();
+
+	size_t count;
+	size_t maxCount;
+	uint32_t random;
+};
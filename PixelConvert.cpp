@@ -0,0 +1,567 @@
+#include "PixelConvert.h"
+#include "CpuFeatures.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(SIMD_X86)
+#include <immintrin.h>
+#endif
+
+// ---------------------------------------------------------------------------------------------
+// scalar reference paths
+
+void expandRGBToRGBAScalar(const unsigned char* rgb, unsigned char* rgba, size_t pixels) {
+	for (size_t i = 0; i < pixels; i++) {
+		rgba[i * 4 + 0] = rgb[i * 3 + 0];
+		rgba[i * 4 + 1] = rgb[i * 3 + 1];
+		rgba[i * 4 + 2] = rgb[i * 3 + 2];
+		rgba[i * 4 + 3] = 255;
+	}
+}
+
+void swizzleRGBAToBGRAScalar(unsigned char* pixels, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		std::swap(pixels[i * 4 + 0], pixels[i * 4 + 2]);
+	}
+}
+
+// exact round(x * a / 255) for x, a in [0, 255]
+static inline unsigned int mulDiv255(unsigned int x, unsigned int a) {
+	unsigned int t = x * a + 128;
+	return (t + (t >> 8)) >> 8;
+}
+
+void premultiplyAlphaScalar(unsigned char* rgba, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		unsigned int a = rgba[i * 4 + 3];
+		rgba[i * 4 + 0] = (unsigned char)mulDiv255(rgba[i * 4 + 0], a);
+		rgba[i * 4 + 1] = (unsigned char)mulDiv255(rgba[i * 4 + 1], a);
+		rgba[i * 4 + 2] = (unsigned char)mulDiv255(rgba[i * 4 + 2], a);
+	}
+}
+
+void flipVerticalScalar(unsigned char* data, size_t rowBytes, int rows) {
+	for (int y = 0; y < rows / 2; y++) {
+		unsigned char* top = data + (size_t)y * rowBytes;
+		unsigned char* bottom = data + (size_t)(rows - 1 - y) * rowBytes;
+		for (size_t i = 0; i < rowBytes; i++) {
+			std::swap(top[i], bottom[i]);
+		}
+	}
+}
+
+// Rounds to nearest even like F16C and GL drivers do. glm::packHalf1x16 rounds ties up, so an HDR value
+// halfway between two halves (4242.0f) came out one step higher than on the F16C path.
+static uint16_t floatToHalf(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t magnitude = bits & 0x7FFFFFFF;
+	if (magnitude > 0x7F800000) {
+		// NaN stays NaN, quiet, with the top of its payload
+		return (uint16_t)(sign | 0x7E00 | ((magnitude >> 13) & 0x3FF));
+	}
+	if (magnitude >= 0x47800000) {
+		// 65536 and up, infinity included
+		return (uint16_t)(sign | 0x7C00);
+	}
+	if (magnitude < 0x38800000) {
+		// below 2^-14 the half is denormal, counted in steps of 2^-24. 2^-25 and less round to zero.
+		if (magnitude < 0x33000001) {
+			return (uint16_t)sign;
+		}
+		uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+		uint32_t shift = 126 - (magnitude >> 23);
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t tie = 1u << (shift - 1);
+		half += rest > tie || (rest == tie && (half & 1));
+		return (uint16_t)(sign | half);
+	}
+	// rebias the exponent from 127 to 15, a carry out of the mantissa bumps the exponent and ends at infinity
+	uint32_t half = (magnitude - 0x38000000) >> 13;
+	uint32_t rest = magnitude & 0x1FFF;
+	half += rest > 0x1000 || (rest == 0x1000 && (half & 1));
+	return (uint16_t)(sign | half);
+}
+
+void packHalfScalar(const float* src, uint16_t* dst, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		dst[i] = floatToHalf(src[i]);
+	}
+}
+
+// EXT_texture_shared_exponent packing. glm::packF3x9_E1x5 clamps at 2^15 instead of the format's
+// largest value 65408 and goes through pow/log2, so the exponent is taken from the float bits here.
+void packRGB9E5Scalar(const float* rgb, uint32_t* dst, size_t pixels) {
+	for (size_t i = 0; i < pixels; i++) {
+		float c[3];
+		for (int k = 0; k < 3; k++) {
+			float v = rgb[i * 3 + k];
+			c[k] = v > 0.0f ? std::min(v, 65408.0f) : 0.0f; // also turns NaN into 0
+		}
+		float maxColor = std::max(c[0], std::max(c[1], c[2]));
+		int exponent;
+		std::frexp(maxColor, &exponent); // maxColor = m * 2^exponent with m in [0.5, 1)
+		int shared = maxColor > 0.0f ? std::max(exponent - 1, -16) + 16 : 0;
+		if ((int)(std::ldexp(maxColor, 24 - shared) + 0.5f) == 512) {
+			shared++;
+		}
+		uint32_t packed = (uint32_t)shared << 27;
+		for (int k = 0; k < 3; k++) {
+			packed |= (uint32_t)(std::ldexp(c[k], 24 - shared) + 0.5f) << (9 * k);
+		}
+		dst[i] = packed;
+	}
+}
+
+// BT.601 limited range with 8 bit fixed point coefficients, the SSE path computes exactly the same
+static inline unsigned char lumaBT601(int r, int g, int b) {
+	return (unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+static inline unsigned char chromaU(int r, int g, int b) {
+	return (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+static inline unsigned char chromaV(int r, int g, int b) {
+	return (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+// one row of chroma from columns x0 on, yBottom is null when top is the last row and bottom repeats it
+static void convertRowPairToYUV420(const unsigned char* top, const unsigned char* bottom, int width, int x0, unsigned char* yTop, unsigned char* yBottom,
+	unsigned char* u, unsigned char* v) {
+	for (int x = x0; x < width; x += 2) {
+		int x1 = std::min(x + 1, width - 1);
+		const unsigned char* p00 = top + x * 4;
+		const unsigned char* p01 = top + x1 * 4;
+		const unsigned char* p10 = bottom + x * 4;
+		const unsigned char* p11 = bottom + x1 * 4;
+		yTop[x] = lumaBT601(p00[0], p00[1], p00[2]);
+		yTop[x1] = lumaBT601(p01[0], p01[1], p01[2]);
+		if (yBottom) {
+			yBottom[x] = lumaBT601(p10[0], p10[1], p10[2]);
+			yBottom[x1] = lumaBT601(p11[0], p11[1], p11[2]);
+		}
+		int r = (p00[0] + p01[0] + p10[0] + p11[0] + 2) >> 2;
+		int g = (p00[1] + p01[1] + p10[1] + p11[1] + 2) >> 2;
+		int b = (p00[2] + p01[2] + p10[2] + p11[2] + 2) >> 2;
+		u[x / 2] = chromaU(r, g, b);
+		v[x / 2] = chromaV(r, g, b);
+	}
+}
+
+void convertRGBAToYUV420Scalar(const unsigned char* rgba, ptrdiff_t rowStride, int width, int height, unsigned char* y, unsigned char* u, unsigned char* v) {
+	int chromaWidth = (width + 1) / 2;
+	for (int row = 0; row < height; row += 2) {
+		const unsigned char* top = rgba + row * rowStride;
+		bool pair = row + 1 < height;
+		unsigned char* yTop = y + (size_t)row * width;
+		convertRowPairToYUV420(top, pair ? top + rowStride : top, width, 0, yTop, pair ? yTop + width : nullptr,
+			u + (size_t)(row / 2) * chromaWidth, v + (size_t)(row / 2) * chromaWidth);
+	}
+}
+
+// ---------------------------------------------------------------------------------------------
+// sRGB tables
+
+static const int ENCODE_TABLE_SIZE = 4096;
+
+static float srgbToLinear(float c) {
+	return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linearToSrgb(float c) {
+	return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+// tables are filled on first use, the static initialisation makes that thread safe
+static const float* decodeTable() {
+	static float table[256];
+	static const bool built = [] {
+		for (int i = 0; i < 256; i++) {
+			table[i] = srgbToLinear(i / 255.0f);
+		}
+		return true;
+	}();
+	(void)built;
+	return table;
+}
+
+static const unsigned char* encodeTable() {
+	static unsigned char table[ENCODE_TABLE_SIZE];
+	static const bool built = [] {
+		for (int i = 0; i < ENCODE_TABLE_SIZE; i++) {
+			// sample the middle of each bucket
+			float linear = (i + 0.5f) / ENCODE_TABLE_SIZE;
+			table[i] = (unsigned char)std::lround(linearToSrgb(linear) * 255.0f);
+		}
+		table[0] = 0;
+		table[ENCODE_TABLE_SIZE - 1] = 255;
+		return true;
+	}();
+	(void)built;
+	return table;
+}
+
+// the encode table widened to 32 bits, the entries a gather loads
+static const uint32_t* encodeTable32() {
+	static uint32_t table[ENCODE_TABLE_SIZE];
+	static const bool built = [] {
+		const unsigned char* bytes = encodeTable();
+		for (int i = 0; i < ENCODE_TABLE_SIZE; i++) {
+			table[i] = bytes[i];
+		}
+		return true;
+	}();
+	(void)built;
+	return table;
+}
+
+void decodeSRGBScalar(const unsigned char* srgb, float* linear, size_t count) {
+	const float* table = decodeTable();
+	for (size_t i = 0; i < count; i++) {
+		linear[i] = table[srgb[i]];
+	}
+}
+
+void encodeSRGBScalar(const float* linear, unsigned char* srgb, size_t count) {
+	const unsigned char* table = encodeTable();
+	for (size_t i = 0; i < count; i++) {
+		// NaN fails the comparison and becomes 0, as in the SIMD paths
+		float c = linear[i] > 0.0f ? std::min(linear[i], 1.0f) : 0.0f;
+		srgb[i] = table[(int)(c * (ENCODE_TABLE_SIZE - 1))];
+	}
+}
+
+// ---------------------------------------------------------------------------------------------
+// SSE paths
+
+#if defined(SIMD_X86)
+
+TARGET_SSSE3 static void expandRGBToRGBASSSE3(const unsigned char* rgb, unsigned char* rgba, size_t pixels) {
+	const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+	size_t i = 0;
+	// 16 pixels per step: three 16 byte loads hold exactly 48 bytes of RGB
+	for (; i + 16 <= pixels; i += 16) {
+		const unsigned char* s = rgb + i * 3;
+		__m128i a = _mm_loadu_si128((const __m128i*)s);
+		__m128i b = _mm_loadu_si128((const __m128i*)(s + 16));
+		__m128i c = _mm_loadu_si128((const __m128i*)(s + 32));
+		__m128i p0 = _mm_shuffle_epi8(a, shuffle);
+		__m128i p1 = _mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), shuffle);
+		__m128i p2 = _mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), shuffle);
+		__m128i p3 = _mm_shuffle_epi8(_mm_srli_si128(c, 4), shuffle);
+		unsigned char* d = rgba + i * 4;
+		_mm_storeu_si128((__m128i*)d, _mm_or_si128(p0, alpha));
+		_mm_storeu_si128((__m128i*)(d + 16), _mm_or_si128(p1, alpha));
+		_mm_storeu_si128((__m128i*)(d + 32), _mm_or_si128(p2, alpha));
+		_mm_storeu_si128((__m128i*)(d + 48), _mm_or_si128(p3, alpha));
+	}
+	expandRGBToRGBAScalar(rgb + i * 3, rgba + i * 4, pixels - i);
+}
+
+TARGET_SSSE3 static void swizzleRGBAToBGRASSSE3(unsigned char* pixels, size_t count) {
+	const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i p = _mm_loadu_si128((const __m128i*)(pixels + i * 4));
+		_mm_storeu_si128((__m128i*)(pixels + i * 4), _mm_shuffle_epi8(p, shuffle));
+	}
+	swizzleRGBAToBGRAScalar(pixels + i * 4, count - i);
+}
+
+// mulDiv255 on eight 16 bit lanes
+TARGET_SSE2 static inline __m128i mulDiv255x8(__m128i x, __m128i a) {
+	__m128i t = _mm_add_epi16(_mm_mullo_epi16(x, a), _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+TARGET_SSE2 static void premultiplyAlphaSSE2(unsigned char* rgba, size_t count) {
+	const __m128i zero = _mm_setzero_si128();
+	// alpha lanes are multiplied by 255 so they come out unchanged
+	const __m128i alphaLanes = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+	const __m128i colorLanes = _mm_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i p = _mm_loadu_si128((const __m128i*)(rgba + i * 4));
+		__m128i lo = _mm_unpacklo_epi8(p, zero);
+		__m128i hi = _mm_unpackhi_epi8(p, zero);
+		__m128i alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xFF), 0xFF);
+		__m128i ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xFF), 0xFF);
+		alo = _mm_or_si128(_mm_and_si128(alo, colorLanes), alphaLanes);
+		ahi = _mm_or_si128(_mm_and_si128(ahi, colorLanes), alphaLanes);
+		lo = mulDiv255x8(lo, alo);
+		hi = mulDiv255x8(hi, ahi);
+		_mm_storeu_si128((__m128i*)(rgba + i * 4), _mm_packus_epi16(lo, hi));
+	}
+	premultiplyAlphaScalar(rgba + i * 4, count - i);
+}
+
+TARGET_SSE2 static void flipVerticalSSE2(unsigned char* data, size_t rowBytes, int rows) {
+	for (int y = 0; y < rows / 2; y++) {
+		unsigned char* top = data + (size_t)y * rowBytes;
+		unsigned char* bottom = data + (size_t)(rows - 1 - y) * rowBytes;
+		size_t i = 0;
+		for (; i + 64 <= rowBytes; i += 64) {
+			__m128i t0 = _mm_loadu_si128((const __m128i*)(top + i));
+			__m128i t1 = _mm_loadu_si128((const __m128i*)(top + i + 16));
+			__m128i t2 = _mm_loadu_si128((const __m128i*)(top + i + 32));
+			__m128i t3 = _mm_loadu_si128((const __m128i*)(top + i + 48));
+			__m128i b0 = _mm_loadu_si128((const __m128i*)(bottom + i));
+			__m128i b1 = _mm_loadu_si128((const __m128i*)(bottom + i + 16));
+			__m128i b2 = _mm_loadu_si128((const __m128i*)(bottom + i + 32));
+			__m128i b3 = _mm_loadu_si128((const __m128i*)(bottom + i + 48));
+			_mm_storeu_si128((__m128i*)(top + i), b0);
+			_mm_storeu_si128((__m128i*)(top + i + 16), b1);
+			_mm_storeu_si128((__m128i*)(top + i + 32), b2);
+			_mm_storeu_si128((__m128i*)(top + i + 48), b3);
+			_mm_storeu_si128((__m128i*)(bottom + i), t0);
+			_mm_storeu_si128((__m128i*)(bottom + i + 16), t1);
+			_mm_storeu_si128((__m128i*)(bottom + i + 32), t2);
+			_mm_storeu_si128((__m128i*)(bottom + i + 48), t3);
+		}
+		for (; i < rowBytes; i++) {
+			std::swap(top[i], bottom[i]);
+		}
+	}
+}
+
+TARGET_AVX2 static void decodeSRGBAVX2(const unsigned char* srgb, float* linear, size_t count) {
+	const float* table = decodeTable();
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(srgb + i)));
+		_mm256_storeu_ps(linear + i, _mm256_i32gather_ps(table, index, 4));
+	}
+	decodeSRGBScalar(srgb + i, linear + i, count - i);
+}
+
+TARGET_AVX2 static void encodeSRGBAVX2(const float* linear, unsigned char* srgb, size_t count) {
+	const int* table = (const int*)encodeTable32();
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 scale = _mm256_set1_ps((float)(ENCODE_TABLE_SIZE - 1));
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 c = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(linear + i), zero), one);
+		__m256i encoded = _mm256_i32gather_epi32(table, _mm256_cvttps_epi32(_mm256_mul_ps(c, scale)), 4);
+		__m128i words = _mm_packus_epi32(_mm256_castsi256_si128(encoded), _mm256_extracti128_si256(encoded, 1));
+		_mm_storel_epi64((__m128i*)(srgb + i), _mm_packus_epi16(words, words));
+	}
+	encodeSRGBScalar(linear + i, srgb + i, count - i);
+}
+
+TARGET_F16C static void packHalfF16C(const float* src, uint16_t* dst, size_t count) {
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+		_mm_storeu_si128((__m128i*)(dst + i), h);
+	}
+	packHalfScalar(src + i, dst + i, count - i);
+}
+
+// 2^e for integer e in the normal float range, built straight from the exponent bits
+TARGET_SSE2 static inline __m128 exp2i(__m128i e) {
+	return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(e, _mm_set1_epi32(127)), 23));
+}
+
+// Shared exponent packing from EXT_texture_shared_exponent on four pixels at a time.
+// log2 and pow are replaced by exponent bit manipulation, which is exact for powers of two.
+TARGET_SSE2 static void packRGB9E5SSE2(const float* rgb, uint32_t* dst, size_t pixels) {
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 maxValue = _mm_set1_ps(65408.0f); // 511 / 512 * 2^16
+	const __m128 half = _mm_set1_ps(0.5f);
+	size_t i = 0;
+	for (; i + 4 <= pixels; i += 4) {
+		const float* p = rgb + i * 3;
+		// max(x, 0) also turns NaN into 0
+		__m128 r = _mm_min_ps(_mm_max_ps(_mm_setr_ps(p[0], p[3], p[6], p[9]), zero), maxValue);
+		__m128 g = _mm_min_ps(_mm_max_ps(_mm_setr_ps(p[1], p[4], p[7], p[10]), zero), maxValue);
+		__m128 b = _mm_min_ps(_mm_max_ps(_mm_setr_ps(p[2], p[5], p[8], p[11]), zero), maxValue);
+		__m128 maxColor = _mm_max_ps(r, _mm_max_ps(g, b));
+
+		// floor(log2(maxColor)) is the unbiased exponent, clamped to -16 like glm (zero ends up there too)
+		__m128i exponent = _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(maxColor), 23), _mm_set1_epi32(127));
+		__m128i lowest = _mm_set1_epi32(-16);
+		exponent = _mm_or_si128(_mm_and_si128(_mm_cmpgt_epi32(exponent, lowest), exponent), _mm_andnot_si128(_mm_cmpgt_epi32(exponent, lowest), lowest));
+		__m128i shared = _mm_add_epi32(exponent, _mm_set1_epi32(16));
+
+		// rounding the largest channel up to 512 needs one more exponent step
+		__m128 scale = exp2i(_mm_sub_epi32(_mm_set1_epi32(24), shared));
+		__m128i maxMantissa = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(maxColor, scale), half));
+		__m128i overflow = _mm_cmpeq_epi32(maxMantissa, _mm_set1_epi32(512));
+		shared = _mm_sub_epi32(shared, overflow);
+		scale = exp2i(_mm_sub_epi32(_mm_set1_epi32(24), shared));
+
+		__m128i ri = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(r, scale), half));
+		__m128i gi = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(g, scale), half));
+		__m128i bi = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(b, scale), half));
+		__m128i packed = _mm_or_si128(_mm_or_si128(ri, _mm_slli_epi32(gi, 9)), _mm_or_si128(_mm_slli_epi32(bi, 18), _mm_slli_epi32(shared, 27)));
+		_mm_storeu_si128((__m128i*)(dst + i), packed);
+	}
+	packRGB9E5Scalar(rgb + i * 3, dst + i, pixels - i);
+}
+
+// eight RGBA pixels to 16 bit lanes of each channel
+TARGET_SSE2 static inline void splitRGBA(const unsigned char* p, __m128i& r, __m128i& g, __m128i& b) {
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	__m128i a = _mm_loadu_si128((const __m128i*)p);
+	__m128i c = _mm_loadu_si128((const __m128i*)(p + 16));
+	r = _mm_packs_epi32(_mm_and_si128(a, mask), _mm_and_si128(c, mask));
+	g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(a, 8), mask), _mm_and_si128(_mm_srli_epi32(c, 8), mask));
+	b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(a, 16), mask), _mm_and_si128(_mm_srli_epi32(c, 16), mask));
+}
+
+// the sum reaches 56228, past int16 but within 16 bits unsigned, so the shift is logical
+TARGET_SSE2 static inline __m128i lumaBT601x8(__m128i r, __m128i g, __m128i b) {
+	__m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)), _mm_mullo_epi16(g, _mm_set1_epi16(129))),
+		_mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(25)), _mm_set1_epi16(128)));
+	return _mm_add_epi16(_mm_srli_epi16(sum, 8), _mm_set1_epi16(16));
+}
+
+// chroma sums stay within +-28688, signed 16 bits with an arithmetic shift
+TARGET_SSE2 static inline __m128i chromaBT601x8(__m128i r, __m128i g, __m128i b, short cr, short cg, short cb) {
+	__m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(cr)), _mm_mullo_epi16(g, _mm_set1_epi16(cg))),
+		_mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(cb)), _mm_set1_epi16(128)));
+	return _mm_add_epi16(_mm_srai_epi16(sum, 8), _mm_set1_epi16(128));
+}
+
+// rounded averages of 2x2 blocks from the column sums of sixteen pixels, eight lanes out
+TARGET_SSE2 static inline __m128i average2x2(__m128i left, __m128i right) {
+	const __m128i ones = _mm_set1_epi16(1);
+	__m128i sums = _mm_packs_epi32(_mm_madd_epi16(left, ones), _mm_madd_epi16(right, ones));
+	return _mm_srli_epi16(_mm_add_epi16(sums, _mm_set1_epi16(2)), 2);
+}
+
+// sixteen columns of two rows at a time, the columns left over go through the scalar row
+TARGET_SSE2 static void convertRGBAToYUV420SSE2(const unsigned char* rgba, ptrdiff_t rowStride, int width, int height, unsigned char* y, unsigned char* u, unsigned char* v) {
+	int chromaWidth = (width + 1) / 2;
+	for (int row = 0; row < height; row += 2) {
+		const unsigned char* top = rgba + row * rowStride;
+		bool pair = row + 1 < height;
+		const unsigned char* bottom = pair ? top + rowStride : top;
+		unsigned char* yTop = y + (size_t)row * width;
+		unsigned char* yBottom = pair ? yTop + width : nullptr;
+		unsigned char* uRow = u + (size_t)(row / 2) * chromaWidth;
+		unsigned char* vRow = v + (size_t)(row / 2) * chromaWidth;
+		int x = 0;
+		for (; x + 16 <= width; x += 16) {
+			__m128i r0, g0, b0, r1, g1, b1, r2, g2, b2, r3, g3, b3;
+			splitRGBA(top + x * 4, r0, g0, b0);
+			splitRGBA(top + x * 4 + 32, r1, g1, b1);
+			splitRGBA(bottom + x * 4, r2, g2, b2);
+			splitRGBA(bottom + x * 4 + 32, r3, g3, b3);
+			_mm_storeu_si128((__m128i*)(yTop + x), _mm_packus_epi16(lumaBT601x8(r0, g0, b0), lumaBT601x8(r1, g1, b1)));
+			if (yBottom) {
+				_mm_storeu_si128((__m128i*)(yBottom + x), _mm_packus_epi16(lumaBT601x8(r2, g2, b2), lumaBT601x8(r3, g3, b3)));
+			}
+			__m128i r = average2x2(_mm_add_epi16(r0, r2), _mm_add_epi16(r1, r3));
+			__m128i g = average2x2(_mm_add_epi16(g0, g2), _mm_add_epi16(g1, g3));
+			__m128i b = average2x2(_mm_add_epi16(b0, b2), _mm_add_epi16(b1, b3));
+			__m128i cu = chromaBT601x8(r, g, b, -38, -74, 112);
+			__m128i cv = chromaBT601x8(r, g, b, 112, -94, -18);
+			_mm_storel_epi64((__m128i*)(uRow + x / 2), _mm_packus_epi16(cu, cu));
+			_mm_storel_epi64((__m128i*)(vRow + x / 2), _mm_packus_epi16(cv, cv));
+		}
+		convertRowPairToYUV420(top, bottom, width, x, yTop, yBottom, uRow, vRow);
+	}
+}
+
+#endif
+
+// ---------------------------------------------------------------------------------------------
+// dispatch
+
+void expandRGBToRGBA(const unsigned char* rgb, unsigned char* rgba, size_t pixels) {
+#if defined(SIMD_X86)
+	if (cpuFeatures().ssse3) {
+		expandRGBToRGBASSSE3(rgb, rgba, pixels);
+		return;
+	}
+#endif
+	expandRGBToRGBAScalar(rgb, rgba, pixels);
+}
+
+void swizzleRGBAToBGRA(unsigned char* pixels, size_t count) {
+#if defined(SIMD_X86)
+	if (cpuFeatures().ssse3) {
+		swizzleRGBAToBGRASSSE3(pixels, count);
+		return;
+	}
+#endif
+	swizzleRGBAToBGRAScalar(pixels, count);
+}
+
+void premultiplyAlpha(unsigned char* rgba, size_t count) {
+#if defined(SIMD_X86)
+	if (cpuFeatures().sse2) {
+		premultiplyAlphaSSE2(rgba, count);
+		return;
+	}
+#endif
+	premultiplyAlphaScalar(rgba, count);
+}
+
+void flipVertical(unsigned char* data, size_t rowBytes, int rows) {
+#if defined(SIMD_X86)
+	if (cpuFeatures().sse2) {
+		flipVerticalSSE2(data, rowBytes, rows);
+		return;
+	}
+#endif
+	flipVerticalScalar(data, rowBytes, rows);
+}
+
+void decodeSRGB(const unsigned char* srgb, float* linear, size_t count) {
+#if defined(SIMD_X86)
+	if (cpuFeatures().avx2) {
+		decodeSRGBAVX2(srgb, linear, count);
+		return;
+	}
+#endif
+	decodeSRGBScalar(srgb, linear, count);
+}
+
+void encodeSRGB(const float* linear, unsigned char* srgb, size_t count) {
+#if defined(SIMD_X86)
+	if (cpuFeatures().avx2) {
+		encodeSRGBAVX2(linear, srgb, count);
+		return;
+	}
+#endif
+	encodeSRGBScalar(linear, srgb, count);
+}
+
+void packHalf(const float* src, uint16_t* dst, size_t count) {
+#if defined(SIMD_X86)
+	if (cpuFeatures().f16c) {
+		packHalfF16C(src, dst, count);
+		return;
+	}
+#endif
+	packHalfScalar(src, dst, count);
+}
+
+void packRGB9E5(const float* rgb, uint32_t* dst, size_t pixels) {
+#if defined(SIMD_X86)
+	if (cpuFeatures().sse2) {
+		packRGB9E5SSE2(rgb, dst, pixels);
+		return;
+	}
+#endif
+	packRGB9E5Scalar(rgb, dst, pixels);
+}
+
+void convertRGBAToYUV420(const unsigned char* rgba, ptrdiff_t rowStride, int width, int height, unsigned char* y, unsigned char* u, unsigned char* v) {
+#if defined(SIMD_X86)
+	if (cpuFeatures().sse2) {
+		convertRGBAToYUV420SSE2(rgba, rowStride, width, height, y, u, v);
+		return;
+	}
+#endif
+	convertRGBAToYUV420Scalar(rgba, rowStride, width, height, y, u, v);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Pixel layout kernels used before uploading images. Every kernel picks an SSE/SSSE3 path at run time
+// and falls back to the *Scalar version, which is also kept public as the reference implementation.
+
+//RGB to RGBA with opaque alpha, rgb and rgba must not overlap
+void expandRGBToRGBA(const unsigned char* rgb, unsigned char* rgba, size_t pixels);
+void expandRGBToRGBAScalar(const unsigned char* rgb, unsigned char* rgba, size_t pixels);
+
+//swaps the red and blue channels in place, RGBA <-> BGRA
+void swizzleRGBAToBGRA(unsigned char* pixels, size_t count);
+void swizzleRGBAToBGRAScalar(unsigned char* pixels, size_t count);
+
+//multiplies color by alpha in place, alpha stays unchanged
+void premultiplyAlpha(unsigned char* rgba, size_t count);
+void premultiplyAlphaScalar(unsigned char* rgba, size_t count);
+
+//mirrors the image top to bottom in place, opengl expects row 0 to be the bottom of the image
+void flipVertical(unsigned char* data, size_t rowBytes, int rows);
+void flipVerticalScalar(unsigned char* data, size_t rowBytes, int rows);
+
+//sRGB decode through a 256 entry table, count is in channels not pixels. AVX2 gathers eight lookups at a time.
+void decodeSRGB(const unsigned char* srgb, float* linear, size_t count);
+void decodeSRGBScalar(const unsigned char* srgb, float* linear, size_t count);
+//sRGB encode through a 4096 entry table, input is clamped to [0, 1]. AVX2 gathers eight lookups at a time.
+void encodeSRGB(const float* linear, unsigned char* srgb, size_t count);
+void encodeSRGBScalar(const float* linear, unsigned char* srgb, size_t count);
+
+//float to half float (GL_HALF_FLOAT) rounded to nearest even, F16C when the CPU has it
+void packHalf(const float* src, uint16_t* dst, size_t count);
+void packHalfScalar(const float* src, uint16_t* dst, size_t count);
+
+//RGB floats to shared exponent GL_UNSIGNED_INT_5_9_9_9_REV, decodes with glm::unpackF3x9_E1x5
+void packRGB9E5(const float* rgb, uint32_t* dst, size_t pixels);
+void packRGB9E5Scalar(const float* rgb, uint32_t* dst, size_t pixels);
+
+//RGBA8 to planar BT.601 limited range YUV 4:2:0 (I420), chroma from the average of each 2x2 block. rowStride is
+//in bytes and negative to read rows bottom up, as glReadPixels leaves them. y is width x height, u and v are
+//(width + 1) / 2 x (height + 1) / 2, an odd last column or row is averaged with itself.
+void convertRGBAToYUV420(const unsigned char* rgba, ptrdiff_t rowStride, int width, int height, unsigned char* y, unsigned char* u, unsigned char* v);
+void convertRGBAToYUV420Scalar(const unsigned char* rgba, ptrdiff_t rowStride, int width, int height, unsigned char* y, unsigned char* u, unsigned char* v);
@@ -0,0 +1,138 @@
+#include "RenderStats.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+std::atomic<uint64_t> RenderStats::counters[RenderStats::COUNTERS];
+
+static const char* STAT_NAMES[RenderStats::STATS] = {
+	"draw_calls",
+	"instances",
+	"triangles",
+	"program_binds",
+	"vao_binds",
+	"texture_binds",
+	"sampler_binds",
+	"uniform_uploads",
+	"buffer_bytes",
+	"texture_bytes",
+	"fence_waits",
+	"cpu_frame_ms",
+	"gpu_frame_ms"
+};
+
+RenderStats::RenderStats(size_t window) : ring(std::max((size_t)1, window)), next(0), count(0), frameNumber(0), csv(false) {
+	memset(&last, 0, sizeof(last));
+}
+
+RenderStats::~RenderStats() {
+	closeStream();
+}
+
+const char* RenderStats::name(Stat stat) {
+	return STAT_NAMES[stat];
+}
+
+void RenderStats::endFrame(double cpuMs, double gpuMs) {
+	Frame frame;
+	frame.number = ++frameNumber;
+	for (int i = 0; i < COUNTERS; i++) {
+		frame.values[i] = (double)counters[i].exchange(0, std::memory_order_relaxed);
+	}
+	frame.values[CPU_FRAME_MS] = cpuMs;
+	frame.values[GPU_FRAME_MS] = gpuMs;
+	ring[next] = frame;
+	next = (next + 1) % ring.size();
+	count = std::min(count + 1, ring.size());
+	last = frame;
+	if (stream.is_open()) {
+		writeFrame(frame);
+	}
+}
+
+double RenderStats::average(Stat stat) const {
+	if (count == 0) {
+		return 0.0;
+	}
+	double total = 0.0;
+	for (size_t i = 0; i < count; i++) {
+		total += ring[i].values[stat];
+	}
+	return total / count;
+}
+
+double RenderStats::percentile(Stat stat, double p) const {
+	if (count == 0) {
+		return 0.0;
+	}
+	std::vector<double> values(count);
+	for (size_t i = 0; i < count; i++) {
+		values[i] = ring[i].values[stat];
+	}
+	size_t k = std::min(count - 1, (size_t)(p * count));
+	std::nth_element(values.begin(), values.begin() + k, values.end());
+	return values[k];
+}
+
+double RenderStats::maximum(Stat stat) const {
+	double result = 0.0;
+	for (size_t i = 0; i < count; i++) {
+		result = std::max(result, ring[i].values[stat]);
+	}
+	return result;
+}
+
+std::vector<size_t> RenderStats::histogram(Stat stat, double bucketWidth, size_t buckets) const {
+	std::vector<size_t> result(buckets, 0);
+	if (buckets == 0 || bucketWidth <= 0.0) {
+		return result;
+	}
+	for (size_t i = 0; i < count; i++) {
+		double bucket = std::max(0.0, ring[i].values[stat] / bucketWidth);
+		result[std::min(buckets - 1, (size_t)bucket)]++;
+	}
+	return result;
+}
+
+bool RenderStats::openStream(const char* path) {
+	closeStream();
+	size_t length = strlen(path);
+	csv = length >= 4 && strcmp(path + length - 4, ".csv") == 0;
+	stream.open(path);
+	if (!stream) {
+		std::cout << "Failed to open " << path << " for render statistics" << std::endl;
+		return false;
+	}
+	if (csv) {
+		stream << "frame";
+		for (int i = 0; i < STATS; i++) {
+			stream << "," << STAT_NAMES[i];
+		}
+		stream << "\n";
+	}
+	return true;
+}
+
+void RenderStats::closeStream() {
+	if (stream.is_open()) {
+		stream.close();
+	}
+}
+
+// Flushed every frame so dashboards tailing the file see whole lines.
+void RenderStats::writeFrame(const Frame& frame) {
+	if (csv) {
+		stream << frame.number;
+		for (int i = 0; i < STATS; i++) {
+			stream << "," << frame.values[i];
+		}
+		stream << std::endl;
+		return;
+	}
+	stream << "{\"frame\":" << frame.number;
+	for (int i = 0; i < STATS; i++) {
+		stream << ",\"" << STAT_NAMES[i] << "\":" << frame.values[i];
+	}
+	stream << "}" << std::endl;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+// Build with RENDER_STATS=0 to compile the counting out, RENDER_STAT then expands to nothing and the per frame
+// records only hold frame times.
+#ifndef RENDER_STATS
+#define RENDER_STATS 1
+#endif
+
+// Per frame render statistics. Counters are process wide relaxed atomics, so the renderer and worker threads
+// add to them without locks. endFrame() moves them into a rolling window of recent frames, which answers
+// averages, percentiles and histograms, and optionally appends the frame to a CSV or JSON lines file.
+// Only one RenderStats should call endFrame(), it takes the counts of every thread.
+class RenderStats
+{
+public:
+	enum Stat {
+		DRAW_CALLS,
+		INSTANCES,
+		TRIANGLES,
+		PROGRAM_BINDS,
+		VAO_BINDS,
+		TEXTURE_BINDS,
+		SAMPLER_BINDS,
+		UNIFORM_UPLOADS,
+		BUFFER_BYTES,
+		TEXTURE_BYTES,
+		FENCE_WAITS,
+		COUNTERS,
+		// not counters, passed to endFrame
+		CPU_FRAME_MS = COUNTERS,
+		GPU_FRAME_MS,
+		STATS
+	};
+
+	struct Frame {
+		uint64_t number;
+		double values[STATS];
+	};
+
+	//window = how many recent frames the queries cover
+	explicit RenderStats(size_t window = 240);
+	~RenderStats();
+
+	static void add(Stat stat, uint64_t amount) { counters[stat].fetch_add(amount, std::memory_order_relaxed); }
+	//names as written to streams, snake case
+	static const char* name(Stat stat);
+
+	//closes the frame: takes the counters (resetting them) and the frame times, gpuMs may be from an older frame
+	void endFrame(double cpuMs, double gpuMs);
+
+	//the last closed frame, all zero before the first
+	const Frame& lastFrame() const { return last; }
+	//over the frames in the window
+	double average(Stat stat) const;
+	double percentile(Stat stat, double p) const;
+	double maximum(Stat stat) const;
+	//frames in the window per bucket of bucketWidth starting at 0, values past the last bucket land in it
+	std::vector<size_t> histogram(Stat stat, double bucketWidth, size_t buckets) const;
+	size_t frames() const { return count; }
+
+	//appends every closed frame to path, CSV when it ends in .csv and JSON lines otherwise
+	bool openStream(const char* path);
+	void closeStream();
+
+private:
+	void writeFrame(const Frame& frame);
+
+	static std::atomic<uint64_t> counters[COUNTERS];
+
+	std::vector<Frame> ring;
+	size_t next;
+	size_t count;
+	uint64_t frameNumber;
+	Frame last;
+	std::ofstream stream;
+	bool csv;
+};
+
+#if RENDER_STATS
+#define RENDER_STAT(stat, amount) RenderStats::add(RenderStats::stat, (uint64_t)(amount))
+#else
+#define RENDER_STAT(stat, amount)
+#endif
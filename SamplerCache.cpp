@@ -0,0 +1,118 @@
+#include "SamplerCache.h"
+#include "GLExtensions.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Small codes for the enums that end up in the key.
+static uint32_t wrapCode(GLenum wrap) {
+	switch (wrap) {
+	case GL_MIRRORED_REPEAT: return 1;
+	case GL_CLAMP_TO_EDGE: return 2;
+	case GL_CLAMP_TO_BORDER: return 3;
+	case GL_MIRROR_CLAMP_TO_EDGE: return 4;
+	default: return 0; // GL_REPEAT
+	}
+}
+
+static uint32_t filterCode(GLenum filter) {
+	switch (filter) {
+	case GL_NEAREST: return 0;
+	case GL_NEAREST_MIPMAP_NEAREST: return 2;
+	case GL_LINEAR_MIPMAP_NEAREST: return 3;
+	case GL_NEAREST_MIPMAP_LINEAR: return 4;
+	case GL_LINEAR_MIPMAP_LINEAR: return 5;
+	default: return 1; // GL_LINEAR
+	}
+}
+
+SamplerDesc SamplerDesc::quantized() const {
+	SamplerDesc q = *this;
+	q.maxAnisotropy = std::floor(std::min(std::max(maxAnisotropy, 1.0f), 16.0f));
+	q.lodBias = std::lround(std::min(std::max(lodBias, -8.0f), 7.9375f) * 16.0f) / 16.0f;
+	return q;
+}
+
+uint32_t SamplerDesc::key() const {
+	// bits: wrapS 3 | wrapT 3 | min 3 | mag 1 | anisotropy 5 | lod bias 8 | compare 1 | func 3
+	SamplerDesc q = quantized();
+	uint32_t aniso = (uint32_t)q.maxAnisotropy - 1;
+	int32_t bias = (int32_t)std::lround(q.lodBias * 16.0f);
+	uint32_t key = wrapCode(wrapS);
+	key |= wrapCode(wrapT) << 3;
+	key |= filterCode(minFilter) << 6;
+	key |= (magFilter == GL_NEAREST ? 0u : 1u) << 9;
+	key |= aniso << 10;
+	key |= ((uint32_t)bias & 0xFF) << 15;
+	key |= (compareMode == GL_COMPARE_REF_TO_TEXTURE ? 1u : 0u) << 23;
+	key |= ((compareFunc - GL_NEVER) & 0x7) << 24;
+	return key;
+}
+
+SamplerCache::SamplerCache() : qualityAnisotropy(16.0f), qualityLodBias(0.0f), maxSupportedAnisotropy(0.0f), anisotropic(false) {
+}
+
+int SamplerCache::get(const SamplerDesc& desc) {
+	uint32_t key = desc.key();
+	auto found = lookup.find(key);
+	if (found != lookup.end()) {
+		return found->second;
+	}
+	if (maxSupportedAnisotropy == 0.0f) {
+		anisotropic = GLAD_GL_VERSION_4_6 || hasGLExtension("GL_ARB_texture_filter_anisotropic") || hasGLExtension("GL_EXT_texture_filter_anisotropic");
+		// the extensions use the same enum values as 4.6
+		if (anisotropic) {
+			glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &maxSupportedAnisotropy);
+		}
+		maxSupportedAnisotropy = std::max(maxSupportedAnisotropy, 1.0f);
+	}
+
+	Entry entry;
+	entry.desc = desc.quantized();
+	glGenSamplers(1, &entry.id);
+	apply(entry);
+	entries.push_back(entry);
+	lookup[key] = (int)entries.size() - 1;
+	return (int)entries.size() - 1;
+}
+
+void SamplerCache::apply(const Entry& entry) const {
+	const SamplerDesc& d = entry.desc;
+	glSamplerParameteri(entry.id, GL_TEXTURE_WRAP_S, d.wrapS);
+	glSamplerParameteri(entry.id, GL_TEXTURE_WRAP_T, d.wrapT);
+	glSamplerParameteri(entry.id, GL_TEXTURE_MIN_FILTER, d.minFilter);
+	glSamplerParameteri(entry.id, GL_TEXTURE_MAG_FILTER, d.magFilter);
+	if (anisotropic) {
+		float aniso = std::min(std::min(d.maxAnisotropy, qualityAnisotropy), maxSupportedAnisotropy);
+		glSamplerParameterf(entry.id, GL_TEXTURE_MAX_ANISOTROPY, std::max(aniso, 1.0f));
+	}
+	glSamplerParameterf(entry.id, GL_TEXTURE_LOD_BIAS, d.lodBias + qualityLodBias);
+	glSamplerParameteri(entry.id, GL_TEXTURE_COMPARE_MODE, d.compareMode);
+	glSamplerParameteri(entry.id, GL_TEXTURE_COMPARE_FUNC, d.compareFunc);
+}
+
+void SamplerCache::setQuality(float maxAnisotropy, float lodBias, bool inPlace) {
+	qualityAnisotropy = maxAnisotropy;
+	qualityLodBias = lodBias;
+	if (inPlace) {
+		for (const Entry& entry : entries) {
+			apply(entry);
+		}
+	}
+}
+
+void SamplerCache::rebuild() {
+	for (Entry& entry : entries) {
+		glDeleteSamplers(1, &entry.id);
+		glGenSamplers(1, &entry.id);
+		apply(entry);
+	}
+}
+
+void SamplerCache::release() {
+	for (const Entry& entry : entries) {
+		glDeleteSamplers(1, &entry.id);
+	}
+	entries.clear();
+	lookup.clear();
+}
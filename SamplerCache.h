@@ -0,0 +1,60 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Describes how a texture is sampled. Equal descriptors share one GL sampler object.
+struct SamplerDesc {
+	GLenum wrapS = GL_REPEAT;
+	GLenum wrapT = GL_REPEAT;
+	GLenum minFilter = GL_LINEAR_MIPMAP_LINEAR;
+	GLenum magFilter = GL_LINEAR;
+	float maxAnisotropy = 1.0f; // 1 to 16, further capped by the quality setting
+	float lodBias = 0.0f; // stored with 1/16 precision in the -8 to 8 range
+	GLenum compareMode = GL_NONE; // GL_COMPARE_REF_TO_TEXTURE for shadow samplers
+	GLenum compareFunc = GL_LEQUAL;
+
+	//anisotropy clamped and rounded down to a whole number, LOD bias clamped and rounded to 1/16, what the key holds
+	SamplerDesc quantized() const;
+	//packs the descriptor into a 32 bit key, descriptors with the same key produce identical samplers
+	uint32_t key() const;
+};
+
+class SamplerCache
+{
+public:
+	SamplerCache();
+
+	//returns a stable sampler index for the descriptor, creating the GL sampler the first time it is seen
+	int get(const SamplerDesc& desc);
+	//GL name of a sampler index, changes after rebuild()
+	unsigned int id(int sampler) const { return entries[sampler].id; }
+	size_t size() const { return entries.size(); }
+
+	//global quality preset applied on top of every descriptor. Updates the existing samplers in place
+	//unless they are frozen by bindless handles, in that case call rebuild() and regenerate the handles.
+	void setQuality(float maxAnisotropy, float lodBias, bool inPlace = true);
+	//deletes and recreates every sampler object with the current quality
+	void rebuild();
+	void release();
+
+private:
+	struct Entry {
+		// quantized, so every descriptor sharing the key gets exactly this sampler
+		SamplerDesc desc;
+		unsigned int id;
+	};
+	void apply(const Entry& entry) const;
+
+	std::unordered_map<uint32_t, int> lookup;
+	std::vector<Entry> entries;
+	float qualityAnisotropy;
+	float qualityLodBias;
+	float maxSupportedAnisotropy;
+	// GL_TEXTURE_MAX_ANISOTROPY is core only in 4.6, before that it needs one of the extensions
+	bool anisotropic;
+};
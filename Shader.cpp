@@ -6,7 +6,11 @@
 
 #include <glad/glad.h>
 
+#include "CpuProfiler.h"
+#include "RenderStats.h"
+
 Shader::Shader(const char* vertexPath, const char* fragmentPath) {
+	CPU_ZONE("Shader");
 	// 1. retrieve the vertex/fragment source code from filePath
 	std::string vertexCode;
 	std::string fragmentCode;
@@ -81,54 +85,112 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
 	glDeleteShader(fragment);
 }
 
+Shader::Shader(const char* computePath) {
+	CPU_ZONE("Shader (compute)");
+	std::string computeCode;
+	std::ifstream cShaderFile;
+	cShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+	try
+	{
+		cShaderFile.open(computePath);
+		std::stringstream cShaderStream;
+		cShaderStream << cShaderFile.rdbuf();
+		cShaderFile.close();
+		computeCode = cShaderStream.str();
+	}
+	catch (const std::ifstream::failure&)
+	{
+		std::cout << "Error Shader file not successfully read." << std::endl;
+	}
+	const char* cShaderCode = computeCode.c_str();
+
+	unsigned int compute;
+	int success;
+	char infoLog[512];
+
+	compute = glCreateShader(GL_COMPUTE_SHADER);
+	glShaderSource(compute, 1, &cShaderCode, NULL);
+	glCompileShader(compute);
+
+	glGetShaderiv(compute, GL_COMPILE_STATUS, &success);
+	if (!success) {
+		glGetShaderInfoLog(compute, 512, NULL, infoLog);
+		std::cout << "Error Compiler Shader Compute " << computePath << "\n" << infoLog << std::endl;
+	}
+
+	ID = glCreateProgram();
+	glAttachShader(ID, compute);
+	glLinkProgram(ID);
+
+	glGetProgramiv(ID, GL_LINK_STATUS, &success);
+	if (!success) {
+		glGetProgramInfoLog(ID, 512, NULL, infoLog);
+		std::cout << "Error Linking Program Shader" << std::endl;
+	}
+
+	glDeleteShader(compute);
+}
+
 void Shader::use() {
 	glUseProgram(ID);
 }
 
 void Shader::setBool(const std::string& name, bool value) const {
 	glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+	RENDER_STAT(UNIFORM_UPLOADS, 1);
 }
 
 void Shader::setFloat(const std::string& name, float value) const {
 	glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+	RENDER_STAT(UNIFORM_UPLOADS, 1);
 }
 
 void Shader::setInt(const std::string& name, int value) const {
 	glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	RENDER_STAT(UNIFORM_UPLOADS, 1);
 }
 
 void Shader::setVec2(const std::string& name, const glm::vec2& value) const {
 	glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+	RENDER_STAT(UNIFORM_UPLOADS, 1);
 }
 
 void Shader::setVec2(const std::string& name, float x, float y) const {
 	glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+	RENDER_STAT(UNIFORM_UPLOADS, 1);
 }
 
 void Shader::setVec3(const std::string& name, const glm::vec3& value) const {
 	glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+	RENDER_STAT(UNIFORM_UPLOADS, 1);
 }
 
 void Shader::setVec3(const std::string& name, float x, float y, float z) const {
 	glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+	RENDER_STAT(UNIFORM_UPLOADS, 1);
 }
 
 void Shader::setVec4(const std::string& name, const glm::vec4& value) const {
 	glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+	RENDER_STAT(UNIFORM_UPLOADS, 1);
 }
 
 void Shader::setVec4(const std::string& name, float x, float y, float z, float w) const {
 	glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+	RENDER_STAT(UNIFORM_UPLOADS, 1);
 }
 
 void Shader::setMat2(const std::string& name, const glm::mat2& value) const {
 	glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &value[0][0]);
+	RENDER_STAT(UNIFORM_UPLOADS, 1);
 }
 
 void Shader::setMat3(const std::string& name, const glm::mat3& value) const {
 	glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &value[0][0]);
+	RENDER_STAT(UNIFORM_UPLOADS, 1);
 }
 
 void Shader::setMat4(const std::string& name, const glm::mat4& value) const {
 	glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &value[0][0]);
+	RENDER_STAT(UNIFORM_UPLOADS, 1);
 }
\ No newline at end of file
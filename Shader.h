@@ -10,6 +10,8 @@ public:
 	unsigned int ID;
 	//constructor reads and builds Shader
 	Shader(const char* vertexPath, const char* fragmentPath);
+	//reads and builds a compute shader program
+	explicit Shader(const char* computePath);
 	//use/activate shader
 	void use();
 	//utility uniform functions
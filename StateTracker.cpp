@@ -0,0 +1,61 @@
+#include "StateTracker.h"
+#include "RenderStats.h"
+
+#include <glad/glad.h>
+
+// Nothing is ever bound to this name, used to mark state as unknown.
+static const unsigned int UNKNOWN = 0xFFFFFFFF;
+
+StateTracker::StateTracker() : changes(0) {
+	invalidate();
+}
+
+void StateTracker::useProgram(unsigned int id) {
+	if (program != id) {
+		program = id;
+		glUseProgram(id);
+		changes++;
+		RENDER_STAT(PROGRAM_BINDS, 1);
+	}
+}
+
+void StateTracker::bindVertexArray(unsigned int id) {
+	if (vao != id) {
+		vao = id;
+		glBindVertexArray(id);
+		changes++;
+		RENDER_STAT(VAO_BINDS, 1);
+	}
+}
+
+void StateTracker::bindTexture(unsigned int unit, unsigned int texture) {
+	if (textures[unit] != texture) {
+		textures[unit] = texture;
+		if (activeUnit != unit) {
+			activeUnit = unit;
+			glActiveTexture(GL_TEXTURE0 + unit);
+		}
+		glBindTexture(GL_TEXTURE_2D, texture);
+		changes++;
+		RENDER_STAT(TEXTURE_BINDS, 1);
+	}
+}
+
+void StateTracker::bindSampler(unsigned int unit, unsigned int sampler) {
+	if (samplers[unit] != sampler) {
+		samplers[unit] = sampler;
+		glBindSampler(unit, sampler);
+		changes++;
+		RENDER_STAT(SAMPLER_BINDS, 1);
+	}
+}
+
+void StateTracker::invalidate() {
+	program = UNKNOWN;
+	vao = UNKNOWN;
+	activeUnit = UNKNOWN;
+	for (int i = 0; i < MAX_UNITS; i++) {
+		textures[i] = UNKNOWN;
+		samplers[i] = UNKNOWN;
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+
+// Shadows the GL binding state so redundant binds never reach the driver.
+// Only state that goes through the tracker is known to it, call invalidate() after touching GL directly.
+class StateTracker
+{
+public:
+	static const int MAX_UNITS = 32;
+
+	StateTracker();
+
+	void useProgram(unsigned int program);
+	void bindVertexArray(unsigned int vao);
+	//binds a GL_TEXTURE_2D to a unit through glActiveTexture, glBindTextureUnit is GL 4.5 and the contexts ask
+	//for 4.4. The unit stays active, code binding textures directly picks its unit with glActiveTexture first.
+	void bindTexture(unsigned int unit, unsigned int texture);
+	void bindSampler(unsigned int unit, unsigned int sampler);
+	//forget everything, the next bind of each kind always reaches GL
+	void invalidate();
+
+	// binds that reached GL, never reset by the tracker itself
+	size_t changes;
+
+private:
+	unsigned int program;
+	unsigned int vao;
+	unsigned int activeUnit;
+	unsigned int textures[MAX_UNITS];
+	unsigned int samplers[MAX_UNITS];
+};
@@ -0,0 +1,427 @@
+#include "TextureManager.h"
+#include "CpuProfiler.h"
+#include "GLExtensions.h"
+#include "PixelConvert.h"
+#include "RenderStats.h"
+#include "Shader.h"
+#include "StateTracker.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include <stb_image.h>
+
+// ARB_bindless_texture entry points, glad does not know about them.
+typedef GLuint64(APIENTRYP PFNGLGETTEXTURESAMPLERHANDLEARBPROC)(GLuint texture, GLuint sampler);
+typedef void (APIENTRYP PFNGLMAKETEXTUREHANDLERESIDENTARBPROC)(GLuint64 handle);
+typedef void (APIENTRYP PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC)(GLuint64 handle);
+
+static PFNGLGETTEXTURESAMPLERHANDLEARBPROC getTextureSamplerHandle = NULL;
+static PFNGLMAKETEXTUREHANDLERESIDENTARBPROC makeHandleResident = NULL;
+static PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC makeHandleNonResident = NULL;
+
+// binding point of the Materials block in shader_bindless.frag
+static const unsigned int MATERIAL_BINDING = 0;
+// GPU memory budget of streamed textures, their always resident low mips included
+static const size_t STREAMING_BUDGET = 64 * 1024 * 1024;
+
+static inline unsigned char average4(int a, int b, int c, int d) {
+	return (unsigned char)((a + b + c + d + 2) / 4);
+}
+
+static inline float average4(float a, float b, float c, float d) {
+	return (a + b + c + d) * 0.25f;
+}
+
+// Box filters the full mip chain on the CPU, glGenerateMipmap needs level 0 on the GPU
+// and cannot write shared exponent formats.
+template<typename T>
+static std::vector<std::vector<T>> buildMipChain(const T* data, int width, int height, int channels) {
+	std::vector<std::vector<T>> mips;
+	mips.emplace_back(data, data + (size_t)width * height * channels);
+	while (width > 1 || height > 1) {
+		const std::vector<T>& src = mips.back();
+		int w = std::max(1, width / 2);
+		int h = std::max(1, height / 2);
+		std::vector<T> dst((size_t)w * h * channels);
+		for (int y = 0; y < h; y++) {
+			int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+			for (int x = 0; x < w; x++) {
+				int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+				for (int c = 0; c < channels; c++) {
+					dst[((size_t)y * w + x) * channels + c] = average4(src[((size_t)y0 * width + x0) * channels + c], src[((size_t)y0 * width + x1) * channels + c],
+						src[((size_t)y1 * width + x0) * channels + c], src[((size_t)y1 * width + x1) * channels + c]);
+				}
+			}
+		}
+		mips.push_back(std::move(dst));
+		width = w;
+		height = h;
+	}
+	return mips;
+}
+
+TextureManager::TextureManager() : bindless(false), residency(STREAMING_BUDGET), nativeFormat(GL_RGBA), nativeType(GL_UNSIGNED_BYTE), handleSSBO(0), boundMaterial(-1), boundProgram(0) {
+}
+
+void TextureManager::release() {
+	if (bindless) {
+		for (GLuint64 handle : handles) {
+			makeHandleNonResident(handle);
+		}
+	}
+	samplers.release();
+	if (handleSSBO) {
+		glDeleteBuffers(1, &handleSSBO);
+	}
+	if (!textures.empty()) {
+		glDeleteTextures((GLsizei)textures.size(), textures.data());
+	}
+	handles.clear();
+	textures.clear();
+	textureSamplers.clear();
+	streamIndex.clear();
+	streamed.clear();
+	materials.clear();
+	handleSSBO = 0;
+	boundMaterial = -1;
+}
+
+void TextureManager::init(GLADloadproc loader) {
+	// ask the driver which client layout it can copy into RGBA8 without converting, usually BGRA on desktop GPUs
+	int format = GL_RGBA, type = GL_UNSIGNED_BYTE;
+	glGetInternalformativ(GL_TEXTURE_2D, GL_RGBA8, GL_TEXTURE_IMAGE_FORMAT, 1, &format);
+	glGetInternalformativ(GL_TEXTURE_2D, GL_RGBA8, GL_TEXTURE_IMAGE_TYPE, 1, &type);
+	bool bytes = type == GL_UNSIGNED_BYTE || type == GL_UNSIGNED_INT_8_8_8_8_REV;
+	nativeFormat = format == GL_BGRA && bytes ? GL_BGRA : GL_RGBA;
+	nativeType = format == GL_BGRA && bytes ? type : GL_UNSIGNED_BYTE;
+
+	bindless = false;
+	if (!hasGLExtension("GL_ARB_bindless_texture")) {
+		std::cout << "ARB_bindless_texture not supported, using bound textures." << std::endl;
+		return;
+	}
+	getTextureSamplerHandle = (PFNGLGETTEXTURESAMPLERHANDLEARBPROC)loader("glGetTextureSamplerHandleARB");
+	makeHandleResident = (PFNGLMAKETEXTUREHANDLERESIDENTARBPROC)loader("glMakeTextureHandleResidentARB");
+	makeHandleNonResident = (PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC)loader("glMakeTextureHandleNonResidentARB");
+	bindless = getTextureSamplerHandle && makeHandleResident && makeHandleNonResident;
+	if (!bindless) {
+		std::cout << "Failed to load ARB_bindless_texture functions, using bound textures." << std::endl;
+	}
+}
+
+// one channel images are gray and two are gray and alpha, the shaders sample all four components
+static void swizzleGray(int channels) {
+	if (channels == 1 || channels == 2) {
+		GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, channels == 2 ? GL_GREEN : GL_ONE };
+		glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+	}
+}
+
+bool TextureManager::decode(const char* path, Image& image) const {
+	int width, height, nrChannels;
+	unsigned char* data = stbi_load(path, &width, &height, &nrChannels, 0);
+	// The last argument of stbi_load can force a channel count, we keep the file's own and expand below.
+	if (!data) {
+		std::cout << "Failed to load image data " << path << std::endl;
+		return false;
+	}
+
+	// Image is flipped because opengl expects y axis 0 to be on bottom. but usually we take it on top so we have to flip image.
+	flipVertical(data, (size_t)width * nrChannels, height);
+
+	image.width = width;
+	image.height = height;
+	size_t pixels = (size_t)width * height;
+	if (nrChannels == 3) {
+		// tightly packed RGB rows force unaligned unpacking and a conversion in the driver, so upload 4 channels
+		image.pixels.resize(pixels * 4);
+		expandRGBToRGBA(data, image.pixels.data(), pixels);
+		nrChannels = 4;
+	}
+	else {
+		image.pixels.assign(data, data + pixels * nrChannels);
+	}
+	stbi_image_free(data);
+	// as we have used image to generate textures and mipmaps. IT's a good practice to free image memory.
+
+	image.channels = nrChannels;
+	image.type = GL_UNSIGNED_BYTE;
+	if (nrChannels == 4) {
+		image.internalFormat = GL_RGBA8;
+		image.format = nativeFormat;
+		image.type = nativeType;
+		if (nativeFormat == GL_BGRA) {
+			swizzleRGBAToBGRA(image.pixels.data(), pixels);
+		}
+	}
+	else {
+		image.internalFormat = nrChannels == 2 ? GL_RG8 : GL_R8;
+		image.format = nrChannels == 2 ? GL_RG : GL_RED;
+	}
+	return true;
+}
+
+int TextureManager::load(const char* path, const SamplerDesc& sampler) {
+	CPU_ZONE("TextureManager::load");
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	// sets the given texture as currently bound texture. Any subsequent texture operations will affect the currently bound texture object.
+
+	// wrap and filter state lives in a shared sampler object instead of glTexParameteri on every texture.
+	textureSamplers.push_back(samplers.get(sampler));
+
+	Image image;
+	if (decode(path, image)) {
+		glPixelStorei(GL_UNPACK_ALIGNMENT, image.channels == 4 ? 4 : 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, image.internalFormat, image.width, image.height, 0, image.format, image.type, image.pixels.data());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		// creates all the required mipmaps.
+		swizzleGray(image.channels);
+	}
+	// the texture object is kept even when loading failed so material indices stay valid.
+
+	textures.push_back(texture);
+	streamIndex.push_back(-1);
+	return (int)textures.size() - 1;
+}
+
+int TextureManager::loadStreamed(const char* path, const SamplerDesc& sampler) {
+	CPU_ZONE("TextureManager::loadStreamed");
+	Image image;
+	if (bindless || !decode(path, image)) {
+		return load(path, sampler);
+	}
+
+	StreamedTexture t;
+	t.texture = (int)textures.size();
+	t.width = image.width;
+	t.height = image.height;
+	t.channels = image.channels;
+	t.internalFormat = image.internalFormat;
+	t.format = image.format;
+	t.type = image.type;
+	t.mips = buildMipChain(image.pixels.data(), image.width, image.height, image.channels);
+
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	textures.push_back(texture);
+	textureSamplers.push_back(samplers.get(sampler));
+	int index = residency.add(image.width, image.height, image.channels);
+	streamIndex.push_back(index);
+
+	// start with the low mips only, levels below GL_TEXTURE_BASE_LEVEL are left undefined
+	int base = residency.residentBase(index);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (int)t.mips.size() - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, base);
+	swizzleGray(t.channels);
+	uploadLevels(t, base, (int)t.mips.size() - 1);
+	streamed.push_back(std::move(t));
+	return (int)textures.size() - 1;
+}
+
+int TextureManager::loadHdr(const char* path, HdrFormat format, const SamplerDesc& sampler) {
+	CPU_ZONE("TextureManager::loadHdr");
+	int width, height, nrChannels;
+	float* data = stbi_loadf(path, &width, &height, &nrChannels, 3);
+	if (!data) {
+		std::cout << "Failed to load HDR image data " << path << std::endl;
+		unsigned int texture;
+		glGenTextures(1, &texture);
+		textures.push_back(texture);
+		textureSamplers.push_back(samplers.get(sampler));
+		streamIndex.push_back(-1);
+		return (int)textures.size() - 1;
+	}
+	flipVertical((unsigned char*)data, (size_t)width * 3 * sizeof(float), height);
+	int texture = createHdr(data, width, height, format, sampler);
+	stbi_image_free(data);
+	return texture;
+}
+
+int TextureManager::createHdr(const float* rgb, int width, int height, HdrFormat format, const SamplerDesc& sampler) {
+	std::vector<std::vector<float>> mips = buildMipChain(rgb, width, height, 3);
+
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (int)mips.size() - 1);
+	// half float RGB rows are only 2 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	std::vector<uint16_t> halves;
+	std::vector<uint32_t> shared;
+	for (int level = 0; level < (int)mips.size(); level++) {
+		int w = std::max(1, width >> level);
+		int h = std::max(1, height >> level);
+		size_t pixels = (size_t)w * h;
+		if (format == HdrFormat::RGB16F) {
+			// 6 bytes per texel, half of RGB32F
+			halves.resize(pixels * 3);
+			packHalf(mips[level].data(), halves.data(), pixels * 3);
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RGB16F, w, h, 0, GL_RGB, GL_HALF_FLOAT, halves.data());
+		}
+		else if (format == HdrFormat::RGB9E5) {
+			// 4 bytes per texel, a third of RGB32F
+			shared.resize(pixels);
+			packRGB9E5(mips[level].data(), shared.data(), pixels);
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RGB9_E5, w, h, 0, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, shared.data());
+		}
+		else {
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RGB32F, w, h, 0, GL_RGB, GL_FLOAT, mips[level].data());
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	textures.push_back(texture);
+	textureSamplers.push_back(samplers.get(sampler));
+	streamIndex.push_back(-1);
+	return (int)textures.size() - 1;
+}
+
+int TextureManager::create(const unsigned char* rgba, int width, int height, const SamplerDesc& sampler) {
+	CPU_ZONE("TextureManager::create");
+	std::vector<unsigned char> pixels(rgba, rgba + (size_t)width * height * 4);
+	if (nativeFormat == GL_BGRA) {
+		swizzleRGBAToBGRA(pixels.data(), (size_t)width * height);
+	}
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, nativeFormat, nativeType, pixels.data());
+	glGenerateMipmap(GL_TEXTURE_2D);
+
+	textures.push_back(texture);
+	textureSamplers.push_back(samplers.get(sampler));
+	streamIndex.push_back(-1);
+	return (int)textures.size() - 1;
+}
+
+void TextureManager::uploadLevels(const StreamedTexture& t, int first, int last) {
+	// rows of one and two channel images are not 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, t.channels == 4 ? 4 : 1);
+	for (int level = first; level <= last; level++) {
+		int w = std::max(1, t.width >> level);
+		int h = std::max(1, t.height >> level);
+		glTexImage2D(GL_TEXTURE_2D, level, t.internalFormat, w, h, 0, t.format, t.type, t.mips[level].data());
+		RENDER_STAT(TEXTURE_BYTES, t.mips[level].size());
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void TextureManager::requestDetail(int material, float projectedPixels) {
+	const Material& m = materials[material];
+	for (unsigned int texture : { m.diffuse, m.overlay }) {
+		int index = streamIndex[texture];
+		if (index < 0) {
+			continue;
+		}
+		const StreamedTexture& t = streamed[index];
+		residency.request(index, MipResidency::levelForDensity(std::max(t.width, t.height), projectedPixels));
+	}
+}
+
+void TextureManager::updateStreaming(StateTracker& state) {
+	CPU_ZONE("TextureManager::updateStreaming");
+	const std::vector<MipResidency::Change>& changes = residency.update();
+	if (changes.empty()) {
+		return;
+	}
+	// the tracker may have left another unit active
+	glActiveTexture(GL_TEXTURE0);
+	for (const MipResidency::Change& change : changes) {
+		const StreamedTexture& t = streamed[change.texture];
+		glBindTexture(GL_TEXTURE_2D, textures[t.texture]);
+		if (change.newBase < change.oldBase) {
+			uploadLevels(t, change.newBase, change.oldBase - 1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, change.newBase);
+		}
+		else {
+			// move the base first so the texture stays complete, then give the memory of the dropped levels back
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, change.newBase);
+			for (int level = change.oldBase; level < change.newBase; level++) {
+				glTexImage2D(GL_TEXTURE_2D, level, t.internalFormat, 0, 0, 0, t.format, t.type, NULL);
+			}
+		}
+	}
+	// glBindTexture went around the tracker
+	state.invalidate();
+}
+
+int TextureManager::addMaterial(unsigned int diffuse, unsigned int overlay) {
+	materials.push_back({ diffuse, overlay });
+	return (int)materials.size() - 1;
+}
+
+void TextureManager::upload() {
+	if (!bindless) {
+		return;
+	}
+	createHandles();
+}
+
+void TextureManager::createHandles() {
+	// A handle freezes the state of both the texture and the sampler, so everything must be final before this point.
+	for (size_t i = handles.size(); i < textures.size(); i++) {
+		GLuint64 handle = getTextureSamplerHandle(textures[i], samplers.id(textureSamplers[i]));
+		makeHandleResident(handle);
+		handles.push_back(handle);
+	}
+
+	// two handles per material, laid out like the std430 Material struct (uvec2 diffuse, uvec2 overlay)
+	std::vector<GLuint64> table;
+	table.reserve(materials.size() * 2);
+	for (const Material& m : materials) {
+		table.push_back(handles[m.diffuse]);
+		table.push_back(handles[m.overlay]);
+	}
+	if (!handleSSBO) {
+		glGenBuffers(1, &handleSSBO);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, handleSSBO);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, table.size() * sizeof(GLuint64), table.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BINDING, handleSSBO);
+}
+
+void TextureManager::setSamplerQuality(float maxAnisotropy, float lodBias) {
+	if (!bindless) {
+		samplers.setQuality(maxAnisotropy, lodBias);
+		return;
+	}
+	// samplers behind resident handles are immutable, so replace them and fetch new handles
+	for (GLuint64 handle : handles) {
+		makeHandleNonResident(handle);
+	}
+	handles.clear();
+	samplers.setQuality(maxAnisotropy, lodBias, false);
+	samplers.rebuild();
+	createHandles();
+}
+
+void TextureManager::setupShader(const Shader& shader) const {
+	if (!bindless) {
+		shader.setInt("ourTexture", 0);
+		shader.setInt("ourTexture2", 1);
+	}
+}
+
+void TextureManager::bindMaterial(const Shader& shader, int material, StateTracker& state) {
+	if (material == boundMaterial && shader.ID == boundProgram) {
+		return;
+	}
+	boundMaterial = material;
+	boundProgram = shader.ID;
+	if (bindless) {
+		shader.setInt("materialIndex", material);
+		return;
+	}
+	const Material& m = materials[material];
+	state.bindTexture(0, textures[m.diffuse]);
+	state.bindSampler(0, samplers.id(textureSamplers[m.diffuse]));
+	state.bindTexture(1, textures[m.overlay]);
+	state.bindSampler(1, samplers.id(textureSamplers[m.overlay]));
+}
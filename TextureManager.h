@@ -0,0 +1,110 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "MipResidency.h"
+#include "SamplerCache.h"
+
+#include <vector>
+
+// How HDR images are stored on the GPU. RGB16F needs half and RGB9E5 a third of the memory and upload bandwidth of RGB32F.
+enum class HdrFormat {
+	RGB32F,
+	RGB16F,
+	RGB9E5
+};
+
+// A material references two textures, matching ourTexture/ourTexture2 in the fragment shader.
+struct Material {
+	unsigned int diffuse;
+	unsigned int overlay;
+};
+
+class TextureManager
+{
+public:
+	// true when ARB_bindless_texture was found and materials are read from the handle SSBO
+	bool bindless;
+	// sampler objects shared by all textures
+	SamplerCache samplers;
+
+	TextureManager();
+
+	//detects bindless support, pass the same loader that was given to glad.
+	void init(GLADloadproc loader);
+	//loads an image from disk, returns the texture index (not the GL name)
+	int load(const char* path, const SamplerDesc& sampler = SamplerDesc());
+	//loads an image and keeps its mip chain in memory, only the low mips start on the GPU.
+	//On the bindless path texture state is frozen by the handles, so this behaves like load().
+	int loadStreamed(const char* path, const SamplerDesc& sampler = SamplerDesc());
+	//loads a float image (Radiance .hdr through stb_image) and converts it to the given format
+	int loadHdr(const char* path, HdrFormat format, const SamplerDesc& sampler = SamplerDesc());
+	//creates an HDR texture with a full mip chain from tightly packed RGB floats, bottom row first.
+	//Lets other decoders (EXR, lightmap bakers) feed the same conversion path.
+	int createHdr(const float* rgb, int width, int height, HdrFormat format, const SamplerDesc& sampler = SamplerDesc());
+	//creates an RGBA8 texture with mipmaps from tightly packed pixels, bottom row first (generated or already decoded images)
+	int create(const unsigned char* rgba, int width, int height, const SamplerDesc& sampler = SamplerDesc());
+	//registers a material, returns its index
+	int addMaterial(unsigned int diffuse, unsigned int overlay);
+	//makes handles resident and uploads the material handle table. Call once after all materials are added.
+	void upload();
+	//one time sampler wiring for the bound-texture path, does nothing on the bindless path
+	void setupShader(const class Shader& shader) const;
+	//makes the material current. Bindless only sets an index, the fallback binds both texture units and their samplers.
+	void bindMaterial(const class Shader& shader, int material, class StateTracker& state);
+	//changes filtering of every texture at once (e.g. a quality preset) by touching only the shared samplers
+	void setSamplerQuality(float maxAnisotropy, float lodBias);
+
+	//asks for enough detail to draw the material's textures across projectedPixels on screen
+	void requestDetail(int material, float projectedPixels);
+	//uploads or drops mip levels of streamed textures, call once per frame after all requests
+	void updateStreaming(class StateTracker& state);
+
+	//deletes textures and the handle table, must be called while the context is still alive
+	void release();
+
+	unsigned int textureID(int texture) const { return textures[texture]; }
+
+	//residency decisions for streamed textures, budget is in bytes of GPU memory
+	MipResidency residency;
+
+private:
+	struct StreamedTexture {
+		int texture;
+		int width;
+		int height;
+		int channels;
+		GLenum internalFormat;
+		GLenum format;
+		GLenum type;
+		std::vector<std::vector<unsigned char>> mips; // CPU copy of every level, [0] is full size
+	};
+
+	// decoded pixels already in the layout they are uploaded with
+	struct Image {
+		std::vector<unsigned char> pixels;
+		int width;
+		int height;
+		int channels;
+		GLenum internalFormat;
+		GLenum format;
+		GLenum type;
+	};
+
+	//loads, flips and converts an image to the GPU's preferred layout
+	bool decode(const char* path, Image& image) const;
+	void createHandles();
+	void uploadLevels(const StreamedTexture& t, int first, int last);
+
+	std::vector<unsigned int> textures;
+	std::vector<int> textureSamplers;
+	std::vector<int> streamIndex; // residency index of each texture, -1 when fully resident
+	std::vector<StreamedTexture> streamed;
+	GLenum nativeFormat; // GL_RGBA or GL_BGRA, whichever the driver takes without conversion
+	GLenum nativeType;
+	std::vector<GLuint64> handles;
+	std::vector<Material> materials;
+	unsigned int handleSSBO;
+	int boundMaterial;
+	unsigned int boundProgram; // bindless material indices are per program uniforms
+};
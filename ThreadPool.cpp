@@ -0,0 +1,86 @@
+#include "ThreadPool.h"
+#include "CpuProfiler.h"
+
+ThreadPool::ThreadPool(unsigned int threads) : job(nullptr), jobCount(0), next(0), finished(0), generation(0), stopping(false) {
+	if (threads == 0) {
+		unsigned int hardware = std::thread::hardware_concurrency();
+		threads = hardware > 1 ? hardware - 1 : 0;
+	}
+	for (unsigned int i = 0; i < threads; i++) {
+		workers.emplace_back(&ThreadPool::run, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& fn) {
+	if (count == 0) {
+		return;
+	}
+	CPU_ZONE("parallelFor");
+	if (workers.empty() || count == 1) {
+		for (size_t i = 0; i < count; i++) {
+			fn(i);
+		}
+		return;
+	}
+	std::unique_lock<std::mutex> lock(mutex);
+	job = &fn;
+	jobCount = count;
+	next = 0;
+	finished = 0;
+	generation++;
+	wake.notify_all();
+
+	// the caller works too instead of just waiting
+	while (next < jobCount) {
+		size_t i = next++;
+		lock.unlock();
+		CPU_ZONE_BEGIN("job");
+		fn(i);
+		CPU_ZONE_END();
+		lock.lock();
+		finished++;
+	}
+	done.wait(lock, [this] { return finished == jobCount; });
+	job = nullptr;
+}
+
+void ThreadPool::run() {
+	unsigned int seen = 0;
+	CpuProfiler::setThreadName("ThreadPool worker");
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		wake.wait(lock, [&] { return stopping || (generation != seen && job && next < jobCount); });
+		if (stopping) {
+			return;
+		}
+		while (job && next < jobCount) {
+			size_t i = next++;
+			const std::function<void(size_t)>* fn = job;
+			lock.unlock();
+			CPU_ZONE_BEGIN("job");
+			(*fn)(i);
+			CPU_ZONE_END();
+			lock.lock();
+			if (++finished == jobCount) {
+				done.notify_all();
+			}
+		}
+		seen = generation;
+	}
+}
+
+ThreadPool& ThreadPool::global() {
+	static ThreadPool pool;
+	return pool;
+}
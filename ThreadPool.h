@@ -0,0 +1,39 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data parallel loops. The calling thread takes part in the work,
+// so a pool with zero workers simply runs everything inline.
+class ThreadPool
+{
+public:
+	//threads = 0 uses one worker per hardware thread minus the caller
+	explicit ThreadPool(unsigned int threads = 0);
+	~ThreadPool();
+
+	//runs fn(i) for i in [0, count) and returns when all calls finished
+	void parallelFor(size_t count, const std::function<void(size_t)>& fn);
+	//workers plus the calling thread
+	unsigned int size() const { return (unsigned int)workers.size() + 1; }
+
+	//shared pool for loaders and per frame jobs
+	static ThreadPool& global();
+
+private:
+	void run();
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	const std::function<void(size_t)>* job;
+	size_t jobCount;
+	size_t next;
+	size_t finished;
+	unsigned int generation;
+	bool stopping;
+};
@@ -0,0 +1,182 @@
+#include "VertexCompression.h"
+#include "MeshOptimizer.h"
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+VertexCompression VertexCompression::none() {
+	VertexCompression c;
+	c.position = PositionFormat::Float32;
+	c.normal = NormalFormat::Float32;
+	c.texCoord = TexCoordFormat::Float32;
+	c.shortIndices = false;
+	return c;
+}
+
+glm::vec2 octahedralEncode(glm::vec3 n) {
+	n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	glm::vec2 e(n.x, n.y);
+	if (n.z < 0.0f) {
+		// fold the lower hemisphere over the diagonals
+		e = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return e;
+}
+
+glm::vec3 octahedralDecode(glm::vec2 e) {
+	// same as octDecode in shader.vert
+	glm::vec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+	float t = std::max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return glm::normalize(n);
+}
+
+// snorm16 rounding of the octahedral coordinates, tries the neighbouring codes and keeps the most accurate one
+static uint32_t packOctahedral(glm::vec3 n) {
+	glm::vec2 e = octahedralEncode(n);
+	glm::vec2 base = glm::floor(glm::clamp(e, -1.0f, 1.0f) * 32767.0f);
+	uint32_t best = 0;
+	float bestDot = -2.0f;
+	for (int i = 0; i < 4; i++) {
+		glm::vec2 code = glm::clamp(base + glm::vec2((float)(i & 1), (float)(i >> 1)), -32767.0f, 32767.0f) / 32767.0f;
+		float d = glm::dot(octahedralDecode(code), n);
+		if (d > bestDot) {
+			bestDot = d;
+			best = glm::packSnorm2x16(code);
+		}
+	}
+	return best;
+}
+
+template<typename T>
+static void put(unsigned char* p, const T& value) {
+	memcpy(p, &value, sizeof(T));
+}
+
+void encodeMesh(const Mesh& mesh, const VertexCompression& compression, EncodedMesh& out, CompressionReport* report) {
+	uint32_t positionSize = compression.position == PositionFormat::Float32 ? 12 : 8;
+	uint32_t normalSize = compression.normal == NormalFormat::Float32 ? 12 : 4;
+	uint32_t texCoordSize = compression.texCoord == TexCoordFormat::Float32 ? 8 : 4;
+	out.stride = positionSize + normalSize + texCoordSize;
+	out.normalEncoding = compression.normal == NormalFormat::Octahedral16 ? 1 : 0;
+
+	out.attributes.clear();
+	switch (compression.position) {
+	case PositionFormat::Float32: out.attributes.push_back({ 0, 3, GL_FLOAT, 0, 0 }); break;
+	case PositionFormat::Half: out.attributes.push_back({ 0, 3, GL_HALF_FLOAT, 0, 0 }); break;
+	case PositionFormat::Unorm16: out.attributes.push_back({ 0, 3, GL_UNSIGNED_SHORT, 1, 0 }); break;
+	}
+	if (compression.normal == NormalFormat::Float32) {
+		out.attributes.push_back({ 1, 3, GL_FLOAT, 0, positionSize });
+	}
+	else {
+		out.attributes.push_back({ 1, 2, GL_SHORT, 1, positionSize });
+	}
+	if (compression.texCoord == TexCoordFormat::Float32) {
+		out.attributes.push_back({ 2, 2, GL_FLOAT, 0, positionSize + normalSize });
+	}
+	else {
+		out.attributes.push_back({ 2, 2, GL_HALF_FLOAT, 0, positionSize + normalSize });
+	}
+
+	out.positionOffset = glm::vec3(0.0f);
+	out.positionScale = glm::vec3(1.0f);
+	if (compression.position == PositionFormat::Unorm16) {
+		out.positionOffset = mesh.boundsMin;
+		out.positionScale = glm::max(mesh.boundsMax - mesh.boundsMin, glm::vec3(1e-20f));
+	}
+
+	float positionError = 0.0f, normalError = 1.0f, texCoordError = 0.0f;
+	out.vertices.assign(mesh.vertices.size() * out.stride, 0);
+	for (size_t i = 0; i < mesh.vertices.size(); i++) {
+		const Vertex& v = mesh.vertices[i];
+		unsigned char* p = out.vertices.data() + i * out.stride;
+		glm::vec3 position;
+		switch (compression.position) {
+		case PositionFormat::Float32:
+			put(p, v.position);
+			position = v.position;
+			break;
+		case PositionFormat::Half: {
+			glm::uint64 packed = glm::packHalf4x16(glm::vec4(v.position, 1.0f));
+			put(p, packed);
+			position = glm::vec3(glm::unpackHalf4x16(packed));
+			break;
+		}
+		case PositionFormat::Unorm16: {
+			glm::uint64 packed = glm::packUnorm4x16(glm::vec4((v.position - out.positionOffset) / out.positionScale, 0.0f));
+			put(p, packed);
+			position = out.positionOffset + glm::vec3(glm::unpackUnorm4x16(packed)) * out.positionScale;
+			break;
+		}
+		}
+		positionError = std::max(positionError, glm::length(position - v.position));
+		p += positionSize;
+
+		float length = glm::length(v.normal);
+		if (compression.normal == NormalFormat::Float32) {
+			put(p, v.normal);
+		}
+		else if (length > 0.0f) {
+			uint32_t packed = packOctahedral(v.normal / length);
+			put(p, packed);
+			normalError = std::min(normalError, glm::dot(octahedralDecode(glm::unpackSnorm2x16(packed)), v.normal / length));
+		}
+		p += normalSize;
+
+		if (compression.texCoord == TexCoordFormat::Float32) {
+			put(p, v.texCoord);
+		}
+		else {
+			uint32_t packed = glm::packHalf2x16(v.texCoord);
+			put(p, packed);
+			glm::vec2 error = glm::abs(glm::unpackHalf2x16(packed) - v.texCoord);
+			texCoordError = std::max(texCoordError, std::max(error.x, error.y));
+		}
+	}
+
+	bool shortIndices = compression.shortIndices && mesh.vertices.size() <= 65536;
+	out.indexType = shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	if (shortIndices) {
+		out.indices.resize(mesh.indices.size() * 2);
+		for (size_t i = 0; i < mesh.indices.size(); i++) {
+			put(out.indices.data() + i * 2, (uint16_t)mesh.indices[i]);
+		}
+	}
+	else {
+		out.indices.resize(mesh.indices.size() * 4);
+		if (!mesh.indices.empty()) {
+			memcpy(out.indices.data(), mesh.indices.data(), out.indices.size());
+		}
+	}
+
+	if (report) {
+		glm::vec3 extent = mesh.boundsMax - mesh.boundsMin;
+		float largest = std::max(extent.x, std::max(extent.y, extent.z));
+		float acmr = analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size()).acmr;
+		report->vertexBytesBefore = mesh.vertices.size() * sizeof(Vertex);
+		report->vertexBytesAfter = out.vertices.size();
+		report->indexBytesBefore = mesh.indices.size() * sizeof(uint32_t);
+		report->indexBytesAfter = out.indices.size();
+		report->fetchBytesPerTriangleBefore = acmr * sizeof(Vertex) + 3 * sizeof(uint32_t);
+		report->fetchBytesPerTriangleAfter = acmr * out.stride + 3 * (shortIndices ? 2 : 4);
+		report->positionError = positionError;
+		report->positionErrorRelative = largest > 0.0f ? positionError / largest : 0.0f;
+		report->normalErrorDegrees = glm::degrees(std::acos(glm::clamp(normalError, -1.0f, 1.0f)));
+		report->texCoordError = texCoordError;
+	}
+}
+
+void printCompressionReport(const CompressionReport& r) {
+	size_t before = r.vertexBytesBefore + r.indexBytesBefore;
+	size_t after = r.vertexBytesAfter + r.indexBytesAfter;
+	std::cout << "Vertex compression: " << before << " -> " << after << " bytes (" << (before ? 100.0 - 100.0 * after / before : 0.0) << "% saved), "
+		<< r.fetchBytesPerTriangleBefore << " -> " << r.fetchBytesPerTriangleAfter << " fetched bytes per triangle" << std::endl;
+	std::cout << "  max error: position " << r.positionError << " (" << r.positionErrorRelative * 100.0f << "% of bounds), normal "
+		<< r.normalErrorDegrees << " degrees, texture coordinate " << r.texCoordError << std::endl;
+}
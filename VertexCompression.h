@@ -0,0 +1,71 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+#include "MeshFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// How each vertex attribute is stored in a cooked mesh. Every attribute starts on a 4 byte boundary.
+enum class PositionFormat {
+	Float32, // 12 bytes
+	Half,    // 8 bytes, xyz as GL_HALF_FLOAT plus padding. Precision drops far from the origin
+	Unorm16  // 8 bytes, normalized to the bounding box, MeshFile::positionDecode() maps it back
+};
+
+enum class NormalFormat {
+	Float32,     // 12 bytes
+	Octahedral16 // 4 bytes, octahedral map as two GL_SHORT snorm values, decoded in the vertex shader
+};
+
+enum class TexCoordFormat {
+	Float32, // 8 bytes
+	Half     // 4 bytes, GL_HALF_FLOAT
+};
+
+struct VertexCompression {
+	PositionFormat position = PositionFormat::Unorm16;
+	NormalFormat normal = NormalFormat::Octahedral16;
+	TexCoordFormat texCoord = TexCoordFormat::Half;
+	// 16 bit indices when every vertex index fits
+	bool shortIndices = true;
+
+	//the Vertex layout as is, 32 bytes per vertex and 32 bit indices
+	static VertexCompression none();
+};
+
+// Vertex and index streams in their GPU layout, plus the attribute setup that reads them.
+struct EncodedMesh {
+	std::vector<unsigned char> vertices;
+	std::vector<unsigned char> indices;
+	std::vector<MeshFileAttribute> attributes;
+	uint32_t stride;
+	uint32_t indexType;
+	uint32_t normalEncoding;
+	// decoded position = offset + stored position * scale
+	glm::vec3 positionOffset;
+	glm::vec3 positionScale;
+};
+
+// Memory, vertex fetch bandwidth and the largest error every attribute picked up.
+struct CompressionReport {
+	size_t vertexBytesBefore, vertexBytesAfter;
+	size_t indexBytesBefore, indexBytesAfter;
+	// bytes read per triangle after the post-transform cache, from the simulated ACMR
+	float fetchBytesPerTriangleBefore, fetchBytesPerTriangleAfter;
+	float positionError;       // in model units
+	float positionErrorRelative; // to the largest bounding box side
+	float normalErrorDegrees;
+	float texCoordError;
+};
+
+//encodes mesh with the given formats, fills report when given
+void encodeMesh(const Mesh& mesh, const VertexCompression& compression, EncodedMesh& out, CompressionReport* report = nullptr);
+void printCompressionReport(const CompressionReport& report);
+
+//octahedral mapping of a unit vector to [-1, 1]^2 and back
+glm::vec2 octahedralEncode(glm::vec3 n);
+glm::vec3 octahedralDecode(glm::vec2 e);
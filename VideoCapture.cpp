@@ -0,0 +1,143 @@
+#include "VideoCapture.h"
+#include "CpuProfiler.h"
+#include "PixelConvert.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#if defined(_WIN32)
+#define popen _popen
+#define pclose _pclose
+#endif
+
+static bool endsWith(const std::string& text, const char* suffix) {
+	size_t length = strlen(suffix);
+	return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+VideoCapture::VideoCapture() : file(nullptr), pipe(false), y4m(false), width(0), height(0), tail(0), head(0), writtenFrames(0), droppedFrames(0),
+	stopping(false), failed(false) {
+}
+
+VideoCapture::~VideoCapture() {
+	stop();
+}
+
+bool VideoCapture::start(const char* path, int width, int height, int fps, int slotCount) {
+	stop();
+	this->path = path;
+	this->width = width;
+	this->height = height;
+	y4m = !endsWith(this->path, ".yuv");
+	pipe = y4m && !endsWith(this->path, ".y4m");
+	if (pipe) {
+		const char* ffmpeg = getenv("FFMPEG");
+		std::string command = std::string("\"") + (ffmpeg ? ffmpeg : "ffmpeg") + "\" -loglevel error -y -f yuv4mpegpipe -i - \"" + this->path + "\"";
+#if !defined(_WIN32)
+		// a write to an ffmpeg that quit must fail, not end the program
+		signal(SIGPIPE, SIG_IGN);
+		file = popen(command.c_str(), "w");
+#else
+		file = popen(command.c_str(), "wb");
+#endif
+	}
+	else {
+		file = fopen(path, "wb");
+	}
+	if (!file) {
+		std::cout << "Failed to open " << (pipe ? "a pipe to ffmpeg for " : "") << path << std::endl;
+		return false;
+	}
+	if (y4m) {
+		// chroma sits between the four pixels it was averaged from, which is what 420jpeg means
+		fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XYSCSS=420JPEG XCOLORRANGE=LIMITED\n", width, height, fps);
+	}
+	size_t bytes = (size_t)width * height + 2 * (size_t)((width + 1) / 2) * ((height + 1) / 2);
+	slots.resize(slotCount);
+	for (Slot& slot : slots) {
+		slot.frame = 0;
+		slot.yuv.resize(bytes);
+	}
+	tail = 0;
+	head = 0;
+	writtenFrames = 0;
+	droppedFrames = 0;
+	stopping = false;
+	failed = false;
+	encoder = std::thread(&VideoCapture::run, this);
+	return true;
+}
+
+void VideoCapture::push(const FrameReadback::Image& image) {
+	if (!file) {
+		return;
+	}
+	size_t index = tail.load(std::memory_order_relaxed);
+	if (index - head.load(std::memory_order_acquire) == slots.size() || image.width != width || image.height != height) {
+		droppedFrames++;
+		return;
+	}
+	CPU_ZONE("VideoCapture::push");
+	Slot& slot = slots[index % slots.size()];
+	slot.frame = image.frame;
+	unsigned char* y = slot.yuv.data();
+	unsigned char* u = y + (size_t)width * height;
+	unsigned char* v = u + (size_t)((width + 1) / 2) * ((height + 1) / 2);
+	// starts from the top row and walks up through memory, the image is bottom up
+	convertRGBAToYUV420(image.row(0), -(ptrdiff_t)width * 4, width, height, y, u, v);
+	tail.store(index + 1, std::memory_order_release);
+	// without the lock a wakeup can be missed, the encoder looks again after a few milliseconds anyway
+	wake.notify_one();
+}
+
+void VideoCapture::run() {
+	CpuProfiler::setThreadName("VideoCapture encoder");
+	while (true) {
+		size_t index = head.load(std::memory_order_relaxed);
+		if (index == tail.load(std::memory_order_acquire)) {
+			if (stopping) {
+				return;
+			}
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait_for(lock, std::chrono::milliseconds(4));
+			continue;
+		}
+		Slot& slot = slots[index % slots.size()];
+		if (!failed) {
+			CPU_ZONE("write frame");
+			bool ok = !y4m || fputs("FRAME\n", file) >= 0;
+			ok = ok && fwrite(slot.yuv.data(), 1, slot.yuv.size(), file) == slot.yuv.size();
+			if (ok) {
+				writtenFrames++;
+			}
+			else {
+				failed = true;
+				std::cout << "Failed to write video frame " << slot.frame << " to " << path << ", recording stops" << std::endl;
+			}
+		}
+		head.store(index + 1, std::memory_order_release);
+	}
+}
+
+bool VideoCapture::stop() {
+	if (!file) {
+		return false;
+	}
+	stopping = true;
+	wake.notify_one();
+	encoder.join();
+	bool ok = !failed;
+	if (pipe) {
+		// waits for ffmpeg to finish encoding
+		ok = pclose(file) == 0 && ok;
+	}
+	else {
+		ok = fclose(file) == 0 && ok;
+	}
+	file = nullptr;
+	slots.clear();
+	return ok;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "FrameReadback.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Records frames from a FrameReadback as video. push() runs on the readback's worker: it converts the frame to
+// YUV 4:2:0 (SSE2, see convertRGBAToYUV420) straight out of the mapped readback buffer into the next free slot of
+// a bounded single producer, single consumer ring, and an encoder thread writes the slots out in order. Neither
+// side takes a lock to hand a frame over; the encoder only sleeps on a condition variable when the ring is empty.
+// When the ring is full the frame is dropped and counted, the readback slot is never held while writing.
+//
+// The file name picks the output: .y4m writes YUV4MPEG2, .yuv raw I420 planes, anything else is encoded by
+// ffmpeg (the FFMPEG environment variable, else ffmpeg on the PATH) fed Y4M through a pipe.
+class VideoCapture
+{
+public:
+	VideoCapture();
+	~VideoCapture();
+	VideoCapture(const VideoCapture&) = delete;
+	VideoCapture& operator=(const VideoCapture&) = delete;
+
+	//opens the output and starts the encoder for width x height frames, slots frames of room between the two
+	bool start(const char* path, int width, int height, int fps = 60, int slots = 8);
+	//converts and queues one frame, or drops it when the encoder is behind. Call from one thread only.
+	void push(const FrameReadback::Image& image);
+	//writes every queued frame and closes the output, false if any write failed
+	bool stop();
+	bool recording() const { return file != nullptr; }
+
+	//frames written so far
+	size_t written() const { return writtenFrames.load(); }
+	//frames push() found no room for
+	size_t dropped() const { return droppedFrames.load(); }
+
+private:
+	struct Slot {
+		uint64_t frame;
+		std::vector<unsigned char> yuv;
+	};
+
+	void run();
+
+	FILE* file;
+	bool pipe;
+	bool y4m;
+	int width;
+	int height;
+	std::string path;
+	std::vector<Slot> slots;
+	// next slot push() fills and next slot the encoder writes, both count up forever
+	std::atomic<size_t> tail;
+	std::atomic<size_t> head;
+	std::atomic<size_t> writtenFrames;
+	std::atomic<size_t> droppedFrames;
+	std::atomic<bool> stopping;
+	bool failed;
+	std::thread encoder;
+	std::mutex mutex;
+	std::condition_variable wake;
+};
@@ -0,0 +1,12 @@
+#version 420 core
+out vec4 FragColor;
+in vec4 color;
+in vec2 corner;
+void main(){
+    // round soft sprite, fades towards the edge
+    float d = dot(corner, corner);
+    if (d > 1.0) {
+        discard;
+    }
+    FragColor = vec4(color.rgb, color.a * (1.0 - d));
+}
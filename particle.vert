@@ -0,0 +1,16 @@
+#version 420 core
+// one camera facing quad per instance, the four corners come from gl_VertexID of a triangle strip
+layout(location = 0) in vec3 aPosition;
+layout(location = 1) in vec4 aColor;
+out vec4 color;
+out vec2 corner;
+uniform mat4 view;
+uniform mat4 projection;
+uniform float size;
+void main(){
+    corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    color = aColor;
+    vec4 viewPos = view * vec4(aPosition, 1.0);
+    viewPos.xy += corner * size;
+    gl_Position = projection * viewPos;
+}
@@ -1,6 +1,5 @@
 #version 420 core
 out vec4 FragColor;
-in vec3 ourColor;
 in vec3 vertexPos;
 in vec2 textCoord;
 uniform sampler2D ourTexture;
@@ -1,17 +1,29 @@
 #version 420 core
 layout(location = 0) in vec3 aPos;
-layout(location = 1) in vec3 aColor;
+layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 atextCoord;
 // uniform float xOffset;
-out vec3 ourColor;
+out vec3 normal;
 out vec3 vertexPos;
 out vec2 textCoord;
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+// expands quantized positions to model space, identity for float positions
+uniform mat4 meshDecode;
+// normals stored as two snorm octahedral coordinates instead of xyz
+uniform bool octahedralNormals;
+vec3 octDecode(vec2 e){
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
 void main(){
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-    vertexPos = aPos;
-    ourColor = aColor;
+    vec3 position = (meshDecode * vec4(aPos, 1.0)).xyz;
+    gl_Position = projection * view * model * vec4(position, 1.0);
+    vertexPos = position;
+    normal = mat3(model) * (octahedralNormals ? octDecode(aNormal.xy) : aNormal);
     textCoord = atextCoord;
 }
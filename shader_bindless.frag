@@ -0,0 +1,17 @@
+#version 440 core
+#extension GL_ARB_bindless_texture : require
+out vec4 FragColor;
+in vec2 textCoord;
+// texture handles written by TextureManager::upload, two per material.
+struct Material {
+    uvec2 diffuse;
+    uvec2 overlay;
+};
+layout(std430, binding = 0) readonly buffer Materials {
+    Material materials[];
+};
+uniform int materialIndex;
+void main(){
+    Material m = materials[materialIndex];
+    FragColor = mix(texture(sampler2D(m.diffuse), textCoord), texture(sampler2D(m.overlay), textCoord), 0.2);
+}
@@ -0,0 +1,40 @@
+#version 430 core
+// shader.vert for GPU culled draws: the model matrix comes from the instance buffer the culling pass read.
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 atextCoord;
+// index into instances, an instanced attribute stepped by each command's baseInstance
+layout(location = 3) in uint instanceIndex;
+out vec3 normal;
+out vec3 vertexPos;
+out vec2 textCoord;
+struct Instance {
+    mat4 model;
+    vec4 sphere;
+    uint firstIndex;
+    uint indexCount;
+    int baseVertex;
+    uint pad;
+};
+layout(std430, binding = 1) readonly buffer Instances {
+    Instance instances[];
+};
+uniform mat4 view;
+uniform mat4 projection;
+uniform mat4 meshDecode;
+uniform bool octahedralNormals;
+vec3 octDecode(vec2 e){
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+void main(){
+    mat4 model = instances[instanceIndex].model;
+    vec3 position = (meshDecode * vec4(aPos, 1.0)).xyz;
+    gl_Position = projection * view * model * vec4(position, 1.0);
+    vertexPos = position;
+    normal = mat3(model) * (octahedralNormals ? octDecode(aNormal.xy) : aNormal);
+    textCoord = atextCoord;
+}
@@ -0,0 +1,36 @@
+#version 420 core
+// shader.vert for skinned meshes: every vertex follows up to four joints, blended as dual quaternions so
+// twisting joints keep their volume instead of collapsing like blended matrices do.
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 atextCoord;
+layout(location = 3) in uvec4 aJoints;
+layout(location = 4) in vec4 aWeights;
+out vec3 normal;
+out vec3 vertexPos;
+out vec2 textCoord;
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+// skinning palette, column 0 is the rotation quaternion (xyz, w) and column 1 the dual part
+uniform mat2x4 bones[64];
+void main(){
+    mat2x4 first = bones[aJoints.x];
+    mat2x4 blended = aWeights.x * first;
+    // q and -q are the same rotation, flip joints whose quaternion points away from the first one
+    for (int i = 1; i < 4; i++) {
+        mat2x4 bone = bones[aJoints[i]];
+        float weight = dot(bone[0], first[0]) < 0.0 ? -aWeights[i] : aWeights[i];
+        blended += weight * bone;
+    }
+    float len = length(blended[0]);
+    vec4 real = blended[0] / len;
+    vec4 dual = blended[1] / len;
+    vec3 position = aPos + 2.0 * cross(real.xyz, cross(real.xyz, aPos) + real.w * aPos);
+    position += 2.0 * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+    vec3 n = aNormal + 2.0 * cross(real.xyz, cross(real.xyz, aNormal) + real.w * aNormal);
+    gl_Position = projection * view * model * vec4(position, 1.0);
+    vertexPos = position;
+    normal = mat3(model) * n;
+    textCoord = atextCoord;
+}
@@ -1,11 +1,45 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include <chrono>
+#include <cstring>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/packing.hpp>
 
 #include "../Shader.h"
+#include "../TextureManager.h"
+#include "../StateTracker.h"
+#include "../MeshImporter.h"
+#include "../MeshFile.h"
+#include "../VertexCompression.h"
+#include "../Meshlets.h"
+#include "../MeshSimplifier.h"
+#include "../LodSelector.h"
+#include "../GpuCuller.h"
+#include "../Animation.h"
+#include "../AnimationCompression.h"
+#include "../ParticleSystem.h"
+#include "../ParticleRenderer.h"
+#include "../HeadlessContext.h"
+#include "../GpuProfiler.h"
+#include "../CpuProfiler.h"
+#include "../RenderStats.h"
+#include "../GLInterposer.h"
+#include "../GLCapture.h"
+#include "../NullGL.h"
+#include "../FrameReadback.h"
+#include "../VideoCapture.h"
+#include "../CpuFeatures.h"
+#include "../PixelConvert.h"
+#include "../ThreadPool.h"
+#include <random>
+#include <algorithm>
+#include <cstddef>
+#include <cmath>
+#include <fstream>
+#include <sstream>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -42,151 +76,1516 @@ void processInput(GLFWwindow* window) {
 	}
 }
 
-int main() {
-	// Initialising glfw and creating window context
-	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+// Imports and optimizes an OBJ or glTF file and writes it in the cooked format, reports how both loaders perform.
+bool cookMesh(const char* source, const char* cooked, const VertexCompression& compression) {
+	Mesh mesh;
+	MeshImporter importer;
+	importer.optimize = true;
+	// reorders triangles for the vertex cache and overdraw and vertices for fetch locality, prints ACMR/ATVR before and after
+	if (!importer.load(source, mesh)) {
+		return false;
+	}
+	std::cout << "Imported " << source << ": " << mesh.triangleCount() << " triangles in " << importer.seconds * 1000.0 << " ms ("
+		<< importer.bytesRead / 1e6 / importer.seconds << " MB/s, " << mesh.triangleCount() / 1e6 / importer.seconds << " M triangles/s)" << std::endl;
+	auto lodStart = std::chrono::steady_clock::now();
+	buildLods(mesh);
+	// quadric error simplification appends coarser index ranges that reuse the same vertices, each about half the previous one
+	std::cout << "Levels of detail in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - lodStart).count() * 1000.0 << " ms:";
+	for (const MeshLod& lod : mesh.lods) {
+		std::cout << " " << lod.indexCount / 3 << " (error " << lod.error << ")";
+	}
+	std::cout << std::endl;
+	buildMeshlets(mesh);
+	// clusters of up to 64 vertices and 124 triangles with bounds for culling, built on the final triangle order of every level
+	CompressionReport report;
+	if (!MeshFile::write(cooked, mesh, compression, source, &report)) {
+		return false;
+	}
+	printCompressionReport(report);
 
-	GLFWwindow* main_window = glfwCreateWindow(800, 600, "RockingEngine", NULL, NULL); // returns NULL if gone wrong.
+	// loading the cooked file is mapping it plus the page faults of reading it once, which the driver does during glBufferData
+	auto start = std::chrono::steady_clock::now();
+	MeshFile file;
+	if (!file.open(cooked)) {
+		return false;
+	}
+	unsigned int checksum = 0;
+	const unsigned char* streams[] = { (const unsigned char*)file.vertexData(), (const unsigned char*)file.indexData() };
+	size_t sizes[] = { file.vertexBytes(), file.indexBytes() };
+	for (int s = 0; s < 2; s++) {
+		for (size_t i = 0; i < sizes[s]; i += 64) {
+			checksum += streams[s][i];
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double bytes = (double)(sizes[0] + sizes[1]);
+	std::cout << "Cooked " << cooked << ": " << bytes / 1e6 << " MB loads in " << seconds * 1000.0 << " ms (" << bytes / 1e6 / seconds
+		<< " MB/s, " << importer.seconds / seconds << "x faster than importing, checksum " << checksum << ")" << std::endl;
+	return true;
+}
 
-	if (main_window == NULL) {
-		std::cout << "Failed to Create window using glfw." << std::endl;
-		glfwTerminate();
-		return -1;
+// Flies a camera over a large field of instances of one mesh and compares the triangles submitted at full detail with
+// the levels the LodSelector picks, with and without hysteresis. Runs on the CPU only, no window is opened.
+bool benchmarkLods(const char* source) {
+	Mesh mesh;
+	MeshImporter importer;
+	importer.optimize = true;
+	if (!importer.load(source, mesh)) {
+		return false;
 	}
+	buildLods(mesh);
+	float radius = glm::length(mesh.boundsMax - mesh.boundsMin) * 0.5f;
+	// instances are placed by the centers of their bounds, three radii apart
 
-	glfwMakeContextCurrent(main_window);
+	const int side = 100;
+	std::vector<glm::vec3> instances;
+	for (int z = 0; z < side; z++) {
+		for (int x = 0; x < side; x++) {
+			instances.push_back(glm::vec3((x - side / 2) * radius * 3.0f, 0.0f, -z * radius * 3.0f));
+		}
+	}
+	// 1080p with a 55 degree vertical field of view, as in the render loop
+	float focalPixels = 1080 / (2.0f * tan(glm::radians(55.0f) / 2.0f));
+	const int frames = 600;
+	float hysteresisValues[] = { 0.0f, 0.25f };
+	for (float hysteresis : hysteresisValues) {
+		LodSelector selector(1.0f, hysteresis);
+		double fullTriangles = 0.0, drawnTriangles = 0.0, seconds = 0.0;
+		std::vector<size_t> levelUse(mesh.lods.size(), 0);
+		for (int frame = 0; frame < frames; frame++) {
+			// moves into the field with a small back and forth wobble, which is what makes levels pop
+			float t = (float)frame / frames;
+			glm::vec3 camera(0.0f, radius, radius * (3.0f - t * side * 0.3f + 0.5f * sin(frame * 0.5f)));
+			auto start = std::chrono::steady_clock::now();
+			size_t triangles = 0;
+			for (size_t i = 0; i < instances.size(); i++) {
+				int level = selector.select(i, mesh.lods.data(), mesh.lods.size(), glm::length(instances[i] - camera), 1.0f, focalPixels);
+				triangles += mesh.lods[level].indexCount / 3;
+				levelUse[level]++;
+			}
+			seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			drawnTriangles += (double)triangles;
+			fullTriangles += (double)mesh.lods[0].indexCount / 3 * instances.size();
+		}
+		std::cout << "LOD field of " << instances.size() << " instances, hysteresis " << hysteresis << ": " << drawnTriangles / frames / 1e6 << " M triangles per frame instead of "
+			<< fullTriangles / frames / 1e6 << " M (" << fullTriangles / drawnTriangles << "x fewer), selection " << seconds / frames * 1000.0 << " ms per frame, "
+			<< selector.switches << " level switches" << std::endl;
+		std::cout << "  instances per level:";
+		for (size_t level = 0; level < levelUse.size(); level++) {
+			std::cout << " " << level << ": " << (double)levelUse[level] / frames;
+		}
+		std::cout << std::endl;
+	}
+	return true;
+}
 
-	// Initialising Glad here
-	// GLAD manages function pointers for OpenGL so we want to initialise GLAD before we call any OpenGL function.
-	// We pass the GLAD the function to load the address of the OpenGL function pointers which are OS Specific.
-	// GLFW gives us glfwGetProcAddress that defines the correct function based on which OS we're compiling for.
-	// just in case https://computergraphics.stackexchange.com/questions/8639/this-function-syntax-is-confusing-me
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-		std::cout << "Failed to initialise GLAD !" << std::endl;
-		return -1;
+// Procedural animation content, there is no importer for skeletons and clips yet. The skeleton either is one chain
+// along +y or branches a new chain every few joints like limbs off a spine. The clip swings every joint around its
+// own axis a whole number of times over the clip so it loops, the root also bobs up and down.
+Skeleton proceduralSkeleton(size_t jointCount, float boneLength, bool chain, unsigned int seed) {
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+	Skeleton skeleton;
+	for (size_t j = 0; j < jointCount; j++) {
+		int parent = j == 0 ? -1 : (int)j - 1;
+		if (!chain && j > 4 && random() % 4 == 0) {
+			parent = (int)(random() % 4);
+			// new limb off the spine
+		}
+		JointPose pose;
+		pose.rotation = chain ? glm::quat(1.0f, 0.0f, 0.0f, 0.0f) : glm::angleAxis(0.5f * uniform(random), glm::normalize(glm::vec3(uniform(random), uniform(random), uniform(random)) + glm::vec3(0.0f, 0.0f, 2.0f)));
+		pose.translation = j == 0 ? glm::vec3(0.0f) : glm::vec3(0.0f, boneLength, 0.0f);
+		pose.scale = glm::vec3(1.0f);
+		skeleton.names.push_back("joint" + std::to_string(j));
+		skeleton.parents.push_back(parent);
+		skeleton.bindPose.push_back(pose);
 	}
+	skeleton.computeInverseBind();
+	return skeleton;
+}
 
-	// Setting up viewport
-	glViewport(0, 0, 800, 600);
+std::vector<JointPose> proceduralClip(const Skeleton& skeleton, float seconds, float sampleRate, float swing, unsigned int seed) {
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+	size_t joints = skeleton.jointCount();
+	std::vector<glm::vec3> axes(joints);
+	std::vector<float> amplitudes(joints), cycles(joints), phases(joints);
+	for (size_t j = 0; j < joints; j++) {
+		axes[j] = glm::normalize(glm::vec3(uniform(random), 0.3f * uniform(random), uniform(random)) + glm::vec3(0.0f, 0.0f, 0.5f));
+		amplitudes[j] = swing * (0.6f + 0.4f * uniform(random));
+		cycles[j] = (float)(1 + random() % 2);
+		phases[j] = 3.14159265f * uniform(random);
+	}
+	size_t frameCount = (size_t)(seconds * sampleRate) + 1;
+	std::vector<JointPose> frames(frameCount * joints);
+	for (size_t f = 0; f < frameCount; f++) {
+		float t = f / (float)(frameCount - 1);
+		for (size_t j = 0; j < joints; j++) {
+			JointPose pose = skeleton.bindPose[j];
+			float angle = amplitudes[j] * sin(2.0f * 3.14159265f * cycles[j] * t + phases[j]);
+			pose.rotation = pose.rotation * glm::angleAxis(angle, axes[j]);
+			if (j == 0) {
+				pose.translation.y += 0.05f * sin(4.0f * 3.14159265f * t);
+			}
+			frames[f * joints + j] = pose;
+		}
+	}
+	return frames;
+}
 
-	// Checking for window resize
-	glfwSetFramebufferSizeCallback(main_window, framebuffer_size_callback);
+// Drives MipResidency along a scripted camera path past a row of textured objects, CPU only. Checks every frame that
+// the budget holds and the byte count matches the resident levels, that textures the camera left behind lose their
+// detail least recently used first, and that the object the camera stops at ends up fully resident.
+bool testMipResidency() {
+	const int objects = 8, size = 1024, bytesPerTexel = 4;
+	const float spacing = 10.0f, focalPixels = 600.0f / (2.0f * std::tan(glm::radians(55.0f) * 0.5f));
+	MipResidency residency(12 * 1024 * 1024);
+	// each full chain is 5.6 MB, so about two objects fit at full detail. Texture i sits at slot[i] along the row, so
+	// evicting by index instead of by last use would show.
+	const int slot[objects] = { 3, 0, 6, 1, 7, 4, 2, 5 };
+	for (int i = 0; i < objects; i++) {
+		residency.add(size, size, bytesPerTexel);
+	}
+	size_t floorBytes = residency.residentBytes();
 
-	//// =============================================================================================== //
+	bool passed = true;
+	auto check = [&](bool condition, const char* what, int frame) {
+		if (!condition && passed) {
+			std::cout << "  failed at frame " << frame << ": " << what << std::endl;
+		}
+		passed = passed && condition;
+	};
+	// flies along the row 2 units to the side looking down +x, then stops next to the last object
+	const int flyFrames = 400, parkFrames = 40;
+	std::vector<int> evictionOrder;
+	size_t peakBytes = 0, streamedIn = 0, evicted = 0;
+	for (int frame = 0; frame < flyFrames + parkFrames; frame++) {
+		float x = -5.0f + std::min(frame, flyFrames - 1) * (spacing * (objects - 1) + 4.0f) / (flyFrames - 1);
+		glm::vec3 camera(x, 0.0f, 2.0f);
+		for (int i = 0; i < objects; i++) {
+			glm::vec3 offset = glm::vec3(slot[i] * spacing, 0.0f, 0.0f) - camera;
+			// behind the camera means not drawn, so not requested
+			if (offset.x < -1.0f) {
+				continue;
+			}
+			float pixels = MipResidency::projectedSize(1.0f, glm::length(offset), focalPixels);
+			residency.request(i, MipResidency::levelForDensity(size, pixels));
+		}
+		for (const MipResidency::Change& change : residency.update()) {
+			check(change.newBase == residency.residentBase(change.texture), "change does not match the resident base", frame);
+			if (change.newBase > change.oldBase) {
+				evicted += change.newBase - change.oldBase;
+				if (std::find(evictionOrder.begin(), evictionOrder.end(), slot[change.texture]) == evictionOrder.end()) {
+					evictionOrder.push_back(slot[change.texture]);
+				}
+			}
+			else {
+				streamedIn += change.oldBase - change.newBase;
+			}
+		}
+		size_t bytes = 0;
+		for (int i = 0; i < objects; i++) {
+			bytes += residency.bytesFrom(i, residency.residentBase(i));
+		}
+		check(bytes == residency.residentBytes(), "resident bytes don't add up", frame);
+		check(bytes <= residency.budget(), "over budget", frame);
+		check(bytes >= floorBytes, "a low mip was dropped", frame);
+		peakBytes = std::max(peakBytes, bytes);
+	}
+	// texture 4 is in the last slot
+	check(residency.residentBase(4) == 0, "the object the camera stopped at is not fully resident", flyFrames + parkFrames);
+	check(std::is_sorted(evictionOrder.begin(), evictionOrder.end()), "textures were not evicted in the order the camera passed them", flyFrames + parkFrames);
+	check(evictionOrder.size() >= (size_t)objects - 2, "textures left behind kept their detail", flyFrames + parkFrames);
 
-	Shader ourShader("shader.vert", "shader.frag");
-	glEnable(GL_DEPTH_TEST);
-	// enables depth test
-	
-// Generating and Loading Textures --------------------------------------------------------
-	
-	unsigned int texture;
-	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
-	// sets the given texture as currently bound texture. Any subsequent texture operations will affect the currently bound texture object.
-
-	//glTexParameteri sets texture parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); // repeat tex on s axis
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT); // repeat tex on t axis
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); // linear filter when downsclaling(minifying) image.
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); // linear filter when upscaling(magnifying) image.
-
-	stbi_set_flip_vertically_on_load(true);
-	// it is a flag so we have to set it once and it will be set for whole program and should be used before loading image!.
-	// Image is flipped on load because opengl expects y axis 0 to be on bottom. but usually we take it on top so we have to flip image.
-
-
-	// Opening stbi_image-----------------------------------------------------------
-	int width, height, nrChannels;
-	unsigned char* data = stbi_load("Textures/container.jpg", &width, &height, &nrChannels, 0);
-	// first argument takes in location of texture file.
-	// second argument provides width
-	// third argument provides height
-	// The last argument of the function is useful if for example you want to load only the R, G, B channels from a four channel, PNG, image and ignore the transparency channel. If you want to load the image as is, pass 0 as the last parameter of the load function.
-
-	if (data) {
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-	// This function generates the texture image for currently bound texture object
-	// first argument - specifies the texture target; setting it to GL_TEXTURE_2D will generate a texture on currently bound texture object at the same target(so any textures bound to GL_TEXTURE_1D or any other target will not be affected).
-	// second argument - specifies mipmap level for which we want to create a texture for if you want to set each mipmap level manually, but we'll leave it at base level 0.
-	// third argument - third argument tells in what format we want to store the texture. Our image as rgb value so we'll store it as GL_RGB.
-	// fourth argument and fifth argument - sets the width and height for resulting texture. We stored this earlier.
-	// sixth argument - should always be zero(some legacy stuff).
-	// seventh argument and eighth argument - specifies the format and datatype of the source image. We loaded the image with rgb format and stored it chars(bytes).
-	// ninth argument - actual image data.
-	glGenerateMipmap(GL_TEXTURE_2D);
-	// creates all the required mipmaps. If we want to use those mipmaps we have to manually apply mipmaps by incrementing the second argument of glTexImage2D function.
+	std::cout << "Mip residency test, " << objects << " textures of " << size << "x" << size << " over " << flyFrames + parkFrames << " frames: peak "
+		<< peakBytes / 1e6 << " of " << residency.budget() / 1e6 << " MB, " << streamedIn << " levels streamed in, " << evicted << " evicted, objects evicted in the order";
+	for (int position : evictionOrder) {
+		std::cout << " " << position;
 	}
+	std::cout << (passed ? ", passed" : ", FAILED") << std::endl;
+	return passed;
+}
 
-	else {
-		std::cout << "Failed to load image data" << std::endl;
+// Compresses a set of procedural clips at several tolerances and reports size, kept keys and the measured model space
+// error per joint, then plays many clips forward with StreamedClipCursor and with the uniform AnimationClip to compare
+// decompression throughput. Runs on the CPU only, no window is opened.
+bool benchmarkAnimationCompression() {
+	const size_t joints = 64;
+	const float sampleRate = 30.0f;
+	Skeleton skeleton = proceduralSkeleton(joints, 0.2f, false, 7);
+	std::vector<std::vector<JointPose>> sources;
+	for (unsigned int i = 0; i < 8; i++) {
+		sources.push_back(proceduralClip(skeleton, 10.0f, sampleRate, 0.3f + 0.1f * i, 10 + i));
+		// a quarter of the joints hold their bind pose, like fingers and face joints in most body clips
+		for (size_t f = 0; f < sources.back().size() / joints; f++) {
+			for (size_t j = 3; j < joints; j += 4) {
+				sources.back()[f * joints + j] = skeleton.bindPose[j];
+			}
+		}
+	}
+	size_t frameCount = sources[0].size() / joints;
+	std::cout << "Animation compression: " << sources.size() << " clips, " << joints << " joints, " << frameCount << " frames each" << std::endl;
+
+	size_t uniformBytes = 0;
+	float uniformError = 0.0f;
+	std::vector<AnimationClip> uniformClips;
+	for (const std::vector<JointPose>& source : sources) {
+		uniformClips.push_back(compressClip(source.data(), frameCount, joints, sampleRate));
+		uniformBytes += uniformClips.back().bytes();
+		std::vector<float> errors;
+		const AnimationClip& clip = uniformClips.back();
+		measureClipError(skeleton, source.data(), frameCount, 0.1f, [&](size_t frame, PoseSoA& pose) { sampleClip(clip, frame / sampleRate, false, pose); }, errors);
+		uniformError = std::max(uniformError, *std::max_element(errors.begin(), errors.end()));
+	}
+	size_t sourceBytes = sources.size() * frameCount * joints * sizeof(JointPose);
+	std::cout << "  float keys " << sourceBytes / 1024.0 << " KB, 16 bit uniform clips " << uniformBytes / 1024.0 << " KB with " << uniformError << " units error" << std::endl;
+
+	float tolerances[] = { 0.0001f, 0.001f, 0.01f };
+	std::vector<StreamedClip> streamedClips;
+	for (float tolerance : tolerances) {
+		AnimationCompressionSettings settings;
+		settings.tolerance = tolerance;
+		std::vector<StreamedClip> clips;
+		size_t bytes = 0, keys = 0, sourceKeys = 0, constantTracks = 0, tracks = 0;
+		float maxError = 0.0f, averageError = 0.0f;
+		std::vector<float> worstJoints(joints, 0.0f);
+		auto start = std::chrono::steady_clock::now();
+		for (const std::vector<JointPose>& source : sources) {
+			AnimationCompressionReport report;
+			clips.emplace_back();
+			if (!compressStreamedClip(skeleton, source.data(), frameCount, sampleRate, settings, clips.back(), &report)) {
+				return false;
+			}
+			bytes += report.bytes;
+			keys += report.keys;
+			sourceKeys += report.sourceKeys;
+			constantTracks += report.constantTracks;
+			tracks += report.tracks;
+			maxError = std::max(maxError, report.maxError);
+			averageError += report.averageError / sources.size();
+			for (size_t j = 0; j < joints; j++) {
+				worstJoints[j] = std::max(worstJoints[j], report.jointErrors[j]);
+			}
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "  tolerance " << tolerance << ": " << bytes / 1024.0 << " KB (" << (double)sourceBytes / bytes << "x smaller than floats, " << (double)uniformBytes / bytes
+			<< "x than uniform), " << constantTracks << " of " << tracks << " tracks constant, " << 100.0 * keys / sourceKeys << "% of animated keys kept, error max "
+			<< maxError << " average " << averageError << ", compressed and measured in " << seconds * 1000.0 << " ms" << std::endl;
+		std::vector<size_t> order(joints);
+		for (size_t j = 0; j < joints; j++) {
+			order[j] = j;
+		}
+		std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return worstJoints[a] > worstJoints[b]; });
+		std::cout << "    worst joints:";
+		for (size_t k = 0; k < 4; k++) {
+			std::cout << " " << skeleton.names[order[k]] << " " << worstJoints[order[k]];
+		}
+		std::cout << std::endl;
+		if (tolerance == 0.001f) {
+			streamedClips = clips;
+		}
+	}
+
+	// the AVX2 interpolation against the scalar one
+	StreamedClipCursor simdCursor(streamedClips[0]), scalarCursor(streamedClips[0]);
+	PoseSoA pose, reference;
+	float kernelDifference = 0.0f;
+	for (int i = 0; i < 600; i++) {
+		simdCursor.sampleFrame(i * 0.5f, pose);
+		scalarCursor.sampleFrameScalar(i * 0.5f, reference);
+		for (size_t k = 0; k < pose.data.size(); k++) {
+			kernelDifference = std::max(kernelDifference, std::abs(pose.data[k] - reference.data[k]));
+		}
+	}
+	std::cout << "  AVX2 " << (cpuFeatures().avx2 ? "on" : "off") << ", largest difference to the scalar interpolation " << kernelDifference << std::endl;
+
+	// many characters playing forward at 60 Hz, each on one of the clips at its own phase
+	const size_t characters = 1000;
+	const int frames = 300;
+	std::vector<StreamedClipCursor> cursors;
+	for (size_t i = 0; i < characters; i++) {
+		cursors.push_back(StreamedClipCursor(streamedClips[i % streamedClips.size()]));
+	}
+	auto playback = [&](bool streamed, bool seek, int frames) {
+		auto start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frames; frame++) {
+			for (size_t i = 0; i < characters; i++) {
+				// seeking plays backwards from the end, every sample restarts the stream and replays it up to the time
+				float time = (seek ? 600 - frame : frame) / 60.0f + i * 0.003f;
+				if (streamed) {
+					cursors[i].sample(time, pose);
+				}
+				else {
+					sampleClip(uniformClips[i % uniformClips.size()], time, true, pose);
+				}
+			}
+		}
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000.0;
+	};
+	double uniformMilliseconds = playback(false, false, frames);
+	size_t keysBefore = 0;
+	for (const StreamedClipCursor& cursor : cursors) {
+		keysBefore += cursor.decodedKeys;
+	}
+	double streamedMilliseconds = playback(true, false, frames);
+	size_t decoded = 0;
+	for (const StreamedClipCursor& cursor : cursors) {
+		decoded += cursor.decodedKeys;
 	}
+	decoded -= keysBefore;
+	const int seekFrames = 10;
+	double seekMilliseconds = playback(true, true, seekFrames);
+	double samples = (double)characters * frames;
+	std::cout << "  playback of " << characters << " characters: uniform " << samples * joints / uniformMilliseconds << " joints per ms, streamed " << samples * joints / streamedMilliseconds
+		<< " joints per ms (" << (double)decoded / samples << " keys decoded per sample), backwards with a restart every sample " << (double)characters * seekFrames * joints / seekMilliseconds << " joints per ms" << std::endl;
+	return kernelDifference < 1e-4f;
+}
+
+// Square column around a chain skeleton from proceduralSkeleton, each side a strip with four rings per bone.
+// Vertices between two bone centers blend those two joints by height.
+void buildSkinnedColumn(const Skeleton& skeleton, float boneLength, float width, std::vector<SkinnedVertex>& vertices, std::vector<uint32_t>& indices) {
+	size_t joints = skeleton.jointCount();
+	size_t rings = joints * 4 + 1;
+	float height = joints * boneLength;
+	glm::vec3 normals[] = { glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(-1.0f, 0.0f, 0.0f) };
+	for (int side = 0; side < 4; side++) {
+		glm::vec3 normal = normals[side];
+		glm::vec3 across = glm::cross(upDir, normal);
+		uint32_t first = (uint32_t)vertices.size();
+		for (size_t ring = 0; ring < rings; ring++) {
+			float y = height * ring / (rings - 1);
+			float bone = y / boneLength - 0.5f;
+			int lower = std::min(std::max((int)floor(bone), 0), (int)joints - 1);
+			int upper = std::min(lower + 1, (int)joints - 1);
+			float weight = std::min(std::max(bone - lower, 0.0f), 1.0f);
+			for (int edge = 0; edge < 2; edge++) {
+				SkinnedVertex vertex = {};
+				vertex.position = normal * (width * 0.5f) + across * (width * (edge - 0.5f)) + glm::vec3(0.0f, y, 0.0f);
+				vertex.normal = normal;
+				vertex.texCoord = glm::vec2((float)edge, y / width);
+				vertex.joints[0] = (uint8_t)lower;
+				vertex.joints[1] = (uint8_t)upper;
+				vertex.weights = glm::vec4(1.0f - weight, weight, 0.0f, 0.0f);
+				vertices.push_back(vertex);
+			}
+			if (ring > 0) {
+				uint32_t v = first + (uint32_t)ring * 2;
+				uint32_t quad[] = { v - 2, v - 1, v + 1, v - 2, v + 1, v };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+	}
+}
 
+// Checks the animation runtime against its references and measures it: quantization error at the keys, AVX2 against
+// the scalar kernels, dual quaternion against matrix palettes, then single thread and pooled throughput over many
+// characters that each cross fade two clips. Runs on the CPU only, no window is opened.
+bool benchmarkAnimation(size_t characterCount) {
+	const size_t joints = 64;
+	const float sampleRate = 30.0f;
+	Skeleton skeleton = proceduralSkeleton(joints, 0.2f, false, 7);
+	std::vector<JointPose> walkFrames = proceduralClip(skeleton, 1.0f, sampleRate, 0.6f, 1);
+	std::vector<JointPose> runFrames = proceduralClip(skeleton, 0.6f, sampleRate, 0.9f, 2);
+	AnimationClip walk = compressClip(walkFrames.data(), walkFrames.size() / joints, joints, sampleRate, "walk");
+	AnimationClip run = compressClip(runFrames.data(), runFrames.size() / joints, joints, sampleRate, "run");
+	std::cout << "Animation: " << joints << " joints, clips of " << walk.frameCount << " and " << run.frameCount << " keys, " << (walk.bytes() + run.bytes()) / 1024.0
+		<< " KB quantized instead of " << (walkFrames.size() + runFrames.size()) * 10 * sizeof(float) / 1024.0 << " KB of float keys" << std::endl;
 
-	stbi_image_free(data);
-	// as we have used image to generate textures and mipmaps. IT's a good practice to free image memory.
+	// quantization error at every key
+	PoseSoA pose, reference, blended;
+	float rotationError = 0.0f, translationError = 0.0f;
+	for (uint32_t f = 0; f < walk.frameCount; f++) {
+		sampleClip(walk, f / sampleRate, false, pose);
+		for (size_t j = 0; j < joints; j++) {
+			JointPose sampled = pose.joint(j), original = walkFrames[f * joints + j];
+			// angle of the difference rotation, atan2 stays accurate where acos of a dot product near 1 does not
+			glm::quat difference = glm::inverse(original.rotation) * sampled.rotation;
+			rotationError = std::max(rotationError, glm::degrees(2.0f * std::atan2(glm::length(glm::vec3(difference.x, difference.y, difference.z)), std::abs(difference.w))));
+			translationError = std::max(translationError, glm::length(sampled.translation - original.translation));
+		}
+	}
+	std::cout << "  quantization error at the keys: " << rotationError << " degrees, " << translationError << " units" << std::endl;
+
+	// the SIMD kernels against the scalar ones, and both palette kinds moving the same points
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+	float kernelDifference = 0.0f, paletteDifference = 0.0f;
+	std::vector<glm::dualquat> dualPalette(joints);
+	std::vector<glm::mat4> matrixPalette(joints);
+	for (int i = 0; i < 100; i++) {
+		float time = uniform(random) * 3.0f, weight = uniform(random);
+		sampleClip(walk, time, true, pose);
+		sampleClip(run, time, true, blended);
+		blendPoses(pose, blended, weight, blended);
+		sampleClipScalar(walk, time, true, pose);
+		sampleClipScalar(run, time, true, reference);
+		blendPosesScalar(pose, reference, weight, reference);
+		for (size_t k = 0; k < blended.data.size(); k++) {
+			kernelDifference = std::max(kernelDifference, std::abs(blended.data[k] - reference.data[k]));
+		}
+		computeDualQuatPalette(skeleton, blended, dualPalette.data());
+		computeMatrixPalette(skeleton, blended, matrixPalette.data());
+		for (size_t j = 0; j < joints; j++) {
+			glm::vec3 point(uniform(random), uniform(random), uniform(random));
+			glm::vec3 byDual = glm::normalize(dualPalette[j]) * point;
+			glm::vec3 byMatrix = glm::vec3(matrixPalette[j] * glm::vec4(point, 1.0f));
+			paletteDifference = std::max(paletteDifference, glm::length(byDual - byMatrix));
+		}
+	}
+	std::cout << "  AVX2 " << (cpuFeatures().avx2 ? "on" : "off") << ", largest difference to the scalar kernels " << kernelDifference
+		<< ", dual quaternion and matrix palettes agree within " << paletteDifference << " units" << std::endl;
 
-	// Creating second texture
-	unsigned int texture2;
-	glGenTextures(1, &texture2);
-	glBindTexture(GL_TEXTURE_2D, texture2);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	// one thread, sample two clips and blend, with and without the SIMD kernels
+	const int poses = 20000;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < poses; i++) {
+		sampleClipScalar(walk, i * 0.01f, true, pose);
+		sampleClipScalar(run, i * 0.01f, true, blended);
+		blendPosesScalar(pose, blended, 0.5f, blended);
+	}
+	auto scalarEnd = std::chrono::steady_clock::now();
+	for (int i = 0; i < poses; i++) {
+		sampleClip(walk, i * 0.01f, true, pose);
+		sampleClip(run, i * 0.01f, true, blended);
+		blendPoses(pose, blended, 0.5f, blended);
+	}
+	auto simdEnd = std::chrono::steady_clock::now();
+	for (int i = 0; i < poses; i++) {
+		computeDualQuatPalette(skeleton, blended, dualPalette.data());
+	}
+	auto dualEnd = std::chrono::steady_clock::now();
+	for (int i = 0; i < poses; i++) {
+		computeMatrixPalette(skeleton, blended, matrixPalette.data());
+	}
+	auto matrixEnd = std::chrono::steady_clock::now();
+	auto microseconds = [poses](std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b) {
+		return std::chrono::duration<double>(b - a).count() * 1e6 / poses;
+	};
+	std::cout << "  per character: sample and blend " << microseconds(start, scalarEnd) << " us scalar, " << microseconds(scalarEnd, simdEnd) << " us SIMD, palette "
+		<< microseconds(simdEnd, dualEnd) << " us dual quaternions, " << microseconds(dualEnd, matrixEnd) << " us matrices" << std::endl;
 
-	data = stbi_load("Textures/awesomeface.png", &width, &height, &nrChannels, 0);
-	if (data) {
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+	// every character cross fades walk and run at its own phase
+	std::vector<Character> characters(characterCount);
+	for (size_t i = 0; i < characterCount; i++) {
+		characters[i].skeleton = &skeleton;
+		characters[i].clips[0] = &walk;
+		characters[i].clips[1] = &run;
+		characters[i].blend = uniform(random);
+	}
+	ThreadPool& pool = ThreadPool::global();
+	const int frames = 60;
+	for (int dualQuaternions = 1; dualQuaternions >= 0; dualQuaternions--) {
+		start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frames; frame++) {
+			for (size_t i = 0; i < characterCount; i++) {
+				characters[i].times[0] += 1.0f / 60.0f;
+				characters[i].times[1] += 1.0f / 60.0f;
+			}
+			animateCharacters(characters.data(), characterCount, pool, dualQuaternions != 0);
+		}
+		double milliseconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000.0;
+		std::cout << "  " << characterCount << " characters, " << (dualQuaternions ? "dual quaternion" : "matrix") << " palettes: " << milliseconds / frames << " ms per frame, "
+			<< characterCount * frames / milliseconds / pool.size() << " characters per ms per core on " << pool.size() << " threads" << std::endl;
+	}
+	return rotationError < 0.1f && kernelDifference < 1e-4f && paletteDifference < 1e-3f;
+}
+
+// Times every PixelConvert kernel against its scalar reference on 4K and 8K frames, best of five runs each, and
+// checks that both produce the same bytes. Runs on the CPU only, no window is opened.
+bool benchmarkPixelKernels() {
+	const CpuFeatures& cpu = cpuFeatures();
+	std::cout << "Pixel kernels, SSSE3 " << (cpu.ssse3 ? "on" : "off") << ", AVX2 " << (cpu.avx2 ? "on" : "off") << ", F16C " << (cpu.f16c ? "on" : "off") << std::endl;
+	std::mt19937 random(5);
+	auto bestOf5 = [](const std::function<void()>& kernel) {
+		double best = 1e30;
+		for (int run = 0; run < 5; run++) {
+			auto start = std::chrono::steady_clock::now();
+			kernel();
+			best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		return best;
+	};
+	bool passed = true;
+	auto compare = [&](const char* name, const std::function<void()>& scalar, const std::function<void()>& dispatched, bool same) {
+		double scalarMs = bestOf5(scalar), dispatchedMs = bestOf5(dispatched);
+		std::cout << "  " << name << ": scalar " << scalarMs << " ms, dispatched " << dispatchedMs << " ms (" << scalarMs / dispatchedMs << "x)" << std::endl;
+		passed = passed && same;
+	};
+	// in place kernels run five times on both sides, so their results are still comparable
+	auto check = [&](bool same, const char* name) {
+		if (!same) {
+			std::cout << "  " << name << " differs from the scalar kernel" << std::endl;
+		}
+		return same;
+	};
+
+	int sizes[][2] = { { 3840, 2160 }, { 7680, 4320 } };
+	for (auto& size : sizes) {
+		int width = size[0], height = size[1];
+		size_t pixels = (size_t)width * height;
+		std::cout << " " << width << "x" << height << std::endl;
+		std::vector<unsigned char> rgba(pixels * 4);
+		for (unsigned char& c : rgba) {
+			c = (unsigned char)random();
+		}
+		{
+			std::vector<unsigned char> a(pixels * 4), b(pixels * 4);
+			auto scalar = [&] { expandRGBToRGBAScalar(rgba.data(), a.data(), pixels); };
+			auto dispatched = [&] { expandRGBToRGBA(rgba.data(), b.data(), pixels); };
+			scalar();
+			dispatched();
+			compare("expand RGB to RGBA", scalar, dispatched, check(a == b, "expand"));
+		}
+		{
+			std::vector<unsigned char> a = rgba, b = rgba;
+			compare("swizzle RGBA to BGRA", [&] { swizzleRGBAToBGRAScalar(a.data(), pixels); }, [&] { swizzleRGBAToBGRA(b.data(), pixels); }, true);
+			passed = check(a == b, "swizzle") && passed;
+		}
+		{
+			std::vector<unsigned char> a = rgba, b = rgba;
+			compare("premultiply alpha", [&] { premultiplyAlphaScalar(a.data(), pixels); }, [&] { premultiplyAlpha(b.data(), pixels); }, true);
+			passed = check(a == b, "premultiply") && passed;
+		}
+		{
+			std::vector<unsigned char> a = rgba, b = rgba;
+			compare("flip vertical", [&] { flipVerticalScalar(a.data(), (size_t)width * 4, height); }, [&] { flipVertical(b.data(), (size_t)width * 4, height); }, true);
+			passed = check(a == b, "flip") && passed;
+		}
+		std::vector<float> linear(pixels * 4);
+		{
+			std::vector<float> b(pixels * 4);
+			auto scalar = [&] { decodeSRGBScalar(rgba.data(), linear.data(), pixels * 4); };
+			auto dispatched = [&] { decodeSRGB(rgba.data(), b.data(), pixels * 4); };
+			scalar();
+			dispatched();
+			compare("decode sRGB", scalar, dispatched, check(linear == b, "decode sRGB"));
+		}
+		{
+			std::vector<unsigned char> a(pixels * 4), b(pixels * 4);
+			auto scalar = [&] { encodeSRGBScalar(linear.data(), a.data(), pixels * 4); };
+			auto dispatched = [&] { encodeSRGB(linear.data(), b.data(), pixels * 4); };
+			scalar();
+			dispatched();
+			compare("encode sRGB", scalar, dispatched, check(a == b, "encode sRGB"));
+		}
+		{
+			std::vector<uint16_t> a(pixels * 4), b(pixels * 4);
+			auto scalar = [&] { packHalfScalar(linear.data(), a.data(), pixels * 4); };
+			auto dispatched = [&] { packHalf(linear.data(), b.data(), pixels * 4); };
+			scalar();
+			dispatched();
+			compare("pack half", scalar, dispatched, check(a == b, "pack half"));
+		}
+		{
+			// HDR range RGB, the first three quarters of the decoded floats scaled up
+			std::vector<float> hdr(linear.begin(), linear.begin() + pixels * 3);
+			for (float& c : hdr) {
+				c *= 100.0f;
+			}
+			std::vector<uint32_t> a(pixels), b(pixels);
+			auto scalar = [&] { packRGB9E5Scalar(hdr.data(), a.data(), pixels); };
+			auto dispatched = [&] { packRGB9E5(hdr.data(), b.data(), pixels); };
+			scalar();
+			dispatched();
+			compare("pack RGB9E5", scalar, dispatched, check(a == b, "pack RGB9E5"));
+		}
+		linear = std::vector<float>();
+		{
+			size_t yuvBytes = pixels + 2 * (size_t)((width + 1) / 2) * ((height + 1) / 2);
+			std::vector<unsigned char> a(yuvBytes), b(yuvBytes);
+			auto scalar = [&] { convertRGBAToYUV420Scalar(rgba.data(), width * 4, width, height, a.data(), a.data() + pixels, a.data() + pixels + (yuvBytes - pixels) / 2); };
+			auto dispatched = [&] { convertRGBAToYUV420(rgba.data(), width * 4, width, height, b.data(), b.data() + pixels, b.data() + pixels + (yuvBytes - pixels) / 2); };
+			scalar();
+			dispatched();
+			compare("RGBA to YUV 4:2:0", scalar, dispatched, check(a == b, "RGBA to YUV 4:2:0"));
+		}
+	}
+	std::cout << (passed ? "Every kernel matches its scalar reference" : "Kernels differ from their scalar references") << std::endl;
+	return passed;
+}
+
+// Converts an HDR image to every HdrFormat. On the CPU the dispatched packers are timed against their scalar
+// references and must give the same bits, and the decoded values are compared with the source floats. On the GPU
+// each format is created through TextureManager::createHdr (and loadHdr when a file is given), level 0 is read back
+// and must decode to exactly what the packers wrote. Without a file a sky with a bright sun is generated.
+bool benchmarkHdrTextures(const char* path, GLADloadproc loader) {
+	int width = 2048, height = 1024;
+	std::vector<float> source;
+	if (path) {
+		int channels;
+		float* data = stbi_loadf(path, &width, &height, &channels, 3);
+		if (!data) {
+			std::cout << "Failed to load HDR image data " << path << std::endl;
+			return false;
+		}
+		source.assign(data, data + (size_t)width * height * 3);
+		stbi_image_free(data);
+		// bottom row first, the order createHdr takes
+		flipVertical((unsigned char*)source.data(), (size_t)width * 3 * sizeof(float), height);
 	}
 	else {
-		std::cout << "Failed to load texture image" << std::endl;
+		source.resize((size_t)width * height * 3);
+		glm::vec3 sun = glm::normalize(glm::vec3(0.3f, 0.6f, -0.7f));
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				// latitude and longitude of an environment map
+				float phi = (x + 0.5f) / width * 6.2831853f, theta = (y + 0.5f) / height * 3.1415927f;
+				glm::vec3 direction(std::sin(theta) * std::cos(phi), -std::cos(theta), std::sin(theta) * std::sin(phi));
+				float horizon = std::max(direction.y, 0.0f);
+				glm::vec3 color = glm::mix(glm::vec3(0.9f, 0.8f, 0.7f), glm::vec3(0.15f, 0.35f, 0.9f), std::sqrt(horizon));
+				color *= direction.y < 0.0f ? 0.05f : 1.0f;
+				float toSun = glm::dot(direction, sun);
+				color += glm::vec3(1.0f, 0.9f, 0.7f) * (toSun > 0.9995f ? 5000.0f : 20.0f * std::pow(std::max(toSun, 0.0f), 64.0f));
+				float* texel = &source[((size_t)y * width + x) * 3];
+				texel[0] = color.r;
+				texel[1] = color.g;
+				texel[2] = color.b;
+			}
+		}
 	}
-	stbi_image_free(data);
+	size_t pixels = (size_t)width * height;
+	std::cout << "HDR textures " << width << "x" << height << (path ? " from " : ", generated sky") << (path ? path : "") << ", F16C " << (cpuFeatures().f16c ? "on" : "off") << std::endl;
 
-	// ====================================================================================//
-	// Vertices in 3d space
-	float vertices[] = {
-		// postions         //textures
-		-0.5f, -0.5f, -0.5f, 0.0f, 0.0f,
-		0.5f, -0.5f, -0.5f, 1.0f, 0.0f,
-		0.5f, 0.5f, -0.5f, 1.0f, 1.0f,
-		-0.5f, 0.5f, -0.5f,	0.0f, 1.0f,
-		-0.5f, -0.5f, 0.5f, 1.0f, 0.0f,
-		0.5f, -0.5f, 0.5f, 0.0f, 0.0f,
-		0.5f, 0.5f, 0.5f, 0.0f, 1.0f,
-		-0.5f, 0.5f, 0.5f, 1.0f, 1.0f,
-		0.5f, 0.5f, 0.5f, 1.0f, 0.0f,
-		-0.5f, 0.5f, 0.5f, 0.0f, 0.0f,
-		0.5f, -0.5f, 0.5f, 1.0f, 1.0f,
-		-0.5f, -0.5f, 0.5f, 0.0f, 1.0f
+	auto milliseconds = [](const std::function<void()>& work) {
+		double best = 1e30;
+		for (int run = 0; run < 5; run++) {
+			auto start = std::chrono::steady_clock::now();
+			work();
+			best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		return best;
+	};
+	std::vector<uint16_t> halves(pixels * 3), scalarHalves(pixels * 3);
+	std::vector<uint32_t> shared(pixels), scalarShared(pixels);
+	double halfMs = milliseconds([&] { packHalf(source.data(), halves.data(), pixels * 3); });
+	double scalarHalfMs = milliseconds([&] { packHalfScalar(source.data(), scalarHalves.data(), pixels * 3); });
+	double sharedMs = milliseconds([&] { packRGB9E5(source.data(), shared.data(), pixels); });
+	double scalarSharedMs = milliseconds([&] { packRGB9E5Scalar(source.data(), scalarShared.data(), pixels); });
+	bool passed = halves == scalarHalves && shared == scalarShared;
+	std::cout << "  pack half: scalar " << scalarHalfMs << " ms, dispatched " << halfMs << " ms" << (halves == scalarHalves ? "" : ", differs from the scalar packer!") << std::endl;
+	std::cout << "  pack RGB9E5: scalar " << scalarSharedMs << " ms, dispatched " << sharedMs << " ms" << (shared == scalarShared ? "" : ", differs from the scalar packer!") << std::endl;
+
+	// what every format gives back, and the worst error against the source relative to the texel's brightest channel
+	std::vector<float> decoded[3];
+	decoded[0] = source;
+	decoded[1].resize(pixels * 3);
+	decoded[2].resize(pixels * 3);
+	float maxError[3] = { 0.0f, 0.0f, 0.0f };
+	for (size_t i = 0; i < pixels; i++) {
+		glm::vec3 texel = glm::unpackF3x9_E1x5(scalarShared[i]);
+		float brightest = 0.0f;
+		for (int c = 0; c < 3; c++) {
+			decoded[1][i * 3 + c] = glm::unpackHalf1x16(scalarHalves[i * 3 + c]);
+			decoded[2][i * 3 + c] = texel[c];
+			brightest = std::max(brightest, source[i * 3 + c]);
+		}
+		if (brightest < 1e-3f) {
+			continue;
+		}
+		for (int format = 1; format < 3; format++) {
+			for (int c = 0; c < 3; c++) {
+				// RGB9E5 saturates at 65408, half at 65504
+				float expected = std::min(std::max(source[i * 3 + c], 0.0f), format == 1 ? 65504.0f : 65408.0f);
+				maxError[format] = std::max(maxError[format], std::abs(decoded[format][i * 3 + c] - expected) / brightest);
+			}
+		}
+	}
+	// 11 and 9 significant bits, rounded
+	passed = passed && maxError[1] < 1e-3f && maxError[2] < 2e-3f;
+
+	TextureManager textureManager;
+	textureManager.init(loader);
+	const char* names[] = { "RGB32F", "RGB16F", "RGB9E5" };
+	HdrFormat formats[] = { HdrFormat::RGB32F, HdrFormat::RGB16F, HdrFormat::RGB9E5 };
+	size_t texelBytes[] = { 12, 6, 4 };
+	size_t chainTexels = 0;
+	for (int level = 0; (width >> level) > 0 || (height >> level) > 0; level++) {
+		chainTexels += (size_t)std::max(1, width >> level) * std::max(1, height >> level);
+	}
+	std::vector<float> readback(pixels * 3);
+	auto matches = [&](int texture, const std::vector<float>& expected) {
+		glBindTexture(GL_TEXTURE_2D, textureManager.textureID(texture));
+		glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_FLOAT, readback.data());
+		return memcmp(readback.data(), expected.data(), readback.size() * sizeof(float)) == 0;
+	};
+	for (int format = 0; format < 3; format++) {
+		glFinish();
+		auto start = std::chrono::steady_clock::now();
+		int texture = textureManager.createHdr(source.data(), width, height, formats[format]);
+		glFinish();
+		double createMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		bool same = matches(texture, decoded[format]);
+		std::cout << "  " << names[format] << ": " << chainTexels * texelBytes[format] / 1048576.0 << " MB with mips, created in " << createMs << " ms, "
+			<< "max error " << maxError[format] << (same ? "" : ", GPU texels differ from the packed data!") << std::endl;
+		passed = passed && same;
+		if (path) {
+			bool loaded = matches(textureManager.loadHdr(path, formats[format]), decoded[format]);
+			if (!loaded) {
+				std::cout << "  " << names[format] << " through loadHdr differs from createHdr!" << std::endl;
+			}
+			passed = passed && loaded;
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	textureManager.release();
+	std::cout << (passed ? "HDR conversion passed" : "HDR conversion failed") << std::endl;
+	return passed;
+}
+
+// Runs particle fountains at increasing counts in steady state, as many emitted each frame as die, and measures the
+// update alone (scalar on one thread against AVX2 on the pool, results compared) and then update plus drawing with
+// a glFinish per frame. Needs a current context for the drawing part.
+bool benchmarkParticles() {
+	ParticleRenderer renderer;
+	ThreadPool& pool = ThreadPool::global();
+	StateTracker state;
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 12.0f), glm::vec3(0.0f, 2.0f, 0.0f), upDir);
+	glm::mat4 projection = glm::perspective(glm::radians(55.0f), (float)800 / 600, 0.1f, 1000.0f);
+	ParticleEmitter emitter;
+	emitter.velocity = glm::vec3(0.0f, 8.0f, 0.0f);
+	emitter.spread = 2.0f;
+	emitter.color = 0xFF3080FF;
+	const float dt = 1.0f / 60.0f;
+	bool matches = true;
+	size_t counts[] = { 10000, 100000, 1000000, 4000000 };
+	glEnable(GL_DEPTH_TEST);
+	for (size_t target : counts) {
+		ParticleSystem particles(target + target / 4), reference(target + target / 4);
+		// start in steady state: ages spread over the lifetimes so deaths are spread over frames
+		for (ParticleSystem* system : { &particles, &reference }) {
+			system->emit(emitter, target);
+			for (size_t i = 0; i < target; i++) {
+				system->life[i] *= (i % 100 + 0.5f) / 100.0f;
+			}
+		}
+		size_t perFrame = (size_t)(target * dt / 1.5f);
+		// lifetimes are 1 to 2 seconds, 1.5 on average
+
+		int frames = (int)std::max((size_t)10, (size_t)20000000 / target);
+		double simdSeconds = 0.0, scalarSeconds = 0.0;
+		for (int frame = 0; frame < frames; frame++) {
+			particles.emit(emitter, perFrame);
+			reference.emit(emitter, perFrame);
+			auto start = std::chrono::steady_clock::now();
+			particles.update(dt, pool);
+			auto middle = std::chrono::steady_clock::now();
+			reference.updateScalar(dt);
+			auto end = std::chrono::steady_clock::now();
+			simdSeconds += std::chrono::duration<double>(middle - start).count();
+			scalarSeconds += std::chrono::duration<double>(end - middle).count();
+		}
+		// both paths compact the same way, so the same particles sit in the same slots
+		float difference = 0.0f;
+		for (size_t i = 0; i < particles.size() && particles.size() == reference.size(); i++) {
+			difference = std::max(difference, std::abs(particles.positionY[i] - reference.positionY[i]));
+		}
+		matches = matches && particles.size() == reference.size() && difference < 1e-3f;
+		std::cout << "Particles " << particles.size() << ": update " << particles.size() * frames / simdSeconds / 1e6 << " M/s AVX2 on " << pool.size() << " threads, "
+			<< reference.size() * frames / scalarSeconds / 1e6 << " M/s scalar, " << simdSeconds / frames * 1000.0 << " ms per frame" << (difference < 1e-3f ? "" : ", results differ!");
+
+		if (renderer.init(particles.capacity())) {
+			// init deleted the last count's program and VAO, the driver may hand their names out again
+			state.invalidate();
+			int drawFrames = 10;
+			renderer.draw(particles, view, projection, state, pool);
+			glFinish();
+			// first draw compiles and pages in, not timed
+			auto start = std::chrono::steady_clock::now();
+			for (int frame = 0; frame < drawFrames; frame++) {
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				particles.emit(emitter, perFrame);
+				particles.update(dt, pool);
+				renderer.draw(particles, view, projection, state, pool);
+				glFinish();
+			}
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			std::cout << ", updated and drawn " << particles.size() * drawFrames / seconds / 1e6 << " M/s (" << seconds / drawFrames * 1000.0 << " ms per frame)";
+		}
+		std::cout << std::endl;
+	}
+	renderer.release();
+	return matches;
+}
+
+// Culls a random field of instances behind a few walls with GpuCuller and with MeshletCuller (one sphere per instance)
+// and compares the results. The GPU may keep more, its Hi-Z reads are coarser, but it must never drop an instance the
+// CPU keeps. Needs a current context, llvmpipe is enough, and the loader glad was given.
+bool testGpuCulling(size_t instanceCount, GLADloadproc loader) {
+	GpuCuller gpuCuller;
+	if (!gpuCuller.init(loader, instanceCount)) {
+		return false;
+	}
+	StateTracker state;
+	gpuCuller.occlusionCulling = true;
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+	for (size_t i = 0; i < instanceCount; i++) {
+		GpuInstance instance = {};
+		instance.model = glm::translate(glm::mat4(1.0f), glm::vec3(uniform(random) * 60.0f, uniform(random) * 20.0f, -50.0f + uniform(random) * 50.0f));
+		instance.model = glm::scale(instance.model, glm::vec3(1.5f + uniform(random)));
+		instance.sphere = glm::vec4(uniform(random) * 0.2f, uniform(random) * 0.2f, uniform(random) * 0.2f, 0.8f + 0.5f * uniform(random));
+		instance.firstIndex = (uint32_t)i * 3;
+		instance.indexCount = 36;
+		gpuCuller.setInstance(i, instance);
+	}
+	glm::vec3 quad[] = { glm::vec3(-1.0f, -1.0f, 0.0f), glm::vec3(1.0f, -1.0f, 0.0f), glm::vec3(1.0f, 1.0f, 0.0f), glm::vec3(-1.0f, 1.0f, 0.0f) };
+	uint32_t quadIndices[] = { 0, 1, 2, 0, 2, 3 };
+	glm::mat4 projection = glm::perspective(glm::radians(55.0f), (float)800 / 600, 0.1f, 1000.0f);
+
+	size_t dropped = 0, extra = 0, cpuVisible = 0;
+	double cpuSeconds = 0.0, gpuSeconds = 0.0;
+	const int frames = 8;
+	for (int frame = 0; frame < frames; frame++) {
+		glm::vec3 camera(uniform(random) * 5.0f, uniform(random) * 3.0f, 10.0f + uniform(random) * 5.0f);
+		glm::mat4 view = glm::lookAt(camera, camera + glm::vec3(uniform(random) * 0.3f, uniform(random) * 0.2f, -1.0f), upDir);
+		MeshletCuller cpuCuller;
+		cpuCuller.occlusionCulling = true;
+		cpuCuller.backfaceCulling = false;
+		cpuCuller.beginFrame(view, projection, camera);
+		cpuCuller.occlusion.clear();
+		for (int wall = 0; wall < 4; wall++) {
+			glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(uniform(random) * 8.0f, uniform(random) * 4.0f, -5.0f - 10.0f * wall));
+			model = glm::scale(model, glm::vec3(3.0f + 3.0f * wall, 2.0f + 2.0f * wall, 1.0f));
+			cpuCuller.occlusion.rasterize(quad, quadIndices, 6, projection * view * model);
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		std::vector<char> visible(instanceCount);
+		std::vector<DrawElementsIndirectCommand> commands;
+		for (size_t i = 0; i < instanceCount; i++) {
+			const GpuInstance& instance = gpuCuller.instance(i);
+			Meshlet bounds = {};
+			bounds.center = glm::vec3(instance.sphere);
+			bounds.radius = instance.sphere.w;
+			bounds.coneCutoff = 2.0f;
+			visible[i] = cpuCuller.cull(&bounds, 1, instance.model, (uint32_t)i, commands) > 0;
+			cpuVisible += visible[i];
+		}
+		auto cpuEnd = std::chrono::steady_clock::now();
+		gpuCuller.updateHiZ(cpuCuller.occlusion.depth.data(), cpuCuller.occlusion.width, cpuCuller.occlusion.height, state);
+		gpuCuller.cull(view, projection, state);
+		gpuCuller.readCommands(commands);
+		auto gpuEnd = std::chrono::steady_clock::now();
+		cpuSeconds += std::chrono::duration<double>(cpuEnd - start).count();
+		gpuSeconds += std::chrono::duration<double>(gpuEnd - cpuEnd).count();
+
+		std::vector<char> gpuVisible(instanceCount, 0);
+		for (const DrawElementsIndirectCommand& command : commands) {
+			if (command.baseInstance < instanceCount && command.count == 36 && command.firstIndex == command.baseInstance * 3) {
+				gpuVisible[command.baseInstance] = 1;
+			}
+		}
+		for (size_t i = 0; i < instanceCount; i++) {
+			dropped += visible[i] && !gpuVisible[i];
+			extra += !visible[i] && gpuVisible[i];
+		}
+	}
+	std::cout << "GPU culling test, " << instanceCount << " instances x " << frames << " frames: " << cpuVisible / frames << " visible on the CPU, " << dropped << " wrongly dropped and "
+		<< extra << " conservatively kept by the GPU. CPU " << cpuSeconds / frames * 1000.0 << " ms, GPU with readback " << gpuSeconds / frames * 1000.0 << " ms per frame" << std::endl;
+	gpuCuller.release();
+	return dropped == 0;
+}
+
+// Spread of frame times in milliseconds. The first frame is left out since it compiles shaders and uploads everything.
+struct FrameTimeStats {
+	size_t frames = 0;
+	double min = 0.0, mean = 0.0, p50 = 0.0, p95 = 0.0, p99 = 0.0, max = 0.0;
+};
+
+FrameTimeStats frameTimeStats(std::vector<double> frameMs) {
+	FrameTimeStats stats;
+	if (frameMs.size() < 2) {
+		return stats;
+	}
+	frameMs.erase(frameMs.begin());
+	std::sort(frameMs.begin(), frameMs.end());
+	double total = 0.0;
+	for (double ms : frameMs) {
+		total += ms;
+	}
+	auto percentile = [&](double p) { return frameMs[std::min(frameMs.size() - 1, (size_t)(p * frameMs.size()))]; };
+	stats.frames = frameMs.size();
+	stats.min = frameMs.front();
+	stats.mean = total / frameMs.size();
+	stats.p50 = percentile(0.5);
+	stats.p95 = percentile(0.95);
+	stats.p99 = percentile(0.99);
+	stats.max = frameMs.back();
+	return stats;
+}
+
+void printFrameTimes(const std::vector<double>& frameMs) {
+	FrameTimeStats stats = frameTimeStats(frameMs);
+	if (stats.frames == 0) {
+		return;
+	}
+	std::cout << "Frame times over " << stats.frames << " frames: min " << stats.min << " ms, mean " << stats.mean << " ms, median " << stats.p50
+		<< " ms, 95% " << stats.p95 << " ms, 99% " << stats.p99 << " ms, max " << stats.max << " ms (" << 1000.0 / stats.mean << " fps)" << std::endl;
+}
+
+// Opens the cooked form of a mesh, cooking it first when it is missing or older than the source.
+bool openCookedMesh(const char* source, const char* cooked, MeshFile& mesh) {
+	if (mesh.open(cooked) && mesh.isCurrent(source)) {
+		return true;
+	}
+	if (!cookMesh(source, cooked, VertexCompression()) || !mesh.open(cooked)) {
+		std::cout << "Failed to load " << source << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Screenshots and video of a run, read back from the frames as they are drawn: --screenshots and --video.
+struct FrameRecording {
+	const char* screenshotPrefix = nullptr;
+	const char* videoPath = nullptr;
+	FrameReadback readback;
+	VideoCapture video;
+
+	//reads width x height frames from now on when either output was asked for
+	void start(int width, int height) {
+		if (!screenshotPrefix && !videoPath) {
+			return;
+		}
+		FrameReadback::Consumer screenshots = screenshotPrefix ? FrameReadback::ppmWriter(screenshotPrefix) : nullptr;
+		bool recording = videoPath && video.start(videoPath, width, height);
+		if (!screenshots && !recording) {
+			return;
+		}
+		VideoCapture* output = recording ? &video : nullptr;
+		readback.init(width, height, [screenshots, output](const FrameReadback::Image& image) {
+			if (screenshots) {
+				screenshots(image);
+			}
+			if (output) {
+				output->push(image);
+			}
+		});
+	}
+	//call after the frame is drawn and before the swap
+	void capture() {
+		readback.capture();
+	}
+	//waits for the frames still in flight, closes the outputs and reports what was dropped
+	void stop() {
+		if (!screenshotPrefix && !videoPath) {
+			return;
+		}
+		readback.release();
+		if (screenshotPrefix) {
+			std::cout << readback.captured << " frames written to " << screenshotPrefix << "_*.ppm" << std::endl;
+		}
+		if (video.recording()) {
+			bool ok = video.stop();
+			std::cout << "Video " << videoPath << (ok ? "" : " failed") << ": " << video.written() << " frames written, " << video.dropped() << " dropped by the encoder" << std::endl;
+		}
+		std::cout << readback.dropped << " frames dropped by the readback" << std::endl;
+	}
+};
+
+// Parameters of the generated benchmark scene. Everything derives from them and a fixed seed, so two runs with the
+// same settings draw exactly the same frames.
+struct BenchmarkSettings {
+	int cubes = 1000;
+	int textures = 8;
+	// separately linked copies of the cube program, every switch between them is a real glUseProgram
+	int shaderVariants = 4;
+	int frames = 300;
+	int width = 800;
+	int height = 600;
+};
+
+static void writeFrameTimeJson(std::ostream& out, const char* name, const FrameTimeStats& stats) {
+	out << "  \"" << name << "\": { \"mean\": " << stats.mean << ", \"p50\": " << stats.p50 << ", \"p95\": " << stats.p95 << ", \"p99\": " << stats.p99
+		<< ", \"max\": " << stats.max << " },\n";
+}
+
+// Draws a generated field of spinning cubes, each with one of the materials and program variants, along a fixed
+// orbit with a fixed 60 Hz timestep. CPU frame time ends when the last command is submitted, frame time after a
+// glFinish, GPU frame time comes from timestamp queries. Results go to outputPath as JSON, or to stdout when it is null. Needs a current context.
+bool runBenchmark(const BenchmarkSettings& settings, GLADloadproc loader, const char* outputPath, FrameRecording& recording) {
+	int cubes = std::max(1, settings.cubes), textureCount = std::max(1, settings.textures), variants = std::max(1, settings.shaderVariants);
+	MeshFile cube;
+	if (!openCookedMesh("Models/cube.obj", "Models/cube.mesh", cube)) {
+		return false;
+	}
+	TextureManager textureManager;
+	textureManager.init(loader);
+
+	// xorshift instead of <random> distributions, their output differs between standard libraries
+	uint32_t seed = 0x2545F491u;
+	auto next = [&]() {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		return seed;
 	};
+	auto unit = [&]() { return (next() >> 8) * (1.0f / 16777216.0f); };
+
+	// textures: 128x128 checkers in generated colors, material i overlays texture i + 1 on texture i
+	const int textureSize = 128;
+	std::vector<unsigned char> pixels(textureSize * textureSize * 4);
+	std::vector<int> textures;
+	for (int t = 0; t < textureCount; t++) {
+		unsigned char a[3] = { (unsigned char)(next() >> 24), (unsigned char)(next() >> 24), (unsigned char)(next() >> 24) };
+		int cell = 4 << (t % 4);
+		for (int y = 0; y < textureSize; y++) {
+			for (int x = 0; x < textureSize; x++) {
+				bool odd = ((x / cell) + (y / cell)) & 1;
+				unsigned char* p = &pixels[(y * textureSize + x) * 4];
+				p[0] = odd ? a[0] : 255 - a[0];
+				p[1] = odd ? a[1] : 255 - a[1];
+				p[2] = odd ? a[2] : 255 - a[2];
+				p[3] = 255;
+			}
+		}
+		textures.push_back(textureManager.create(pixels.data(), textureSize, textureSize));
+	}
+	for (int t = 0; t < textureCount; t++) {
+		textureManager.addMaterial(textures[t], textures[(t + 1) % textureCount]);
+	}
+	textureManager.upload();
+
+	std::vector<Shader> programs;
+	programs.reserve(variants);
+	for (int v = 0; v < variants; v++) {
+		programs.emplace_back("shader.vert", textureManager.bindless ? "shader_bindless.frag" : "shader.frag");
+		programs.back().use();
+		textureManager.setupShader(programs.back());
+		programs.back().setMat4("meshDecode", cube.positionDecode());
+		programs.back().setBool("octahedralNormals", cube.octahedralNormals());
+	}
 
+	unsigned int VAO, VBO, EBO;
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO);
+	glGenBuffers(1, &EBO);
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ARRAY_BUFFER, cube.vertexBytes(), cube.vertexData(), GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, cube.indexBytes(), cube.indexData(), GL_STATIC_DRAW);
+	cube.setupAttributes();
+	glBindVertexArray(0);
+	GLenum indexType = cube.header().indexType;
+	GLsizei indexCount = (GLsizei)(cube.lodCount() > 0 ? cube.lods()[0].indexCount : cube.header().indexCount);
+	cube.close();
 
-	unsigned int indices[] = {  // note that we start from 0!
-		// first face
-		0, 1, 2,
-		0, 2, 3,
-		// second face
-		4, 0, 3,
-		7, 4, 3,
-		// third face
-		7, 4, 5,
-		6, 7, 5,
-		// fourth face
-		6, 2, 1,
-		1, 5, 6,
-		// fifth face
-		9, 3, 2,
-		8, 9, 2,
-		//sixth face
-		11, 0, 1,
-		10, 11, 1
+	// cubes on a jittered grid, like cubePos but any number of them, each with its own material and program
+	struct BenchmarkCube {
+		glm::vec3 position;
+		float angle;
+		int material;
+		int variant;
 	};
+	int side = (int)std::ceil(std::cbrt((double)cubes));
+	float spacing = 2.5f;
+	std::vector<BenchmarkCube> field(cubes);
+	for (int i = 0; i < cubes; i++) {
+		glm::vec3 cell((float)(i % side), (float)(i / side % side), (float)(i / (side * side)));
+		field[i].position = (cell - glm::vec3((side - 1) * 0.5f)) * spacing + (glm::vec3(unit(), unit(), unit()) - 0.5f) * spacing * 0.5f;
+		field[i].angle = i * 10.0f;
+		field[i].material = (int)(next() % (uint32_t)textureCount);
+		field[i].variant = (int)(next() % (uint32_t)variants);
+	}
+
+	glViewport(0, 0, settings.width, settings.height);
+	glEnable(GL_DEPTH_TEST);
+	StateTracker state;
+	glm::mat4 projection = glm::perspective(glm::radians(55.0f), (float)settings.width / settings.height, 0.1f, 1000.0f);
+	float radius = side * spacing * 0.9f + 3.0f;
+	std::vector<double> cpuMs, frameMs;
+	size_t drawCalls = 0, stateChanges = 0, triangles = 0;
+	GpuProfiler gpuProfiler;
+	gpuProfiler.init();
+	gpuProfiler.keepHistory = true;
+	recording.start(settings.width, settings.height);
+	for (int frame = 0; frame < settings.frames; frame++) {
+		auto start = std::chrono::steady_clock::now();
+		double time = frame / 60.0;
+		// one orbit every 20 seconds, bobbing up and down
+		glm::vec3 eye(radius * (float)sin(time * 0.314), radius * 0.3f * (float)sin(time * 0.7), radius * (float)cos(time * 0.314));
+		glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f), upDir);
+		size_t changesBefore = state.changes;
+		gpuProfiler.beginFrame();
+		gpuProfiler.beginZone("frame");
+
+		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		for (Shader& program : programs) {
+			state.useProgram(program.ID);
+			program.setMat4("view", view);
+			program.setMat4("projection", projection);
+		}
+		state.bindVertexArray(VAO);
+		for (const BenchmarkCube& c : field) {
+			Shader& program = programs[c.variant];
+			state.useProgram(program.ID);
+			textureManager.bindMaterial(program, c.material, state);
+			glm::mat4 model = glm::translate(glm::mat4(1.0f), c.position);
+			model = glm::rotate(model, (float)(c.angle + time), glm::vec3(0.3f, 0.2f, 0.3f));
+			program.setMat4("model", model);
+			glDrawElements(GL_TRIANGLES, indexCount, indexType, 0);
+		}
+		drawCalls += field.size();
+		triangles += field.size() * (indexCount / 3);
+		stateChanges += state.changes - changesBefore;
+		gpuProfiler.endZone();
+		gpuProfiler.endFrame();
+		recording.capture();
+		GLInterposer::endFrame();
+		GLCapture::endFrame();
+		auto submitted = std::chrono::steady_clock::now();
+		glFinish();
+		auto finished = std::chrono::steady_clock::now();
+		cpuMs.push_back(std::chrono::duration<double, std::milli>(submitted - start).count());
+		frameMs.push_back(std::chrono::duration<double, std::milli>(finished - start).count());
+	}
+	recording.stop();
+
+	if (GLInterposer::installed()) {
+		GLInterposer::report(std::cout);
+	}
+	gpuProfiler.beginFrame();
+	// the glFinish above let every frame's queries complete
+	std::vector<double> gpuMs;
+	for (const GpuFrameResult& result : gpuProfiler.history()) {
+		gpuMs.push_back(result.zones.empty() ? 0.0 : result.zones[0].ms);
+	}
+	gpuProfiler.release();
+
+	std::ostringstream json;
+	json << "{\n";
+	json << "  \"scene\": { \"cubes\": " << cubes << ", \"textures\": " << textureCount << ", \"shaderVariants\": " << variants << ", \"frames\": " << settings.frames
+		<< ", \"width\": " << settings.width << ", \"height\": " << settings.height << " },\n";
+	json << "  \"renderer\": \"" << (const char*)glGetString(GL_RENDERER) << "\",\n";
+	json << "  \"bindless\": " << (textureManager.bindless ? "true" : "false") << ",\n";
+	writeFrameTimeJson(json, "cpuFrameMs", frameTimeStats(cpuMs));
+	writeFrameTimeJson(json, "frameMs", frameTimeStats(frameMs));
+	writeFrameTimeJson(json, "gpuFrameMs", frameTimeStats(gpuMs));
+	int frames = std::max(1, settings.frames);
+	json << "  \"drawCalls\": " << drawCalls / frames << ",\n";
+	json << "  \"stateChanges\": " << stateChanges / frames << ",\n";
+	json << "  \"triangles\": " << triangles / frames << "\n";
+	json << "}\n";
+	// per frame averages, every frame draws the same counts except for the first one's state changes
+
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &EBO);
+	for (Shader& program : programs) {
+		glDeleteProgram(program.ID);
+	}
+	textureManager.release();
+
+	if (!outputPath) {
+		std::cout << json.str();
+		return true;
+	}
+	std::ofstream file(outputPath);
+	file << json.str();
+	if (!file) {
+		std::cout << "Failed to write " << outputPath << std::endl;
+		return false;
+	}
+	std::cout << "Benchmark results written to " << outputPath << std::endl;
+	return true;
+}
+
+// Plays a capture made with --gl-capture and reports how fast its frame is submitted, with none of the engine's
+// own CPU work in between. Needs a current context.
+bool replayCapture(const char* path, int iterations) {
+	GLCapture::ReplayStats stats;
+	if (!GLCapture::replay(path, iterations, stats)) {
+		return false;
+	}
+	FrameTimeStats submit = frameTimeStats(stats.submitMs);
+	std::cout << "Replay of " << path << ": setup " << stats.setupCalls << " calls in " << stats.setupMs << " ms, then " << stats.frameCalls << " calls per frame" << std::endl;
+	if (submit.frames > 0) {
+		std::cout << "Submission over " << submit.frames << " frames: mean " << submit.mean << " ms, median " << submit.p50 << " ms, 95% " << submit.p95 << " ms ("
+			<< stats.frameCalls / submit.mean / 1000.0 << " M calls/s)" << std::endl;
+	}
+	printFrameTimes(stats.frameMs);
+	if (stats.remappedLocations > 0) {
+		std::cout << stats.remappedLocations << " uniform locations differ from the capture and were translated" << std::endl;
+	}
+	if (stats.nameMismatches > 0) {
+		std::cout << stats.nameMismatches << " object names differ from the capture, the replay may not draw what was captured" << std::endl;
+	}
+	return true;
+}
+
+// Writes the CPU capture and the GL call trace when main returns, whichever way it returns.
+struct TraceOnExit {
+	const char* path;
+	const char* glPath;
+	~TraceOnExit() {
+		GLCapture::stop();
+		if (glPath && GLInterposer::installed()) {
+			GLInterposer::stopTrace();
+			if (GLInterposer::writeTrace(glPath)) {
+				std::cout << "GL call trace written to " << glPath << std::endl;
+			}
+		}
+		if (!path) {
+			return;
+		}
+		CpuProfiler::stop();
+		if (CpuProfiler::writeChromeTrace(path)) {
+			std::cout << "CPU trace written to " << path << " (" << CpuProfiler::droppedEvents() << " events dropped), open it in chrome://tracing or ui.perfetto.dev" << std::endl;
+		}
+	}
+};
+
+int main(int argc, char** argv) {
+	// CPU zones of the whole run as a Chrome trace, after the arguments of any mode: RockingEngine ... --trace <out.json>
+	// Per frame render statistics streamed to a file, .csv or JSON lines: RockingEngine ... --stats <out.csv|out.jsonl>
+	// Every GL call wrapped, counted per frame and traced with its arguments: RockingEngine ... --gl-trace <out.txt>
+	// GL command stream of the first 60 frames with its data, for --gl-replay: RockingEngine ... --gl-capture <out.glcap>
+	// every frame of the main loop or benchmark read back without stalls and written as prefix_000000.ppm: RockingEngine ... --screenshots <prefix>
+	// the same frames as video, .y4m, raw .yuv or anything ffmpeg encodes: RockingEngine ... --video <out.y4m|out.yuv|out.mp4>
+	// GL calls that go nowhere, frame times are the engine's CPU work alone: RockingEngine --headless|--benchmark|--gl-replay ... --null-gl
+	TraceOnExit trace = { nullptr, nullptr };
+	const char* statsPath = nullptr;
+	const char* capturePath = nullptr;
+	FrameRecording recording;
+	bool nullGL = false;
+	while ((argc >= 2 && strcmp(argv[argc - 1], "--null-gl") == 0) || (argc >= 3 && (strcmp(argv[argc - 2], "--trace") == 0
+		|| strcmp(argv[argc - 2], "--stats") == 0 || strcmp(argv[argc - 2], "--gl-trace") == 0 || strcmp(argv[argc - 2], "--gl-capture") == 0
+		|| strcmp(argv[argc - 2], "--screenshots") == 0 || strcmp(argv[argc - 2], "--video") == 0))) {
+		if (strcmp(argv[argc - 1], "--null-gl") == 0) {
+			nullGL = NULL_GL != 0;
+			argc -= 1;
+			continue;
+		}
+		if (strcmp(argv[argc - 2], "--stats") == 0) {
+			statsPath = argv[argc - 1];
+		}
+		else if (strcmp(argv[argc - 2], "--screenshots") == 0) {
+			recording.screenshotPrefix = argv[argc - 1];
+		}
+		else if (strcmp(argv[argc - 2], "--video") == 0) {
+			recording.videoPath = argv[argc - 1];
+		}
+		else if (strcmp(argv[argc - 2], "--gl-capture") == 0) {
+			capturePath = argv[argc - 1];
+		}
+		else if (strcmp(argv[argc - 2], "--gl-trace") == 0) {
+			trace.glPath = argv[argc - 1];
+		}
+		else {
+#if CPU_PROFILING
+			trace.path = argv[argc - 1];
+			CpuProfiler::setThreadName("main");
+			CpuProfiler::start();
+#endif
+		}
+		argc -= 2;
+	}
+
+	// offline cooking: RockingEngine --cook <source.obj|.gltf|.glb> <out.mesh> [--uncompressed]
+	if ((argc == 4 || argc == 5) && strcmp(argv[1], "--cook") == 0) {
+		bool uncompressed = argc == 5 && strcmp(argv[4], "--uncompressed") == 0;
+		return cookMesh(argv[2], argv[3], uncompressed ? VertexCompression::none() : VertexCompression()) ? 0 : -1;
+	}
+	// level of detail benchmark: RockingEngine --lod-benchmark <source.obj|.gltf|.glb>
+	if (argc == 3 && strcmp(argv[1], "--lod-benchmark") == 0) {
+		return benchmarkLods(argv[2]) ? 0 : -1;
+	}
+	// SIMD pixel kernels against their scalar references at 4K and 8K: RockingEngine --pixel-benchmark
+	if (argc == 2 && strcmp(argv[1], "--pixel-benchmark") == 0) {
+		return benchmarkPixelKernels() ? 0 : -1;
+	}
+	// mip streaming decisions along a scripted camera path: RockingEngine --mip-residency-test
+	if (argc == 2 && strcmp(argv[1], "--mip-residency-test") == 0) {
+		return testMipResidency() ? 0 : -1;
+	}
+	// animation compression benchmark: RockingEngine --anim-compress-benchmark
+	if (argc == 2 && strcmp(argv[1], "--anim-compress-benchmark") == 0) {
+		return benchmarkAnimationCompression() ? 0 : -1;
+	}
+	// skeletal animation benchmark: RockingEngine --anim-benchmark [characters]
+	if (argc >= 2 && strcmp(argv[1], "--anim-benchmark") == 0) {
+		return benchmarkAnimation(argc >= 3 ? (size_t)atoi(argv[2]) : 1000) ? 0 : -1;
+	}
+
+	// rendering without a window into an offscreen framebuffer, then frame time statistics:
+	// RockingEngine --headless [frames] [width] [height] [gpu.csv]
+	bool headless = argc >= 2 && strcmp(argv[1], "--headless") == 0;
+	int headlessFrames = headless && argc >= 3 ? atoi(argv[2]) : 600;
+	int screenWidth = headless && argc >= 4 ? atoi(argv[3]) : 800;
+	int screenHeight = headless && argc >= 5 ? atoi(argv[4]) : 600;
+	const char* gpuCsv = headless && argc >= 6 ? argv[5] : nullptr;
+	// generated scene along a fixed camera path, JSON results for comparing commits:
+	// RockingEngine --benchmark [cubes] [textures] [shader variants] [frames] [out.json]
+	bool benchmark = argc >= 2 && strcmp(argv[1], "--benchmark") == 0;
+	BenchmarkSettings benchmarkSettings;
+	if (benchmark) {
+		int* values[] = { &benchmarkSettings.cubes, &benchmarkSettings.textures, &benchmarkSettings.shaderVariants, &benchmarkSettings.frames };
+		for (int i = 0; i < 4 && i + 2 < argc; i++) {
+			*values[i] = atoi(argv[i + 2]);
+		}
+	}
+
+	// last frame of a GL capture played over and over: RockingEngine --gl-replay <capture.glcap> [iterations]
+	bool replay = argc >= 3 && strcmp(argv[1], "--gl-replay") == 0;
+	if (replay && !GLCapture::readSize(argv[2], screenWidth, screenHeight)) {
+		return -1;
+	}
+	// HDR formats created on the GPU and checked against the CPU packers: RockingEngine --hdr-benchmark [image.hdr]
+	bool hdrBenchmark = argc >= 2 && strcmp(argv[1], "--hdr-benchmark") == 0;
+
+	// Initialising glfw and creating window context
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+	// GPU culling check against the CPU culler: RockingEngine --gpu-cull-test [instances]
+	bool gpuCullTest = argc >= 2 && strcmp(argv[1], "--gpu-cull-test") == 0;
+	// particle update and drawing throughput: RockingEngine --particle-benchmark
+	bool particleBenchmark = argc == 2 && strcmp(argv[1], "--particle-benchmark") == 0;
+	if (gpuCullTest || particleBenchmark || benchmark || replay || hdrBenchmark) {
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	}
+
+	GLFWwindow* main_window = NULL;
+	HeadlessContext headlessContext;
+	GLADloadproc loadProc = (GLADloadproc)glfwGetProcAddress;
+	// the null backend needs no context, it only runs the modes that have no window
+	nullGL = nullGL && (headless || benchmark || replay);
+	bool offscreen = !nullGL && (headless || benchmark || replay || hdrBenchmark || gpuCullTest || particleBenchmark) && headlessContext.init(screenWidth, screenHeight);
+	// the benchmarks, tests and replays fall back to a hidden window where there is no EGL
+	if (headless && !offscreen && !nullGL) {
+		glfwTerminate();
+		return -1;
+	}
+	if (nullGL) {
+		gladLoadGLLoader((GLADloadproc)NullGL::getProcAddress);
+		loadProc = (GLADloadproc)NullGL::getProcAddress;
+		std::cout << "Null GL backend, nothing is drawn" << std::endl;
+	}
+	else if (offscreen) {
+		// EGL context with a framebuffer object that stays bound, glad is loaded by init. The rest of main runs as is.
+		loadProc = (GLADloadproc)HeadlessContext::getProcAddress;
+	}
+	else {
+		main_window = glfwCreateWindow(screenWidth, screenHeight, "RockingEngine", NULL, NULL); // returns NULL if gone wrong.
+
+		if (main_window == NULL) {
+			std::cout << "Failed to Create window using glfw." << std::endl;
+			glfwTerminate();
+			return -1;
+		}
+
+		glfwMakeContextCurrent(main_window);
+
+		// Initialising Glad here
+		// GLAD manages function pointers for OpenGL so we want to initialise GLAD before we call any OpenGL function.
+		// We pass the GLAD the function to load the address of the OpenGL function pointers which are OS Specific.
+		// GLFW gives us glfwGetProcAddress that defines the correct function based on which OS we're compiling for.
+		// just in case https://computergraphics.stackexchange.com/questions/8639/this-function-syntax-is-confusing-me
+		if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+			std::cout << "Failed to initialise GLAD !" << std::endl;
+			return -1;
+		}
+		// Setting up viewport
+		glViewport(0, 0, screenWidth, screenHeight);
+
+		// Checking for window resize
+		glfwSetFramebufferSizeCallback(main_window, framebuffer_size_callback);
+	}
+	if (trace.glPath || capturePath) {
+		// swaps glad's pointers, every GL call from here on goes through a wrapper
+		std::cout << "GL interposer: " << GLInterposer::install() << " functions wrapped" << std::endl;
+	}
+	if (trace.glPath) {
+		GLInterposer::startTrace();
+	}
+	if (capturePath && !replay) {
+		GLCapture::start(capturePath, screenWidth, screenHeight);
+	}
+	if (replay) {
+		bool passed = replayCapture(argv[2], argc >= 4 ? atoi(argv[3]) : 300);
+		headlessContext.release();
+		glfwTerminate();
+		return passed ? 0 : -1;
+	}
+	if (gpuCullTest || particleBenchmark) {
+		bool passed = gpuCullTest ? testGpuCulling(argc >= 3 ? (size_t)atoi(argv[2]) : 100000, loadProc) : benchmarkParticles();
+		headlessContext.release();
+		glfwTerminate();
+		return passed ? 0 : -1;
+	}
+	if (hdrBenchmark) {
+		bool passed = benchmarkHdrTextures(argc >= 3 ? argv[2] : nullptr, loadProc);
+		headlessContext.release();
+		glfwTerminate();
+		return passed ? 0 : -1;
+	}
+	if (benchmark) {
+		bool passed = runBenchmark(benchmarkSettings, loadProc, argc >= 7 ? argv[6] : nullptr, recording);
+		headlessContext.release();
+		glfwTerminate();
+		return passed ? 0 : -1;
+	}
+
+	//// =============================================================================================== //
+
+// Generating and Loading Textures --------------------------------------------------------
+
+	TextureManager textureManager;
+	textureManager.init(loadProc);
+	// picks ARB_bindless_texture when the driver has it, otherwise textures are bound to units every frame.
+	// Images are flipped and converted to the driver's native RGBA/BGRA layout by the manager, so stbi's flip flag is not used.
+
+	int texture = textureManager.loadStreamed("Textures/container.jpg");
+	int texture2 = textureManager.loadStreamed("Textures/awesomeface.png");
+	// streamed textures start with only their low mips, finer levels are uploaded when cubes get close to the camera.
+	int material = textureManager.addMaterial(texture, texture2);
+	textureManager.upload();
+	// on the bindless path this makes the handles resident and uploads them to the material SSBO.
+
+	Shader ourShader("shader.vert", textureManager.bindless ? "shader_bindless.frag" : "shader.frag");
+	Shader instancedShader("shader_instanced.vert", textureManager.bindless ? "shader_bindless.frag" : "shader.frag");
+	// same shading, but the model matrix comes from the GPU culler's instance buffer
+	GpuCuller gpuCuller;
+	bool gpuCulling = gpuCuller.init(loadProc, 5);
+	gpuCuller.occlusionCulling = true;
+	// culls whole cubes in a compute shader when the context has one (4.3), otherwise the CPU meshlet path below is used
+	glEnable(GL_DEPTH_TEST);
+	// enables depth test
+
+	// ====================================================================================//
+	// Loading the cube mesh. Source files are cooked once into a binary file that is memory mapped on later runs,
+	// its vertex and index streams are already in the layout the GPU reads so nothing is parsed or copied at startup.
+	const char* cubeSource = "Models/cube.obj";
+	const char* cubeCooked = "Models/cube.mesh";
+	MeshFile cube;
+	if (!openCookedMesh(cubeSource, cubeCooked, cube)) {
+		// cooks on the first run or when the OBJ changed since it was cooked
+		glfwTerminate();
+		return -1;
+	}
+	GLenum cubeIndexType = cube.header().indexType;
+	// 16 bit indices for the cube, it has far fewer than 65536 vertices
+	glm::mat4 cubeDecode = cube.positionDecode();
+	bool cubeOctahedral = cube.octahedralNormals();
+	// positions are stored as 16 bit values inside the bounding box and normals as two octahedral coordinates, the shader expands them
+	std::vector<Meshlet> cubeMeshlets(cube.meshlets(), cube.meshlets() + cube.meshletCount());
+	std::vector<glm::vec3> cubePositions;
+	std::vector<uint32_t> cubeIndices;
+	cube.decodePositions(cubePositions);
+	cube.decodeIndices(cubeIndices);
+	// CPU copies for culling: meshlet bounds, and the triangles the cubes are rasterized with as occluders
+	std::vector<MeshLod> cubeLods(cube.lods(), cube.lods() + cube.lodCount());
+	if (cubeLods.empty()) {
+		cubeLods.push_back({ 0, cube.header().indexCount, 0, cube.meshletCount(), 0.0f });
+	}
+	glm::vec3 cubeMin = glm::make_vec3(cube.header().boundsMin), cubeMax = glm::make_vec3(cube.header().boundsMax);
+	glm::vec4 cubeSphere = glm::vec4((cubeMin + cubeMax) * 0.5f, glm::length(cubeMax - cubeMin) * 0.5f);
+	// bounding sphere the GPU culler tests each cube with
+	// level 0 is the whole cube, coarser levels follow it in the index buffer with their own meshlets
 
 	glm::vec3 cubePos[]{
 		glm::vec3(0.3f, 0.1f, -0.5f),
@@ -263,8 +1662,9 @@ int main() {
 	//// From this point any buffer call we make, it will be used to configure currently bound buffer which is VBO.
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, cube.vertexBytes(), cube.vertexData(), GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, cube.indexBytes(), cube.indexData(), GL_STATIC_DRAW);
+	// the pointers point straight into the mapped file, the OS pages it in while the driver copies it.
 	//// Function used to copy user defined data into the currently bound buffer.
 	//// first parameter = type of buffer of we want to copy data into
 	//// second parameter = size of data(in bytes)
@@ -274,9 +1674,12 @@ int main() {
 	//	// GL_STATIC_DRAW: data is set only once and used by GPU many times.
 	//	// GL_DYNAMIC_DRAW: data is changed a lot of times and is used by GPU many times.
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-	//glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3*sizeof(float)));
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3*sizeof(float)));
+	cube.setupAttributes();
+	// calls glVertexAttribPointer for every attribute the cooked file describes, here position, normal and texture coordinate.
+	if (gpuCulling) {
+		gpuCuller.setupInstanceAttribute(3);
+		// location 3 of shader_instanced.vert, advances once per instance so each command's baseInstance selects its cube
+	}
 	////This function specifies how OpenGL should interpret this data whenever a drawing call is made.
 	////first Parameter: specifies which vertex attribute we want to configure. REMEMBER ? we specified the location of position vertex attribute in the vertex shader with "layout (location=0)". This sets the location of the vertex attribute to 0 and since we want to pass data to this location we set it as 0
 	//// second Parameter: specifies the size of vertex attribute. Vertex attribute is a vec3 so we put 3.
@@ -285,10 +1688,7 @@ int main() {
 	//// fifth Parameter: it is known as stride and tells us the space between consecutive vertex attributes. As the next set of position data is 3*sizeof(float) away in the memory. So we write 3*sizeof(float). We could've set this to 0 and let the OpenGL determine the stride.(This only works when values are tightly packed or in a array.). We have to carefully determine the spacing between vertex attribute
 	//// sixth parameter: this is the offset of where the position data begins in buffer. Since the position data is at the start of array this value is just 0. We will explore it later on.
 	
-	glEnableVertexAttribArray(0); //Enables to draw the image
-	//glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
-	//first argument: from which VAO index to start
+	// setupAttributes also calls glEnableVertexAttribArray for each attribute, which enables it to draw the image
 
 	// note that this is allowed, the call to glVertexAttribPointer registered VBO as the vertex attribute's bound vertex buffer object so afterwards we can safely unbind
 	glBindBuffer(GL_ARRAY_BUFFER, 0);// Bounds the created buffer object (that have specific id) with the target type object (GL_ARRAY_BUFFER (vertex array buffer))
@@ -298,67 +1698,384 @@ int main() {
 	// You can unbind the VAO afterwards so other VAO calls won't accidentally modify this VAO, but this rarely happens. Modifying other
 	// VAOs requires a call to glBindVertexArray anyways so we generally don't unbind VAOs (nor VBOs) when it's not directly necessary.
 	glBindVertexArray(0);
+	cube.close();
+	// the mapping is only needed until the data is in GL buffers
 
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_POINT);
 
 	ourShader.use();// don't forget to activate / use the shader before setting uniforms.
-	ourShader.setInt("ourTexture", 0);
-	ourShader.setInt("ourTexture2", 1);
+	textureManager.setupShader(ourShader);
+	ourShader.setMat4("meshDecode", cubeDecode);
+	ourShader.setBool("octahedralNormals", cubeOctahedral);
+	instancedShader.use();
+	textureManager.setupShader(instancedShader);
+	instancedShader.setMat4("meshDecode", cubeDecode);
+	instancedShader.setBool("octahedralNormals", cubeOctahedral);
 
+	// ====================================================================================//
+	// Skinned characters: columns bending along a chain of joints. Two procedural clips are sampled and cross faded
+	// on the thread pool every frame and shader_skinned.vert blends each vertex's joints as dual quaternions.
+	const size_t columnJoints = 8;
+	const float columnBone = 0.35f;
+	Skeleton columnSkeleton = proceduralSkeleton(columnJoints, columnBone, true, 1);
+	std::vector<JointPose> swayFrames = proceduralClip(columnSkeleton, 4.0f, 30.0f, 0.25f, 1);
+	std::vector<JointPose> coilFrames = proceduralClip(columnSkeleton, 2.0f, 30.0f, 0.5f, 2);
+	AnimationClip swayClip = compressClip(swayFrames.data(), swayFrames.size() / columnJoints, columnJoints, 30.0f, "sway");
+	AnimationClip coilClip = compressClip(coilFrames.data(), coilFrames.size() / columnJoints, columnJoints, 30.0f, "coil");
+	std::vector<SkinnedVertex> columnVertices;
+	std::vector<uint32_t> columnIndices;
+	buildSkinnedColumn(columnSkeleton, columnBone, 0.3f, columnVertices, columnIndices);
+	glm::vec3 characterPos[]{
+		glm::vec3(-2.5f, -1.5f, -3.0f),
+		glm::vec3(2.2f, -1.8f, -2.0f),
+		glm::vec3(0.0f, -2.5f, -6.0f)
+	};
+	Character characters[3];
+	for (int i = 0; i < 3; i++) {
+		characters[i].skeleton = &columnSkeleton;
+		characters[i].clips[0] = &swayClip;
+		characters[i].clips[1] = &coilClip;
+		characters[i].times[0] = characters[i].times[1] = i * 0.7f;
+	}
+
+	unsigned int skinVAO, skinVBO, skinEBO;
+	glGenVertexArrays(1, &skinVAO);
+	glGenBuffers(1, &skinVBO);
+	glGenBuffers(1, &skinEBO);
+	glBindVertexArray(skinVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, skinVBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, skinEBO);
+	glBufferData(GL_ARRAY_BUFFER, columnVertices.size() * sizeof(SkinnedVertex), columnVertices.data(), GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, columnIndices.size() * sizeof(uint32_t), columnIndices.data(), GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (void*)offsetof(SkinnedVertex, position));
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (void*)offsetof(SkinnedVertex, normal));
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (void*)offsetof(SkinnedVertex, texCoord));
+	glVertexAttribIPointer(3, 4, GL_UNSIGNED_BYTE, sizeof(SkinnedVertex), (void*)offsetof(SkinnedVertex, joints));
+	// the I variant keeps joint indices as integers instead of converting them to floats
+	glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (void*)offsetof(SkinnedVertex, weights));
+	for (GLuint location = 0; location < 5; location++) {
+		glEnableVertexAttribArray(location);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+
+	Shader skinnedShader("shader_skinned.vert", textureManager.bindless ? "shader_bindless.frag" : "shader.frag");
+	skinnedShader.use();
+	textureManager.setupShader(skinnedShader);
+	int bonesLocation = glGetUniformLocation(skinnedShader.ID, "bones");
+
+	// Scene time: the wall clock with a window. Headless runs step a fixed 60th of a second per frame instead, so every
+	// run renders the same frames and their times can be compared between machines and builds.
+	int frame = 0;
+	auto sceneTime = [&]() { return headless ? frame / 60.0 : glfwGetTime(); };
+	std::vector<double> frameMs;
+	double animationTime = sceneTime();
+
+	// ====================================================================================//
+	// Particles: a fountain of 200k particles updated on the thread pool and drawn as instanced quads
+	// from a persistently mapped buffer.
+	ParticleSystem fountain(200000);
+	ParticleEmitter fountainEmitter;
+	fountainEmitter.position = glm::vec3(0.0f, -2.0f, -4.0f);
+	fountainEmitter.velocity = glm::vec3(0.0f, 5.0f, 0.0f);
+	fountainEmitter.spread = 1.2f;
+	fountainEmitter.lifetimeMin = 1.5f;
+	fountainEmitter.lifetimeMax = 2.5f;
+	fountainEmitter.color = 0xFFFFA040;
+	// RGBA8 with red in the low byte, a light blue
+	ParticleRenderer particleRenderer;
+	particleRenderer.init(fountain.capacity());
+	double particleTime = sceneTime();
+
+	StateTracker state;
+	// skips binds that would not change anything, all binds inside the render loop go through it.
+
+	LodSelector lodSelector;
+	// picks the coarsest level whose error stays under a pixel, going coarser only with a 25% margin so cubes don't pop
+	MeshletCuller culler;
+	culler.occlusionCulling = true;
+	std::vector<DrawElementsIndirectCommand> drawCommands;
+	unsigned int indirectBuffer;
+	glGenBuffers(1, &indirectBuffer);
+	// visible meshlet ranges are written to this buffer every frame and drawn with glMultiDrawElementsIndirect
+	MeshletCullStats cullTotals = {};
+	int cullFrames = 0;
+	double cullReportTime = sceneTime();
+	GpuProfiler gpuProfiler;
+	gpuProfiler.init();
+	gpuProfiler.keepHistory = gpuCsv != nullptr;
+	// GPU time of each part of the frame from timestamp queries, read a few frames late so the CPU never waits
+	RenderStats renderStats;
+	if (statsPath) {
+		renderStats.openStream(statsPath);
+	}
+	// draw calls, binds, uploads and frame times of the last 240 frames
+	int readWidth = screenWidth, readHeight = screenHeight;
+	if (main_window) {
+		glfwGetFramebufferSize(main_window, &readWidth, &readHeight);
+	}
+	recording.start(readWidth, readHeight);
+	// frames are written on the readback's own threads a few frames after they were drawn
 	
-	while (!glfwWindowShouldClose(main_window)) {
+	while (headless ? frame < headlessFrames : !glfwWindowShouldClose(main_window)) {
+		auto frameStart = std::chrono::steady_clock::now();
+		// closes the GL calls of the previous frame, its glFinish or swap included
+		GLInterposer::endFrame();
+		GLCapture::endFrame();
 
 		// Check for input--------------------------------------------------------------------------
-		processInput(main_window);
+		if (main_window) {
+			CPU_ZONE("processInput");
+			processInput(main_window);
+		}
+		size_t stateChangesBefore = state.changes;
 
 		//rendering commands here-------------------------------------------------------------------
+		gpuProfiler.beginFrame();
+		gpuProfiler.beginZone("frame");
+		gpuProfiler.beginZone("cubes");
+		CPU_ZONE_BEGIN("draw");
 		glClearColor(0.2f, 0.3f, 0.3f, 1.0f); // Clear the screen using this color.
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); //to clear the color buffer.
 
-		// bind textures on corresponding texture units.
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, texture);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, texture2);
-
-		ourShader.use();
-		glBindVertexArray(VAO);
+		state.useProgram(ourShader.ID);
+		textureManager.bindMaterial(ourShader, material, state);
+		// bindless only sets the material index, otherwise binds textures and samplers on corresponding texture units.
+		state.bindVertexArray(VAO);
 		glm::mat4 view = glm::mat4(1.0f);
 
 		view = glm::lookAt(cameraPos, cameraTarget, upDir);
 		//view = glm::translate(view, glm::vec3(4.0f, 0.0f, -4.0f));
 		//view = glm::rotate(view, (float)glm::radians(glfwGetTime()), glm::vec3(0.0f, 0.0f, 1.0f));
 		glm::mat4 projection = glm::mat4(1.0f);
-		projection = glm::perspective(glm::radians(55.0f), (float)800 / 600, 0.1f, 1000.0f);
+		projection = glm::perspective(glm::radians(55.0f), (float)screenWidth / screenHeight, 0.1f, 1000.0f);
 		ourShader.setMat4("view", view);
 		ourShader.setMat4("projection", projection);
 
+		// distance of a pixel plane with the same vertical fov, used to estimate how big each cube is on screen
+		float focalPixels = screenHeight / (2.0f * tan(glm::radians(55.0f) / 2.0f));
+
+		CPU_ZONE_BEGIN("matrices");
+		glm::mat4 cubeModel[5];
 		for (size_t i = 0; i < 5; i++) {
 			glm::mat4 transMat = glm::mat4(1.0f);
 			//transMat = glm::translate(transMat, glm::vec3(0.0f, 0.0f, -0.4f));
 			transMat = glm::translate(transMat, cubePos[i]);
 			float angle = i * 10;
-			transMat = glm::rotate(transMat, (float)(angle+glfwGetTime()), glm::vec3(0.3f, 0.2f, 0.3f));
-//			glUniformMatrix4fv(glGetUniformLocation(ourShader.ID, "transMat"), 1, GL_FALSE, glm::value_ptr(transMat));
+			transMat = glm::rotate(transMat, (float)(angle+sceneTime()), glm::vec3(0.3f, 0.2f, 0.3f));
+			cubeModel[i] = transMat;
+		}
+		CPU_ZONE_END();
+
+		// Meshlet culling on the CPU: every cube is drawn into a small software depth buffer first, then each cube's
+		// meshlets are tested against the frustum, their normal cone and that buffer. Survivors become indirect draws.
+		culler.beginFrame(view, projection, cameraPos);
+		culler.occlusion.clear();
+		for (size_t i = 0; i < 5; i++) {
+			culler.occlusion.rasterize(cubePositions.data(), cubeIndices.data(), cubeLods[0].indexCount, projection * view * cubeModel[i]);
+		}
+		drawCommands.clear();
+		size_t firstCommand[6];
+		for (size_t i = 0; i < 5; i++) {
+			firstCommand[i] = drawCommands.size();
+			const MeshLod& lod = cubeLods[lodSelector.select(i, cubeLods.data(), cubeLods.size(), glm::length(cubePos[i] - cameraPos), 1.0f, focalPixels)];
+			if (gpuCulling) {
+				gpuCuller.setInstance(i, { cubeModel[i], cubeSphere, lod.firstIndex, lod.indexCount, 0, 0 });
+				// only changed instances are uploaded, these cubes spin so all five are
+			} else {
+				culler.cull(cubeMeshlets.data() + lod.firstMeshlet, lod.meshletCount, cubeModel[i], 0, drawCommands);
+			}
+		}
+		firstCommand[5] = drawCommands.size();
+		if (gpuCulling) {
+			// GPU culling: the software depth buffer becomes a Hi-Z pyramid, a compute shader tests each cube against it and
+			// writes the draw commands, and glMultiDrawElementsIndirectCount draws however many it wrote.
+			GPU_ZONE(gpuProfiler, "gpu culling");
+			gpuCuller.updateHiZ(culler.occlusion.depth.data(), culler.occlusion.width, culler.occlusion.height, state);
+			gpuCuller.cull(view, projection, state);
+			state.useProgram(instancedShader.ID);
+			instancedShader.setMat4("view", view);
+			instancedShader.setMat4("projection", projection);
+			textureManager.bindMaterial(instancedShader, material, state);
+			gpuCuller.draw(cubeIndexType);
+		}
+		else {
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, drawCommands.size() * sizeof(DrawElementsIndirectCommand), drawCommands.data(), GL_STREAM_DRAW);
+			RENDER_STAT(BUFFER_BYTES, drawCommands.size() * sizeof(DrawElementsIndirectCommand));
+
+			for (size_t i = 0; i < 5; i++) {
+//				glUniformMatrix4fv(glGetUniformLocation(ourShader.ID, "transMat"), 1, GL_FALSE, glm::value_ptr(cubeModel[i]));
 	
-			ourShader.setMat4("model", transMat);
+				ourShader.setMat4("model", cubeModel[i]);
 		
-			//glDrawArrays(GL_TRIANGLES, 0, 3); // first parameter = OpenGL primitive type
-			glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0); // draws object from indices provided
-			// second parameter = starting index of vertex array we'd like to draw
-			// third parameter = number of vertices we want to draw
+				//glDrawArrays(GL_TRIANGLES, 0, 3); // first parameter = OpenGL primitive type
+				//glDrawElements(GL_TRIANGLES, cubeIndexCount, cubeIndexType, 0); // draws object from indices provided
+				// second parameter = starting index of vertex array we'd like to draw
+				// third parameter = number of vertices we want to draw
+				GLsizei commandCount = (GLsizei)(firstCommand[i + 1] - firstCommand[i]);
+				if (commandCount > 0) {
+					glMultiDrawElementsIndirect(GL_TRIANGLES, cubeIndexType, (void*)(firstCommand[i] * sizeof(DrawElementsIndirectCommand)), commandCount, 0);
+					RENDER_STAT(DRAW_CALLS, 1);
+					RENDER_STAT(INSTANCES, commandCount);
+					for (size_t c = firstCommand[i]; c < firstCommand[i + 1]; c++) {
+						RENDER_STAT(TRIANGLES, drawCommands[c].count / 3);
+					}
+					// draws every visible meshlet range of this cube, each command is count/instanceCount/firstIndex/baseVertex/baseInstance
+				}
+			}
+		}
+		for (size_t i = 0; i < 5; i++) {
+			textureManager.requestDetail(material, MipResidency::projectedSize(0.87f, glm::length(cubePos[i] - cameraPos), focalPixels));
+			// 0.87 is the radius of the sphere around a unit cube.
+		}
+
+		gpuProfiler.endZone();
+		gpuProfiler.beginZone("skinned");
+
+		// Skeletal animation: advance every character, evaluate all of them on the thread pool, then draw each
+		// with its palette. The blend between the clips drifts so the columns alternate between swaying and coiling.
+		float frameTime = (float)(sceneTime() - animationTime);
+		animationTime = sceneTime();
+		for (int i = 0; i < 3; i++) {
+			characters[i].times[0] += frameTime;
+			characters[i].times[1] += frameTime;
+			characters[i].blend = 0.5f + 0.5f * (float)sin(animationTime * 0.5 + i);
+		}
+		CPU_ZONE_BEGIN("animateCharacters");
+		animateCharacters(characters, 3, ThreadPool::global());
+		CPU_ZONE_END();
+		state.useProgram(skinnedShader.ID);
+		textureManager.bindMaterial(skinnedShader, material, state);
+		state.bindVertexArray(skinVAO);
+		skinnedShader.setMat4("view", view);
+		skinnedShader.setMat4("projection", projection);
+		for (int i = 0; i < 3; i++) {
+			skinnedShader.setMat4("model", glm::translate(glm::mat4(1.0f), characterPos[i]));
+			glUniformMatrix2x4fv(bonesLocation, (GLsizei)columnJoints, GL_FALSE, (const float*)characters[i].palette.data());
+			RENDER_STAT(UNIFORM_UPLOADS, 1);
+			// a dual quaternion is two quaternions, the same 8 floats as one mat2x4
+			glDrawElements(GL_TRIANGLES, (GLsizei)columnIndices.size(), GL_UNSIGNED_INT, 0);
+			RENDER_STAT(DRAW_CALLS, 1);
+			RENDER_STAT(INSTANCES, 1);
+			RENDER_STAT(TRIANGLES, columnIndices.size() / 3);
 		}
+
+		gpuProfiler.endZone();
+
+		// Particles last, they blend over everything and don't write depth.
+		gpuProfiler.beginZone("particles");
+		float particleStep = std::min((float)(sceneTime() - particleTime), 0.05f);
+		particleTime = sceneTime();
+		fountain.emit(fountainEmitter, (size_t)(fountain.capacity() * particleStep / 2.0f));
+		// about as many as die per frame, lifetimes average 2 seconds
+		CPU_ZONE_BEGIN("particle update");
+		fountain.update(particleStep, ThreadPool::global());
+		CPU_ZONE_END();
+		particleRenderer.draw(fountain, view, projection, state, ThreadPool::global());
+		gpuProfiler.endZone();
+		CPU_ZONE_END();
+		CPU_COUNTER("particles", fountain.size());
+		CPU_COUNTER("indirect draws", drawCommands.size());
+
+		if (gpuCulling && sceneTime() - cullReportTime >= 1.0) {
+			gpuCuller.requestDrawCount();
+		}
+		uint32_t gpuVisible;
+		if (gpuCulling && gpuCuller.pollDrawCount(gpuVisible)) {
+			// arrives a frame or two after the request, reading it right away would wait for the GPU
+			std::cout << "GPU culling: " << gpuVisible << " of 5 cubes visible" << std::endl;
+		}
+		cullTotals.triangles += culler.stats.triangles;
+		cullTotals.trianglesRejected += culler.stats.trianglesRejected;
+		cullTotals.frustumRejected += culler.stats.frustumRejected;
+		cullTotals.backfaceRejected += culler.stats.backfaceRejected;
+		cullTotals.occlusionRejected += culler.stats.occlusionRejected;
+		cullFrames++;
+		if (sceneTime() - cullReportTime >= 1.0) {
+			// the GPU path reports its visible count above, culler.stats only count the CPU path
+			if (!gpuCulling) {
+				std::cout << "Meshlet culling: " << cullTotals.trianglesRejected / cullFrames << " of " << cullTotals.triangles / cullFrames << " triangles rejected per frame (meshlets: "
+					<< cullTotals.frustumRejected / cullFrames << " frustum, " << cullTotals.backfaceRejected / cullFrames << " backface, " << cullTotals.occlusionRejected / cullFrames << " occluded)" << std::endl;
+			}
+			if (gpuProfiler.enabled) {
+				std::cout << "GPU ms: frame " << gpuProfiler.average("frame") << " (cubes " << gpuProfiler.average("cubes") << ", of that culling " << gpuProfiler.average("gpu culling")
+					<< ", skinned " << gpuProfiler.average("skinned") << ", particles " << gpuProfiler.average("particles") << ", streaming " << gpuProfiler.average("streaming") << ")" << std::endl;
+			}
+			std::cout << "Render stats: " << renderStats.average(RenderStats::DRAW_CALLS) << " draw calls, " << renderStats.average(RenderStats::TRIANGLES) << " triangles, "
+				<< renderStats.average(RenderStats::PROGRAM_BINDS) + renderStats.average(RenderStats::VAO_BINDS) + renderStats.average(RenderStats::TEXTURE_BINDS) + renderStats.average(RenderStats::SAMPLER_BINDS)
+				<< " binds, " << renderStats.average(RenderStats::UNIFORM_UPLOADS) << " uniform uploads, " << renderStats.average(RenderStats::BUFFER_BYTES) / 1024.0 << " KB buffers, "
+				<< renderStats.average(RenderStats::FENCE_WAITS) << " fence waits, CPU " << renderStats.average(RenderStats::CPU_FRAME_MS) << " ms (95% "
+				<< renderStats.percentile(RenderStats::CPU_FRAME_MS, 0.95) << " ms) per frame" << std::endl;
+			if (GLInterposer::installed()) {
+				GLInterposer::report(std::cout, 8);
+			}
+			cullTotals = MeshletCullStats();
+			cullFrames = 0;
+			cullReportTime = sceneTime();
+		}
+		gpuProfiler.beginZone("streaming");
+		textureManager.updateStreaming(state);
+		// uploads finer mips that were asked for this frame, or drops unused ones when over budget.
+		gpuProfiler.endZone();
+		gpuProfiler.endZone();
+		gpuProfiler.endFrame();
+		CPU_COUNTER("state changes", state.changes - stateChangesBefore);
+		renderStats.endFrame(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count(),
+			gpuProfiler.lastFrame().zones.empty() ? 0.0 : gpuProfiler.lastFrame().zones[0].ms);
+		// CPU time up to here, before waiting on the GPU. GPU time is from the newest frame the profiler finished.
+		recording.capture();
+
+		if (headless) {
+			CPU_ZONE_BEGIN("glFinish");
+			glFinish();
+			CPU_ZONE_END();
+			CPU_FRAME();
+			// nothing is presented, waiting for the GPU stands in for the swap so each frame's time includes its GPU work
+			frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+			frame++;
+			continue;
+		}
+
 		// check and call events and swap buffers here ---------------------------------------------
+		CPU_ZONE_BEGIN("glfwSwapBuffers");
 		glfwSwapBuffers(main_window);
+		CPU_ZONE_END();
+		CPU_FRAME();
 		// will swap the color buffer that is used to render to during this render iteration and show it as the output to the screen.
 		// Search for Double Buffer for more information.
 
 		glfwPollEvents(); // checking for key events or mouse movements.
 	}
+	// the calls after the loop tear the scene down, they are not part of any frame
+	GLCapture::stop();
+	recording.stop();
+	if (headless) {
+		std::cout << "Headless " << screenWidth << "x" << screenHeight << ", " << frame << " frames" << std::endl;
+		printFrameTimes(frameMs);
+		if (gpuCsv) {
+			glFinish();
+			gpuProfiler.beginFrame();
+			// collects the frames still in flight
+			if (gpuProfiler.writeCsv(gpuCsv)) {
+				std::cout << "GPU zone times of " << gpuProfiler.history().size() << " frames written to " << gpuCsv << std::endl;
+			}
+		}
+	}
 	glDeleteVertexArrays(1, &VAO);
 	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &EBO);
+	glDeleteBuffers(1, &indirectBuffer);
+	glDeleteVertexArrays(1, &skinVAO);
+	glDeleteBuffers(1, &skinVBO);
+	glDeleteBuffers(1, &skinEBO);
+	gpuCuller.release();
+	particleRenderer.release();
+	gpuProfiler.release();
+	textureManager.release();
+	headlessContext.release();
 
 	glfwTerminate();
 	return 0;